@@ -2,15 +2,33 @@
 # -*- coding: utf-8 -*-
 
 import unittest
+import errno
+import json
 import os
 import sys
 
 from wallix_term.wallix_term import (OutputFormat,
+                                     MinimapFormat,
+                                     MinimapGlyph,
                                      TranscriptPrefix,
+                                     TranscriptLineMode,
+                                     TranscriptAlternateScreen,
+                                     TranscriptFormat,
+                                     TranscriptOptions,
                                      Allocator,
                                      TerminalEmulatorException,
                                      TerminalEmulator,
-                                     TerminalEmulatorBuffer)
+                                     TerminalEmulatorBuffer,
+                                     Replay,
+                                     KeywordMatcher,
+                                     FrameIndex,
+                                     Mirror,
+                                     ThreadPool,
+                                     render_many,
+                                     render_many_into_buffer,
+                                     transcript_ttyrec_files,
+                                     ttyrec_remove_noop_frames,
+                                     ttyrec_reencode)
 
 
 unittest.util._MAX_LENGTH = 9999
@@ -64,6 +82,48 @@ class TestTerminalEmulator(unittest.TestCase):
         buf.prepare(term, OutputFormat.json)
         self.assertEqual(buf.as_bytes(), contents)
 
+    def test_region(self):
+        term = TerminalEmulator(3,10)
+        buf = TerminalEmulatorBuffer()
+        term.feed(b'abcdef\r\nghijkl')
+
+        buf.prepare(term, OutputFormat.text)
+        self.assertEqual(buf.as_bytes(), b'abcdef\nghijkl\n\n')
+
+        buf.prepare_region(term, OutputFormat.text, 0, 1, 1, 2)
+        self.assertEqual(buf.as_bytes(), b'bc\nhi\n')
+
+    def test_minimap(self):
+        term = TerminalEmulator(3,10)
+        buf = TerminalEmulatorBuffer()
+        term.feed(b'aaab')
+
+        buf.prepare_minimap(term, MinimapFormat.json, 2, 4, MinimapGlyph.dominant)
+        self.assertEqual(buf.as_bytes(), br'{"lines":2,"columns":3,"data":[{"s":"a  ","f":[16777215,16777215,16777215],"b":[0,0,0]},{"s":"   ","f":[16777215,16777215,16777215],"b":[0,0,0]}]}')
+
+        buf.prepare_minimap(term, MinimapFormat.rgb)
+        self.assertEqual(len(buf.as_bytes()), 2 * 3 * 3)
+
+    def test_render_many(self):
+        terms = [TerminalEmulator(3,10) for i in range(4)]
+        bufs = [TerminalEmulatorBuffer() for i in range(4)]
+        for i, term in enumerate(terms):
+            term.feed(b'term %d' % i)
+
+        pool = ThreadPool(2)
+        render_many(terms, bufs, OutputFormat.json, pool)
+
+        expected = []
+        buf = TerminalEmulatorBuffer()
+        for term, term_buf in zip(terms, bufs):
+            buf.prepare(term, OutputFormat.json)
+            expected.append(buf.as_bytes())
+            self.assertEqual(term_buf.as_bytes(), expected[-1])
+
+        offsets = render_many_into_buffer(buf, terms, OutputFormat.json, pool)
+        data = buf.as_bytes()
+        self.assertEqual([data[offsets[i]:offsets[i+1]] for i in range(4)], expected)
+
     def test_buffer_transcript(self):
         os.environ["TZ"] = "CET-1CEST,M3.5.0,M10.5.0/3" # for localtime_r
 
@@ -76,6 +136,60 @@ class TestTerminalEmulator(unittest.TestCase):
                          "2017-11-29 17:29:05 browser/  Jamroot  out_text  README.md   src/         tools/  vt-emulator.kdev4\n"
                          "2017-11-29 17:29:06 [2]~/projects/vt-emulator!4903$(nomove)✗                 ~/projects/vt-𨭎ator\n".encode())
 
+    def test_buffer_stream(self):
+        os.environ["TZ"] = "CET-1CEST,M3.5.0,M10.5.0/3" # for localtime_r
+
+        buf = TerminalEmulatorBuffer()
+        buf.prepare_transcript_from_ttyrec_file("../test/data/ttyrec1", TranscriptPrefix.datetime)
+        ref = buf.as_bytes()
+
+        blocks = []
+        buf = TerminalEmulatorBuffer.stream_to_callback(blocks.append, 16)
+        buf.prepare_transcript_from_ttyrec_file("../test/data/ttyrec1", TranscriptPrefix.datetime)
+        self.assertEqual(b''.join(blocks), ref)
+        self.assertEqual(len(blocks), 4)
+        self.assertEqual(buf.as_bytes(), b'')
+
+        r, w = os.pipe()
+        buf = TerminalEmulatorBuffer.stream_to_fd(w)
+        buf.prepare_transcript_from_ttyrec_file("../test/data/ttyrec1", TranscriptPrefix.datetime)
+        os.close(w)
+        self.assertEqual(os.read(r, len(ref) + 1), ref)
+        os.close(r)
+
+        def write_error(data):
+            raise OSError(28, 'No space left on device')
+
+        buf = TerminalEmulatorBuffer.stream_to_callback(write_error)
+        with self.assertRaises(TerminalEmulatorException):
+            buf.prepare_transcript_from_ttyrec_file("../test/data/ttyrec1", TranscriptPrefix.datetime)
+
+    def test_transcript_line_mode(self):
+        data = b'$ l\x1b[B\x1b[As\r\nfoo\r\n$ '
+        ttyrec = (0).to_bytes(8, 'little') + len(data).to_bytes(4, 'little') + data
+
+        buf = TerminalEmulatorBuffer()
+        buf.prepare_transcript_from_ttyrec_buffer(ttyrec, TranscriptPrefix.noprefix)
+        self.assertEqual(buf.as_bytes(), b'$ l\n\n$ ls\nfoo\n')
+
+        options = TranscriptOptions(TranscriptPrefix.noprefix, TranscriptLineMode.commit)
+        buf.prepare_transcript_from_ttyrec_buffer(ttyrec, options)
+        self.assertEqual(buf.as_bytes(), b'$ ls\nfoo\n$ \n')
+
+        data = b'a\r\n\x1b[?1049hvim1\x1b[Hvim2\x1b[?1049lb\r\n'
+        ttyrec = (0).to_bytes(8, 'little') + len(data).to_bytes(4, 'little') + data
+        options = TranscriptOptions(TranscriptPrefix.noprefix,
+                                    alternate_screen=TranscriptAlternateScreen.snapshot)
+        buf.prepare_transcript_from_ttyrec_buffer(ttyrec, options)
+        self.assertEqual(buf.as_bytes(), b'a\nvim2\nb\n')
+
+        options = TranscriptOptions(TranscriptPrefix.noprefix, format=TranscriptFormat.jsonl)
+        buf.prepare_transcript_from_ttyrec_buffer(ttyrec, options)
+        self.assertEqual(buf.as_bytes(),
+                         b'{"t":0,"y":0,"g":0,"a":false,"s":"a"}\n'
+                         b'{"t":0,"y":0,"g":1,"a":true,"s":"vim1"}\n'
+                         b'{"t":0,"y":1,"g":2,"a":false,"s":"b"}\n')
+
     def test_transcript(self):
         os.environ["TZ"] = "CET-1CEST,M3.5.0,M10.5.0/3" # for localtime_r
         outfile = "/tmp/emu_transcript_py.txt"
@@ -90,6 +204,307 @@ class TestTerminalEmulator(unittest.TestCase):
                          "2017-11-29 17:29:06 [2]~/projects/vt-emulator!4903$(nomove)✗                 ~/projects/vt-𨭎ator\n"
                          "".encode())
 
+    def test_transcript_from_fd(self):
+        options = TranscriptOptions(TranscriptPrefix.noprefix)
+        expected = TerminalEmulatorBuffer()
+        expected.prepare_transcript_from_ttyrec_file("../test/data/ttyrec1", options)
+
+        r, w = os.pipe()
+        try:
+            os.write(w, read_file("../test/data/ttyrec1"))
+            os.close(w)
+            buf = TerminalEmulatorBuffer()
+            buf.prepare_transcript_from_ttyrec_fd(r, options)
+        finally:
+            os.close(r)
+        self.assertEqual(buf.as_bytes(), expected.as_bytes())
+
+        frames = []
+        replay = Replay()
+        replay.add_frame_callback(lambda emu, sec, usec: frames.append(sec))
+        with open("../test/data/ttyrec1", "rb") as f:
+            replay.run_ttyrec_fd(f.fileno())
+        self.assertEqual(frames[-1], 1511972946)
+
+    def test_transcript_time_window(self):
+        ttyrec = b''
+        for sec, data in ((0, b'a\r\n'), (5, b'b\r\n'), (10, b'c\r\n')):
+            ttyrec += sec.to_bytes(4, 'little') + (0).to_bytes(4, 'little') + len(data).to_bytes(4, 'little') + data
+
+        buf = TerminalEmulatorBuffer()
+        options = TranscriptOptions(TranscriptPrefix.noprefix)
+        buf.prepare_transcript_from_ttyrec_buffer_with_time_window(ttyrec, options, 5, 10)
+        self.assertEqual(buf.as_bytes(), b'b\n')
+
+        with self.assertRaises(TerminalEmulatorException):
+            buf.prepare_transcript_from_ttyrec_buffer_with_time_window(ttyrec, options, 10, 5)
+
+    def test_transcript_parallel(self):
+        ttyrec = b''
+        for sec, data in ((0, b'a\r\nb'), (5, b'c\r\n\xc3'), (10, b'\xa9\r\n')):
+            ttyrec += sec.to_bytes(4, 'little') + (0).to_bytes(4, 'little') + len(data).to_bytes(4, 'little') + data
+
+        buf = TerminalEmulatorBuffer()
+        options = TranscriptOptions(TranscriptPrefix.noprefix)
+        buf.prepare_transcript_from_ttyrec_buffer_parallel(ttyrec, options, ThreadPool(2), 1)
+        self.assertEqual(buf.as_bytes(), 'a\nbc\né\n'.encode())
+
+        buf.prepare_transcript_from_ttyrec_file('../test/data/ttyrec1', options)
+        expected = buf.as_bytes()
+        buf.prepare_transcript_from_ttyrec_file_parallel('../test/data/ttyrec1', options, segment_size=4096)
+        self.assertEqual(buf.as_bytes(), expected)
+
+    def test_transcript_ttyrec_files(self):
+        os.environ["TZ"] = "CET-1CEST,M3.5.0,M10.5.0/3" # for localtime_r
+        options = TranscriptOptions(TranscriptPrefix.datetime)
+        buf = TerminalEmulatorBuffer()
+        buf.prepare_transcript_from_ttyrec_file('../test/data/ttyrec1', options)
+
+        outfiles = ['/tmp/emu_batch_py1.txt', '/tmp/emu_batch_py2.txt']
+        results = transcript_ttyrec_files(['../test/data/ttyrec1', '/unknown/file'],
+                                          outfiles, options, ThreadPool(2))
+        self.assertEqual(results, [0, errno.ENOENT])
+        self.assertEqual(read_file(outfiles[0]), buf.as_bytes())
+
+    def test_replay(self):
+        os.environ["TZ"] = "CET-1CEST,M3.5.0,M10.5.0/3" # for localtime_r
+        text = TerminalEmulatorBuffer()
+        jsonl = TerminalEmulatorBuffer()
+        snapshots = TerminalEmulatorBuffer()
+        frames = []
+
+        def on_frame(emu, sec, usec):
+            buf = TerminalEmulatorBuffer()
+            buf.prepare(emu, OutputFormat.text)
+            frames.append(buf.as_bytes())
+
+        replay = Replay()
+        replay.add_transcript(text, TranscriptOptions(TranscriptPrefix.datetime))
+        replay.add_transcript(jsonl, TranscriptOptions(TranscriptPrefix.noprefix, format=TranscriptFormat.jsonl))
+        replay.add_snapshots(snapshots, OutputFormat.text)
+        replay.add_frame_callback(on_frame)
+        replay.run_ttyrec_file("../test/data/ttyrec1")
+
+        buf = TerminalEmulatorBuffer()
+        buf.prepare_transcript_from_ttyrec_file("../test/data/ttyrec1", TranscriptPrefix.datetime)
+        self.assertEqual(text.as_bytes(), buf.as_bytes())
+        self.assertEqual(jsonl.as_bytes().count(b'\n'), 4)
+        self.assertEqual(snapshots.as_bytes(), frames[-1] + b'\n')
+
+        def on_frame_error(emu, sec, usec):
+            raise OSError(28, 'No space left on device')
+
+        replay.add_frame_callback(on_frame_error)
+        with self.assertRaises(TerminalEmulatorException):
+            replay.run_ttyrec_file("../test/data/ttyrec1")
+
+    def test_replay_screenshots(self):
+        screens = {}
+
+        def on_frame(emu, sec, usec):
+            buf = TerminalEmulatorBuffer()
+            buf.prepare(emu, OutputFormat.json)
+            screens[sec * 1000000 + usec] = buf.as_bytes()
+
+        screenshots = []
+        replay = Replay()
+        replay.add_frame_callback(on_frame)
+        replay.run_ttyrec_file("../test/data/ttyrec1")
+        times = sorted(screens)
+
+        replay = Replay()
+        replay.add_screenshots(OutputFormat.json, times,
+                               lambda i, time, data: screenshots.append((i, time, data)))
+        replay.run_ttyrec_file("../test/data/ttyrec1")
+        self.assertEqual(screenshots, [(i, time, screens[time]) for i, time in enumerate(times)])
+
+        screenshots = []
+        replay = Replay()
+        replay.add_screenshots_every(OutputFormat.json, 1000000,
+                                     lambda i, time, data: screenshots.append(time))
+        replay.run_ttyrec_file("../test/data/ttyrec1")
+        self.assertEqual(screenshots, list(range(times[0], times[-1] + 1, 1000000)))
+
+    def test_replay_timeline(self):
+        timeline = TerminalEmulatorBuffer()
+        replay = Replay()
+        replay.add_timeline(timeline, 1000)
+        replay.run_ttyrec_file("../test/data/ttyrec1")
+
+        entries = [json.loads(line) for line in timeline.as_bytes().splitlines()]
+        self.assertGreater(len(entries), 0)
+        self.assertEqual(sorted(entries[0]), ['a', 'b', 'c', 'e', 'l', 'r', 't'])
+        times = [entry['t'] for entry in entries]
+        self.assertEqual(times, sorted(set(times)))
+        self.assertTrue(all(t % 1000000 == 0 for t in times))
+
+        data = read_file("../test/data/ttyrec1")
+        total_bytes = 0
+        while data:
+            frame_len = int.from_bytes(data[8:12], 'little')
+            total_bytes += frame_len
+            data = data[12 + frame_len:]
+        self.assertEqual(sum(entry['b'] for entry in entries), total_bytes)
+
+    def test_keyword_alert(self):
+        matcher = KeywordMatcher(["rm -rf", "readme", "Jamroot"], ignore_ascii_case=True)
+        alerts = []
+
+        def on_alert(pattern_id, row, sec, usec):
+            alerts.append((pattern_id, row))
+
+        emu = TerminalEmulator(4, 10)
+        emu.set_keyword_alert(matcher, on_alert)
+        emu.feed(b"$ sudo RM -Rf /\r\na\r\nb\r\nc\r\n")
+        self.assertEqual(alerts, [(0, 1)])
+        emu.feed(b"cat README")
+        emu.finish()
+        self.assertEqual(alerts, [(0, 1), (1, 3)])
+
+        def on_alert_error(pattern_id, row, sec, usec):
+            raise OSError(28, 'No space left on device')
+
+        emu.set_keyword_alert(matcher, on_alert_error)
+        emu.feed(b"\r\nrm -rf\r\n")
+        with self.assertRaises(TerminalEmulatorException):
+            emu.finish()
+
+        emu.set_keyword_alert(None)
+        emu.feed(b"rm -rf\r\n")
+        emu.finish()
+
+        alerts = []
+        replay = Replay()
+        replay.add_keyword_alert(matcher, lambda pattern_id, row, sec, usec: alerts.append((pattern_id, sec)))
+        replay.run_ttyrec_file("../test/data/ttyrec1")
+        self.assertEqual(sorted(alerts), [(1, 1511972946), (2, 1511972946)])
+
+    def test_frame_index(self):
+        frames = []
+
+        def on_frame(emu, sec, usec):
+            buf = TerminalEmulatorBuffer()
+            buf.prepare(emu, OutputFormat.json)
+            frames.append(((sec, usec), buf.as_bytes()))
+
+        replay = Replay()
+        replay.add_frame_callback(on_frame)
+        replay.run_ttyrec_file("../test/data/ttyrec1")
+
+        index = FrameIndex()
+        index.build_from_ttyrec_file("../test/data/ttyrec1", 20, 80, keyframe_interval=1)
+        index.save("/tmp/wallix_term_frame_index.idx")
+        loaded = FrameIndex()
+        loaded.load("/tmp/wallix_term_frame_index.idx")
+        self.assertEqual(len(loaded), len(frames))
+
+        emu = TerminalEmulator(3, 3)
+        buf = TerminalEmulatorBuffer()
+        i = len(frames) // 2
+        while frames[i + 1][0] == frames[i][0]:
+            i += 1
+        self.assertEqual(loaded.frame_time(i), frames[i][0])
+        loaded.seek(emu, "../test/data/ttyrec1", *frames[i][0])
+        buf.prepare(emu, OutputFormat.json)
+        self.assertEqual(buf.as_bytes(), frames[i][1])
+
+        with self.assertRaises(TerminalEmulatorException):
+            loaded.load("../test/data/ttyrec1")
+
+    def test_serialize(self):
+        emu = TerminalEmulator(4, 12, "title")
+        emu.feed(b"ab\033[1;31mcd\r\nef\033[")
+        state = emu.serialize()
+
+        emu2 = TerminalEmulator(3, 3)
+        emu2.deserialize(state)
+        emu.feed(b"mgh")
+        emu2.feed(b"mgh")
+        buf = TerminalEmulatorBuffer()
+        buf.prepare(emu, OutputFormat.json)
+        buf2 = TerminalEmulatorBuffer()
+        buf2.prepare(emu2, OutputFormat.json)
+        self.assertEqual(buf.as_bytes(), buf2.as_bytes())
+
+        with self.assertRaises(TerminalEmulatorException):
+            emu2.deserialize(state[:-1])
+
+    def test_journal(self):
+        emu = TerminalEmulator(4, 12)
+        emu.set_journal(64 * 1024)
+        buf = TerminalEmulatorBuffer()
+        screens = []
+        for frame in (b"abc\r\n", b"\033[31mdef", b"\033]2;title\007\033[2J"):
+            buf.prepare(emu, OutputFormat.json)
+            screens.append(buf.as_bytes())
+            emu.feed(frame)
+        self.assertEqual(emu.journal_frame_count(), 3)
+
+        for screen in reversed(screens):
+            self.assertTrue(emu.undo_frame())
+            buf.prepare(emu, OutputFormat.json)
+            self.assertEqual(buf.as_bytes(), screen)
+        self.assertFalse(emu.undo_frame())
+
+    def test_ttyrec_remove_noop_frames(self):
+        outfile = "/tmp/wallix_term_noop_frames.ttyrec"
+        nb_read, nb_written = ttyrec_remove_noop_frames("../test/data/ttyrec1", outfile, 24, 80)
+        self.assertGreater(nb_read, 0)
+        self.assertLessEqual(nb_written, nb_read)
+
+        def transcript(infile):
+            buf = TerminalEmulatorBuffer()
+            buf.prepare_transcript_from_ttyrec_file(infile, TranscriptPrefix.noprefix)
+            return buf.as_bytes()
+
+        self.assertEqual(transcript(outfile), transcript("../test/data/ttyrec1"))
+        os.unlink(outfile)
+
+    def test_mirror(self):
+        emu = TerminalEmulator(4, 10)
+        viewer = TerminalEmulator(4, 10)
+        mirror = Mirror(4, 10, use_repeat=True)
+        buf = TerminalEmulatorBuffer()
+
+        def screen(emu):
+            buf.prepare(emu, OutputFormat.json)
+            return buf.as_bytes()
+
+        for s in (b"$ ls\r\n", b"\033[1;34mdir\033[0m  file\r\n$ ", b"\033]2;title\007----------"):
+            emu.feed(s)
+            viewer.feed(mirror.update(emu))
+            self.assertEqual(screen(viewer), screen(emu))
+        self.assertEqual(mirror.update(emu), b"")
+
+        mirror.reset()
+        sequences = mirror.update(emu, buf)
+        self.assertTrue(sequences.startswith(b"\033c"))
+        viewer = TerminalEmulator(4, 10)
+        viewer.feed(b"garbage")
+        viewer.feed(sequences)
+        self.assertEqual(screen(viewer), screen(emu))
+
+    def test_ttyrec_reencode(self):
+        outfile = "/tmp/wallix_term_reencode.ttyrec"
+        nb_read, nb_written = ttyrec_reencode("../test/data/ttyrec1", outfile, 24, 80)
+        self.assertGreater(nb_written, 0)
+        self.assertLessEqual(nb_written, nb_read)
+        self.assertLess(os.path.getsize(outfile), os.path.getsize("../test/data/ttyrec1"))
+
+        def last_screen(infile):
+            emu = TerminalEmulator(24, 80)
+            data = read_file(infile)
+            while len(data) >= 12:
+                frame_len = int.from_bytes(data[8:12], "little")
+                emu.feed(data[12:12 + frame_len])
+                data = data[12 + frame_len:]
+            buf = TerminalEmulatorBuffer()
+            buf.prepare(emu, OutputFormat.json)
+            return buf.as_bytes()
+
+        self.assertEqual(last_screen(outfile), last_screen("../test/data/ttyrec1"))
+        os.unlink(outfile)
+
     def test_buffer_transcript_big_file(self):
         os.environ["TZ"] = "CET-1CEST,M3.5.0,M10.5.0/3" # for localtime_r
         buf = TerminalEmulatorBuffer()
@@ -7,14 +7,24 @@ from .wallix_term_lib import (lib,
                               TerminalEmulatorBufferSetFinalBufferFn,
                               TerminalEmulatorBufferClearFn,
                               TerminalEmulatorBufferDeleteCtxFn,
+                              TerminalEmulatorBufferWriteFn,
+                              TerminalEmulatorReplayFrameFn,
+                              TerminalEmulatorReplayScreenshotFn,
+                              TerminalEmulatorKeywordAlertFn,
                               TerminalEmulatorOutputFormat as OutputFormat,
+                              TerminalEmulatorMinimapFormat as MinimapFormat,
+                              TerminalEmulatorMinimapGlyph as MinimapGlyph,
+                              TerminalEmulatorImageFormat as ImageFormat,
                               TerminalEmulatorTranscriptPrefix as TranscriptPrefix,
+                              TerminalEmulatorTranscriptLineMode as TranscriptLineMode,
+                              TerminalEmulatorTranscriptAlternateScreen as TranscriptAlternateScreen,
+                              TerminalEmulatorTranscriptFormat as TranscriptFormat,
                               )
 from collections import namedtuple
-from ctypes import byref, cast, c_size_t, c_char, c_void_p, Array, addressof
+from ctypes import byref, cast, c_size_t, c_uint32, c_uint64, c_char, c_char_p, c_int, c_void_p, Array, addressof, string_at
 from enum import Enum
 from os import fsencode, strerror, PathLike
-from typing import Callable, Any, Optional, Union, Tuple, NamedTuple
+from typing import Callable, Any, Optional, Union, Tuple, NamedTuple, Sequence, List
 
 
 PathLikeObject = Union[str, bytes, PathLike]
@@ -22,9 +32,34 @@ PathLikeObject = Union[str, bytes, PathLike]
 
 # OutputFormat.json = 0
 # OutputFormat.ansi = 1
+# OutputFormat.text = 2
+
+# MinimapFormat.json = 0
+# MinimapFormat.rgb = 1
+
+# MinimapGlyph.density = 0
+# MinimapGlyph.dominant = 1
+
+# ImageFormat.ppm = 0
+# ImageFormat.pam = 1
 
 # TranscriptPrefix.noprefix = 0
 # TranscriptPrefix.datetime = 1
+# TranscriptPrefix.datetime_utc = 2
+# TranscriptPrefix.epoch = 3
+# TranscriptPrefix.iso8601_ms = 4
+# TranscriptPrefix.iso8601_us = 5
+# TranscriptPrefix.iso8601_ms_utc = 6
+# TranscriptPrefix.iso8601_us_utc = 7
+
+# TranscriptLineMode.cursor_move = 0
+# TranscriptLineMode.commit = 1
+
+# TranscriptAlternateScreen.lines = 0
+# TranscriptAlternateScreen.snapshot = 1
+
+# TranscriptFormat.text = 0
+# TranscriptFormat.jsonl = 1
 
 
 class Allocator(NamedTuple):
@@ -56,6 +91,102 @@ def _check_errnum(errnum: int) -> None:
     raise TerminalEmulatorException(strerror(errnum))
 
 
+class ThreadPool:
+    __slot__ = ('_ctx')
+
+    def __init__(self, nb_thread: int = 0) -> None:
+        self._ctx = lib.terminal_emulator_thread_pool_new(nb_thread)
+
+        if not self._ctx:
+            raise TerminalEmulatorException("malloc error")
+
+    def __del__(self) -> None:
+        lib.terminal_emulator_thread_pool_delete(self._ctx)
+
+
+class TranscriptOptions:
+    __slot__ = ('_ctx')
+
+    def __init__(self,
+                 prefix_type: TranscriptPrefix = TranscriptPrefix.datetime,
+                 line_mode: TranscriptLineMode = TranscriptLineMode.cursor_move,
+                 alternate_screen: TranscriptAlternateScreen = TranscriptAlternateScreen.lines,
+                 snapshot_interval: int = 0,
+                 format: TranscriptFormat = TranscriptFormat.text) -> None:
+        self._ctx = lib.terminal_emulator_transcript_options_new()
+
+        if not self._ctx:
+            raise TerminalEmulatorException("malloc error")
+
+        self.set_prefix(prefix_type)
+        self.set_line_mode(line_mode)
+        self.set_alternate_screen(alternate_screen, snapshot_interval)
+        self.set_format(format)
+
+    def __del__(self) -> None:
+        lib.terminal_emulator_transcript_options_delete(self._ctx)
+
+    def set_prefix(self, prefix_type: TranscriptPrefix) -> None:
+        _check_errnum(lib.terminal_emulator_transcript_options_set_prefix(self._ctx, prefix_type))
+
+    def set_line_mode(self, line_mode: TranscriptLineMode) -> None:
+        _check_errnum(lib.terminal_emulator_transcript_options_set_line_mode(self._ctx, line_mode))
+
+    def set_alternate_screen(self, alternate_screen: TranscriptAlternateScreen, snapshot_interval: int = 0) -> None:
+        """
+        snapshot_interval in seconds of recording, 0 for disable
+        """
+        _check_errnum(lib.terminal_emulator_transcript_options_set_alternate_screen(
+            self._ctx, alternate_screen, snapshot_interval))
+
+    def set_format(self, format: TranscriptFormat) -> None:
+        _check_errnum(lib.terminal_emulator_transcript_options_set_format(self._ctx, format))
+
+
+def _make_keyword_alert_fn(func: Callable[[int, int, int, int], None]):
+    def alert_fn(ctx, pattern_id, row, sec, usec):
+        try:
+            func(pattern_id, row, sec, usec)
+        except OSError as e:
+            return e.errno or -1
+        except Exception:
+            return -1
+        return 0
+
+    return TerminalEmulatorKeywordAlertFn(alert_fn)
+
+
+def _make_screenshot_fn(func: Callable[[int, int, bytes], None]):
+    def screenshot_fn(ctx, i, time, data, len):
+        try:
+            func(i, time, string_at(data, len))
+        except OSError as e:
+            return e.errno or -1
+        except Exception:
+            return -1
+        return 0
+
+    return TerminalEmulatorReplayScreenshotFn(screenshot_fn)
+
+
+class KeywordMatcher:
+    """
+    Keywords searched in the lines of the emulators, the id of a keyword is its index.
+    A matcher can be shared by several emulators and replays.
+    """
+    __slot__ = ('_ctx')
+
+    def __init__(self, patterns: Sequence[str], ignore_ascii_case: bool = False) -> None:
+        cpatterns = (c_char_p * len(patterns))(*(p.encode() for p in patterns))
+        self._ctx = lib.terminal_emulator_keyword_matcher_new(cpatterns, len(patterns), int(ignore_ascii_case))
+
+        if not self._ctx:
+            raise TerminalEmulatorException("malloc error")
+
+    def __del__(self) -> None:
+        lib.terminal_emulator_keyword_matcher_delete(self._ctx)
+
+
 class TerminalEmulator:
     __slot__ = ('_ctx')
 
@@ -84,9 +215,65 @@ class TerminalEmulator:
     def feed(self, s: bytes) -> None:
         _check_errnum(lib.terminal_emulator_feed(self._ctx, s, len(s)))
 
+    def finish(self) -> None:
+        _check_errnum(lib.terminal_emulator_finish(self._ctx))
+
     def resize(self, lines: int, columns: int) -> None:
         _check_errnum(lib.terminal_emulator_resize(self._ctx, lines, columns))
 
+    def serialize(self, buffer: Optional['TerminalEmulatorBuffer'] = None) -> bytes:
+        """
+        Full state of the emulator, restored by deserialize().
+        """
+        if buffer is None:
+            buffer = TerminalEmulatorBuffer()
+        _check_errnum(lib.terminal_emulator_serialize(self._ctx, buffer._ctx))
+        return buffer.as_bytes()
+
+    def deserialize(self, data: bytes) -> None:
+        _check_errnum(lib.terminal_emulator_deserialize(self._ctx, data, len(data)))
+
+    def set_journal(self, max_bytes: int) -> None:
+        """
+        Keep the reverse changes of each feed() and finish() for undo_frame().
+        0 for disable.
+        """
+        _check_errnum(lib.terminal_emulator_set_journal(self._ctx, max_bytes))
+
+    def undo_frame(self) -> bool:
+        """
+        Restore the state before the last frame of the journal.
+        Return False when the journal is empty.
+        """
+        errnum = lib.terminal_emulator_undo_frame(self._ctx)
+        if errnum == -1:
+            return False
+        _check_errnum(errnum)
+        return True
+
+    def journal_frame_count(self) -> int:
+        return lib.terminal_emulator_journal_frame_count(self._ctx)
+
+    def set_keyword_alert(self, matcher: Optional[KeywordMatcher],
+                          func: Optional[Callable[[int, int, int, int], None]] = None) -> None:
+        """
+        func(pattern_id, row, sec, usec) is called for each keyword of matcher found in a committed line
+        (when the line is scrolled out, erased, overwritten or by finish()).
+        An exception is raised by feed() or finish().
+        None for disable.
+        """
+        alert_fn = _make_keyword_alert_fn(func) if matcher else TerminalEmulatorKeywordAlertFn()
+        _check_errnum(lib.terminal_emulator_set_keyword_alert(
+            self._ctx, matcher._ctx if matcher else None, alert_fn, None))
+        # extend lifetime
+        self._keyword_alert = (matcher, alert_fn)
+
+    def set_parallel_rendering(self, pool: Optional[ThreadPool], min_cells: int = 64 * 1024) -> None:
+        _check_errnum(lib.terminal_emulator_set_parallel_rendering(
+            self._ctx, pool._ctx if pool else None, min_cells))
+        # extend lifetime
+        self._pool = pool
+
 
 class TerminalEmulatorBuffer:
     __slot__ = ('_ctx', '_allocator')
@@ -108,6 +295,43 @@ class TerminalEmulatorBuffer:
         if not self._ctx:
             raise Exception("malloc error")
 
+    @classmethod
+    def stream_to_fd(cls, fd: int, block_size: int = 0) -> 'TerminalEmulatorBuffer':
+        """
+        Renderings are written in fd by blocks of block_size bytes (0 for 1 MiB)
+        """
+        return cls._from_ctx(lib.terminal_emulator_buffer_new_stream_to_fd(fd, block_size), None)
+
+    @classmethod
+    def stream_to_callback(cls, func: Callable[[bytes], None], block_size: int = 0) -> 'TerminalEmulatorBuffer':
+        """
+        Renderings are sent to func by blocks of block_size bytes (0 for 1 MiB).
+        func is called from a dedicated thread, an OSError stops the rendering.
+        """
+        def write_fn(ctx, data, n):
+            try:
+                func(string_at(data, n))
+            except OSError as e:
+                return e.errno or -1
+            except Exception:
+                return -1
+            return 0
+
+        write_fn = TerminalEmulatorBufferWriteFn(write_fn)
+        return cls._from_ctx(lib.terminal_emulator_buffer_new_stream_to_callback(None, write_fn, block_size),
+                             write_fn)
+
+    @classmethod
+    def _from_ctx(cls, ctx, write_fn) -> 'TerminalEmulatorBuffer':
+        if not ctx:
+            raise Exception("malloc error")
+
+        buf = cls.__new__(cls)
+        buf._ctx = ctx
+        # extend lifetime
+        buf._allocator = write_fn
+        return buf
+
     def __del__(self) -> None:
         lib.terminal_emulator_buffer_delete(self._ctx)
 
@@ -118,17 +342,93 @@ class TerminalEmulatorBuffer:
         else:
             _check_errnum(lib.terminal_emulator_buffer_prepare(self._ctx, emu._ctx, int(format)))
 
+    def prepare_region(self, emu: TerminalEmulator, format: OutputFormat,
+                       first_line: int, last_line: int, first_column: int, last_column: int) -> None:
+        """
+        Bounds are included
+        """
+        _check_errnum(lib.terminal_emulator_buffer_prepare_region(
+            self._ctx, emu._ctx, int(format), first_line, last_line, first_column, last_column))
+
+    def prepare_minimap(self, emu: TerminalEmulator, format: MinimapFormat,
+                        block_lines: int = 2, block_columns: int = 4,
+                        glyph: MinimapGlyph = MinimapGlyph.density) -> None:
+        _check_errnum(lib.terminal_emulator_buffer_prepare_minimap(
+            self._ctx, emu._ctx, int(format), block_lines, block_columns, int(glyph)))
+
+    def prepare_image(self, emu: TerminalEmulator, format: ImageFormat = ImageFormat.ppm, scale: int = 1) -> None:
+        _check_errnum(lib.terminal_emulator_buffer_prepare_image(self._ctx, emu._ctx, int(format), scale))
+
     def prepare_transcript_from_ttyrec_file(self,
                                             infile: PathLikeObject,
-                                            prefix_type: TranscriptPrefix = TranscriptPrefix.datetime) -> None:
-        _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(
-            self._ctx, fsencode(infile), prefix_type))
+                                            prefix_type: Union[TranscriptPrefix, TranscriptOptions] = TranscriptPrefix.datetime) -> None:
+        if isinstance(prefix_type, TranscriptOptions):
+            _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(
+                self._ctx, fsencode(infile), prefix_type._ctx))
+        else:
+            _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(
+                self._ctx, fsencode(infile), prefix_type))
 
     def prepare_transcript_from_ttyrec_buffer(self,
                                               data: memoryview,
-                                              prefix_type: TranscriptPrefix = TranscriptPrefix.datetime) -> None:
-        _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer(
-            self._ctx, data, len(data), prefix_type))
+                                              prefix_type: Union[TranscriptPrefix, TranscriptOptions] = TranscriptPrefix.datetime) -> None:
+        if isinstance(prefix_type, TranscriptOptions):
+            _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+                self._ctx, data, len(data), prefix_type._ctx))
+        else:
+            _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer(
+                self._ctx, data, len(data), prefix_type))
+
+    def prepare_transcript_from_ttyrec_fd(self, fd: int, options: TranscriptOptions) -> None:
+        """
+        fd (file, pipe, etc) is read by blocks with a bounded memory and is not closed
+        """
+        _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd(
+            self._ctx, fd, options._ctx))
+
+    def prepare_transcript_from_ttyrec_file_with_time_window(self,
+                                                             infile: PathLikeObject,
+                                                             options: TranscriptOptions,
+                                                             start_time: int, end_time: int) -> None:
+        """
+        Lines saved by frames recorded in [start_time, end_time) (seconds since epoch)
+        """
+        _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_time_window(
+            self._ctx, fsencode(infile), options._ctx, start_time, end_time))
+
+    def prepare_transcript_from_ttyrec_buffer_with_time_window(self,
+                                                               data: memoryview,
+                                                               options: TranscriptOptions,
+                                                               start_time: int, end_time: int) -> None:
+        """
+        Lines saved by frames recorded in [start_time, end_time) (seconds since epoch)
+        """
+        _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window(
+            self._ctx, data, len(data), options._ctx, start_time, end_time))
+
+    def prepare_transcript_from_ttyrec_file_parallel(self,
+                                                     infile: PathLikeObject,
+                                                     options: TranscriptOptions,
+                                                     pool: Optional[ThreadPool] = None,
+                                                     segment_size: int = 0) -> None:
+        """
+        Same result as prepare_transcript_from_ttyrec_file() with options,
+        segments of segment_size bytes (0 for 4 MiB) are rendered in parallel
+        """
+        _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel(
+            self._ctx, fsencode(infile), options._ctx, pool._ctx if pool else None, segment_size))
+
+    def prepare_transcript_from_ttyrec_buffer_parallel(self,
+                                                       data: memoryview,
+                                                       options: TranscriptOptions,
+                                                       pool: Optional[ThreadPool] = None,
+                                                       segment_size: int = 0) -> None:
+        """
+        Same result as prepare_transcript_from_ttyrec_buffer() with options,
+        segments of segment_size bytes (0 for 4 MiB) are rendered in parallel
+        """
+        _check_errnum(lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel(
+            self._ctx, data, len(data), options._ctx, pool._ctx if pool else None, segment_size))
 
     def as_bytes(self) -> bytes:
         return self.get_data().raw
@@ -146,3 +446,293 @@ class TerminalEmulatorBuffer:
         if not p:
             raise TerminalEmulatorException('invalid buffer')
         return (addressof(p.contents), n.value)
+
+
+class _BorrowedTerminalEmulator(TerminalEmulator):
+    """
+    TerminalEmulator owned by the library
+    """
+    def __init__(self, ctx) -> None:
+        self._ctx = ctx
+
+    def __del__(self) -> None:
+        pass
+
+
+class Replay:
+    """
+    Emulate a ttyrec once and send the result to each registered sink.
+    """
+    __slot__ = ('_ctx', '_sinks')
+
+    def __init__(self) -> None:
+        self._ctx = lib.terminal_emulator_replay_new()
+        # extend lifetime
+        self._sinks = []
+
+        if not self._ctx:
+            raise TerminalEmulatorException("malloc error")
+
+    def __del__(self) -> None:
+        lib.terminal_emulator_replay_delete(self._ctx)
+
+    def add_transcript(self, buffer: TerminalEmulatorBuffer, options: TranscriptOptions) -> None:
+        """
+        line mode and alternate screen policy must be the same for all transcripts
+        """
+        _check_errnum(lib.terminal_emulator_replay_add_transcript(self._ctx, buffer._ctx, options._ctx))
+        self._sinks.append(buffer)
+
+    def add_snapshots(self, buffer: TerminalEmulatorBuffer, format: OutputFormat, interval: int = 0) -> None:
+        """
+        The screen is rendered every interval seconds of recording (0 for disable)
+        and at end of stream. Each rendering is followed by a new line.
+        """
+        _check_errnum(lib.terminal_emulator_replay_add_snapshots(self._ctx, buffer._ctx, int(format), interval))
+        self._sinks.append(buffer)
+
+    def add_timeline(self, buffer: TerminalEmulatorBuffer, interval: int = 1000) -> None:
+        """
+        The activity of each period of interval milliseconds with frames, one json object by line:
+        {"t": start_of_period_in_us, "b": received_bytes, "c": changed_cells, "l": committed_lines,
+         "e": screen_erased, "r": screen_reset, "a": alternate_screen}
+        """
+        _check_errnum(lib.terminal_emulator_replay_add_timeline(self._ctx, buffer._ctx, interval))
+        self._sinks.append(buffer)
+
+    def add_frame_callback(self, func: Callable[[TerminalEmulator, int, int], None]) -> None:
+        """
+        func(emu, sec, usec) is called after each frame, emu is only valid during the call.
+        An exception stops the replay.
+        """
+        def frame_fn(ctx, emu, sec, usec):
+            try:
+                func(_BorrowedTerminalEmulator(emu), sec, usec)
+            except OSError as e:
+                return e.errno or -1
+            except Exception:
+                return -1
+            return 0
+
+        frame_fn = TerminalEmulatorReplayFrameFn(frame_fn)
+        _check_errnum(lib.terminal_emulator_replay_add_frame_callback(self._ctx, frame_fn, None))
+        self._sinks.append(frame_fn)
+
+    def add_screenshots(self, format: OutputFormat, times: Sequence[int],
+                        func: Callable[[int, int, bytes], None]) -> None:
+        """
+        func(i, time, data) receives a rendering of the screen at each time of times
+        (microseconds since epoch, sorted in ascending order).
+        An exception stops the replay.
+        """
+        screenshot_fn = _make_screenshot_fn(func)
+        c_times = (c_uint64 * len(times))(*times)
+        _check_errnum(lib.terminal_emulator_replay_add_screenshots(
+            self._ctx, int(format), c_times, len(times), screenshot_fn, None))
+        self._sinks.append(screenshot_fn)
+
+    def add_screenshots_every(self, format: OutputFormat, interval: int,
+                              func: Callable[[int, int, bytes], None]) -> None:
+        """
+        Same as add_screenshots() with a screenshot every interval microseconds
+        from the first frame to the last frame.
+        """
+        screenshot_fn = _make_screenshot_fn(func)
+        _check_errnum(lib.terminal_emulator_replay_add_screenshots_every(
+            self._ctx, int(format), interval, screenshot_fn, None))
+        self._sinks.append(screenshot_fn)
+
+    def add_keyword_alert(self, matcher: KeywordMatcher, func: Callable[[int, int, int, int], None]) -> None:
+        """
+        func(pattern_id, row, sec, usec) is called for each keyword of matcher found in the lines
+        of the transcripts (committed lines when there is no transcript).
+        An exception stops the replay.
+        """
+        alert_fn = _make_keyword_alert_fn(func)
+        _check_errnum(lib.terminal_emulator_replay_add_keyword_alert(self._ctx, matcher._ctx, alert_fn, None))
+        self._sinks.append((matcher, alert_fn))
+
+    def set_time_window(self, start_time: int, end_time: int) -> None:
+        """
+        Sinks only receive frames recorded in [start_time, end_time) (seconds since epoch)
+        """
+        _check_errnum(lib.terminal_emulator_replay_set_time_window(self._ctx, start_time, end_time))
+
+    def run_ttyrec_file(self, infile: PathLikeObject) -> None:
+        _check_errnum(lib.terminal_emulator_replay_ttyrec_file(self._ctx, fsencode(infile)))
+
+    def run_ttyrec_fd(self, fd: int) -> None:
+        _check_errnum(lib.terminal_emulator_replay_ttyrec_fd(self._ctx, fd))
+
+    def run_ttyrec_buffer(self, data: memoryview) -> None:
+        _check_errnum(lib.terminal_emulator_replay_ttyrec_buffer(self._ctx, data, len(data)))
+
+
+class FrameIndex:
+    """
+    Index of a ttyrec for seeking: offset and time of each frame and keyframes
+    with the state of the emulator. An index can be saved in a sidecar file.
+    """
+    __slot__ = ('_ctx')
+
+    def __init__(self) -> None:
+        self._ctx = lib.terminal_emulator_frame_index_new()
+
+        if not self._ctx:
+            raise TerminalEmulatorException("malloc error")
+
+    def __del__(self) -> None:
+        lib.terminal_emulator_frame_index_delete(self._ctx)
+
+    def build_from_ttyrec_file(self, infile: PathLikeObject, lines: int, columns: int,
+                               keyframe_interval: int = 60, keyframe_bytes: int = 8 * 1024 * 1024) -> None:
+        """
+        A keyframe is added at the start of the ttyrec, then every keyframe_interval
+        seconds of recording and every keyframe_bytes bytes of ttyrec (0 for disable).
+        """
+        _check_errnum(lib.terminal_emulator_frame_index_build_from_ttyrec_file(
+            self._ctx, fsencode(infile), lines, columns, keyframe_interval, keyframe_bytes))
+
+    def build_from_ttyrec_fd(self, fd: int, lines: int, columns: int,
+                             keyframe_interval: int = 60, keyframe_bytes: int = 8 * 1024 * 1024) -> None:
+        _check_errnum(lib.terminal_emulator_frame_index_build_from_ttyrec_fd(
+            self._ctx, fd, lines, columns, keyframe_interval, keyframe_bytes))
+
+    def save(self, outfile: PathLikeObject) -> None:
+        _check_errnum(lib.terminal_emulator_frame_index_save(self._ctx, fsencode(outfile)))
+
+    def load(self, infile: PathLikeObject) -> None:
+        _check_errnum(lib.terminal_emulator_frame_index_load(self._ctx, fsencode(infile)))
+
+    def __len__(self) -> int:
+        return lib.terminal_emulator_frame_index_frame_count(self._ctx)
+
+    def frame_time(self, i: int) -> Tuple[int, int]:
+        """
+        Return (sec, usec) of the frame i
+        """
+        sec = c_uint32()
+        usec = c_uint32()
+        _check_errnum(lib.terminal_emulator_frame_index_get_frame_time(self._ctx, i, byref(sec), byref(usec)))
+        return (sec.value, usec.value)
+
+    def seek(self, emu: TerminalEmulator, infile: PathLikeObject, sec: int, usec: int = 0) -> None:
+        """
+        Set emu to the state of the indexed ttyrec infile at the time sec.usec
+        """
+        _check_errnum(lib.terminal_emulator_frame_index_seek(self._ctx, emu._ctx, fsencode(infile), sec, usec))
+
+
+class Mirror:
+    """
+    Terminal of a remote viewer which displays the screen of an emulator.
+    An update only contains the differences with the last update,
+    a viewer updated less often than the emulator skips the intermediate states.
+    With use_repeat, the repeated characters can be written with REP (CSI b),
+    which is not supported by all terminals.
+    """
+    __slot__ = ('_ctx')
+
+    def __init__(self, lines: int, columns: int, use_repeat: bool = False) -> None:
+        self._ctx = lib.terminal_emulator_mirror_new(lines, columns, int(use_repeat))
+
+        if not self._ctx:
+            raise TerminalEmulatorException("malloc error")
+
+    def __del__(self) -> None:
+        lib.terminal_emulator_mirror_delete(self._ctx)
+
+    def update(self, emu: TerminalEmulator, buffer: Optional[TerminalEmulatorBuffer] = None) -> bytes:
+        """
+        ANSI sequences which turn the terminal of the viewer into the screen of emu.
+        """
+        if buffer is None:
+            buffer = TerminalEmulatorBuffer()
+        _check_errnum(lib.terminal_emulator_mirror_update(self._ctx, emu._ctx, buffer._ctx))
+        # a buffer without allocation has no data
+        n = c_size_t()
+        p = lib.terminal_emulator_buffer_get_data(buffer._ctx, byref(n))
+        return string_at(p, n.value) if n.value else b""
+
+    def reset(self) -> None:
+        """
+        The next update resets the terminal of the viewer and redraws the whole screen.
+        """
+        _check_errnum(lib.terminal_emulator_mirror_reset(self._ctx))
+
+
+def render_many(emus: Sequence[TerminalEmulator],
+                buffers: Sequence[TerminalEmulatorBuffer],
+                format: OutputFormat,
+                pool: Optional[ThreadPool] = None) -> None:
+    n = len(emus)
+    if len(buffers) != n:
+        raise TerminalEmulatorException("bad argument(s)")
+    _check_errnum(lib.terminal_emulator_render_many(
+        (c_void_p * n)(*(emu._ctx for emu in emus)), n, int(format),
+        (c_void_p * n)(*(buf._ctx for buf in buffers)),
+        pool._ctx if pool else None, None))
+
+
+def render_many_into_buffer(buffer: TerminalEmulatorBuffer,
+                            emus: Sequence[TerminalEmulator],
+                            format: OutputFormat,
+                            pool: Optional[ThreadPool] = None) -> List[int]:
+    """
+    Return offsets of each rendering in buffer (len(emus) + 1 elements)
+    """
+    n = len(emus)
+    offsets = (c_size_t * (n + 1))()
+    _check_errnum(lib.terminal_emulator_render_many_into_buffer(
+        buffer._ctx, (c_void_p * n)(*(emu._ctx for emu in emus)), n, int(format),
+        pool._ctx if pool else None, offsets))
+    return list(offsets)
+
+
+def transcript_ttyrec_files(infiles: Sequence[PathLikeObject],
+                            outfiles: Sequence[PathLikeObject],
+                            options: TranscriptOptions,
+                            pool: Optional[ThreadPool] = None) -> List[int]:
+    """
+    Transcript of infiles[i] into outfiles[i], largest files first.
+    Return the error code of each file (0 for success, -1 for a truncated file
+    which still has a transcript, > 0 for an errno).
+    """
+    n = len(infiles)
+    if len(outfiles) != n:
+        raise TerminalEmulatorException("bad argument(s)")
+    results = (c_int * n)()
+    errnum = lib.terminal_emulator_transcript_ttyrec_files(
+        (c_char_p * n)(*map(fsencode, infiles)), (c_char_p * n)(*map(fsencode, outfiles)), n,
+        options._ctx, pool._ctx if pool else None, results)
+    if errnum and not any(results):
+        _check_errnum(errnum)
+    return list(results)
+
+
+def ttyrec_remove_noop_frames(infile: PathLikeObject, outfile: PathLikeObject,
+                              lines: int = 24, columns: int = 80, max_idle: int = 0) -> Tuple[int, int]:
+    """
+    Write infile into outfile without the frames which leave the screen unchanged,
+    their bytes are merged into the next frame which changes the screen.
+    max_idle is the maximum time between 2 frames in milliseconds (0 for disable).
+    Return the number of read and written frames.
+    """
+    frame_counts = (c_uint64 * 2)()
+    _check_errnum(lib.terminal_emulator_ttyrec_remove_noop_frames(
+        fsencode(infile), fsencode(outfile), lines, columns, max_idle, frame_counts))
+    return (frame_counts[0], frame_counts[1])
+
+
+def ttyrec_reencode(infile: PathLikeObject, outfile: PathLikeObject,
+                    lines: int = 24, columns: int = 80, max_idle: int = 0) -> Tuple[int, int]:
+    """
+    Write infile into outfile with the frames replaced by the minimal sequences
+    which update the screen. The rendering is kept, not the transcript.
+    max_idle is the maximum time between 2 frames in milliseconds (0 for disable).
+    Return the number of read and written frames.
+    """
+    frame_counts = (c_uint64 * 2)()
+    _check_errnum(lib.terminal_emulator_ttyrec_reencode(
+        fsencode(infile), fsencode(outfile), lines, columns, max_idle, frame_counts))
+    return (frame_counts[0], frame_counts[1])
@@ -1,17 +1,55 @@
 # ./tools/cpp2ctypes/cpp2ctypes.lua 'src/rvt_lib/terminal_emulator.hpp' '-l' 'libwallix_term.so'
 
-from ctypes import CDLL, CFUNCTYPE, POINTER, c_char, c_char_p, c_int, c_size_t, c_void_p
+from ctypes import CDLL, CFUNCTYPE, POINTER, c_char, c_char_p, c_int, c_size_t, c_uint32, c_uint64, c_void_p
 from enum import IntEnum
 
 lib = CDLL("libwallix_term.so")
 
 # enum class TerminalEmulatorOutputFormat : int {
 #    json,
-#    ansi
+#    ansi,
+#    text,
 # }
 class TerminalEmulatorOutputFormat(IntEnum):
     json = 0
     ansi = 1
+    text = 2
+
+    def from_param(self) -> int:
+        return int(self)
+
+
+# enum class TerminalEmulatorMinimapFormat : int {
+#    json,
+#    rgb,
+# }
+class TerminalEmulatorMinimapFormat(IntEnum):
+    json = 0
+    rgb = 1
+
+    def from_param(self) -> int:
+        return int(self)
+
+
+# enum class TerminalEmulatorMinimapGlyph : int {
+#    density,
+#    dominant,
+# }
+class TerminalEmulatorMinimapGlyph(IntEnum):
+    density = 0
+    dominant = 1
+
+    def from_param(self) -> int:
+        return int(self)
+
+
+# enum class TerminalEmulatorImageFormat : int {
+#    ppm,
+#    pam,
+# }
+class TerminalEmulatorImageFormat(IntEnum):
+    ppm = 0
+    pam = 1
 
     def from_param(self) -> int:
         return int(self)
@@ -20,10 +58,58 @@ class TerminalEmulatorOutputFormat(IntEnum):
 # enum class TerminalEmulatorTranscriptPrefix : int {
 #    noprefix,
 #    datetime,
+#    datetime_utc,
+#    epoch,
+#    iso8601_ms,
+#    iso8601_us,
+#    iso8601_ms_utc,
+#    iso8601_us_utc,
 # }
 class TerminalEmulatorTranscriptPrefix(IntEnum):
     noprefix = 0
     datetime = 1
+    datetime_utc = 2
+    epoch = 3
+    iso8601_ms = 4
+    iso8601_us = 5
+    iso8601_ms_utc = 6
+    iso8601_us_utc = 7
+
+    def from_param(self) -> int:
+        return int(self)
+
+
+# enum class TerminalEmulatorTranscriptLineMode : int {
+#    cursor_move,
+#    commit,
+# }
+class TerminalEmulatorTranscriptLineMode(IntEnum):
+    cursor_move = 0
+    commit = 1
+
+    def from_param(self) -> int:
+        return int(self)
+
+
+# enum class TerminalEmulatorTranscriptAlternateScreen : int {
+#    lines,
+#    snapshot,
+# }
+class TerminalEmulatorTranscriptAlternateScreen(IntEnum):
+    lines = 0
+    snapshot = 1
+
+    def from_param(self) -> int:
+        return int(self)
+
+
+# enum class TerminalEmulatorTranscriptFormat : int {
+#    text,
+#    jsonl,
+# }
+class TerminalEmulatorTranscriptFormat(IntEnum):
+    text = 0
+    jsonl = 1
 
     def from_param(self) -> int:
         return int(self)
@@ -79,12 +165,82 @@ terminal_emulator_feed.argtypes = [c_void_p, POINTER(c_char), c_size_t]
 terminal_emulator_feed.restype = c_int
 
 # int terminal_emulator_finish(TerminalEmulator *) noexcept;
+terminal_emulator_finish = lib.terminal_emulator_finish
+terminal_emulator_finish.argtypes = [c_void_p]
+terminal_emulator_finish.restype = c_int
+
 # int terminal_emulator_resize(TerminalEmulator * emu, int lines, int columns) noexcept;
 terminal_emulator_resize = lib.terminal_emulator_resize
 terminal_emulator_resize.argtypes = [c_void_p, c_int, c_int]
 terminal_emulator_resize.restype = c_int
 
 # END emulator
+# BEGIN state
+# Write the full state of \p emu (screens, cursor, modes, charsets, title,
+# partial escape sequence and partial UTF-8 character) in \p buffer.
+# The format is versioned, compact and does not depend on the platform.
+# Log function, parallel rendering and keyword alert are not saved.
+# int terminal_emulator_serialize(
+#     TerminalEmulator const * emu, TerminalEmulatorBuffer * buffer) noexcept;
+terminal_emulator_serialize = lib.terminal_emulator_serialize
+terminal_emulator_serialize.argtypes = [c_void_p, c_void_p]
+terminal_emulator_serialize.restype = c_int
+
+# Restore a state written by \c terminal_emulator_serialize(), the storage of \p emu is reused.
+# The size of \p emu becomes the size of the saved state.
+# \return -1 for an invalid state, \p emu is then reset with its previous size
+# int terminal_emulator_deserialize(
+#     TerminalEmulator * emu, uint8_t const * data, std::size_t len) noexcept;
+terminal_emulator_deserialize = lib.terminal_emulator_deserialize
+terminal_emulator_deserialize.argtypes = [c_void_p, POINTER(c_char), c_size_t]
+terminal_emulator_deserialize.restype = c_int
+
+# END state
+# BEGIN journal
+# Keep the reverse changes of each call of \c terminal_emulator_feed() and \c terminal_emulator_finish()
+# (a frame): previous content of the modified lines, cursor, modes, title, etc.
+# The oldest frames are dropped when the journal exceeds \p max_bytes.
+# The journal is cleared when the state is modified by another function (resize, seek, etc).
+# \param max_bytes  0 for disable the journal
+# int terminal_emulator_set_journal(TerminalEmulator * emu, std::size_t max_bytes) noexcept;
+terminal_emulator_set_journal = lib.terminal_emulator_set_journal
+terminal_emulator_set_journal.argtypes = [c_void_p, c_size_t]
+terminal_emulator_set_journal.restype = c_int
+
+# Restore the state before the last frame of the journal.
+# \return -1 when the journal is empty ; -2 without journal
+# int terminal_emulator_undo_frame(TerminalEmulator * emu) noexcept;
+terminal_emulator_undo_frame = lib.terminal_emulator_undo_frame
+terminal_emulator_undo_frame.argtypes = [c_void_p]
+terminal_emulator_undo_frame.restype = c_int
+
+# std::size_t terminal_emulator_journal_frame_count(TerminalEmulator const * emu) noexcept;
+terminal_emulator_journal_frame_count = lib.terminal_emulator_journal_frame_count
+terminal_emulator_journal_frame_count.argtypes = [c_void_p]
+terminal_emulator_journal_frame_count.restype = c_size_t
+
+# END journal
+# BEGIN thread pool
+# \param nb_thread  number of threads used by a job (calling thread included), 0 for the number of cores
+# TerminalEmulatorThreadPool * terminal_emulator_thread_pool_new(int nb_thread) noexcept;
+terminal_emulator_thread_pool_new = lib.terminal_emulator_thread_pool_new
+terminal_emulator_thread_pool_new.argtypes = [c_int]
+terminal_emulator_thread_pool_new.restype = c_void_p
+
+# int terminal_emulator_thread_pool_delete(TerminalEmulatorThreadPool * pool) noexcept;
+terminal_emulator_thread_pool_delete = lib.terminal_emulator_thread_pool_delete
+terminal_emulator_thread_pool_delete.argtypes = [c_void_p]
+terminal_emulator_thread_pool_delete.restype = c_int
+
+# Split the rendering of screens with at least \p min_cells cells (lines * columns) between the threads of \p pool.
+# \param pool  nullptr for disable parallel rendering. Must outlive \p emu or the next call.
+# int terminal_emulator_set_parallel_rendering(
+#     TerminalEmulator * emu, TerminalEmulatorThreadPool * pool, std::size_t min_cells) noexcept;
+terminal_emulator_set_parallel_rendering = lib.terminal_emulator_set_parallel_rendering
+terminal_emulator_set_parallel_rendering.argtypes = [c_void_p, c_void_p, c_size_t]
+terminal_emulator_set_parallel_rendering.restype = c_int
+
+# END thread pool
 # BEGIN buffer
 TerminalEmulatorBufferGetBufferFn = CFUNCTYPE(c_void_p, c_void_p, POINTER(c_size_t))
 
@@ -122,6 +278,22 @@ terminal_emulator_buffer_new_with_custom_allocator = lib.terminal_emulator_buffe
 terminal_emulator_buffer_new_with_custom_allocator.argtypes = [c_void_p, c_void_p, c_void_p, c_void_p, c_void_p, c_void_p]
 terminal_emulator_buffer_new_with_custom_allocator.restype = c_void_p
 
+# using TerminalEmulatorBufferWriteFn
+#   = int(void * ctx, uint8_t const * data, std::size_t len) noexcept;
+TerminalEmulatorBufferWriteFn = CFUNCTYPE(c_int, c_void_p, POINTER(c_char), c_size_t)
+
+# TerminalEmulatorBuffer * terminal_emulator_buffer_new_stream_to_callback(
+#     void * ctx, TerminalEmulatorBufferWriteFn * write_fn, std::size_t block_size) noexcept;
+terminal_emulator_buffer_new_stream_to_callback = lib.terminal_emulator_buffer_new_stream_to_callback
+terminal_emulator_buffer_new_stream_to_callback.argtypes = [c_void_p, TerminalEmulatorBufferWriteFn, c_size_t]
+terminal_emulator_buffer_new_stream_to_callback.restype = c_void_p
+
+# TerminalEmulatorBuffer * terminal_emulator_buffer_new_stream_to_fd(
+#     int fd, std::size_t block_size) noexcept;
+terminal_emulator_buffer_new_stream_to_fd = lib.terminal_emulator_buffer_new_stream_to_fd
+terminal_emulator_buffer_new_stream_to_fd.argtypes = [c_int, c_size_t]
+terminal_emulator_buffer_new_stream_to_fd.restype = c_void_p
+
 # int terminal_emulator_buffer_delete(TerminalEmulatorBuffer * buffer) noexcept;
 terminal_emulator_buffer_delete = lib.terminal_emulator_buffer_delete
 terminal_emulator_buffer_delete.argtypes = [c_void_p]
@@ -142,6 +314,38 @@ terminal_emulator_buffer_prepare2 = lib.terminal_emulator_buffer_prepare2
 terminal_emulator_buffer_prepare2.argtypes = [c_void_p, c_void_p, c_int, POINTER(c_char), c_size_t]
 terminal_emulator_buffer_prepare2.restype = c_int
 
+# Render the rectangle of cells from (\p first_line, \p first_column) to (\p last_line, \p last_column) included.
+# The rectangle is truncated to the screen size.
+# int terminal_emulator_buffer_prepare_region(
+#     TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+#     TerminalEmulatorOutputFormat format,
+#     int first_line, int last_line, int first_column, int last_column) noexcept;
+terminal_emulator_buffer_prepare_region = lib.terminal_emulator_buffer_prepare_region
+terminal_emulator_buffer_prepare_region.argtypes = [c_void_p, c_void_p, c_int, c_int, c_int, c_int, c_int]
+terminal_emulator_buffer_prepare_region.restype = c_int
+
+# Render a reduced screen where an output cell summarizes a block of \p block_lines x \p block_columns cells.
+# The rgb format has 3 bytes by output cell and ceil(lines / block_lines) x ceil(columns / block_columns) cells.
+# \param glyph  unused with rgb format
+# int terminal_emulator_buffer_prepare_minimap(
+#     TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+#     TerminalEmulatorMinimapFormat format,
+#     int block_lines, int block_columns,
+#     TerminalEmulatorMinimapGlyph glyph) noexcept;
+terminal_emulator_buffer_prepare_minimap = lib.terminal_emulator_buffer_prepare_minimap
+terminal_emulator_buffer_prepare_minimap.argtypes = [c_void_p, c_void_p, c_int, c_int, c_int, c_int]
+terminal_emulator_buffer_prepare_minimap.restype = c_int
+
+# Render an RGB image of screen with a built-in bitmap font.
+# A character is 8x12 pixels with a \p scale of 1.
+# \param scale  between 1 and 16
+# int terminal_emulator_buffer_prepare_image(
+#     TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+#     TerminalEmulatorImageFormat format, int scale) noexcept;
+terminal_emulator_buffer_prepare_image = lib.terminal_emulator_buffer_prepare_image
+terminal_emulator_buffer_prepare_image.argtypes = [c_void_p, c_void_p, c_int, c_int]
+terminal_emulator_buffer_prepare_image.restype = c_int
+
 # uint8_t const * terminal_emulator_buffer_get_data(
 #     TerminalEmulatorBuffer const * buffer, std::size_t * output_len) noexcept;
 terminal_emulator_buffer_get_data = lib.terminal_emulator_buffer_get_data
@@ -150,7 +354,106 @@ terminal_emulator_buffer_get_data.restype = POINTER(c_char)
 
 # int terminal_emulator_buffer_clear_data(TerminalEmulatorBuffer *) noexcept;
 # END buffer
+# BEGIN batch
+# Render \c emus[i] into \c buffers[i] for each \c i in [0, \p n), spread across the threads of \p pool.
+# Buffers must be distinct and their allocator functions may be called from any thread of \p pool.
+# \param pool     nullptr for a rendering by the calling thread
+# \param results  nullptr or array of \p n elements which receives the error code of each rendering
+# \return the first error code in order of \p emus or 0
+# int terminal_emulator_render_many(
+#     TerminalEmulator * const * emus, std::size_t n,
+#     TerminalEmulatorOutputFormat format,
+#     TerminalEmulatorBuffer * const * buffers,
+#     TerminalEmulatorThreadPool * pool, int * results) noexcept;
+terminal_emulator_render_many = lib.terminal_emulator_render_many
+terminal_emulator_render_many.argtypes = [POINTER(c_void_p), c_size_t, c_int, POINTER(c_void_p), c_void_p, POINTER(c_int)]
+terminal_emulator_render_many.restype = c_int
+
+# Render \p n emulators one after the other into \p buffer, spread across the threads of \p pool.
+# The rendering of \c emus[i] is at [offsets[i], offsets[i+1]) in data of \p buffer.
+# \param pool     nullptr for a rendering by the calling thread
+# \param offsets  array of \p n + 1 elements
+# int terminal_emulator_render_many_into_buffer(
+#     TerminalEmulatorBuffer * buffer,
+#     TerminalEmulator * const * emus, std::size_t n,
+#     TerminalEmulatorOutputFormat format,
+#     TerminalEmulatorThreadPool * pool, std::size_t * offsets) noexcept;
+terminal_emulator_render_many_into_buffer = lib.terminal_emulator_render_many_into_buffer
+terminal_emulator_render_many_into_buffer.argtypes = [c_void_p, POINTER(c_void_p), c_size_t, c_int, c_void_p, POINTER(c_size_t)]
+terminal_emulator_render_many_into_buffer.restype = c_int
+
+# END batch
+# BEGIN transcript options
+# Default options are \c TerminalEmulatorTranscriptPrefix::noprefix, \c TerminalEmulatorTranscriptLineMode::cursor_move
+# , \c TerminalEmulatorTranscriptAlternateScreen::lines and \c TerminalEmulatorTranscriptFormat::text.
+# TerminalEmulatorTranscriptOptions * terminal_emulator_transcript_options_new() noexcept;
+terminal_emulator_transcript_options_new = lib.terminal_emulator_transcript_options_new
+terminal_emulator_transcript_options_new.argtypes = []
+terminal_emulator_transcript_options_new.restype = c_void_p
+
+# int terminal_emulator_transcript_options_delete(TerminalEmulatorTranscriptOptions * options) noexcept;
+terminal_emulator_transcript_options_delete = lib.terminal_emulator_transcript_options_delete
+terminal_emulator_transcript_options_delete.argtypes = [c_void_p]
+terminal_emulator_transcript_options_delete.restype = c_int
+
+# int terminal_emulator_transcript_options_set_prefix(
+#     TerminalEmulatorTranscriptOptions * options, TerminalEmulatorTranscriptPrefix prefix_type) noexcept;
+terminal_emulator_transcript_options_set_prefix = lib.terminal_emulator_transcript_options_set_prefix
+terminal_emulator_transcript_options_set_prefix.argtypes = [c_void_p, c_int]
+terminal_emulator_transcript_options_set_prefix.restype = c_int
+
+# int terminal_emulator_transcript_options_set_line_mode(
+#     TerminalEmulatorTranscriptOptions * options, TerminalEmulatorTranscriptLineMode line_mode) noexcept;
+terminal_emulator_transcript_options_set_line_mode = lib.terminal_emulator_transcript_options_set_line_mode
+terminal_emulator_transcript_options_set_line_mode.argtypes = [c_void_p, c_int]
+terminal_emulator_transcript_options_set_line_mode.restype = c_int
+
+# \param snapshot_interval  with \c TerminalEmulatorTranscriptAlternateScreen::snapshot,
+#   the alternate screen is also written every \p snapshot_interval seconds of recording (0 for disable)
+# int terminal_emulator_transcript_options_set_alternate_screen(
+#     TerminalEmulatorTranscriptOptions * options,
+#     TerminalEmulatorTranscriptAlternateScreen alternate_screen,
+#     uint32_t snapshot_interval) noexcept;
+terminal_emulator_transcript_options_set_alternate_screen = lib.terminal_emulator_transcript_options_set_alternate_screen
+terminal_emulator_transcript_options_set_alternate_screen.argtypes = [c_void_p, c_int, c_uint32]
+terminal_emulator_transcript_options_set_alternate_screen.restype = c_int
+
+# int terminal_emulator_transcript_options_set_format(
+#     TerminalEmulatorTranscriptOptions * options, TerminalEmulatorTranscriptFormat format) noexcept;
+terminal_emulator_transcript_options_set_format = lib.terminal_emulator_transcript_options_set_format
+terminal_emulator_transcript_options_set_format.argtypes = [c_void_p, c_int]
+terminal_emulator_transcript_options_set_format.restype = c_int
+
+# END transcript options
+
 # BEGIN read
+# Construct a transcript buffer of session recorded by ttyrec.
+# int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+#     TerminalEmulatorBuffer * buffer,
+#     uint8_t const * data, std::size_t data_len,
+#     TerminalEmulatorTranscriptOptions const * options) noexcept;
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options = lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options.argtypes = [c_void_p, c_char_p, c_size_t, c_void_p]
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options.restype = c_int
+
+# Construct a transcript buffer of session recorded by ttyrec.
+# int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(
+#     TerminalEmulatorBuffer * buffer,
+#     char const * infile,
+#     TerminalEmulatorTranscriptOptions const * options) noexcept;
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options = lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options.argtypes = [c_void_p, c_char_p, c_void_p]
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options.restype = c_int
+
+# Construct a transcript buffer of session recorded by ttyrec read from \p fd (file, pipe, etc).
+# The ttyrec is read by blocks with a bounded memory, \p fd is not closed.
+# int terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd(
+#     TerminalEmulatorBuffer * buffer, int fd,
+#     TerminalEmulatorTranscriptOptions const * options) noexcept;
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd = lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd.argtypes = [c_void_p, c_int, c_void_p]
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd.restype = c_int
+
 # Construct a transcript buffer of session recorded by ttyrec.
 # int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer(
 #     TerminalEmulatorBuffer * buffer,
@@ -169,5 +472,390 @@ terminal_emulator_buffer_prepare_transcript_from_ttyrec_file = lib.terminal_emul
 terminal_emulator_buffer_prepare_transcript_from_ttyrec_file.argtypes = [c_void_p, c_char_p, c_int]
 terminal_emulator_buffer_prepare_transcript_from_ttyrec_file.restype = c_int
 
+# Construct a transcript buffer with the lines saved by frames recorded in [\p start_time, \p end_time) (seconds since epoch).
+# Previous frames are emulated without rendering and the reading stops at the first frame after the window.
+# int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window(
+#     TerminalEmulatorBuffer * buffer,
+#     uint8_t const * data, std::size_t data_len,
+#     TerminalEmulatorTranscriptOptions const * options,
+#     uint32_t start_time, uint32_t end_time) noexcept;
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window = lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window.argtypes = [c_void_p, c_char_p, c_size_t, c_void_p, c_uint32, c_uint32]
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window.restype = c_int
+
+# Construct a transcript buffer with the lines saved by frames recorded in [\p start_time, \p end_time) (seconds since epoch).
+# Previous frames are emulated without rendering and the reading stops at the first frame after the window.
+# int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_time_window(
+#     TerminalEmulatorBuffer * buffer,
+#     char const * infile,
+#     TerminalEmulatorTranscriptOptions const * options,
+#     uint32_t start_time, uint32_t end_time) noexcept;
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_time_window = lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_time_window
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_time_window.argtypes = [c_void_p, c_char_p, c_void_p, c_uint32, c_uint32]
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_time_window.restype = c_int
+
+# Construct a transcript buffer identical to terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options().
+# A first pass emulates the session without rendering and copies the emulator state every \p segment_size bytes
+# (0 for 4 MiB), then segments are rendered in parallel from these checkpoints.
+# \param pool  may be null
+# int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel(
+#     TerminalEmulatorBuffer * buffer,
+#     uint8_t const * data, std::size_t data_len,
+#     TerminalEmulatorTranscriptOptions const * options,
+#     TerminalEmulatorThreadPool * pool, std::size_t segment_size) noexcept;
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel = lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel.argtypes = [c_void_p, c_char_p, c_size_t, c_void_p, c_void_p, c_size_t]
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel.restype = c_int
+
+# \see terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel
+# int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel(
+#     TerminalEmulatorBuffer * buffer,
+#     char const * infile,
+#     TerminalEmulatorTranscriptOptions const * options,
+#     TerminalEmulatorThreadPool * pool, std::size_t segment_size) noexcept;
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel = lib.terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel.argtypes = [c_void_p, c_char_p, c_void_p, c_void_p, c_size_t]
+terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel.restype = c_int
+
+# Construct the transcript of the ttyrec file \c infiles[i] into the file \c outfiles[i]
+# for each \c i in [0, \p n), spread across the threads of \p pool.
+# Largest files are processed first and each thread reuses its emulator and its buffer.
+# A truncated recording has a transcript and a -1 error code.
+# \param pool     nullptr for a processing by the calling thread
+# \param results  nullptr or array of \p n elements which receives the error code of each transcript
+# \return the first error code in order of \p infiles or 0
+# int terminal_emulator_transcript_ttyrec_files(
+#     char const * const * infiles, char const * const * outfiles, std::size_t n,
+#     TerminalEmulatorTranscriptOptions const * options,
+#     TerminalEmulatorThreadPool * pool, int * results) noexcept;
+terminal_emulator_transcript_ttyrec_files = lib.terminal_emulator_transcript_ttyrec_files
+terminal_emulator_transcript_ttyrec_files.argtypes = [POINTER(c_char_p), POINTER(c_char_p), c_size_t, c_void_p, c_void_p, POINTER(c_int)]
+terminal_emulator_transcript_ttyrec_files.restype = c_int
+
 # END read
+
+# BEGIN keyword alert
+# Keyword set searched in the lines (Aho-Corasick automaton).
+# A matcher is immutable, it can be shared by the emulators and replays of several threads.
+# \param patterns  \p n zero-terminated UTF-8 keywords, the id of a keyword is its index
+# \param ignore_ascii_case  when not 0, ASCII letters are compared without the case
+# TerminalEmulatorKeywordMatcher * terminal_emulator_keyword_matcher_new(
+#     char const * const * patterns, std::size_t n, int ignore_ascii_case) noexcept;
+terminal_emulator_keyword_matcher_new = lib.terminal_emulator_keyword_matcher_new
+terminal_emulator_keyword_matcher_new.argtypes = [POINTER(c_char_p), c_size_t, c_int]
+terminal_emulator_keyword_matcher_new.restype = c_void_p
+
+# int terminal_emulator_keyword_matcher_delete(TerminalEmulatorKeywordMatcher * matcher) noexcept;
+terminal_emulator_keyword_matcher_delete = lib.terminal_emulator_keyword_matcher_delete
+terminal_emulator_keyword_matcher_delete.argtypes = [c_void_p]
+terminal_emulator_keyword_matcher_delete.restype = c_int
+
+# \param row  line of the screen where the keyword ends. A wrapped line is searched as a single line.
+# \return 0 to continue, otherwise the search stops and this value is returned by the function which emulates
+# using TerminalEmulatorKeywordAlertFn = int(void * ctx, std::size_t pattern_id, int row, uint32_t sec, uint32_t usec) noexcept;
+TerminalEmulatorKeywordAlertFn = CFUNCTYPE(c_int, c_void_p, c_size_t, c_int, c_uint32, c_uint32)
+
+# Search the keywords of \p matcher in the committed lines of \p emu
+# (see \c TerminalEmulatorTranscriptLineMode::commit): a line is searched once,
+# when it is scrolled out, erased, overwritten or by \c terminal_emulator_finish().
+# The timestamp of an alert is the current time.
+# \param matcher  nullptr for disable. Must outlive \p emu or the next call.
+# int terminal_emulator_set_keyword_alert(
+#     TerminalEmulator * emu, TerminalEmulatorKeywordMatcher const * matcher,
+#     TerminalEmulatorKeywordAlertFn * alert_fn, void * ctx) noexcept;
+terminal_emulator_set_keyword_alert = lib.terminal_emulator_set_keyword_alert
+terminal_emulator_set_keyword_alert.argtypes = [c_void_p, c_void_p, TerminalEmulatorKeywordAlertFn, c_void_p]
+terminal_emulator_set_keyword_alert.restype = c_int
+
+# END keyword alert
+
+# BEGIN replay
+# A replay emulates a ttyrec once and sends the result to each registered sink.
+# Each sink has its own buffer.
+# TerminalEmulatorReplay * terminal_emulator_replay_new() noexcept;
+terminal_emulator_replay_new = lib.terminal_emulator_replay_new
+terminal_emulator_replay_new.argtypes = []
+terminal_emulator_replay_new.restype = c_void_p
+
+# int terminal_emulator_replay_delete(TerminalEmulatorReplay * replay) noexcept;
+terminal_emulator_replay_delete = lib.terminal_emulator_replay_delete
+terminal_emulator_replay_delete.argtypes = [c_void_p]
+terminal_emulator_replay_delete.restype = c_int
+
+# Line based sink: \p buffer receives the transcript described by \p options (copied).
+# Line mode and alternate screen policy drive the emulator and must be the same for all transcripts.
+# int terminal_emulator_replay_add_transcript(
+#     TerminalEmulatorReplay * replay, TerminalEmulatorBuffer * buffer,
+#     TerminalEmulatorTranscriptOptions const * options) noexcept;
+terminal_emulator_replay_add_transcript = lib.terminal_emulator_replay_add_transcript
+terminal_emulator_replay_add_transcript.argtypes = [c_void_p, c_void_p, c_void_p]
+terminal_emulator_replay_add_transcript.restype = c_int
+
+# Time based sink: \p buffer receives a rendering of the screen every \p interval seconds
+# of recording (0 for disable) and at end of stream. Each rendering is followed by '\n'.
+# int terminal_emulator_replay_add_snapshots(
+#     TerminalEmulatorReplay * replay, TerminalEmulatorBuffer * buffer,
+#     TerminalEmulatorOutputFormat format, uint32_t interval) noexcept;
+terminal_emulator_replay_add_snapshots = lib.terminal_emulator_replay_add_snapshots
+terminal_emulator_replay_add_snapshots.argtypes = [c_void_p, c_void_p, c_int, c_uint32]
+terminal_emulator_replay_add_snapshots.restype = c_int
+
+# Timeline sink: \p buffer receives the activity of each period of \p interval milliseconds
+# which contains frames (periods are aligned on the epoch), one json object by line:
+# {"t": start_of_period_in_us, "b": received_bytes, "c": changed_cells, "l": committed_lines,
+#  "e": screen_erased, "r": screen_reset, "a": alternate_screen}
+# changed_cells is the sum of the cells modified by each frame.
+# committed_lines is the number of lines saved with the line mode of the transcripts
+# (\c TerminalEmulatorTranscriptLineMode::commit without transcript).
+# "a" is true when a frame of the period ends with the alternate screen.
+# int terminal_emulator_replay_add_timeline(
+#     TerminalEmulatorReplay * replay, TerminalEmulatorBuffer * buffer, uint32_t interval) noexcept;
+terminal_emulator_replay_add_timeline = lib.terminal_emulator_replay_add_timeline
+terminal_emulator_replay_add_timeline.argtypes = [c_void_p, c_void_p, c_uint32]
+terminal_emulator_replay_add_timeline.restype = c_int
+
+# \param emu  the emulator of the replay, only valid during the call and should not be modified
+# \return 0 to continue, otherwise the replay stops and returns this value
+# using TerminalEmulatorReplayFrameFn = int(void * ctx, TerminalEmulator * emu, uint32_t sec, uint32_t usec) noexcept;
+TerminalEmulatorReplayFrameFn = CFUNCTYPE(c_int, c_void_p, c_void_p, c_uint32, c_uint32)
+
+# Frame based sink: \p frame_fn is called after each frame.
+# int terminal_emulator_replay_add_frame_callback(
+#     TerminalEmulatorReplay * replay,
+#     TerminalEmulatorReplayFrameFn * frame_fn, void * ctx) noexcept;
+terminal_emulator_replay_add_frame_callback = lib.terminal_emulator_replay_add_frame_callback
+terminal_emulator_replay_add_frame_callback.argtypes = [c_void_p, TerminalEmulatorReplayFrameFn, c_void_p]
+terminal_emulator_replay_add_frame_callback.restype = c_int
+
+# \param i     index of the screenshot
+# \param time  requested time in microseconds since epoch
+# \return 0 to continue, otherwise the replay stops and returns this value
+# using TerminalEmulatorReplayScreenshotFn = int(
+#     void * ctx, std::size_t i, uint64_t time, uint8_t const * data, std::size_t len) noexcept;
+TerminalEmulatorReplayScreenshotFn = CFUNCTYPE(c_int, c_void_p, c_size_t, c_uint64, POINTER(c_char), c_size_t)
+
+# Screenshot sink: \p screenshot_fn receives a rendering of the screen at each time of \p times
+# (microseconds since epoch, copied), that is after the last frame recorded at this time.
+# The screen is only rendered when the replay crosses a time. Times before the time window are ignored.
+# \param times  sorted in ascending order
+# int terminal_emulator_replay_add_screenshots(
+#     TerminalEmulatorReplay * replay, TerminalEmulatorOutputFormat format,
+#     uint64_t const * times, std::size_t n,
+#     TerminalEmulatorReplayScreenshotFn * screenshot_fn, void * ctx) noexcept;
+terminal_emulator_replay_add_screenshots = lib.terminal_emulator_replay_add_screenshots
+terminal_emulator_replay_add_screenshots.argtypes = [c_void_p, c_int, POINTER(c_uint64), c_size_t, TerminalEmulatorReplayScreenshotFn, c_void_p]
+terminal_emulator_replay_add_screenshots.restype = c_int
+
+# Same as \c terminal_emulator_replay_add_screenshots() with a screenshot every \p interval
+# microseconds from the first frame of the time window to the last frame.
+# int terminal_emulator_replay_add_screenshots_every(
+#     TerminalEmulatorReplay * replay, TerminalEmulatorOutputFormat format, uint64_t interval,
+#     TerminalEmulatorReplayScreenshotFn * screenshot_fn, void * ctx) noexcept;
+terminal_emulator_replay_add_screenshots_every = lib.terminal_emulator_replay_add_screenshots_every
+terminal_emulator_replay_add_screenshots_every.argtypes = [c_void_p, c_int, c_uint64, TerminalEmulatorReplayScreenshotFn, c_void_p]
+terminal_emulator_replay_add_screenshots_every.restype = c_int
+
+# Alert sink: the keywords of \p matcher are searched in the lines of the transcripts
+# (committed lines when there is no transcript) and \p alert_fn receives the time of the frame.
+# \p matcher must outlive \p replay.
+# int terminal_emulator_replay_add_keyword_alert(
+#     TerminalEmulatorReplay * replay, TerminalEmulatorKeywordMatcher const * matcher,
+#     TerminalEmulatorKeywordAlertFn * alert_fn, void * ctx) noexcept;
+terminal_emulator_replay_add_keyword_alert = lib.terminal_emulator_replay_add_keyword_alert
+terminal_emulator_replay_add_keyword_alert.argtypes = [c_void_p, c_void_p, TerminalEmulatorKeywordAlertFn, c_void_p]
+terminal_emulator_replay_add_keyword_alert.restype = c_int
+
+# Sinks only receive frames recorded in [\p start_time, \p end_time) (seconds since epoch).
+# Previous frames are emulated without rendering and the reading stops at the first frame after the window.
+# int terminal_emulator_replay_set_time_window(
+#     TerminalEmulatorReplay * replay, uint32_t start_time, uint32_t end_time) noexcept;
+terminal_emulator_replay_set_time_window = lib.terminal_emulator_replay_set_time_window
+terminal_emulator_replay_set_time_window.argtypes = [c_void_p, c_uint32, c_uint32]
+terminal_emulator_replay_set_time_window.restype = c_int
+
+# int terminal_emulator_replay_ttyrec_buffer(
+#     TerminalEmulatorReplay const * replay,
+#     uint8_t const * data, std::size_t data_len) noexcept;
+terminal_emulator_replay_ttyrec_buffer = lib.terminal_emulator_replay_ttyrec_buffer
+terminal_emulator_replay_ttyrec_buffer.argtypes = [c_void_p, c_char_p, c_size_t]
+terminal_emulator_replay_ttyrec_buffer.restype = c_int
+
+# int terminal_emulator_replay_ttyrec_file(
+#     TerminalEmulatorReplay const * replay, char const * infile) noexcept;
+terminal_emulator_replay_ttyrec_file = lib.terminal_emulator_replay_ttyrec_file
+terminal_emulator_replay_ttyrec_file.argtypes = [c_void_p, c_char_p]
+terminal_emulator_replay_ttyrec_file.restype = c_int
+
+# Same as \c terminal_emulator_replay_ttyrec_file() with a ttyrec read from \p fd (file, pipe, etc).
+# \p fd is not closed.
+# int terminal_emulator_replay_ttyrec_fd(
+#     TerminalEmulatorReplay const * replay, int fd) noexcept;
+terminal_emulator_replay_ttyrec_fd = lib.terminal_emulator_replay_ttyrec_fd
+terminal_emulator_replay_ttyrec_fd.argtypes = [c_void_p, c_int]
+terminal_emulator_replay_ttyrec_fd.restype = c_int
+
+# END replay
+
+# BEGIN frame index
+# Index of a ttyrec for seeking: offset and time of each frame and keyframes
+# with the state of the emulator. An index can be saved in a sidecar file.
+# TerminalEmulatorFrameIndex * terminal_emulator_frame_index_new() noexcept;
+terminal_emulator_frame_index_new = lib.terminal_emulator_frame_index_new
+terminal_emulator_frame_index_new.argtypes = []
+terminal_emulator_frame_index_new.restype = c_void_p
+
+# int terminal_emulator_frame_index_delete(TerminalEmulatorFrameIndex * index) noexcept;
+terminal_emulator_frame_index_delete = lib.terminal_emulator_frame_index_delete
+terminal_emulator_frame_index_delete.argtypes = [c_void_p]
+terminal_emulator_frame_index_delete.restype = c_int
+
+# Index a ttyrec emulated with a screen of \p lines x \p columns.
+# A keyframe is added at the start of the ttyrec, then every \p keyframe_interval
+# seconds of recording and every \p keyframe_bytes bytes of ttyrec (0 for disable).
+# \return -1 for a truncated ttyrec, the index is then unchanged
+# int terminal_emulator_frame_index_build_from_ttyrec_file(
+#     TerminalEmulatorFrameIndex * index, char const * infile, int lines, int columns,
+#     uint32_t keyframe_interval, uint64_t keyframe_bytes) noexcept;
+terminal_emulator_frame_index_build_from_ttyrec_file = lib.terminal_emulator_frame_index_build_from_ttyrec_file
+terminal_emulator_frame_index_build_from_ttyrec_file.argtypes = [c_void_p, c_char_p, c_int, c_int, c_uint32, c_uint64]
+terminal_emulator_frame_index_build_from_ttyrec_file.restype = c_int
+
+# Same as \c terminal_emulator_frame_index_build_from_ttyrec_file() with a ttyrec read from \p fd.
+# \p fd is not closed.
+# int terminal_emulator_frame_index_build_from_ttyrec_fd(
+#     TerminalEmulatorFrameIndex * index, int fd, int lines, int columns,
+#     uint32_t keyframe_interval, uint64_t keyframe_bytes) noexcept;
+terminal_emulator_frame_index_build_from_ttyrec_fd = lib.terminal_emulator_frame_index_build_from_ttyrec_fd
+terminal_emulator_frame_index_build_from_ttyrec_fd.argtypes = [c_void_p, c_int, c_int, c_int, c_uint32, c_uint64]
+terminal_emulator_frame_index_build_from_ttyrec_fd.restype = c_int
+
+# int terminal_emulator_frame_index_save(
+#     TerminalEmulatorFrameIndex const * index, char const * outfile) noexcept;
+terminal_emulator_frame_index_save = lib.terminal_emulator_frame_index_save
+terminal_emulator_frame_index_save.argtypes = [c_void_p, c_char_p]
+terminal_emulator_frame_index_save.restype = c_int
+
+# \return -1 for an invalid index file, the index is then unchanged
+# int terminal_emulator_frame_index_load(
+#     TerminalEmulatorFrameIndex * index, char const * infile) noexcept;
+terminal_emulator_frame_index_load = lib.terminal_emulator_frame_index_load
+terminal_emulator_frame_index_load.argtypes = [c_void_p, c_char_p]
+terminal_emulator_frame_index_load.restype = c_int
+
+# std::size_t terminal_emulator_frame_index_frame_count(
+#     TerminalEmulatorFrameIndex const * index) noexcept;
+terminal_emulator_frame_index_frame_count = lib.terminal_emulator_frame_index_frame_count
+terminal_emulator_frame_index_frame_count.argtypes = [c_void_p]
+terminal_emulator_frame_index_frame_count.restype = c_size_t
+
+# Time of the frame \p i.
+# int terminal_emulator_frame_index_get_frame_time(
+#     TerminalEmulatorFrameIndex const * index, std::size_t i,
+#     uint32_t * sec, uint32_t * usec) noexcept;
+terminal_emulator_frame_index_get_frame_time = lib.terminal_emulator_frame_index_get_frame_time
+terminal_emulator_frame_index_get_frame_time.argtypes = [c_void_p, c_size_t, POINTER(c_uint32), POINTER(c_uint32)]
+terminal_emulator_frame_index_get_frame_time.restype = c_int
+
+# Set \p emu to the state of the indexed ttyrec \p infile at the time \p sec.\p usec:
+# the nearest previous keyframe is restored, then only the following frames
+# recorded until this time are emulated.
+# The frames are expected in chronological order.
+# \return -1 when \p infile does not match the index
+# int terminal_emulator_frame_index_seek(
+#     TerminalEmulatorFrameIndex const * index, TerminalEmulator * emu,
+#     char const * infile, uint32_t sec, uint32_t usec) noexcept;
+terminal_emulator_frame_index_seek = lib.terminal_emulator_frame_index_seek
+terminal_emulator_frame_index_seek.argtypes = [c_void_p, c_void_p, c_char_p, c_uint32, c_uint32]
+terminal_emulator_frame_index_seek.restype = c_int
+
+# END frame index
+
+# BEGIN ttyrec rewriting
+# Write in \p outfd the ttyrec read from \p infd without the frames which leave the visible
+# screen (cells, cursor and title) of a \p lines x \p columns emulator unchanged.
+# The bytes of these frames are merged into the next frame which changes the screen,
+# the rendering of the new ttyrec is the same. The times of the frames are kept.
+# \p infd and \p outfd are not closed.
+# \param max_idle      maximum time between 2 frames in milliseconds (0 for disable),
+#                      the following frames are moved back
+# \param frame_counts  nullptr or array of 2 elements which receives the number of read and written frames
+# \return -1 for a truncated ttyrec, the previous frames are written
+# int terminal_emulator_ttyrec_remove_noop_frames_fd(
+#     int infd, int outfd, int lines, int columns,
+#     uint32_t max_idle, uint64_t * frame_counts) noexcept;
+terminal_emulator_ttyrec_remove_noop_frames_fd = lib.terminal_emulator_ttyrec_remove_noop_frames_fd
+terminal_emulator_ttyrec_remove_noop_frames_fd.argtypes = [c_int, c_int, c_int, c_int, c_uint32, POINTER(c_uint64)]
+terminal_emulator_ttyrec_remove_noop_frames_fd.restype = c_int
+
+# Same as \c terminal_emulator_ttyrec_remove_noop_frames_fd() with files.
+# int terminal_emulator_ttyrec_remove_noop_frames(
+#     char const * infile, char const * outfile, int lines, int columns,
+#     uint32_t max_idle, uint64_t * frame_counts) noexcept;
+terminal_emulator_ttyrec_remove_noop_frames = lib.terminal_emulator_ttyrec_remove_noop_frames
+terminal_emulator_ttyrec_remove_noop_frames.argtypes = [c_char_p, c_char_p, c_int, c_int, c_uint32, POINTER(c_uint64)]
+terminal_emulator_ttyrec_remove_noop_frames.restype = c_int
+
+# Write in \p outfd the ttyrec read from \p infd where the frames are replaced with the
+# escape sequences which turn the previous screen of a \p lines x \p columns emulator
+# into the next one (cursor movements, SGR attributes, erasures and scrolling are chosen
+# for the shortest output).
+# The rendering of the new ttyrec is the same, but not the transcript: the lines which
+# leave the screen without scrolling are lost. The frames without visible change are removed.
+# \p infd and \p outfd are not closed.
+# \param max_idle      maximum time between 2 frames in milliseconds (0 for disable),
+#                      the following frames are moved back
+# \param frame_counts  nullptr or array of 2 elements which receives the number of read and written frames
+# \return -1 for a truncated ttyrec, the previous frames are written
+# int terminal_emulator_ttyrec_reencode_fd(
+#     int infd, int outfd, int lines, int columns,
+#     uint32_t max_idle, uint64_t * frame_counts) noexcept;
+terminal_emulator_ttyrec_reencode_fd = lib.terminal_emulator_ttyrec_reencode_fd
+terminal_emulator_ttyrec_reencode_fd.argtypes = [c_int, c_int, c_int, c_int, c_uint32, POINTER(c_uint64)]
+terminal_emulator_ttyrec_reencode_fd.restype = c_int
+
+# Same as \c terminal_emulator_ttyrec_reencode_fd() with files.
+# int terminal_emulator_ttyrec_reencode(
+#     char const * infile, char const * outfile, int lines, int columns,
+#     uint32_t max_idle, uint64_t * frame_counts) noexcept;
+terminal_emulator_ttyrec_reencode = lib.terminal_emulator_ttyrec_reencode
+terminal_emulator_ttyrec_reencode.argtypes = [c_char_p, c_char_p, c_int, c_int, c_uint32, POINTER(c_uint64)]
+terminal_emulator_ttyrec_reencode.restype = c_int
+
+# END ttyrec rewriting
+
+# BEGIN mirror
+# Terminal of a remote viewer which displays the screen of an emulator.
+# The mirror keeps the last state sent to the viewer, an update only contains
+# the differences (cursor addressing, erasures, SGR changes and scrolling are chosen
+# for the shortest output). A viewer updated less often than the emulator skips the intermediate states.
+# The visible screen, the cursor, the title and the size are reproduced, not the scrollback.
+# \param use_repeat  when not 0, the repeated characters can be written with REP (CSI b),
+#                    which is not supported by all terminals
+# TerminalEmulatorMirror * terminal_emulator_mirror_new(int lines, int columns, int use_repeat) noexcept;
+terminal_emulator_mirror_new = lib.terminal_emulator_mirror_new
+terminal_emulator_mirror_new.argtypes = [c_int, c_int, c_int]
+terminal_emulator_mirror_new.restype = c_void_p
+
+# int terminal_emulator_mirror_delete(TerminalEmulatorMirror * mirror) noexcept;
+terminal_emulator_mirror_delete = lib.terminal_emulator_mirror_delete
+terminal_emulator_mirror_delete.argtypes = [c_void_p]
+terminal_emulator_mirror_delete.restype = c_int
+
+# Replace the content of \p buffer with the ANSI sequences which turn the terminal
+# of the viewer into the current screen of \p emu. The buffer is empty when the viewer is up to date.
+# int terminal_emulator_mirror_update(
+#     TerminalEmulatorMirror * mirror, TerminalEmulator const * emu,
+#     TerminalEmulatorBuffer * buffer) noexcept;
+terminal_emulator_mirror_update = lib.terminal_emulator_mirror_update
+terminal_emulator_mirror_update.argtypes = [c_void_p, c_void_p, c_void_p]
+terminal_emulator_mirror_update.restype = c_int
+
+# The state of the viewer is unknown (new connection, lost output, etc):
+# the next update starts with a reset of the terminal and redraws the whole screen.
+# int terminal_emulator_mirror_reset(TerminalEmulatorMirror * mirror) noexcept;
+terminal_emulator_mirror_reset = lib.terminal_emulator_mirror_reset
+terminal_emulator_mirror_reset.argtypes = [c_void_p]
+terminal_emulator_mirror_reset.restype = c_int
+
+# END mirror
 # @}
@@ -49,7 +49,7 @@ namespace {
                 charClass_[i] |= CTL;
             for (int i = 32; i < 256; ++i)
                 charClass_[i] |= CHR;
-            for (auto s = "@ABCDGHILMPSTXZcdfry"; *s; ++s)
+            for (auto s = "@ABCDGHILMPSTXZbcdfry"; *s; ++s)
                 charClass_[u8(*s)] |= CPN;
             // resize = \e[8;<row>;<col>t
             for (auto s = "t"; *s; ++s)
@@ -92,7 +92,7 @@ namespace {
         CHR|CPN, CHR|CPN,CHR|CPN, CHR|CPN, CHR|CPN, CHR, CHR, CHR|CPN,
         CHR|CPN, CHR|CPN, CHR, CHR, CHR|CPN, CHR|CPN, CHR, CHR, CHR|CPN,
         CHR, CHR, CHR|CPN, CHR|CPN, CHR, CHR, CHR, CHR|CPN, CHR, CHR|CPN,
-        CHR|GRP, CHR, CHR|GRP, CHR, CHR, CHR, CHR, CHR, CHR|CPN, CHR|CPN,
+        CHR|GRP, CHR, CHR|GRP, CHR, CHR, CHR, CHR, CHR|CPN, CHR|CPN, CHR|CPN,
         CHR, CHR|CPN, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR,
         CHR|CPN, CHR, CHR|CPS, CHR, CHR, CHR, CHR, CHR|CPN, CHR, CHR, CHR, CHR,
         CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR, CHR,
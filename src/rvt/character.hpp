@@ -175,6 +175,12 @@ class ExtendedCharTable
 public:
     ExtendedCharTable() = default;
 
+    ExtendedCharTable(ExtendedCharTable&&) = default;
+    ExtendedCharTable& operator=(ExtendedCharTable&&) = default;
+
+    ExtendedCharTable(ExtendedCharTable const& other);
+    ExtendedCharTable& operator=(ExtendedCharTable const& other);
+
     void growChar(Character & character, ucs4_char uc);
 
     void clear();
@@ -194,7 +200,7 @@ inline void ExtendedCharacter::append(ucs4_char uc)
     if (this->len == this->capacity) {
         if (this->len != (1u << (8 * sizeof(this->len) - 1))) {
             std::unique_ptr<ucs4_char[]> u(new ucs4_char[this->capacity * 2u]);
-            memcpy(u.get(), this->chars.get(), this->len);
+            memcpy(u.get(), this->chars.get(), this->len * sizeof(ucs4_char));
             this->chars = std::move(u);
             this->capacity *= 2u;
             this->chars[this->len] = uc;
@@ -208,6 +214,24 @@ inline void ExtendedCharacter::append(ucs4_char uc)
 }
 
 
+inline ExtendedCharTable::ExtendedCharTable(ExtendedCharTable const& other)
+{
+    this->extendedCharTable.reserve(other.extendedCharTable.size());
+    for (ExtendedCharacter const& ext : other.extendedCharTable) {
+        std::unique_ptr<ucs4_char[]> chars{new ucs4_char[ext.capacity]};
+        memcpy(chars.get(), ext.chars.get(), ext.len * sizeof(ucs4_char));
+        this->extendedCharTable.emplace_back(ExtendedCharacter{ext.len, ext.capacity, std::move(chars)});
+    }
+}
+
+inline ExtendedCharTable& ExtendedCharTable::operator=(ExtendedCharTable const& other)
+{
+    if (this != &other) {
+        *this = ExtendedCharTable(other);
+    }
+    return *this;
+}
+
 inline void ExtendedCharTable::growChar(Character & character, ucs4_char uc)
 {
     if (character.is_extended()) {
@@ -223,6 +223,65 @@ public:
      */
     Color color(ColorTableView palette) const;
 
+    /**
+     * Returns the color space (with the dim flag) and the color bytes packed
+     * in an integer, used for serialization.
+     */
+    uint32_t toPacked() const noexcept
+    {
+        return uint32_t(_colorSpaceWithDim.colorSpace())
+             | (_colorSpaceWithDim.isDim() ? 0x8u : 0u)
+             | (uint32_t(_u) << 8)
+             | (uint32_t(_v) << 16)
+             | (uint32_t(_w) << 24);
+    }
+
+    /**
+     * Inverse of toPacked().
+     * Returns false if @p packed does not contain a valid color space or
+     * contains color bytes out of range for this color space.
+     */
+    bool fromPacked(uint32_t packed) noexcept
+    {
+        auto const colorSpace = packed & 0x7;
+        if (colorSpace > uint32_t(ColorSpace::RGB) || (packed & 0xf0)) {
+            return false;
+        }
+
+        uint8_t const u = uint8_t(packed >> 8);
+        uint8_t const v = uint8_t(packed >> 16);
+        uint8_t const w = uint8_t(packed >> 24);
+
+        // the bytes are used as palette index by color()
+        bool const isValidColor = [&]{
+            switch (ColorSpace(colorSpace)) {
+            case ColorSpace::Default:
+                return u <= 1 && v <= 1 && !w;
+            case ColorSpace::System:
+                return u <= 7 && v <= 1 && !w;
+            case ColorSpace::Index256:
+                return !v && !w;
+            case ColorSpace::RGB:
+                return true;
+            case ColorSpace::Undefined:
+                return !u && !v && !w;
+            }
+            return false;
+        }();
+        if (!isValidColor) {
+            return false;
+        }
+
+        _colorSpaceWithDim = ColorSpaceWithDim(ColorSpace(colorSpace));
+        if (packed & 0x8) {
+            _colorSpaceWithDim.setDim();
+        }
+        _u = u;
+        _v = v;
+        _w = w;
+        return true;
+    }
+
     /**
      * Compares two colors and returns true if they represent the same color value and
      * use the same color space.
@@ -0,0 +1,70 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+
+#include "rvt/emulator_state.hpp"
+#include "rvt/state_stream.hpp"
+#include "rvt/vt_emulator.hpp"
+#include "rvt/utf8_decoder.hpp"
+
+
+namespace rvt
+{
+
+void write_emulator_state(std::vector<uint8_t> & out, VtEmulator const & emulator, Utf8Decoder const & decoder)
+{
+    StateWriter writer(out);
+    writer.u32(emulator_state_magic);
+    writer.u8(emulator_state_version);
+
+    auto const pending_bytes = decoder.pending_bytes();
+    writer.u8(uint8_t(pending_bytes.size()));
+    writer.bytes(pending_bytes);
+
+    emulator.writeState(writer);
+}
+
+bool read_emulator_state(array_view<uint8_t const> data, VtEmulator & emulator, Utf8Decoder & decoder)
+{
+    StateReader reader(data);
+    bool const valid_header
+        = reader.u32() == emulator_state_magic
+       && reader.u8() == emulator_state_version;
+
+    std::size_t const pending_len = reader.u8();
+    if (pending_len > 4) {
+        reader.fail();
+    }
+    auto const pending_bytes = reader.bytes(pending_len);
+
+    if (!valid_header) {
+        reader.fail();
+    }
+
+    if (emulator.readState(reader)) {
+        decoder.set_pending_bytes(pending_bytes);
+        return true;
+    }
+
+    decoder.set_pending_bytes({});
+    return false;
+}
+
+}
@@ -0,0 +1,52 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+
+#pragma once
+
+#include "utils/sugar/array_view.hpp"
+
+#include <vector>
+
+#include <cstdint>
+
+
+namespace rvt
+{
+
+class VtEmulator;
+struct Utf8Decoder;
+
+/**
+ * Serialized state of an emulator and of its UTF-8 decoder (keyframe of a ttyrec,
+ * checkpoint, etc), with a magic number and a format version.
+ * The format is little endian and does not depend on the platform.
+ */
+constexpr uint32_t emulator_state_magic = 0x53545652; // "RVTS"
+constexpr uint8_t emulator_state_version = 1;
+
+/// Append the state of \p emulator and \p decoder to \p out.
+void write_emulator_state(std::vector<uint8_t> & out, VtEmulator const & emulator, Utf8Decoder const & decoder);
+
+/// Restore a state written by \c write_emulator_state(), the storage of \p emulator is reused.
+/// With an invalid state, \p emulator (previous size) and \p decoder are reset and false is returned.
+bool read_emulator_state(array_view<uint8_t const> data, VtEmulator & emulator, Utf8Decoder & decoder);
+
+}
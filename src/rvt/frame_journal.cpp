@@ -0,0 +1,199 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#include "rvt/frame_journal.hpp"
+#include "rvt/state_stream.hpp"
+#include "rvt/vt_emulator.hpp"
+#include "rvt/utf8_decoder.hpp"
+
+#include <utility>
+
+
+namespace rvt
+{
+
+FrameJournal::FrameJournal(VtEmulator & emulator, std::size_t maxBytes)
+: _emulator(emulator)
+, _maxBytes(maxBytes)
+{
+    _emulator.setChangeTracking(true, this);
+}
+
+FrameJournal::~FrameJournal()
+{
+    _emulator.setChangeTracking(false);
+}
+
+void FrameJournal::beginFrame(Utf8Decoder const & decoder)
+{
+    endFrame();
+
+    Frame& frame = _frames.emplace_back();
+    frame.data = std::move(_spareData);
+    frame.data.clear();
+
+    try {
+        StateWriter writer(frame.data);
+        auto const pending_bytes = decoder.pending_bytes();
+        writer.u8(uint8_t(pending_bytes.size()));
+        writer.bytes(pending_bytes);
+        _emulator.writeTerminalState(writer);
+    }
+    catch (...) {
+        _frames.pop_back();
+        throw;
+    }
+    frame.linesOffset = frame.data.size();
+
+    _emulator.resetChangedLines();
+    _recording = true;
+}
+
+void FrameJournal::endFrame() noexcept
+{
+    if (!_recording) {
+        return;
+    }
+
+    _recording = false;
+    _bytes += _frames.back().memoryUsage();
+    while (_bytes > _maxBytes && !_frames.empty()) {
+        popFrontFrame();
+    }
+}
+
+// a modification outside a frame or an incomplete frame cannot be undone: the journal is cleared
+
+void FrameJournal::beforeLineChange(Screen const& screen, int y)
+{
+    if (!_recording) {
+        clear();
+        return;
+    }
+
+    Frame& frame = _frames.back();
+    if (frame.snapshotOffset != noSnapshot) {
+        return;
+    }
+
+    try {
+        StateWriter writer(frame.data);
+        writer.u8(_emulator.isAlternateScreen(screen));
+        writer.uvar(unsigned(y));
+        screen.writeLine(writer, y);
+    }
+    catch (...) {
+        clear();
+        throw;
+    }
+}
+
+void FrameJournal::beforeResize(Screen const& /*screen*/)
+{
+    if (!_recording) {
+        clear();
+        return;
+    }
+
+    Frame& frame = _frames.back();
+    if (frame.snapshotOffset != noSnapshot) {
+        return;
+    }
+
+    // the lines modified before the resize are restored after the snapshot
+    try {
+        frame.snapshotOffset = frame.data.size();
+        StateWriter writer(frame.data);
+        _emulator.writeState(writer);
+    }
+    catch (...) {
+        clear();
+        throw;
+    }
+}
+
+bool FrameJournal::undoFrame(Utf8Decoder & decoder)
+{
+    endFrame();
+
+    if (_frames.empty()) {
+        return false;
+    }
+
+    Frame& frame = _frames.back();
+    uint8_t const* data = frame.data.data();
+    std::size_t const linesEnd = frame.snapshotOffset == noSnapshot
+        ? frame.data.size()
+        : frame.snapshotOffset;
+
+    bool isValid = true;
+
+    if (frame.snapshotOffset != noSnapshot) {
+        StateReader reader({data + frame.snapshotOffset, frame.data.size() - frame.snapshotOffset});
+        isValid = _emulator.readState(reader);
+    }
+
+    StateReader linesReader({data + frame.linesOffset, linesEnd - frame.linesOffset});
+    while (isValid && linesReader.remaining()) {
+        bool const alternateScreen = linesReader.u8();
+        int const y = int(linesReader.size(std::size_t(_emulator.getCurrentScreen().getLines() - 1)));
+        isValid = !linesReader.failed() && _emulator.readScreenLine(linesReader, alternateScreen, y);
+    }
+
+    StateReader reader({data, frame.linesOffset});
+    std::size_t const pending_len = reader.u8();
+    auto const pending_bytes = reader.bytes(pending_len <= 4 ? pending_len : 0);
+    isValid = isValid && pending_len <= 4 && _emulator.readTerminalState(reader);
+
+    if (!isValid) {
+        clear();
+        decoder.set_pending_bytes({});
+        return false;
+    }
+
+    decoder.set_pending_bytes(pending_bytes);
+    _bytes -= frame.memoryUsage();
+    _spareData = std::move(frame.data);
+    _frames.pop_back();
+    return true;
+}
+
+void FrameJournal::clear() noexcept
+{
+    // the frame being recorded is not counted in _bytes
+    if (std::exchange(_recording, false)) {
+        _frames.pop_back();
+    }
+    while (!_frames.empty()) {
+        popFrontFrame();
+    }
+}
+
+void FrameJournal::popFrontFrame() noexcept
+{
+    Frame& frame = _frames.front();
+    _bytes -= frame.memoryUsage();
+    if (frame.data.capacity() > _spareData.capacity()) {
+        _spareData = std::move(frame.data);
+    }
+    _frames.pop_front();
+}
+
+}
@@ -0,0 +1,109 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#pragma once
+
+#include "rvt/screen.hpp"
+
+#include <deque>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace rvt
+{
+
+class VtEmulator;
+struct Utf8Decoder;
+
+/**
+ * Reverse deltas of the frames emulated by a \c VtEmulator for stepping backward.
+ *
+ * A frame is the emulation between beginFrame() and endFrame(). The journal
+ * keeps the terminal state before the frame (cursor, modes, title, charsets,
+ * partial sequences, etc) and the previous content of the lines modified by
+ * the frame. A frame which resizes the screens keeps a copy of the emulator instead.
+ * The oldest frames are dropped when the journal exceeds its memory limit.
+ *
+ * The journal uses the change tracking of the screens while it exists.
+ * The waiting lines of the line savers are not restored.
+ */
+class FrameJournal final : private Screen::ChangeObserver
+{
+public:
+    /// \param maxBytes  memory limit of the journal
+    FrameJournal(VtEmulator & emulator, std::size_t maxBytes);
+    ~FrameJournal();
+
+    FrameJournal(FrameJournal const&) = delete;
+    FrameJournal& operator=(FrameJournal const&) = delete;
+
+    void beginFrame(Utf8Decoder const & decoder);
+    void endFrame() noexcept;
+
+    /// Restore the emulator and the decoder before the last frame.
+    /// \return false when the journal is empty or when a frame is invalid (the journal is then cleared)
+    bool undoFrame(Utf8Decoder & decoder);
+
+    void clear() noexcept;
+
+    std::size_t frameCount() const noexcept
+    {
+        return _frames.size();
+    }
+
+    std::size_t memoryUsage() const noexcept
+    {
+        return _bytes;
+    }
+
+private:
+    void beforeLineChange(Screen const& screen, int y) override;
+    void beforeResize(Screen const& screen) override;
+
+    static constexpr std::size_t noSnapshot = ~std::size_t();
+
+    /// [terminal state][lines][emulator state (snapshot)]
+    struct Frame
+    {
+        std::vector<uint8_t> data;
+        std::size_t linesOffset = 0;
+        std::size_t snapshotOffset = noSnapshot;
+
+        std::size_t memoryUsage() const noexcept
+        {
+            return sizeof(Frame) + data.capacity();
+        }
+    };
+
+    void popFrontFrame() noexcept;
+
+    VtEmulator & _emulator;
+    std::deque<Frame> _frames;
+    /// buffer of a dropped frame reused by the next frame
+    std::vector<uint8_t> _spareData;
+    std::size_t _bytes = 0;
+    std::size_t _maxBytes;
+    bool _recording = false;
+};
+
+}
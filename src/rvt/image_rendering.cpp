@@ -0,0 +1,416 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#include "rvt/image_rendering.hpp"
+#include "rvt/screen.hpp"
+
+#include "cxx/cxx.hpp"
+#include "utils/sugar/bytes_t.hpp"
+
+#include <algorithm>
+#include <new>
+
+#include <cstdio>
+#include <cstring>
+
+namespace rvt {
+
+namespace
+{
+
+/// 5x7 glyphs of ' ' to '~' with a row for descenders, bit 7 is the leftmost pixel.
+constexpr uint8_t ascii_glyphs[][8] = {
+    /* ' ' */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* '!' */ {0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x10, 0x00},
+    /* '"' */ {0x28, 0x28, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* '#' */ {0x28, 0x28, 0x7c, 0x28, 0x7c, 0x28, 0x28, 0x00},
+    /* '$' */ {0x10, 0x3c, 0x50, 0x38, 0x14, 0x78, 0x10, 0x00},
+    /* '%' */ {0x60, 0x64, 0x08, 0x10, 0x20, 0x4c, 0x0c, 0x00},
+    /* '&' */ {0x30, 0x48, 0x50, 0x20, 0x54, 0x48, 0x34, 0x00},
+    /* '\'' */ {0x10, 0x10, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* '(' */ {0x08, 0x10, 0x20, 0x20, 0x20, 0x10, 0x08, 0x00},
+    /* ')' */ {0x20, 0x10, 0x08, 0x08, 0x08, 0x10, 0x20, 0x00},
+    /* '*' */ {0x00, 0x10, 0x54, 0x38, 0x54, 0x10, 0x00, 0x00},
+    /* '+' */ {0x00, 0x10, 0x10, 0x7c, 0x10, 0x10, 0x00, 0x00},
+    /* ',' */ {0x00, 0x00, 0x00, 0x00, 0x30, 0x10, 0x20, 0x00},
+    /* '-' */ {0x00, 0x00, 0x00, 0x7c, 0x00, 0x00, 0x00, 0x00},
+    /* '.' */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x30, 0x00},
+    /* '/' */ {0x00, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00, 0x00},
+    /* '0' */ {0x38, 0x44, 0x4c, 0x54, 0x64, 0x44, 0x38, 0x00},
+    /* '1' */ {0x10, 0x30, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00},
+    /* '2' */ {0x38, 0x44, 0x04, 0x08, 0x10, 0x20, 0x7c, 0x00},
+    /* '3' */ {0x7c, 0x08, 0x10, 0x08, 0x04, 0x44, 0x38, 0x00},
+    /* '4' */ {0x08, 0x18, 0x28, 0x48, 0x7c, 0x08, 0x08, 0x00},
+    /* '5' */ {0x7c, 0x40, 0x78, 0x04, 0x04, 0x44, 0x38, 0x00},
+    /* '6' */ {0x18, 0x20, 0x40, 0x78, 0x44, 0x44, 0x38, 0x00},
+    /* '7' */ {0x7c, 0x04, 0x08, 0x10, 0x20, 0x20, 0x20, 0x00},
+    /* '8' */ {0x38, 0x44, 0x44, 0x38, 0x44, 0x44, 0x38, 0x00},
+    /* '9' */ {0x38, 0x44, 0x44, 0x3c, 0x04, 0x08, 0x30, 0x00},
+    /* ':' */ {0x00, 0x30, 0x30, 0x00, 0x30, 0x30, 0x00, 0x00},
+    /* ';' */ {0x00, 0x30, 0x30, 0x00, 0x30, 0x10, 0x20, 0x00},
+    /* '<' */ {0x08, 0x10, 0x20, 0x40, 0x20, 0x10, 0x08, 0x00},
+    /* '=' */ {0x00, 0x00, 0x7c, 0x00, 0x7c, 0x00, 0x00, 0x00},
+    /* '>' */ {0x20, 0x10, 0x08, 0x04, 0x08, 0x10, 0x20, 0x00},
+    /* '?' */ {0x38, 0x44, 0x04, 0x08, 0x10, 0x00, 0x10, 0x00},
+    /* '@' */ {0x38, 0x44, 0x04, 0x34, 0x54, 0x54, 0x38, 0x00},
+    /* 'A' */ {0x38, 0x44, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x00},
+    /* 'B' */ {0x78, 0x44, 0x44, 0x78, 0x44, 0x44, 0x78, 0x00},
+    /* 'C' */ {0x38, 0x44, 0x40, 0x40, 0x40, 0x44, 0x38, 0x00},
+    /* 'D' */ {0x70, 0x48, 0x44, 0x44, 0x44, 0x48, 0x70, 0x00},
+    /* 'E' */ {0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x7c, 0x00},
+    /* 'F' */ {0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x40, 0x00},
+    /* 'G' */ {0x38, 0x44, 0x40, 0x5c, 0x44, 0x44, 0x3c, 0x00},
+    /* 'H' */ {0x44, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x44, 0x00},
+    /* 'I' */ {0x38, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00},
+    /* 'J' */ {0x1c, 0x08, 0x08, 0x08, 0x08, 0x48, 0x30, 0x00},
+    /* 'K' */ {0x44, 0x48, 0x50, 0x60, 0x50, 0x48, 0x44, 0x00},
+    /* 'L' */ {0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7c, 0x00},
+    /* 'M' */ {0x44, 0x6c, 0x54, 0x54, 0x44, 0x44, 0x44, 0x00},
+    /* 'N' */ {0x44, 0x44, 0x64, 0x54, 0x4c, 0x44, 0x44, 0x00},
+    /* 'O' */ {0x38, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00},
+    /* 'P' */ {0x78, 0x44, 0x44, 0x78, 0x40, 0x40, 0x40, 0x00},
+    /* 'Q' */ {0x38, 0x44, 0x44, 0x44, 0x54, 0x48, 0x34, 0x00},
+    /* 'R' */ {0x78, 0x44, 0x44, 0x78, 0x50, 0x48, 0x44, 0x00},
+    /* 'S' */ {0x3c, 0x40, 0x40, 0x38, 0x04, 0x04, 0x78, 0x00},
+    /* 'T' */ {0x7c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00},
+    /* 'U' */ {0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00},
+    /* 'V' */ {0x44, 0x44, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00},
+    /* 'W' */ {0x44, 0x44, 0x44, 0x54, 0x54, 0x54, 0x28, 0x00},
+    /* 'X' */ {0x44, 0x44, 0x28, 0x10, 0x28, 0x44, 0x44, 0x00},
+    /* 'Y' */ {0x44, 0x44, 0x44, 0x28, 0x10, 0x10, 0x10, 0x00},
+    /* 'Z' */ {0x7c, 0x04, 0x08, 0x10, 0x20, 0x40, 0x7c, 0x00},
+    /* '[' */ {0x38, 0x20, 0x20, 0x20, 0x20, 0x20, 0x38, 0x00},
+    /* '\\' */ {0x00, 0x40, 0x20, 0x10, 0x08, 0x04, 0x00, 0x00},
+    /* ']' */ {0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00},
+    /* '^' */ {0x10, 0x28, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* '_' */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7c, 0x00},
+    /* '`' */ {0x20, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 'a' */ {0x00, 0x00, 0x38, 0x04, 0x3c, 0x44, 0x3c, 0x00},
+    /* 'b' */ {0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x78, 0x00},
+    /* 'c' */ {0x00, 0x00, 0x38, 0x40, 0x40, 0x44, 0x38, 0x00},
+    /* 'd' */ {0x04, 0x04, 0x34, 0x4c, 0x44, 0x44, 0x3c, 0x00},
+    /* 'e' */ {0x00, 0x00, 0x38, 0x44, 0x7c, 0x40, 0x38, 0x00},
+    /* 'f' */ {0x18, 0x24, 0x20, 0x70, 0x20, 0x20, 0x20, 0x00},
+    /* 'g' */ {0x00, 0x00, 0x3c, 0x44, 0x44, 0x3c, 0x04, 0x38},
+    /* 'h' */ {0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00},
+    /* 'i' */ {0x10, 0x00, 0x30, 0x10, 0x10, 0x10, 0x38, 0x00},
+    /* 'j' */ {0x08, 0x00, 0x18, 0x08, 0x08, 0x08, 0x48, 0x30},
+    /* 'k' */ {0x20, 0x20, 0x24, 0x28, 0x30, 0x28, 0x24, 0x00},
+    /* 'l' */ {0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00},
+    /* 'm' */ {0x00, 0x00, 0x68, 0x54, 0x54, 0x44, 0x44, 0x00},
+    /* 'n' */ {0x00, 0x00, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00},
+    /* 'o' */ {0x00, 0x00, 0x38, 0x44, 0x44, 0x44, 0x38, 0x00},
+    /* 'p' */ {0x00, 0x00, 0x78, 0x44, 0x44, 0x78, 0x40, 0x40},
+    /* 'q' */ {0x00, 0x00, 0x3c, 0x44, 0x44, 0x3c, 0x04, 0x04},
+    /* 'r' */ {0x00, 0x00, 0x58, 0x64, 0x40, 0x40, 0x40, 0x00},
+    /* 's' */ {0x00, 0x00, 0x38, 0x40, 0x38, 0x04, 0x78, 0x00},
+    /* 't' */ {0x20, 0x20, 0x70, 0x20, 0x20, 0x24, 0x18, 0x00},
+    /* 'u' */ {0x00, 0x00, 0x44, 0x44, 0x44, 0x4c, 0x34, 0x00},
+    /* 'v' */ {0x00, 0x00, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00},
+    /* 'w' */ {0x00, 0x00, 0x44, 0x44, 0x54, 0x54, 0x28, 0x00},
+    /* 'x' */ {0x00, 0x00, 0x44, 0x28, 0x10, 0x28, 0x44, 0x00},
+    /* 'y' */ {0x00, 0x00, 0x44, 0x44, 0x44, 0x3c, 0x04, 0x38},
+    /* 'z' */ {0x00, 0x00, 0x7c, 0x08, 0x10, 0x20, 0x7c, 0x00},
+    /* '{' */ {0x08, 0x10, 0x10, 0x20, 0x10, 0x10, 0x08, 0x00},
+    /* '|' */ {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00},
+    /* '}' */ {0x20, 0x10, 0x10, 0x08, 0x10, 0x10, 0x20, 0x00},
+    /* '~' */ {0x00, 0x00, 0x20, 0x54, 0x08, 0x00, 0x00, 0x00},
+};
+
+constexpr int glyph_top = 2;
+constexpr int underline_top = 10;
+
+enum BoxWeight : uint8_t { none, light, heavy, doubled };
+
+/// Weight of the arms of U+2500 to U+257F, 2 bits by arm: left, up, right, down.
+constexpr uint8_t box_arms[] = {
+    0x11, 0x22, 0x44, 0x88, 0x11, 0x22, 0x44, 0x88, // U+2500
+    0x11, 0x22, 0x44, 0x88, 0x50, 0x60, 0x90, 0xa0, // U+2508
+    0x41, 0x42, 0x81, 0x82, 0x14, 0x24, 0x18, 0x28, // U+2510
+    0x05, 0x06, 0x09, 0x0a, 0x54, 0x64, 0x58, 0x94, // U+2518
+    0x98, 0x68, 0xa4, 0xa8, 0x45, 0x46, 0x49, 0x85, // U+2520
+    0x89, 0x4a, 0x86, 0x8a, 0x51, 0x52, 0x61, 0x62, // U+2528
+    0x91, 0x92, 0xa1, 0xa2, 0x15, 0x16, 0x25, 0x26, // U+2530
+    0x19, 0x1a, 0x29, 0x2a, 0x55, 0x56, 0x65, 0x66, // U+2538
+    0x59, 0x95, 0x99, 0x5a, 0x69, 0x96, 0xa5, 0x6a, // U+2540
+    0xa6, 0x9a, 0xa9, 0xaa, 0x11, 0x22, 0x44, 0x88, // U+2548
+    0x33, 0xcc, 0x70, 0xd0, 0xf0, 0x43, 0xc1, 0xc3, // U+2550
+    0x34, 0x1c, 0x3c, 0x07, 0x0d, 0x0f, 0x74, 0xdc, // U+2558
+    0xfc, 0x47, 0xcd, 0xcf, 0x73, 0xd1, 0xf3, 0x37, // U+2560
+    0x1d, 0x3f, 0x77, 0xdd, 0xff, 0x50, 0x41, 0x05, // U+2568
+    0x14, 0x00, 0x00, 0x00, 0x01, 0x04, 0x10, 0x40, // U+2570
+    0x02, 0x08, 0x20, 0x80, 0x21, 0x84, 0x12, 0x48, // U+2578
+};
+
+Color blend(Color const & bg, Color const & fg, int alpha) noexcept
+{
+    auto mix = [alpha](int bg, int fg) { return uint8_t(bg + (fg - bg) * alpha / 4); };
+    return Color(mix(bg.red(), fg.red()), mix(bg.green(), fg.green()), mix(bg.blue(), fg.blue()));
+}
+
+struct CellPainter
+{
+    uint8_t * p; // first pixel of cell
+    std::size_t stride; // bytes by line of image
+    int width;
+    int height;
+    int scale;
+
+    void fill(int x0, int y0, int x1, int y1, Color const & color) const
+    {
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, width);
+        y1 = std::min(y1, height);
+        for (int y = y0; y < y1; ++y) {
+            uint8_t * pixel = p + std::size_t(y) * stride + std::size_t(x0) * 3u;
+            for (int x = x0; x < x1; ++x) {
+                *pixel++ = color.red();
+                *pixel++ = color.green();
+                *pixel++ = color.blue();
+            }
+        }
+    }
+
+    void fill(Color const & color) const
+    {
+        fill(0, 0, width, height, color);
+    }
+
+    void draw_glyph(uint8_t const (&glyph)[8], bool is_bold, Color const & fg) const
+    {
+        int const s = scale;
+        for (int gy = 0; gy < 8; ++gy) {
+            unsigned row = glyph[gy];
+            if (is_bold) {
+                row |= row >> 1;
+            }
+            int const y = (glyph_top + gy) * s;
+            for (int gx = 0; row; ++gx, row = (row << 1) & 0xffu) {
+                if (row & 0x80u) {
+                    fill(gx * s, y, (gx + 1) * s, y + s, fg);
+                }
+            }
+        }
+    }
+
+    void draw_unknown(Color const & fg) const
+    {
+        int const s = scale;
+        int const x0 = 1 * s;
+        int const x1 = 6 * s;
+        int const y0 = glyph_top * s;
+        int const y1 = (glyph_top + 7) * s;
+        fill(x0, y0, x1, y0 + s, fg);
+        fill(x0, y1 - s, x1, y1, fg);
+        fill(x0, y0, x0 + s, y1, fg);
+        fill(x1 - s, y0, x1, y1, fg);
+    }
+
+    void draw_box(uint8_t arms, Color const & fg) const
+    {
+        int const t = scale;
+        auto band_begin = [t](int c, int weight) {
+            switch (weight) {
+                case heavy: return c - t;
+                case doubled: return c - t / 2 - t;
+                default: return c - t / 2;
+            }
+        };
+        auto band_end = [t](int c, int weight) {
+            switch (weight) {
+                case heavy: return c + t;
+                case doubled: return c - t / 2 + 2 * t;
+                default: return c - t / 2 + t;
+            }
+        };
+
+        int const left = arms & 3;
+        int const up = (arms >> 2) & 3;
+        int const right = (arms >> 4) & 3;
+        int const down = (arms >> 6) & 3;
+
+        int const cx = width / 2;
+        int const cy = height / 2;
+        int const vertical = std::max({up, down, int(light)});
+        int const horizontal = std::max({left, right, int(light)});
+
+        auto hline = [&](int x0, int x1, int weight) {
+            if (weight == doubled) {
+                int const y = band_begin(cy, doubled);
+                fill(x0, y, x1, y + t, fg);
+                fill(x0, y + 2 * t, x1, y + 3 * t, fg);
+            }
+            else if (weight) {
+                fill(x0, band_begin(cy, weight), x1, band_end(cy, weight), fg);
+            }
+        };
+        auto vline = [&](int y0, int y1, int weight) {
+            if (weight == doubled) {
+                int const x = band_begin(cx, doubled);
+                fill(x, y0, x + t, y1, fg);
+                fill(x + 2 * t, y0, x + 3 * t, y1, fg);
+            }
+            else if (weight) {
+                fill(band_begin(cx, weight), y0, band_end(cx, weight), y1, fg);
+            }
+        };
+
+        hline(0, band_end(cx, vertical), left);
+        hline(band_begin(cx, vertical), width, right);
+        vline(0, band_end(cy, horizontal), up);
+        vline(band_begin(cy, horizontal), height, down);
+    }
+
+    void draw_diagonal(bool rising, Color const & fg) const
+    {
+        for (int y = 0; y < height; ++y) {
+            int const dy = rising ? height - 1 - y : y;
+            int const x = dy * width / height;
+            fill(x, y, x + scale, y + 1, fg);
+        }
+    }
+
+    /// U+2580 to U+259F
+    void draw_block(ucs4_char uc, Color const & bg, Color const & fg) const
+    {
+        int const w = width;
+        int const h = height;
+        switch (uc) {
+            case 0x2580: fill(0, 0, w, h / 2, fg); break;
+            case 0x2590: fill(w / 2, 0, w, h, fg); break;
+            case 0x2591: fill(blend(bg, fg, 1)); break;
+            case 0x2592: fill(blend(bg, fg, 2)); break;
+            case 0x2593: fill(blend(bg, fg, 3)); break;
+            case 0x2594: fill(0, 0, w, h / 8, fg); break;
+            case 0x2595: fill(w - w / 8, 0, w, h, fg); break;
+            default:
+                if (uc <= 0x2588) {
+                    int const n = int(uc - 0x2580);
+                    fill(0, h - h * n / 8, w, h, fg);
+                }
+                else if (uc <= 0x258F) {
+                    int const n = int(0x2590 - uc);
+                    fill(0, 0, w * n / 8, h, fg);
+                }
+                else {
+                    // quadrants: 1 = upper left, 2 = upper right, 4 = lower left, 8 = lower right
+                    constexpr uint8_t quadrants[] = {4, 8, 1, 13, 9, 7, 11, 2, 6, 14};
+                    unsigned const q = quadrants[uc - 0x2596];
+                    if (q & 1) fill(0, 0, w / 2, h / 2, fg);
+                    if (q & 2) fill(w / 2, 0, w, h / 2, fg);
+                    if (q & 4) fill(0, h / 2, w / 2, h, fg);
+                    if (q & 8) fill(w / 2, h / 2, w, h, fg);
+                }
+        }
+    }
+
+    void draw(Character const & ch, ColorTableView palette) const
+    {
+        // colors are already swapped with Rendition::Reverse
+        Color const fg = ch.foregroundColor.color(palette);
+        Color const bg = ch.backgroundColor.color(palette);
+
+        fill(bg);
+
+        ucs4_char const uc = ch.is_extended() ? 0 : ch.character;
+        if (ch.isRealCharacter && uc != ' ' && uc != 0xA0) {
+            if (uc > ' ' && uc < 0x7F) {
+                draw_glyph(ascii_glyphs[uc - ' '], bool(ch.rendition & Rendition::Bold), fg);
+            }
+            else if (uc >= 0x2571 && uc <= 0x2573) {
+                if (uc != 0x2572) draw_diagonal(true, fg);
+                if (uc != 0x2571) draw_diagonal(false, fg);
+            }
+            else if (uc >= 0x2500 && uc <= 0x257F) {
+                draw_box(box_arms[uc - 0x2500], fg);
+            }
+            else if (uc >= 0x2580 && uc <= 0x259F) {
+                draw_block(uc, bg, fg);
+            }
+            else {
+                draw_unknown(fg);
+            }
+        }
+
+        if (bool(ch.rendition & Rendition::Underline)) {
+            fill(0, underline_top * scale, width, (underline_top + 1) * scale, fg);
+        }
+    }
+};
+
+}
+
+void image_rendering(
+    Screen const & screen,
+    ColorTableView palette,
+    RenderingBuffer buffer,
+    ImageFormat format,
+    int scale
+) {
+    scale = std::max(1, scale);
+
+    int const cell_width = image_cell_width * scale;
+    int const cell_height = image_cell_height * scale;
+    int const nb_columns = screen.getColumns();
+    int const nb_lines = screen.getLines();
+    int const width = nb_columns * cell_width;
+    int const height = nb_lines * cell_height;
+
+    char header[128];
+    int const header_len = (format == ImageFormat::pam)
+        ? snprintf(header, sizeof(header),
+            "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 3\nMAXVAL 255\nTUPLTYPE RGB\nENDHDR\n",
+            width, height)
+        : snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+
+    std::size_t const stride = std::size_t(width) * 3u;
+    std::size_t const len = std::size_t(header_len) + stride * std::size_t(height);
+
+    uint8_t * p = bytes_t(buffer.buffer).to_u8p();
+    if (buffer.length < len) {
+        std::size_t capacity = len;
+        p = buffer.allocate(buffer.ctx, &capacity, p, 0);
+        if (REDEMPTION_UNLIKELY(!p)) {
+            throw std::bad_alloc();
+        }
+    }
+
+    memcpy(p, header, std::size_t(header_len));
+
+    uint8_t * const pixels = p + header_len;
+    Character const default_ch;
+    auto const&& lines = screen.getScreenLines();
+
+    for (int y = 0; y < nb_lines; ++y) {
+        auto const & line = lines[std::size_t(y)];
+        for (int x = 0; x < nb_columns; ++x) {
+            CellPainter painter{
+                pixels + std::size_t(y * cell_height) * stride + std::size_t(x * cell_width) * 3u,
+                stride, cell_width, cell_height, scale
+            };
+            painter.draw(std::size_t(x) < line.size() ? line[std::size_t(x)] : default_ch, palette);
+        }
+    }
+
+    buffer.set_final_buffer(buffer.ctx, p, len);
+}
+
+}
@@ -0,0 +1,51 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#pragma once
+
+#include "rvt/character_color.hpp"
+#include "rvt/text_rendering.hpp"
+
+namespace rvt {
+
+class Screen;
+
+enum class ImageFormat : uint8_t
+{
+    /// binary Portable PixMap (P6)
+    ppm,
+    /// Portable Arbitrary Map (P7) with RGB tuples
+    pam,
+};
+
+/// Size in pixels of a character cell with a scale of 1.
+constexpr int image_cell_width = 8;
+constexpr int image_cell_height = 12;
+
+/// Rasterize \c screen with a built-in bitmap font (ASCII, box drawing and block elements),
+/// the other characters are drawn as a rectangle.
+/// The image has columns * image_cell_width * scale pixels by line
+/// and lines * image_cell_height * scale lines.
+void image_rendering(
+    Screen const & screen, ColorTableView palette,
+    RenderingBuffer buffer, ImageFormat format, int scale = 1
+);
+
+}
@@ -0,0 +1,121 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#include "rvt/keyword_matcher.hpp"
+
+#include <algorithm>
+#include <utility>
+
+
+namespace rvt
+{
+
+KeywordMatcher::KeywordMatcher(array_view<std::string_view const> patterns, bool ignore_ascii_case)
+: _patternCount(patterns.size())
+{
+    for (std::size_t c = 0; c < _foldCase.size(); ++c) {
+        _foldCase[c] = (ignore_ascii_case && 'A' <= c && c <= 'Z')
+            ? uint8_t(c - 'A' + 'a')
+            : uint8_t(c);
+    }
+
+    // trie
+    struct TrieNode
+    {
+        std::vector<std::pair<uint8_t, State>> transitions;
+        std::vector<uint32_t> outputs;
+    };
+    std::vector<TrieNode> trie(1);
+
+    for (std::size_t id = 0; id < patterns.size(); ++id) {
+        std::string_view const pattern = patterns[id];
+        if (pattern.empty()) {
+            continue;
+        }
+        State state = root;
+        for (char ch : pattern) {
+            uint8_t const c = _foldCase[uint8_t(ch)];
+            auto& transitions = trie[state].transitions;
+            auto it = std::find_if(transitions.begin(), transitions.end(),
+                                   [c](auto const& t){ return t.first == c; });
+            if (it != transitions.end()) {
+                state = it->second;
+            }
+            else {
+                State const next = State(trie.size());
+                transitions.emplace_back(c, next);
+                trie.emplace_back();
+                state = next;
+            }
+        }
+        trie[state].outputs.push_back(uint32_t(id));
+    }
+
+    // flatten the trie in breadth-first order, the failure of a state
+    // is computed before the states of the next depth
+    _nodes.resize(trie.size());
+    _rootTransitions.fill(root);
+
+    std::vector<State> queue;
+    queue.reserve(trie.size());
+    queue.push_back(root);
+
+    for (std::size_t iqueue = 0; iqueue < queue.size(); ++iqueue) {
+        State const state = queue[iqueue];
+        TrieNode& trie_node = trie[state];
+        Node& node = _nodes[state];
+
+        std::sort(trie_node.transitions.begin(), trie_node.transitions.end());
+
+        node.firstTransition = uint32_t(_transitions.size());
+        for (auto const& [c, next] : trie_node.transitions) {
+            _transitions.push_back({c, next});
+            queue.push_back(next);
+
+            Node& next_node = _nodes[next];
+            next_node.failure = (state == root) ? root : this->next(node.failure, c);
+            if (state == root) {
+                _rootTransitions[c] = next;
+            }
+        }
+        node.lastTransition = uint32_t(_transitions.size());
+
+        node.firstOutput = uint32_t(_outputs.size());
+        _outputs.insert(_outputs.end(), trie_node.outputs.begin(), trie_node.outputs.end());
+        node.lastOutput = uint32_t(_outputs.size());
+
+        if (state == root) {
+            node.failure = root;
+            node.outputLink = root;
+            node.hasMatch = false;
+        }
+        else {
+            Node const& failure = _nodes[node.failure];
+            node.outputLink = (failure.firstOutput != failure.lastOutput)
+                ? node.failure
+                : failure.outputLink;
+            node.hasMatch = (node.firstOutput != node.lastOutput) || failure.hasMatch;
+        }
+
+        trie_node = TrieNode();
+    }
+}
+
+}
@@ -0,0 +1,173 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#pragma once
+
+#include "utils/sugar/array_view.hpp"
+#include "rvt/screen.hpp"
+#include "rvt/utf8_decoder.hpp"
+
+#include <array>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace rvt
+{
+
+/**
+ * Aho-Corasick automaton searching a set of keywords (UTF-8) in the screen lines.
+ *
+ * The automaton is immutable once built: a matcher can be shared by
+ * several emulators running in different threads.
+ * The cost of a search is linear in the length of the text.
+ */
+class KeywordMatcher
+{
+public:
+    using State = uint32_t;
+
+    static constexpr State root = 0;
+
+    /// \param patterns  keywords, the id of a keyword is its index. Empty keywords never match.
+    /// \param ignore_ascii_case  compare the ASCII letters without the case
+    explicit KeywordMatcher(array_view<std::string_view const> patterns, bool ignore_ascii_case = false);
+
+    std::size_t patternCount() const noexcept
+    {
+        return _patternCount;
+    }
+
+    State next(State state, uint8_t c) const noexcept
+    {
+        c = _foldCase[c];
+        if (state == root) {
+            return _rootTransitions[c];
+        }
+        for (;;) {
+            Node const& node = _nodes[state];
+            for (uint32_t i = node.firstTransition; i < node.lastTransition; ++i) {
+                if (_transitions[i].c == c) {
+                    return _transitions[i].next;
+                }
+            }
+            state = node.failure;
+            if (state == root) {
+                return _rootTransitions[c];
+            }
+        }
+    }
+
+    /// Call \c f(pattern_id) for each keyword which ends at \p state.
+    template<class F>
+    void forEachMatch(State state, F&& f) const
+    {
+        if (!_nodes[state].hasMatch) {
+            return;
+        }
+        for (State s = state; s != root; s = _nodes[s].outputLink) {
+            Node const& node = _nodes[s];
+            for (uint32_t i = node.firstOutput; i < node.lastOutput; ++i) {
+                f(std::size_t(_outputs[i]));
+            }
+        }
+    }
+
+    /// Search the keywords in \p data, \c f(pattern_id, end_position) is called for each match.
+    template<class F>
+    State search(State state, array_view<uint8_t const> data, F&& f) const
+    {
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            state = next(state, data[i]);
+            forEachMatch(state, [&](std::size_t pattern_id){ f(pattern_id, i + 1); });
+        }
+        return state;
+    }
+
+    /**
+     * Search the keywords in the lines of \p screen which contain a line in [y, yend).
+     * A wrapped line is searched as a single line.
+     * \c f(pattern_id, row) is called for each match, \c row is the line of the last character.
+     */
+    template<class F>
+    void searchLines(Screen const& screen, size_t y, size_t yend, F&& f) const
+    {
+        auto const&& lines = screen.getScreenLines();
+        auto const& extendedCharTable = screen.extendedCharTable();
+        for_each_wrapped_line(screen, y, yend, [&](size_t first_line, size_t last_line){
+            State state = root;
+            auto push_ucs = [&](ucs4_char ucs, size_t row){
+                uint8_t utf8[4];
+                std::size_t const len = unsafe_ucs4_to_utf8(ucs, utf8);
+                for (std::size_t i = 0; i < len; ++i) {
+                    state = next(state, utf8[i]);
+                    forEachMatch(state, [&](std::size_t pattern_id){ f(pattern_id, row); });
+                }
+            };
+            for (size_t row = first_line; row <= last_line; ++row) {
+                for (Character const& ch : lines[row]) {
+                    if (!ch.isRealCharacter) {
+                        continue;
+                    }
+                    if (REDEMPTION_UNLIKELY(ch.is_extended())) {
+                        for (ucs4_char ucs : extendedCharTable[ch.character]) {
+                            push_ucs(ucs, row);
+                        }
+                    }
+                    else {
+                        push_ucs(ch.character, row);
+                    }
+                }
+            }
+        });
+    }
+
+private:
+    struct Node
+    {
+        uint32_t firstTransition;
+        uint32_t lastTransition;
+        uint32_t firstOutput;
+        uint32_t lastOutput;
+        State failure;
+        /// next state in the failure chain with a keyword
+        State outputLink;
+        /// a keyword ends at this state or in the failure chain
+        bool hasMatch;
+    };
+
+    struct Transition
+    {
+        uint8_t c;
+        State next;
+    };
+
+    std::vector<Node> _nodes;
+    std::vector<Transition> _transitions;
+    std::vector<uint32_t> _outputs;
+    std::array<State, 256> _rootTransitions;
+    std::array<uint8_t, 256> _foldCase;
+    std::size_t _patternCount;
+};
+
+}
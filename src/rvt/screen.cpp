@@ -21,9 +21,11 @@
 */
 
 #include "rvt/screen.hpp"
+#include "rvt/state_stream.hpp"
 
 #include <algorithm>
 #include <cassert>
+#include <utility>
 
 
 namespace rvt
@@ -68,6 +70,7 @@ Screen::Screen(strictly_positif lines, strictly_positif columns):
     _lineSaver{}
 {
     _lineProperties.resize(_lines + 1, LineProperty::Default);
+    _lineCommits.resize(_lines + 1);
 
     initTabStops();
     reset();
@@ -92,21 +95,246 @@ ExtendedCharTable const & Screen::extendedCharTable() const
 
 void Screen::setLineSaver(LineSaver lineSaver)
 {
+    flushSavedLines();
     this->_lineSaver = std::move(lineSaver);
+    resetLineCommits(0, _lines - 1);
 }
 
-void Screen::saveLine() const
+void Screen::copyState(Screen const& other)
 {
-    if (this->_lineSaver) {
-        this->_lineSaver(*this, size_t(_cuY), size_t(_cuY+1u));
+    LineSaver lineSaver = std::move(_lineSaver);
+    bool const changeTracking = !_changedLines.empty();
+    ChangeObserver * changeObserver = _changeObserver;
+    *this = other;
+    _lineSaver = std::move(lineSaver);
+    _changeObserver = changeObserver;
+    _changedLines.clear();
+    if (changeTracking) {
+        _changedLines.assign(std::size_t(_lines), true);
+    }
+}
+
+void Screen::setLineSaveMode(LineSaveMode mode)
+{
+    flushSavedLines();
+    this->_lineSaveMode = mode;
+    resetLineCommits(0, _lines - 1);
+}
+
+void Screen::setLineSaveBatching(bool enable)
+{
+    flushSavedLines();
+    this->_lineSaveBatching = enable;
+}
+
+void Screen::setChangeTracking(bool enable, ChangeObserver * observer)
+{
+    _changeObserver = enable ? observer : nullptr;
+    if (enable) {
+        _changedLines.assign(std::size_t(_lines), true);
+    }
+    else {
+        _changedLines.clear();
+    }
+}
+
+bool Screen::isLineChanged(int y) const
+{
+    return _changedLines.empty() || _changedLines[std::size_t(y)];
+}
+
+void Screen::resetChangedLines()
+{
+    std::fill(_changedLines.begin(), _changedLines.end(), false);
+}
+
+void Screen::markLinesChangedSlow(int topLine, int bottomLine)
+{
+    bottomLine = std::min(bottomLine, _lines - 1);
+    for (int y = topLine; y <= bottomLine; ++y) {
+        if (!_changedLines[std::size_t(y)]) {
+            if (_changeObserver) {
+                _changeObserver->beforeLineChange(*this, y);
+            }
+            _changedLines[std::size_t(y)] = true;
+        }
+    }
+}
+
+void Screen::markAllLinesChanged()
+{
+    if (!_changedLines.empty()) {
+        _changedLines.assign(std::size_t(_lines), true);
+    }
+}
+
+void Screen::flushSavedLines()
+{
+    if (!_batchedLines.empty()) {
+        BatchedLines const batchedLines = std::exchange(_batchedLines, BatchedLines{});
+        this->_lineSaver(*this, size_t(batchedLines.top), size_t(batchedLines.bottom+1));
     }
 }
 
-void Screen::saveLines(int topLine, int bottomLine) const
+void Screen::scrollSavedLines(int topLine, int bottomLine, int n)
+{
+    auto& batched = _batchedLines;
+    if (batched.empty()
+     || batched.lastDependentLine < topLine
+     || bottomLine < batched.firstDependentLine
+    ) {
+        return;
+    }
+
+    int const firstLine = batched.firstDependentLine + n;
+    int const lastLine = batched.lastDependentLine + n;
+
+    bool const isMoved
+        = topLine <= batched.firstDependentLine && batched.lastDependentLine <= bottomLine
+       && topLine <= firstLine && lastLine <= bottomLine
+       && !bool(_lineProperties[batched.lastDependentLine] & LineProperty::Wrapped);
+
+    // the line before the new position must not be a wrapped line
+    bool const isPrecededByWrappedLine
+        = firstLine == topLine && topLine > 0
+       && bool(_lineProperties[topLine - 1] & LineProperty::Wrapped);
+
+    if (isMoved && !isPrecededByWrappedLine) {
+        batched.top += n;
+        batched.bottom += n;
+        batched.firstDependentLine = firstLine;
+        batched.lastDependentLine = lastLine;
+    }
+    else {
+        flushSavedLines();
+    }
+}
+
+void Screen::saveLine()
+{
+    saveLines(_cuY, _cuY);
+}
+
+void Screen::saveLines(int topLine, int bottomLine)
 {
     if (this->_lineSaver) {
-        this->_lineSaver(*this, size_t(topLine), size_t(bottomLine+1));
+        if (_lineSaveMode == LineSaveMode::CursorMove) {
+            if (!_lineSaveBatching) {
+                this->_lineSaver(*this, size_t(topLine), size_t(bottomLine+1));
+                return;
+            }
+
+            if (!_batchedLines.empty()) {
+                // consecutive lines without wrapped line in common
+                if (topLine == _batchedLines.bottom + 1
+                 && !bool(_lineProperties[_batchedLines.bottom] & LineProperty::Wrapped)
+                ) {
+                    _batchedLines.bottom = bottomLine;
+                    _batchedLines.lastDependentLine = lastLineOfWrappedLine(bottomLine);
+                    return;
+                }
+                flushSavedLines();
+            }
+
+            _batchedLines.top = topLine;
+            _batchedLines.bottom = bottomLine;
+            _batchedLines.firstDependentLine = firstLineOfWrappedLine(topLine);
+            _batchedLines.lastDependentLine = lastLineOfWrappedLine(bottomLine);
+        }
+        else {
+            for (int y = topLine; y <= bottomLine; ++y) {
+                _lineCommits[firstLineOfWrappedLine(y)].pending = true;
+            }
+        }
+    }
+}
+
+int Screen::firstLineOfWrappedLine(int y) const
+{
+    while (y && bool(_lineProperties[y-1] & LineProperty::Wrapped)) {
+        --y;
+    }
+    return y;
+}
+
+int Screen::lastLineOfWrappedLine(int y) const
+{
+    while (y < _lines - 1 && bool(_lineProperties[y] & LineProperty::Wrapped)) {
+        ++y;
     }
+    return y;
+}
+
+void Screen::commitLine(int y)
+{
+    LineCommit& commit = _lineCommits[y];
+    if (!commit.pending) {
+        return;
+    }
+    commit.pending = false;
+
+    if (_lineSaveMode != LineSaveMode::Commit || !this->_lineSaver) {
+        return;
+    }
+
+    int ylast = y;
+    while (ylast < _lines - 1 && bool(_lineProperties[ylast] & LineProperty::Wrapped)) {
+        ++ylast;
+    }
+    uint64_t const hash = hashLines(y, ylast);
+
+    if (commit.hash != hash) {
+        commit.hash = hash;
+        int const first = int(&commit - _lineCommits.data());
+        this->_lineSaver(*this, size_t(first), size_t(first+1));
+    }
+}
+
+uint64_t Screen::hashLines(int topLine, int bottomLine) const
+{
+    uint64_t hash = 0xcbf29ce484222325u;
+    auto update_hash = [&hash](ucs4_char c) {
+        hash = (hash ^ c) * 0x100000001b3u;
+    };
+    for (int y = topLine; y <= bottomLine; ++y) {
+        for (Character const& ch : _screenLines[y]) {
+            if (!ch.isRealCharacter) {
+                continue;
+            }
+            if (ch.is_extended()) {
+                for (ucs4_char c : _extendedCharTable[ch.character]) {
+                    update_hash(c);
+                }
+            }
+            else {
+                update_hash(ch.character);
+            }
+        }
+        update_hash('\n');
+    }
+    return hash;
+}
+
+void Screen::commitLines(int topLine, int bottomLine)
+{
+    for (int y = topLine; y <= bottomLine; ++y) {
+        commitLine(y);
+    }
+}
+
+void Screen::commitLines()
+{
+    if (_lineSaveMode == LineSaveMode::Commit && this->_lineSaver) {
+        if (!_screenLines[_cuY].empty()) {
+            saveLine();
+        }
+        commitLines(0, _lines - 1);
+    }
+}
+
+void Screen::resetLineCommits(int topLine, int bottomLine)
+{
+    std::fill(_lineCommits.begin() + topLine, _lineCommits.begin() + bottomLine + 1, LineCommit{});
 }
 
 void Screen::cursorUp(int n)
@@ -225,6 +453,8 @@ void Screen::deleteChars(int n)
     assert(n >= 0);
     assert(_cuX + n <= int(_screenLines[_cuY].size()));
 
+    beforeLinesChange(_cuY, _cuY);
+
     auto pos = _screenLines[_cuY].begin() + _cuX;
     _screenLines[_cuY].erase(pos, pos + n);
 
@@ -241,6 +471,8 @@ void Screen::insertChars(int n)
 {
     if (n == 0) n = 1; // Default
 
+    beforeLinesChange(_cuY, _cuY);
+
     if (int(_screenLines[_cuY].size()) < _cuX)
         _screenLines[_cuY].resize(_cuX);
 
@@ -328,6 +560,13 @@ void Screen::resizeImage(strictly_positif new_lines, strictly_positif new_column
 {
     if ((new_lines == _lines) && (new_columns == _columns)) return;
 
+    if (_changeObserver) {
+        _changeObserver->beforeResize(*this);
+    }
+
+    flushSavedLines();
+    commitLines(0, _lines - 1);
+
     if (_cuY > new_lines - 1) {
         // attempt to preserve focus and _lines
         _bottomMargin = _lines - 1; //FIXME: margin lost
@@ -344,9 +583,11 @@ void Screen::resizeImage(strictly_positif new_lines, strictly_positif new_column
         }
     }
     _lineProperties.resize(new_lines + 1, LineProperty::Default);
+    _lineCommits.assign(new_lines + 1, LineCommit{});
 
     _lines = new_lines;
     _columns = new_columns;
+    markAllLinesChanged();
     _cuX = std::min(_cuX, _columns - 1);
     saveLine();
     _cuY = std::min(_cuY, _lines - 1);
@@ -425,6 +666,10 @@ void Screen::updateEffectiveRendition()
 
 void Screen::reset(bool clearScreen)
 {
+    if (_changeObserver) {
+        _changeObserver->beforeReset(*this);
+    }
+
     setMode(Mode::Wrap);
     saveMode(Mode::Wrap);      // wrap at end of margin
 
@@ -459,6 +704,8 @@ void Screen::backspace()
     _cuX = std::min(_columns - 1, _cuX); // nowrap!
     _cuX = std::max(0, _cuX - 1);
 
+    beforeLinesChange(_cuY, _cuY);
+
     if (int(_screenLines[_cuY].size()) < _cuX + 1)
         _screenLines[_cuY].resize(_cuX + 1);
 
@@ -666,6 +913,26 @@ inline int konsole_wcwidth(ucs4_char ucs)
              (ucs >= 0x30000 && ucs <= 0x3fffd)));
 }
 
+int Screen::charWidth(ucs4_char c)
+{
+    return konsole_wcwidth(c);
+}
+
+
+void Screen::compactExtendedCharTable()
+{
+    std::vector<ExtendedCharacter> new_table;
+    new_table.reserve(std::size_t(_lines * _columns));
+    for (auto & line : getMutableScreenLines()) {
+        for (Character & ch : line) {
+            if (ch.is_extended()) {
+                new_table.emplace_back(std::move(_extendedCharTable.extendedCharTable[ch.character]));
+                ch.character = ucs4_char(new_table.size() - 1);
+            }
+        }
+    }
+    _extendedCharTable.extendedCharTable = std::move(new_table);
+}
 
 void Screen::displayCharacter(ucs4_char c)
 {
@@ -705,30 +972,23 @@ void Screen::displayCharacter(ucs4_char c)
             return;
         }
 
+        beforeLinesChange(charToCombineWithY, charToCombineWithY);
+
         Character & currentChar = _screenLines[charToCombineWithY][charToCombineWithX];
         _extendedCharTable.growChar(currentChar, c);
         if (int(_extendedCharTable.size()) >= _lines * _columns) {
-            std::vector<ExtendedCharacter> new_table;
-            new_table.resize(_lines * _columns);
-            auto b = new_table.begin();
-            auto p = b;
-            for (auto & line : getMutableScreenLines()) {
-                for (Character & ch : line) {
-                    if (ch.is_extended()) {
-                        ch.character = p - b;
-                        *p = std::move(_extendedCharTable.extendedCharTable[ch.character]);
-                        ++p;
-                    }
-                }
-            }
-            new_table.resize(p - b);
-            _extendedCharTable.extendedCharTable = std::move(new_table);
+            compactExtendedCharTable();
         }
         return;
     }
 
     if (_cuX + w > _columns) {
         if (getMode(Mode::Wrap)) {
+            // the next line becomes a part of the current line
+            if (_cuY < _bottomMargin && !bool(_lineProperties[_cuY] & LineProperty::Wrapped)) {
+                commitLine(_cuY + 1);
+            }
+            beforeLinesChange(_cuY, _cuY + 1);
             _lineProperties[_cuY] |= LineProperty::Wrapped;
             nextLine();
         } else {
@@ -736,6 +996,19 @@ void Screen::displayCharacter(ucs4_char c)
         }
     }
 
+    // a line left by the cursor is overwritten with a different content
+    if (_lineCommits[_cuY].pending
+     && _cuX < int(_screenLines[_cuY].size())
+    ) {
+        Character const& ch = _screenLines[_cuY][_cuX];
+        if (ch.isRealCharacter && (ch.is_extended() || ch.character != c)) {
+            // previous lines first to keep the screen order
+            commitLines(0, _cuY);
+        }
+    }
+
+    beforeLinesChange(_cuY, _cuY);
+
     // ensure current line vector has enough elements
     if (int(_screenLines[_cuY].size()) < _cuX + w) {
         _screenLines[_cuY].resize(_cuX + w);
@@ -777,8 +1050,11 @@ void Screen::scrollUp(int from, int n)
     if (n <= 0 || from + n > _bottomMargin) return;
 
     saveLines(_bottomMargin - n + 1, _bottomMargin);
+    commitLines(from, from + n - 1);
+    scrollSavedLines(from, _bottomMargin, -n);
     //FIXME: make sure `topMargin', `bottomMargin', `from', `n' is in bounds.
     moveImage(loc(0, from), loc(0, from + n), loc(_columns - 1, _bottomMargin));
+    resetLineCommits(_bottomMargin - n + 1, _bottomMargin);
     clearImage(loc(0, _bottomMargin - n + 1), loc(_columns - 1, _bottomMargin), ' ');
 }
 
@@ -799,7 +1075,10 @@ void Screen::scrollDown(int from, int n)
         n = _bottomMargin - from;
 
     saveLines(from, from + n - 1);
+    commitLines(_bottomMargin - n + 1, _bottomMargin);
+    scrollSavedLines(from, _bottomMargin, n);
     moveImage(loc(0, from + n), loc(0, from), loc(_columns - 1, _bottomMargin - n));
+    resetLineCommits(from, from + n - 1);
     clearImage(loc(0, from), loc(_columns - 1, from + n - 1), ' ');
 }
 
@@ -868,6 +1147,8 @@ void Screen::clearImage(int loca, int loce, char c)
     const int topLine = loca / _columns;
     const int bottomLine = loce / _columns;
 
+    beforeLinesChange(topLine, bottomLine);
+
     Character clearCh(c, _currentForeground, _currentBackground, Rendition::Default, false);
 
     //if the character being used to clear the area is the same as the
@@ -875,11 +1156,19 @@ void Screen::clearImage(int loca, int loce, char c)
     const bool isDefaultCh = (clearCh == Screen::DefaultChar);
 
     for (int y = topLine; y <= bottomLine; y++) {
-        _lineProperties[y] = LineProperty::Default;
-
         const int endCol = (y == bottomLine) ? loce % _columns : _columns - 1;
         const int startCol = (y == topLine) ? loca % _columns : 0;
 
+        if (startCol == 0) {
+            commitLine(y);
+            // an erased line is saved again, even with the same content
+            if (endCol == _columns - 1) {
+                resetLineCommits(y, y);
+            }
+        }
+
+        _lineProperties[y] = LineProperty::Default;
+
         std::vector<Character>& line = _screenLines[y];
 
         if (isDefaultCh && endCol == _columns - 1) {
@@ -901,6 +1190,9 @@ void Screen::moveImage(int dest, int sourceBegin, int sourceEnd)
 
     const int lines = (sourceEnd - sourceBegin) / _columns;
 
+    markLinesChanged(std::min(dest, sourceBegin) / _columns,
+                     std::max(dest, sourceBegin) / _columns + lines);
+
     //move screen image and line properties:
     //the source and destination areas of the image may overlap,
     //so it matters that we do the copy in the right order -
@@ -910,11 +1202,13 @@ void Screen::moveImage(int dest, int sourceBegin, int sourceEnd)
         for (int i = 0; i <= lines; i++) {
             _screenLines[(dest / _columns) + i ] = std::move(_screenLines[(sourceBegin / _columns) + i ]);
             _lineProperties[(dest / _columns) + i] = std::move(_lineProperties[(sourceBegin / _columns) + i]);
+            _lineCommits[(dest / _columns) + i] = _lineCommits[(sourceBegin / _columns) + i];
         }
     } else {
         for (int i = lines; i >= 0; i--) {
             _screenLines[(dest / _columns) + i ] = std::move(_screenLines[(sourceBegin / _columns) + i ]);
             _lineProperties[(dest / _columns) + i] = std::move(_lineProperties[(sourceBegin / _columns) + i]);
+            _lineCommits[(dest / _columns) + i] = _lineCommits[(sourceBegin / _columns) + i];
         }
     }
 }
@@ -931,6 +1225,13 @@ void Screen::clearToBeginOfScreen()
 
 void Screen::clearEntireScreen()
 {
+    if (_changeObserver) {
+        _changeObserver->beforeClear(*this);
+    }
+    flushSavedLines();
+    commitLines();
+    resetLineCommits(0, _lines - 1);
+    markLinesChanged(0, _lines - 1);
     std::fill(_lineProperties.begin(), _lineProperties.end(), LineProperty::Default);
     for (auto & v : getMutableScreenLines()) {
         v.resize(0);
@@ -943,6 +1244,9 @@ void Screen::clearEntireScreen()
 
 void Screen::helpAlign()
 {
+    flushSavedLines();
+    commitLines();
+    markLinesChanged(0, _lines - 1);
     std::fill(_lineProperties.begin(), _lineProperties.end(), LineProperty::Default);
     Character clearCh('E');
     for (auto & v : getMutableScreenLines()) {
@@ -1008,6 +1312,8 @@ void Screen::setBackColor(ColorSpace space, int color)
 
 void Screen::setLineProperty(LineProperty property , bool enable)
 {
+    // the wrapped property links the next line
+    beforeLinesChange(_cuY, _cuY + 1);
     if (enable)
         _lineProperties[_cuY] |= property;
     else
@@ -1019,4 +1325,360 @@ void Screen::fillWithDefaultChar(Character* dest, int count)
         dest[i] = Screen::DefaultChar;
 }
 
+
+namespace
+{
+    // sanity limits of a serialized screen
+    constexpr int max_state_dimension = 4096;
+    constexpr std::size_t max_extended_char_len = 1u << 15;
+
+    void write_color(StateWriter & writer, CharacterColor const& color)
+    {
+        writer.u32(color.toPacked());
+    }
+
+    CharacterColor read_color(StateReader & reader)
+    {
+        CharacterColor color;
+        if (!color.fromPacked(reader.u32())) {
+            reader.fail();
+        }
+        return color;
+    }
+
+    /// A line is a sequence of runs of characters with the same format,
+    /// \c write_char(ch) writes each character of a run.
+    template<class WriteChar>
+    void write_line_runs(StateWriter & writer, Screen::ImageLine const& line, WriteChar write_char)
+    {
+        writer.uvar(line.size());
+        auto first = line.begin();
+        while (first != line.end()) {
+            auto last = std::find_if(first + 1, line.end(), [&](Character const& ch){
+                return ch.isRealCharacter != first->isRealCharacter || !ch.equalsFormat(*first);
+            });
+            writer.uvar(uint64_t(last - first));
+            writer.u8(uint8_t(first->rendition));
+            writer.u8(first->isRealCharacter);
+            write_color(writer, first->foregroundColor);
+            write_color(writer, first->backgroundColor);
+            for (; first != last; ++first) {
+                write_char(*first);
+            }
+        }
+    }
+
+    /// Read a line written by \c write_line_runs(), \c read_char(is_extended) returns a character.
+    template<class ReadChar>
+    bool read_line_runs(StateReader & reader, Screen::ImageLine & line, std::size_t max_size, ReadChar read_char)
+    {
+        std::size_t const size = reader.size(max_size);
+        line.resize(size);
+        std::size_t x = 0;
+        while (x < size) {
+            std::size_t const n = reader.size(size - x);
+            auto const rendition = Rendition(reader.u8());
+            uint8_t const isRealCharacter = reader.u8();
+            CharacterColor const foregroundColor = read_color(reader);
+            CharacterColor const backgroundColor = read_color(reader);
+            if (reader.failed() || n == 0 || isRealCharacter > 1) {
+                return false;
+            }
+
+            bool const isExtended = bool(rendition & Rendition::ExtendedChar);
+            for (std::size_t end = x + n; x < end; ++x) {
+                Character& ch = line[x];
+                if (!read_char(isExtended, ch.character)) {
+                    return false;
+                }
+                ch.rendition = rendition;
+                ch.foregroundColor = foregroundColor;
+                ch.backgroundColor = backgroundColor;
+                ch.isRealCharacter = isRealCharacter;
+            }
+        }
+        return !reader.failed();
+    }
+
+    ExtendedCharacter new_extended_char(std::size_t len)
+    {
+        uint16_t capacity = 4;
+        while (capacity < len) {
+            capacity *= 2u;
+        }
+        return ExtendedCharacter{0, capacity, std::unique_ptr<ucs4_char[]>{new ucs4_char[capacity]}};
+    }
+}
+
+void Screen::writeState(StateWriter & writer) const
+{
+    writer.svar(_lines);
+    writer.svar(_columns);
+
+    auto const& extendedChars = _extendedCharTable.extendedCharTable;
+    writer.uvar(extendedChars.size());
+    for (ExtendedCharacter const& ext : extendedChars) {
+        writer.uvar(ext.len);
+        for (ucs4_char uc : ext.as_array()) {
+            writer.uvar(uc);
+        }
+    }
+
+    for (ImageLine const& line : _screenLines) {
+        write_line_runs(writer, line, [&](Character const& ch){
+            writer.uvar(ch.character);
+        });
+    }
+
+    for (LineProperty property : _lineProperties) {
+        writer.u8(uint8_t(property));
+    }
+
+    for (LineCommit const& commit : _lineCommits) {
+        writer.u8(commit.pending);
+        writer.u64(commit.hash);
+    }
+
+    writeCursorState(writer);
+}
+
+void Screen::writeCursorState(StateWriter & writer) const
+{
+    writer.svar(_cuX);
+    writer.svar(_cuY);
+    write_color(writer, _currentForeground);
+    write_color(writer, _currentBackground);
+    writer.u8(uint8_t(_currentRendition));
+
+    writer.svar(_topMargin);
+    writer.svar(_bottomMargin);
+
+    writer.u8(_currentModes.value());
+    writer.u8(_savedModes.value());
+
+    for (int x = 0; x < _columns; x += 8) {
+        uint8_t bits = 0;
+        for (int i = 0; i < 8 && x + i < _columns; ++i) {
+            bits |= uint8_t(_tabStops[std::size_t(x + i)] << i);
+        }
+        writer.u8(bits);
+    }
+
+    write_color(writer, _effectiveForeground);
+    write_color(writer, _effectiveBackground);
+    writer.u8(uint8_t(_effectiveRendition));
+
+    writer.svar(_savedState.cursorColumn);
+    writer.svar(_savedState.cursorLine);
+    writer.u8(uint8_t(_savedState.rendition));
+    write_color(writer, _savedState.foreground);
+    write_color(writer, _savedState.background);
+}
+
+void Screen::writeLine(StateWriter & writer, int y) const
+{
+    writer.u8(uint8_t(_lineProperties[std::size_t(y)]));
+    write_line_runs(writer, _screenLines[std::size_t(y)], [&](Character const& ch){
+        if (ch.is_extended()) {
+            auto const chars = _extendedCharTable[ch.character];
+            writer.uvar(chars.size());
+            for (ucs4_char uc : chars) {
+                writer.uvar(uc);
+            }
+        }
+        else {
+            writer.uvar(ch.character);
+        }
+    });
+}
+
+bool Screen::readLine(StateReader & reader, int y)
+{
+    uint8_t const property = reader.u8();
+    if (property > 7) {
+        return false;
+    }
+
+    auto& extendedChars = _extendedCharTable.extendedCharTable;
+    bool const isValid = read_line_runs(reader, _screenLines[std::size_t(y)], std::size_t(_columns) + 1,
+        [&](bool isExtended, ucs4_char& c){
+            if (!isExtended) {
+                c = ucs4_char(reader.size(UINT32_MAX));
+                return true;
+            }
+
+            std::size_t const len = reader.size(max_extended_char_len);
+            if (reader.failed() || len > reader.remaining()) {
+                return false;
+            }
+            ExtendedCharacter ext = new_extended_char(len);
+            for (std::size_t k = 0; k < len; ++k) {
+                ext.chars[k] = ucs4_char(reader.size(UINT32_MAX));
+            }
+            ext.len = uint16_t(len);
+            c = ucs4_char(extendedChars.size());
+            extendedChars.emplace_back(std::move(ext));
+            return true;
+        });
+
+    _lineProperties[std::size_t(y)] = LineProperty(property);
+    if (!_changedLines.empty()) {
+        _changedLines[std::size_t(y)] = true;
+    }
+
+    if (int(_extendedCharTable.size()) >= _lines * _columns) {
+        compactExtendedCharTable();
+    }
+
+    return isValid;
+}
+
+bool Screen::readState(StateReader & reader)
+{
+    int const lines = _lines;
+    int const columns = _columns;
+    if (readStateImpl(reader)) {
+        return true;
+    }
+
+    LineSaveMode const lineSaveMode = _lineSaveMode;
+    bool const lineSaveBatching = _lineSaveBatching;
+    copyState(Screen(lines, columns));
+    _lineSaveMode = lineSaveMode;
+    _lineSaveBatching = lineSaveBatching;
+    return false;
+}
+
+bool Screen::readStateImpl(StateReader & reader)
+{
+    int const lines = reader.bounded(1, max_state_dimension);
+    int const columns = reader.bounded(1, max_state_dimension);
+    if (reader.failed()) {
+        return false;
+    }
+
+    _batchedLines = BatchedLines{};
+
+    _lines = lines;
+    _columns = columns;
+    _screenLines.resize(std::size_t(lines + 1));
+    _lineProperties.resize(std::size_t(lines + 1));
+    _lineCommits.resize(std::size_t(lines + 1));
+    _tabStops.resize(std::size_t(columns));
+    _cuX = 0;
+    _cuY = 0;
+    _topMargin = 0;
+    _bottomMargin = lines - 1;
+    markAllLinesChanged();
+
+    // each entry takes at least one byte
+    auto& extendedChars = _extendedCharTable.extendedCharTable;
+    std::size_t const extendedCharCount = reader.size(reader.remaining());
+    for (std::size_t i = 0; i < extendedCharCount; ++i) {
+        std::size_t const len = reader.size(max_extended_char_len);
+        if (reader.failed() || len > reader.remaining()) {
+            return false;
+        }
+
+        if (i == extendedChars.size()) {
+            extendedChars.emplace_back(new_extended_char(len));
+        }
+        else if (extendedChars[i].capacity < len) {
+            extendedChars[i] = new_extended_char(len);
+        }
+
+        ExtendedCharacter& ext = extendedChars[i];
+        for (std::size_t k = 0; k < len; ++k) {
+            ext.chars[k] = ucs4_char(reader.size(UINT32_MAX));
+        }
+        ext.len = uint16_t(len);
+    }
+    if (reader.failed()) {
+        return false;
+    }
+    extendedChars.resize(extendedCharCount);
+
+    for (ImageLine& line : _screenLines) {
+        bool const isValid = read_line_runs(reader, line, std::size_t(columns) + 1,
+            [&](bool isExtended, ucs4_char& c){
+                c = ucs4_char(reader.size(UINT32_MAX));
+                return !isExtended || c < extendedCharCount;
+            });
+        if (!isValid) {
+            return false;
+        }
+    }
+
+    for (LineProperty& property : _lineProperties) {
+        uint8_t const value = reader.u8();
+        if (value > 7) {
+            return false;
+        }
+        property = LineProperty(value);
+    }
+
+    for (LineCommit& commit : _lineCommits) {
+        uint8_t const pending = reader.u8();
+        if (pending > 1) {
+            return false;
+        }
+        commit.pending = pending;
+        commit.hash = reader.u64();
+    }
+
+    return readCursorState(reader);
+}
+
+bool Screen::readCursorState(StateReader & reader)
+{
+    int const cuX = reader.bounded(0, _columns);
+    int const cuY = reader.bounded(0, _lines - 1);
+    _currentForeground = read_color(reader);
+    _currentBackground = read_color(reader);
+    _currentRendition = Rendition(reader.u8());
+
+    int const topMargin = reader.bounded(0, _lines - 1);
+    int const bottomMargin = reader.bounded(0, _lines - 1);
+    // same range as setMargins(), a screen of one line has top == bottom
+    if (topMargin >= bottomMargin && _lines > 1) {
+        return false;
+    }
+
+    constexpr unsigned modeMask = (1u << unsigned(Mode::COUNT_)) - 1u;
+    uint8_t const currentModes = reader.u8();
+    uint8_t const savedModes = reader.u8();
+    if ((currentModes | savedModes) & ~modeMask) {
+        return false;
+    }
+    _currentModes = ModeFlags(currentModes);
+    _savedModes = ModeFlags(savedModes);
+
+    for (int x = 0; x < _columns; x += 8) {
+        uint8_t const bits = reader.u8();
+        for (int i = 0; i < 8 && x + i < _columns; ++i) {
+            _tabStops[std::size_t(x + i)] = (bits >> i) & 1;
+        }
+    }
+
+    _effectiveForeground = read_color(reader);
+    _effectiveBackground = read_color(reader);
+    _effectiveRendition = Rendition(reader.u8());
+
+    _savedState.cursorColumn = reader.bounded(0, max_state_dimension);
+    _savedState.cursorLine = reader.bounded(0, max_state_dimension);
+    _savedState.rendition = Rendition(reader.u8());
+    _savedState.foreground = read_color(reader);
+    _savedState.background = read_color(reader);
+
+    if (reader.failed()) {
+        return false;
+    }
+
+    _cuX = cuX;
+    _cuY = cuY;
+    _topMargin = topMargin;
+    _bottomMargin = bottomMargin;
+    return true;
+}
+
 }
@@ -24,10 +24,12 @@
 
 #include "rvt/character.hpp"
 
+#include "cxx/cxx.hpp"
 #include "utils/sugar/enum_flags_operators.hpp"
 
 #include <vector>
 #include <functional>
+#include <type_traits>
 
 #include <cstdint>
 #include <cassert>
@@ -48,6 +50,9 @@ template<> struct is_enum_flags<rvt::LineProperty> : std::true_type {};
 namespace rvt
 {
 
+class StateWriter;
+class StateReader;
+
 template<class Bit, class Underlying = underlying_type_t<Bit>>
 struct Flags
 {
@@ -58,6 +63,7 @@ struct Flags
     void reset(Bit pos) { this->value_ &= ~to_flag(pos); }
     void copy_of(Bit pos, Flags f) { this->value_ = (this->value_ & ~to_flag(pos)) | (f.value_ & to_flag(pos)); }
     bool has(Bit pos) const { return bool(this->value_ & to_flag(pos)); }
+    Underlying value() const { return this->value_; }
 
 private:
     constexpr static Underlying to_flag(Bit pos) { return 1u << Underlying(pos); }
@@ -119,16 +125,115 @@ public:
         COUNT_
     };
 
-    using LineSaver = std::function<void(Screen const&, size_t y, size_t yend)>;
+    /// Receive the lines [y, yend) to save.
+    /// Either a raw function with its context or a function object stored in a \c std::function.
+    class LineSaver
+    {
+    public:
+        using Fn = void(void * ctx, Screen const& screen, size_t y, size_t yend);
+
+        LineSaver() noexcept = default;
+        LineSaver(std::nullptr_t) noexcept {}
+
+        LineSaver(Fn * fn, void * ctx) noexcept
+        : _fn(fn)
+        , _ctx(ctx)
+        {}
+
+        template<class F, class = std::enable_if_t<std::conjunction_v<
+            std::negation<std::is_same<std::decay_t<F>, LineSaver>>,
+            std::is_invocable<F&, Screen const&, size_t, size_t>
+        >>>
+        LineSaver(F f)
+        : _function(std::move(f))
+        {}
+
+        /// Line saver which calls \p f without type erasure. \p f must outlive the line saver.
+        template<class F>
+        static LineSaver from_ref(F & f) noexcept
+        {
+            return LineSaver([](void * ctx, Screen const& screen, size_t y, size_t yend) {
+                (*static_cast<F*>(ctx))(screen, y, yend);
+            }, &f);
+        }
+
+        explicit operator bool () const noexcept
+        {
+            return _fn || _function;
+        }
+
+        void operator()(Screen const& screen, size_t y, size_t yend) const
+        {
+            if (_fn) {
+                _fn(_ctx, screen, y, yend);
+            }
+            else {
+                _function(screen, y, yend);
+            }
+        }
+
+    private:
+        std::function<void(Screen const&, size_t y, size_t yend)> _function;
+        Fn * _fn = nullptr;
+        void * _ctx = nullptr;
+    };
+
+    enum class LineSaveMode : uint8_t
+    {
+        /// A line is saved each time the cursor leaves it.
+        CursorMove,
+        /// A line left by the cursor is saved once, when it is scrolled out,
+        /// erased, overwritten or with commitLines(). An unchanged line is not saved again.
+        Commit,
+    };
+
+    /// Receive the modifications of a screen, see setChangeTracking().
+    class ChangeObserver
+    {
+    public:
+        /// The line \p y will be modified for the first time since the last resetChangedLines().
+        virtual void beforeLineChange(Screen const& screen, int y) = 0;
+        /// The screen will be resized.
+        virtual void beforeResize(Screen const& screen) = 0;
+        /// The entire screen will be erased.
+        virtual void beforeClear(Screen const& /*screen*/) {}
+        /// The modes, margins and rendition of the screen will be reset.
+        virtual void beforeReset(Screen const& /*screen*/) {}
+
+    protected:
+        ~ChangeObserver() = default;
+    };
 
     /** Construct a new screen image of size @p lines by @p columns. */
     Screen(strictly_positif lines, strictly_positif columns);
     ~Screen();
 
     Screen(const Screen&) = delete;
-    Screen& operator=(const Screen&) = delete;
+
+    /// Copy the state of \p other (image, cursor, modes, waiting commits, etc). The line saver is not copied.
+    void copyState(Screen const& other);
 
     void setLineSaver(LineSaver lineSaver);
+    LineSaver const& getLineSaver() const { return _lineSaver; }
+    void setLineSaveMode(LineSaveMode mode);
+
+    /// With LineSaveMode::CursorMove, consecutive saved lines are merged and sent
+    /// to the line saver when one of them will be modified or scrolled out,
+    /// or with flushSavedLines() (typically at the end of a feed).
+    void setLineSaveBatching(bool enable);
+    /// Send the lines waiting with setLineSaveBatching().
+    void flushSavedLines();
+
+    /// With LineSaveMode::Commit, save the waiting lines and the cursor line (end of stream).
+    void commitLines();
+
+    /// Track the modified lines (see isLineChanged()) and notify \p observer (nullptr for none).
+    /// All the lines are marked as modified.
+    void setChangeTracking(bool enable, ChangeObserver * observer = nullptr);
+    /// \return whether the line \p y was modified since the last resetChangedLines().
+    /// Always true without change tracking.
+    bool isLineChanged(int y) const;
+    void resetChangedLines();
 
     // VT100/2 Operations
     // Cursor Movement
@@ -445,14 +550,38 @@ public:
 
     static const Character DefaultChar;
 
+    /// Number of columns of \p c: 0 for a combining character, -1 for a non printable character.
+    static int charWidth(ucs4_char c);
+
     using ImageLine = std::vector<Character> ; // [0..columns]
 
     array_view<const LineProperty> getLineProperties() const;
 
+    /// Hash of the characters of lines in [topLine, bottomLine] (FNV-1a).
+    uint64_t hashLines(int topLine, int bottomLine) const;
+
     array_view<const ImageLine> getScreenLines() const;
 
     ExtendedCharTable const & extendedCharTable() const;
 
+    /// Write the state of the screen (image, cursor, modes, waiting commits, etc).
+    /// The line saver and its configuration are not written.
+    void writeState(StateWriter & writer) const;
+    /// Restore a state written by writeState(). The storage of the screen is reused
+    /// and the lines waiting with setLineSaveBatching() are dropped.
+    /// With an invalid state, the screen is reset to its previous size and false is returned.
+    bool readState(StateReader & reader);
+
+    /// Write the cursor, colors, margins, modes, tab stops and saved cursor.
+    void writeCursorState(StateWriter & writer) const;
+    /// Restore a state written by writeCursorState() with the same screen size.
+    bool readCursorState(StateReader & reader);
+
+    /// Write the line \p y and its properties, the extended characters are written by value.
+    void writeLine(StateWriter & writer, int y) const;
+    /// Restore a line written by writeLine() in the line \p y, without notifying the change observer.
+    bool readLine(StateReader & reader, int y);
+
 private:
     //fills a section of the screen image with the character 'c'
     //the parameters are specified as offsets from the start of the screen image.
@@ -472,9 +601,14 @@ private:
 
     void initTabStops();
 
+    bool readStateImpl(StateReader & reader);
+
     void updateEffectiveRendition();
     void reverseRendition(Character& p) const;
 
+    /// Renumber the extended characters when the table is larger than the screen.
+    void compactExtendedCharTable();
+
     // screen image ----------------
     int _lines;
     int _columns;
@@ -531,10 +665,95 @@ private:
 
     ExtendedCharTable _extendedCharTable;
 
-    void saveLine() const;
-    void saveLines(int topLine, int bottomLine) const;
+    void saveLine();
+    void saveLines(int topLine, int bottomLine);
+
+    int firstLineOfWrappedLine(int y) const;
+    int lastLineOfWrappedLine(int y) const;
+    void commitLine(int y);
+    void commitLines(int topLine, int bottomLine);
+    void resetLineCommits(int topLine, int bottomLine);
 
     LineSaver _lineSaver;
+    LineSaveMode _lineSaveMode = LineSaveMode::CursorMove;
+    bool _lineSaveBatching = false;
+
+    /// Lines waiting with setLineSaveBatching(): [top, bottom] are saved and
+    /// the rendering depends on [firstDependentLine, lastDependentLine] (wrapped lines).
+    struct BatchedLines
+    {
+        int top = 0;
+        int bottom = -1;
+        int firstDependentLine = 0;
+        int lastDependentLine = -1;
+
+        bool empty() const noexcept { return bottom < top; }
+    };
+    BatchedLines _batchedLines;
+
+    /// Flush the waiting lines which depend on [topLine, bottomLine] before a modification.
+    void beforeLinesChange(int topLine, int bottomLine)
+    {
+        if (REDEMPTION_UNLIKELY(_batchedLines.firstDependentLine <= bottomLine
+                             && topLine <= _batchedLines.lastDependentLine)) {
+            flushSavedLines();
+        }
+        markLinesChanged(topLine, bottomLine);
+    }
+
+    /// Lines modified since the last resetChangedLines(), empty without change tracking.
+    std::vector<bool> _changedLines;           // [lines]
+    ChangeObserver * _changeObserver = nullptr;
+
+    void markLinesChanged(int topLine, int bottomLine)
+    {
+        if (REDEMPTION_UNLIKELY(!_changedLines.empty())) {
+            markLinesChangedSlow(topLine, bottomLine);
+        }
+    }
+    void markLinesChangedSlow(int topLine, int bottomLine);
+    void markAllLinesChanged();
+    /// Follow the lines moved by a scroll of \p n lines in [topLine, bottomLine]
+    /// (negative \p n moves them up).
+    void scrollSavedLines(int topLine, int bottomLine, int n);
+
+    struct LineCommit
+    {
+        bool pending = false;
+        uint64_t hash = 0; // content of the last saved line
+    };
+    std::vector<LineCommit> _lineCommits;      // [lines]
+
+    // used by copyState()
+    Screen& operator=(const Screen&) = default;
+    friend class VtEmulator;
 };
 
+/// Call \c f(first_line, last_line) for each wrapped line which contains a line in [y, yend).
+template<class F>
+void for_each_wrapped_line(Screen const & screen, size_t y, size_t yend, F&& f)
+{
+    auto const&& lines = screen.getScreenLines();
+    auto const&& lineProperties = screen.getLineProperties();
+    constexpr auto wrapped = rvt::LineProperty::Wrapped;
+    while (y && bool(lineProperties[y-1] & wrapped)) {
+        --y;
+    }
+    while (y < yend) {
+        size_t const first_line = y;
+        if (bool(lineProperties[y] & wrapped)) {
+            while (++y < lines.size()) {
+                if (!bool(lineProperties[y] & wrapped)) {
+                    break;
+                }
+            }
+            if (y == lines.size()) {
+                --y;
+            }
+        }
+        f(first_line, y);
+        ++y;
+    }
+}
+
 }
@@ -0,0 +1,907 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#include "rvt/screen_diff_encoder.hpp"
+#include "rvt/utf8_decoder.hpp"
+
+#include <algorithm>
+#include <vector>
+
+
+namespace rvt
+{
+
+namespace
+{
+    struct ColorBytes
+    {
+        ColorSpace space;
+        uint8_t u;
+        uint8_t v;
+        uint8_t w;
+    };
+
+    ColorBytes color_bytes(CharacterColor const& color)
+    {
+        uint32_t const packed = color.toPacked();
+        return ColorBytes{
+            ColorSpace(packed & 0x7),
+            uint8_t(packed >> 8), uint8_t(packed >> 16), uint8_t(packed >> 24)
+        };
+    }
+
+    Rendition without_extended(Rendition rendition)
+    {
+        return rendition & ~Rendition::ExtendedChar;
+    }
+
+    bool same_format(Character const& a, Character const& b)
+    {
+        return a.foregroundColor == b.foregroundColor
+            && a.backgroundColor == b.backgroundColor
+            && without_extended(a.rendition) == without_extended(b.rendition);
+    }
+
+    /// second half of a wide character (a combining character can be attached)
+    bool is_placeholder(Character const& ch, ExtendedCharTable const& table)
+    {
+        return !ch.isRealCharacter
+            && (ch.is_extended() ? table[ch.character][0] == 0 : ch.character == 0);
+    }
+
+    /// blank cell which is not a character (a combining character can be attached)
+    bool is_blank(Character const& ch, ExtendedCharTable const& table)
+    {
+        return !ch.isRealCharacter
+            && (ch.is_extended() ? table[ch.character][0] == ' ' : ch.character == ' ');
+    }
+
+    /// cell cleared by an erasure
+    bool is_erased(Character const& ch, ExtendedCharTable const& table)
+    {
+        return is_blank(ch, table) && without_extended(ch.rendition) == Rendition::Default;
+    }
+
+    /// cell added by a deletion of characters with the current rendition
+    bool is_deleted(Character const& ch, ExtendedCharTable const& table)
+    {
+        return is_blank(ch, table) && without_extended(ch.rendition) != Rendition::Default;
+    }
+
+    /// cell cleared by an erasure with the colors of \p erased
+    bool same_erasure(Character const& ch, Character const& erased, ExtendedCharTable const& table)
+    {
+        return is_erased(ch, table) && same_format(ch, erased);
+    }
+
+    /// \return the format of a line written by an erasure of the whole line, nullptr when it is not
+    Character const* erased_line(Screen::ImageLine const& line, int columns, ExtendedCharTable const& table)
+    {
+        if (line.empty()) {
+            return &Screen::DefaultChar;
+        }
+        // an erasure with the default colors truncates the line
+        if (int(line.size()) != columns || same_format(line[0], Screen::DefaultChar)) {
+            return nullptr;
+        }
+        for (Character const& ch : line) {
+            if (!same_erasure(ch, line[0], table)) {
+                return nullptr;
+            }
+        }
+        return &line[0];
+    }
+
+    ucs4_carray_view characters(Character const& ch, ExtendedCharTable const& table)
+    {
+        return ch.is_extended() ? table[ch.character] : ucs4_carray_view{&ch.character, 1};
+    }
+
+    /// cells with the same rendering, the characters which are not real are only compared by format
+    bool same_cell(Character const& a, ExtendedCharTable const& atable,
+                   Character const& b, ExtendedCharTable const& btable)
+    {
+        if (a.isRealCharacter != b.isRealCharacter || !same_format(a, b)) {
+            return false;
+        }
+        if (!a.isRealCharacter) {
+            return is_placeholder(a, atable) == is_placeholder(b, btable);
+        }
+        if (!a.is_extended() && !b.is_extended()) {
+            return a.character == b.character;
+        }
+        auto const achars = characters(a, atable);
+        auto const bchars = characters(b, btable);
+        return std::equal(achars.begin(), achars.end(), bchars.begin(), bchars.end());
+    }
+
+    Character const& cell_at(Screen::ImageLine const& line, int x)
+    {
+        static Character const blank;
+        return (x < int(line.size())) ? line[x] : blank;
+    }
+
+    /// \return 0 when the character cannot be written
+    int character_width(Character const& ch, ExtendedCharTable const& table)
+    {
+        return ch.isRealCharacter ? std::max(0, Screen::charWidth(characters(ch, table)[0])) : 0;
+    }
+
+    enum class HalfWriting
+    {
+        WideCharacter,
+        IdeographicSpace,
+        Deletion,
+    };
+
+    /// how the second half of a wide character at \p x is written
+    HalfWriting half_writing(Screen::ImageLine const& line, int x, ExtendedCharTable const& table)
+    {
+        if (x == 0) {
+            return HalfWriting::Deletion;
+        }
+        Character const& previous = line[x - 1];
+        int const previous_width = character_width(previous, table);
+        if (previous_width == 2 && same_format(previous, line[x])) {
+            return HalfWriting::WideCharacter;
+        }
+        // the previous cell is written again without the current cell
+        if (previous_width == 1 || is_erased(previous, table)
+         || (is_placeholder(previous, table) && half_writing(line, x - 1, table) != HalfWriting::Deletion)
+        ) {
+            return HalfWriting::IdeographicSpace;
+        }
+        return HalfWriting::Deletion;
+    }
+
+    std::size_t utf8_len(ucs4_char uc)
+    {
+        return (uc < 0x80) ? 1 : (uc < 0x800) ? 2 : (uc < 0x10000) ? 3 : 4;
+    }
+
+    void push_number(std::string& s, unsigned n)
+    {
+        char buf[10];
+        char * p = std::end(buf);
+        do {
+            *--p = char('0' + n % 10);
+            n /= 10;
+        } while (n);
+        s.append(p, std::end(buf));
+    }
+
+    /// CSI with a parameter omitted when it is the default value (1)
+    std::string csi(int n, char cmd)
+    {
+        std::string s = "\033[";
+        if (n > 1) {
+            push_number(s, unsigned(n));
+        }
+        s += cmd;
+        return s;
+    }
+
+    void push_color(std::string& s, CharacterColor const& color, bool foreground)
+    {
+        ColorBytes const c = color_bytes(color);
+        char const base = foreground ? '3' : '4';
+        switch (c.space) {
+            case ColorSpace::System:
+                if (c.v) {
+                    s += foreground ? "9" : "10";
+                }
+                else {
+                    s += base;
+                }
+                s += char('0' + c.u);
+                break;
+            case ColorSpace::Index256:
+                s += base;
+                s += "8;5;";
+                push_number(s, c.u);
+                break;
+            case ColorSpace::RGB:
+                s += base;
+                s += "8;2;";
+                push_number(s, c.u);
+                s += ';';
+                push_number(s, c.v);
+                s += ';';
+                push_number(s, c.w);
+                break;
+            case ColorSpace::Default:
+            case ColorSpace::Undefined:
+                s += base;
+                s += '9';
+                break;
+        }
+    }
+
+    // same as Screen::updateEffectiveRendition()
+    template<class Style>
+    Character effective_format(Style const& style)
+    {
+        Character ch;
+        bool const reverse = bool(style.rendition & Rendition::Reverse);
+        ch.foregroundColor = reverse ? style.background : style.foreground;
+        ch.backgroundColor = reverse ? style.foreground : style.background;
+        ch.rendition = style.rendition;
+        if (bool(style.rendition & Rendition::Bold)) {
+            ch.foregroundColor.setIntensive();
+        }
+        if (bool(style.rendition & Rendition::Dim)) {
+            ch.foregroundColor.setDim();
+        }
+        return ch;
+    }
+
+    /// color set by a SGR which gives \p color with the bold and dim attributes
+    CharacterColor source_color(CharacterColor const& color, bool bold)
+    {
+        ColorBytes const c = color_bytes(color);
+        if (c.space == ColorSpace::Default || (bold && c.space == ColorSpace::System)) {
+            return CharacterColor(c.space, c.u);
+        }
+        CharacterColor source;
+        source.fromPacked(color.toPacked() & ~0x8u);
+        return source;
+    }
+
+    struct SgrCode
+    {
+        Rendition rendition;
+        char const * set;
+        char const * reset;
+    };
+
+    // Rendition::Bold is reset by SGR 22 in most terminals but by SGR 21 in this emulator
+    constexpr SgrCode sgr_codes[] {
+        {Rendition::Bold, "1", nullptr},
+        {Rendition::Dim, "2", "22"},
+        {Rendition::Italic, "3", "23"},
+        {Rendition::Underline, "4", "24"},
+        {Rendition::Blink, "5", "25"},
+        {Rendition::Reverse, "7", "27"},
+    };
+}
+
+ScreenDiffEncoder::ScreenDiffEncoder(int lines, int columns, bool useRepeat)
+: _terminal(lines, columns)
+, _style{Screen::DefaultChar.foregroundColor, Screen::DefaultChar.backgroundColor, Rendition::Default}
+, _useRepeat(useRepeat)
+{}
+
+void ScreenDiffEncoder::encode(VtEmulator const& emulator, std::string& out)
+{
+    this->encode(emulator.getCurrentScreen(), emulator.getWindowTitle(), out);
+}
+
+void ScreenDiffEncoder::encode(Screen const& screen, ucs4_carray_view title, std::string& out)
+{
+    _out = &out;
+
+    int const lines = screen.getLines();
+    int const columns = screen.getColumns();
+    Screen const& terminal = _terminal.getCurrentScreen();
+
+    if (lines != terminal.getLines() || columns != terminal.getColumns()) {
+        std::string s = "\033[8;";
+        push_number(s, unsigned(lines));
+        s += ';';
+        push_number(s, unsigned(columns));
+        s += 't';
+        this->put(s);
+    }
+
+    this->scroll(screen);
+
+    auto const&& screen_lines = screen.getScreenLines();
+    ExtendedCharTable const& table = screen.extendedCharTable();
+    for (int y = 0; y < lines; ++y) {
+        this->encodeLine(y, screen_lines[y], table);
+    }
+
+    if (screen.hasCursorVisible()) {
+        int const x = screen.getCursorX();
+        int const y = screen.getCursorY();
+        if (x < columns) {
+            this->moveTo(x, y);
+        }
+        else if (x != terminal.getCursorX() || y != terminal.getCursorY()) {
+            this->writePendingWrap(screen);
+        }
+    }
+
+    if (_unknownState || screen.hasCursorVisible() != terminal.hasCursorVisible()) {
+        this->put(screen.hasCursorVisible() ? "\033[?25h" : "\033[?25l");
+    }
+
+    auto const terminal_title = _terminal.getWindowTitle();
+    if (_unknownState || !std::equal(title.begin(), title.end(), terminal_title.begin(), terminal_title.end())) {
+        this->put("\033]2;");
+        for (ucs4_char uc : title) {
+            this->putChar(uc);
+        }
+        this->put('\a');
+    }
+
+    _unknownState = false;
+    _out = nullptr;
+}
+
+void ScreenDiffEncoder::writePendingWrap(Screen const& screen)
+{
+    auto const&& screen_lines = screen.getScreenLines();
+    ExtendedCharTable const& table = screen.extendedCharTable();
+    int const lines = screen.getLines();
+    int const columns = screen.getColumns();
+    int const y = screen.getCursorY();
+    int const last = columns - 1;
+
+    // a line is written again with a character at the last column
+    auto rewrite = [&](int line_y) {
+        Screen::ImageLine const& line = screen_lines[line_y];
+        if (int(line.size()) == columns && character_width(line[last], table) == 1) {
+            this->writeCharacter(last, line_y, line[last], characters(line[last], table));
+            return true;
+        }
+        // the combining characters of a wide character are written after a cursor movement
+        if (last > 0 && int(line.size()) == columns && character_width(line[last - 1], table) == 2
+         && characters(line[last - 1], table).size() == 1
+        ) {
+            this->writeCharacter(last - 1, line_y, line[last - 1], characters(line[last - 1], table));
+            return true;
+        }
+        // the erasure of the line keeps the cursor
+        if (Character const* erased = erased_line(line, columns, table)) {
+            this->moveTo(last, line_y);
+            this->put(' ');
+            this->setColors(erased->foregroundColor, erased->backgroundColor);
+            this->put("\033[2K");
+            return true;
+        }
+        return false;
+    };
+
+    // the line of the cursor first, otherwise the cursor is moved by VPA which keeps the pending wrap
+    for (int i = 0; i < lines; ++i) {
+        int const line_y = (y + i) % lines;
+        if (rewrite(line_y)) {
+            if (line_y != y) {
+                this->put(csi(y + 1, 'd'));
+            }
+            return;
+        }
+    }
+
+    // the cursor is as close as possible
+    this->moveTo(last, y);
+}
+
+void ScreenDiffEncoder::reset(std::string& out)
+{
+    _out = &out;
+    this->put("\033c");
+    _out = nullptr;
+
+    _style = Style{Screen::DefaultChar.foregroundColor, Screen::DefaultChar.backgroundColor, Rendition::Default};
+    _unknownState = true;
+}
+
+void ScreenDiffEncoder::scroll(Screen const& screen)
+{
+    Screen const& terminal = _terminal.getCurrentScreen();
+    int const lines = screen.getLines();
+
+    // lines are compared with the hash of their text, weighted by their length
+    std::vector<uint64_t> hashes(std::size_t(lines) * 2);
+    for (int y = 0; y < lines; ++y) {
+        hashes[std::size_t(y)] = screen.hashLines(y, y);
+        hashes[std::size_t(lines + y)] = terminal.hashLines(y, y);
+    }
+
+    auto const&& screen_lines = screen.getScreenLines();
+
+    // content of the terminal moved up by n lines (down when n < 0)
+    auto score = [&](int n) {
+        std::size_t result = 0;
+        for (int y = std::max(0, -n); y < std::min(lines, lines - n); ++y) {
+            if (hashes[std::size_t(y)] == hashes[std::size_t(lines + y + n)]) {
+                result += screen_lines[y].size();
+            }
+        }
+        return result;
+    };
+
+    std::size_t const unscrolled = score(0);
+    int best = 0;
+    std::size_t best_score = 0;
+    for (int n = 1; n < lines; ++n) {
+        for (int d : {n, -n}) {
+            std::size_t const d_score = score(d);
+            // the gain must be greater than the scrolling sequence
+            if (d_score > best_score && d_score > unscrolled + csi(n, 'S').size()) {
+                best = d;
+                best_score = d_score;
+            }
+        }
+    }
+
+    if (!best) {
+        return;
+    }
+
+    // the new lines are erased with the current colors
+    this->setColors(Screen::DefaultChar.foregroundColor, Screen::DefaultChar.backgroundColor);
+    if (best < 0) {
+        this->put(csi(-best, 'T'));
+    }
+    else if (best <= 3 && terminal.getCursorY() == lines - 1) {
+        this->put(std::string(std::size_t(best), '\n'));
+    }
+    else {
+        this->put(csi(best, 'S'));
+    }
+}
+
+void ScreenDiffEncoder::encodeLine(int y, Screen::ImageLine const& line, ExtendedCharTable const& table)
+{
+    Screen const& terminal = _terminal.getCurrentScreen();
+    ExtendedCharTable const& terminal_table = terminal.extendedCharTable();
+    Screen::ImageLine const& terminal_line = terminal.getScreenLines()[y];
+    int const columns = terminal.getColumns();
+    int const size = std::min(int(line.size()), columns);
+
+    auto differs = [&](int x) {
+        return !same_cell(cell_at(terminal_line, x), terminal_table, line[x], table);
+    };
+
+    // erased cells at the end of the line are written with an erasure to the end of line,
+    // which truncates the line with the default colors
+    int end = size;
+    bool const erased_tail = (size == 0 || (is_erased(line[size - 1], table)
+        && (size == columns || same_format(line[size - 1], Screen::DefaultChar))));
+    Character const tail = size ? line[size - 1] : Screen::DefaultChar;
+    if (erased_tail) {
+        while (end > 0 && same_erasure(line[end - 1], tail, table)) {
+            --end;
+        }
+    }
+
+    auto write_tail = [&]{
+        if (!erased_tail) {
+            if (int(terminal_line.size()) > size) {
+                this->moveTo(size, y);
+                this->setColors(Screen::DefaultChar.foregroundColor, Screen::DefaultChar.backgroundColor);
+                this->put("\033[K");
+            }
+            return;
+        }
+
+        bool const truncated = same_format(tail, Screen::DefaultChar);
+        bool modified = truncated
+            ? int(terminal_line.size()) != size
+            : int(terminal_line.size()) < size;
+        for (int x = end; x < size && !modified; ++x) {
+            modified = differs(x);
+        }
+
+        if (modified && truncated && size == columns) {
+            // an erasure with the default colors up to the last column truncates the line,
+            // the deleted characters are replaced with erased cells up to the last column
+            this->moveTo(end, y);
+            if (int(terminal_line.size()) < columns) {
+                this->setColors(Screen::DefaultChar.foregroundColor, CharacterColor(ColorSpace::System, 0));
+                this->put("\033[K");
+            }
+            this->setStyle(tail);
+            this->put(csi(size - end, 'P'));
+        }
+        else if (modified) {
+            this->moveTo(end, y);
+            this->setColors(tail.foregroundColor, tail.backgroundColor);
+            this->put("\033[K");
+            // an erasure with the default colors up to the last column truncates the line
+            if (truncated && end < size && size < columns) {
+                this->put(csi(size - end, 'X'));
+            }
+        }
+    };
+
+    for (int x = 0; x < end; ) {
+        x = differs(x) ? this->writeCell(x, y, end, line, table) : x + 1;
+    }
+
+    write_tail();
+
+    // the last cells are blank characters added by the terminal when the line grows
+    if (end == size && int(terminal_line.size()) < size) {
+        this->writeCell(size - 1, y, size, line, table);
+    }
+}
+
+int ScreenDiffEncoder::writeCell(
+    int x, int y, int end, Screen::ImageLine const& line, ExtendedCharTable const& table)
+{
+    Screen const& terminal = _terminal.getCurrentScreen();
+    int const columns = terminal.getColumns();
+    Character const& ch = line[x];
+
+    if (ch.isRealCharacter) {
+        int const width = character_width(ch, table);
+        if (width && x + width <= columns) {
+            this->writeCharacter(x, y, ch, characters(ch, table), &line);
+
+            // the second half of a wide character was erased at the end of the line
+            if (x + width > int(line.size())) {
+                this->moveTo(int(line.size()), y);
+                this->setColors(Screen::DefaultChar.foregroundColor, Screen::DefaultChar.backgroundColor);
+                this->put("\033[K");
+                return x + 1;
+            }
+
+            // the next modified cells with the same character are written with REP
+            if (_useRepeat && width == 1 && !ch.is_extended()) {
+                Screen::ImageLine const& terminal_line = terminal.getScreenLines()[y];
+                int last = x + 1;
+                while (last < end && line[last] == ch
+                    && !same_cell(cell_at(terminal_line, last), terminal.extendedCharTable(), ch, table)
+                ) {
+                    ++last;
+                }
+                int const n = last - x - 1;
+                if (n && csi(n, 'b').size() < std::size_t(n) * utf8_len(ch.character)) {
+                    this->put(csi(n, 'b'));
+                    return last;
+                }
+            }
+        }
+        // a wide character at the last column lost its second half with an insertion:
+        // the character is written before the last column then moved by an insertion,
+        // the previous cell is written again
+        else if (width == 2 && x == columns - 1 && x > 0 && !is_deleted(line[x - 1], table)
+              && !(is_placeholder(line[x - 1], table) && half_writing(line, x - 1, table) == HalfWriting::Deletion)
+        ) {
+            this->writeCharacter(x - 1, y, ch, characters(ch, table));
+            this->moveTo(x - 1, y);
+            this->put("\033[@");
+            return x - 1;
+        }
+        return x + 1;
+    }
+
+    if (is_erased(ch, table)) {
+        int last = x + 1;
+        while (last < end && same_erasure(line[last], ch, table)) {
+            ++last;
+        }
+        int n = last - x;
+        // an erasure with the default colors up to the last column truncates the line
+        if (last == columns && same_format(ch, Screen::DefaultChar)) {
+            --n;
+        }
+        if (n) {
+            this->moveTo(x, y, &line);
+            this->setColors(ch.foregroundColor, ch.backgroundColor);
+            this->put(csi(n, 'X'));
+        }
+        return last;
+    }
+
+    // the deleted characters are replaced with blank cells up to the end of the line,
+    // the next cells are written again
+    if (is_deleted(ch, table)) {
+        this->moveTo(x, y);
+        // the line is not extended by a deletion
+        if (int(terminal.getScreenLines()[y].size()) <= x) {
+            this->setColors(Screen::DefaultChar.foregroundColor, CharacterColor(ColorSpace::System, 0));
+            this->put("\033[X");
+        }
+        this->setStyle(ch);
+        this->put(csi(columns - x, 'P'));
+        return x + 1;
+    }
+
+    if (is_placeholder(ch, table)) {
+        switch (half_writing(line, x, table)) {
+            // second half of a wide character: the wide character is written again
+            case HalfWriting::WideCharacter:
+                this->writeCharacter(x - 1, y, line[x - 1], characters(line[x - 1], table));
+                break;
+            // second half of a wide character whose first half was overwritten:
+            // a wide character is written on the previous cell, then the previous cell is written again
+            case HalfWriting::IdeographicSpace:
+                this->moveTo(x - 1, y);
+                this->setStyle(ch);
+                this->putChar(0x3000); // ideographic space
+                this->writeCell(x - 1, y, x, line, table);
+                break;
+            // the first half of a wide character is deleted, the next cells are written again
+            case HalfWriting::Deletion:
+                if (x < columns - 1) {
+                    this->moveTo(x, y);
+                    this->setStyle(ch);
+                    this->putChar(0x3000); // ideographic space
+                    this->moveTo(x, y);
+                    this->put("\033[P");
+                }
+                break;
+        }
+    }
+
+    return x + 1;
+}
+
+void ScreenDiffEncoder::writeCharacter(
+    int x, int y, Character const& ch, ucs4_carray_view chars, Screen::ImageLine const* line)
+{
+    this->moveTo(x, y, line);
+    this->setStyle(ch);
+    this->putChar(chars[0]);
+    // the combining characters are attached to the cell before the cursor,
+    // which is the second half of a wide character
+    if (chars.size() > 1 && Screen::charWidth(chars[0]) == 2) {
+        this->moveTo(x + 1, y);
+    }
+    for (ucs4_char uc : chars.subarray(1)) {
+        this->putChar(uc);
+    }
+}
+
+void ScreenDiffEncoder::moveTo(int x, int y, Screen::ImageLine const* line)
+{
+    Screen const& terminal = _terminal.getCurrentScreen();
+    int const cx = terminal.getCursorX();
+    int const cy = terminal.getCursorY();
+    if (cx == x && cy == y) {
+        return;
+    }
+
+    std::string const sequence = this->moveSequence(x, y);
+
+    // the characters between the cursor and x are written again when it is shorter
+    if (line && cy == y && cx < x && x <= int(line->size()) && std::size_t(x - cx) < sequence.size()) {
+        Character const format = effective_format(_style);
+        std::size_t len = 0;
+        bool rewritable = true;
+        for (int i = cx; i < x && rewritable; ++i) {
+            Character const& ch = (*line)[i];
+            rewritable = ch.isRealCharacter && !ch.is_extended()
+                      && same_format(ch, format)
+                      && Screen::charWidth(ch.character) == 1;
+            len += utf8_len(ch.character);
+        }
+        if (rewritable && len < sequence.size()) {
+            for (int i = cx; i < x; ++i) {
+                this->putChar((*line)[i].character);
+            }
+            return;
+        }
+    }
+
+    this->put(sequence);
+}
+
+std::string ScreenDiffEncoder::moveSequence(int x, int y) const
+{
+    Screen const& terminal = _terminal.getCurrentScreen();
+    int const cx = terminal.getCursorX();
+    int const cy = terminal.getCursorY();
+    // the relative movements leave the column after the last column
+    int const bounded_cx = std::min(cx, terminal.getColumns() - 1);
+
+    std::string best = "\033[";
+    if (y) {
+        push_number(best, unsigned(y + 1));
+    }
+    if (x) {
+        best += ';';
+        push_number(best, unsigned(x + 1));
+    }
+    best += 'H';
+
+    auto consider = [&best](std::string s) {
+        if (s.size() < best.size()) {
+            best = std::move(s);
+        }
+    };
+
+    if (cy == y) {
+        consider(this->columnSequence(cx, x));
+    }
+    else {
+        consider(csi(y + 1, 'd') + this->columnSequence(cx, x));
+        if (y > cy) {
+            consider(csi(y - cy, 'B') + this->columnSequence(bounded_cx, x));
+            if (y - cy <= 3) {
+                std::string const column = this->columnSequence(cx, x);
+                std::string const newlines(std::size_t(y - cy), '\n');
+                consider((column == "\r") ? column + newlines : newlines + column);
+            }
+        }
+        else {
+            consider(csi(cy - y, 'A') + this->columnSequence(bounded_cx, x));
+        }
+    }
+
+    return best;
+}
+
+std::string ScreenDiffEncoder::columnSequence(int cx, int x) const
+{
+    if (cx == x) {
+        return std::string();
+    }
+
+    int const columns = _terminal.getCurrentScreen().getColumns();
+    int const bounded_cx = std::min(cx, columns - 1);
+
+    std::string best = csi(x + 1, 'G');
+    auto consider = [&best](std::string s) {
+        if (s.size() < best.size()) {
+            best = std::move(s);
+        }
+    };
+
+    if (x == 0) {
+        consider("\r");
+    }
+    if (x > bounded_cx || (cx == columns && x == columns - 1)) {
+        consider(csi(std::max(1, x - cx), 'C'));
+    }
+    if (x < bounded_cx) {
+        consider(csi(bounded_cx - x, 'D'));
+    }
+
+    return best;
+}
+
+void ScreenDiffEncoder::setStyle(Character const& ch)
+{
+    if (same_format(effective_format(_style), ch)) {
+        return;
+    }
+
+    Rendition const rendition = without_extended(ch.rendition);
+    CharacterColor const color = source_color(ch.foregroundColor, bool(rendition & Rendition::Bold));
+    bool const reverse = bool(rendition & Rendition::Reverse);
+    Style style{reverse ? ch.backgroundColor : color, reverse ? color : ch.backgroundColor, rendition};
+
+    // the colors of the current style are kept when the result is the same
+    Style candidate = style;
+    candidate.foreground = _style.foreground;
+    if (same_format(effective_format(candidate), ch)) {
+        style = candidate;
+    }
+    candidate = style;
+    candidate.background = _style.background;
+    if (same_format(effective_format(candidate), ch)) {
+        style = candidate;
+    }
+
+    this->setStyle(style, false);
+}
+
+void ScreenDiffEncoder::setColors(CharacterColor const& foreground, CharacterColor const& background)
+{
+    this->setStyle(Style{foreground, background, _style.rendition}, true);
+}
+
+void ScreenDiffEncoder::setStyle(Style const& style, bool anyRendition)
+{
+    bool const same_foreground = (style.foreground == _style.foreground);
+    bool const same_background = (style.background == _style.background);
+    if (same_foreground && same_background && style.rendition == _style.rendition) {
+        return;
+    }
+
+    // parameters from the current style
+    std::string incremental;
+    bool incrementable = true;
+    auto add = [&incremental](char const * param) {
+        if (!incremental.empty()) {
+            incremental += ';';
+        }
+        incremental += param;
+    };
+
+    Rendition const removed = _style.rendition & ~style.rendition;
+    Rendition added = style.rendition & ~_style.rendition;
+    for (SgrCode const& code : sgr_codes) {
+        if (bool(removed & code.rendition)) {
+            if (code.reset) {
+                add(code.reset);
+            }
+            else {
+                incrementable = false;
+            }
+        }
+    }
+    // SGR 22 also resets the bold in most terminals
+    if (bool(removed & Rendition::Dim)) {
+        added |= style.rendition & Rendition::Bold;
+    }
+    for (SgrCode const& code : sgr_codes) {
+        if (bool(added & code.rendition)) {
+            add(code.set);
+        }
+    }
+    if (!same_foreground) {
+        add("");
+        push_color(incremental, style.foreground, true);
+    }
+    if (!same_background) {
+        add("");
+        push_color(incremental, style.background, false);
+    }
+
+    // parameters after a reset (SGR 0 written as an empty parameter)
+    Style const reset_style{style.foreground, style.background,
+                            anyRendition ? Rendition::Default : style.rendition};
+    std::string reset;
+    for (SgrCode const& code : sgr_codes) {
+        if (bool(reset_style.rendition & code.rendition)) {
+            reset += ';';
+            reset += code.set;
+        }
+    }
+    if (reset_style.foreground != Screen::DefaultChar.foregroundColor) {
+        reset += ';';
+        push_color(reset, reset_style.foreground, true);
+    }
+    if (reset_style.background != Screen::DefaultChar.backgroundColor) {
+        reset += ';';
+        push_color(reset, reset_style.background, false);
+    }
+
+    this->put("\033[");
+    if (incrementable && incremental.size() <= reset.size()) {
+        this->put(incremental);
+        _style = style;
+    }
+    else {
+        this->put(reset);
+        _style = reset_style;
+    }
+    this->put('m');
+}
+
+void ScreenDiffEncoder::put(char c)
+{
+    _out->push_back(c);
+    _terminal.receiveChar(ucs4_char(uint8_t(c)));
+}
+
+void ScreenDiffEncoder::put(std::string_view s)
+{
+    for (char c : s) {
+        this->put(c);
+    }
+}
+
+void ScreenDiffEncoder::putChar(ucs4_char uc)
+{
+    uint8_t utf8[4];
+    std::size_t const len = unsafe_ucs4_to_utf8(uc, utf8);
+    _out->append(bytes_t(utf8).to_charp(), len);
+    _terminal.receiveChar(uc);
+}
+
+}
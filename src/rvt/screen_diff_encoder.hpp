@@ -0,0 +1,99 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#pragma once
+
+#include "rvt/vt_emulator.hpp"
+
+#include <string>
+#include <string_view>
+
+
+namespace rvt
+{
+
+/**
+ * Encoder of the escape sequences which turn the screen of a terminal into
+ * the visible screen of an emulator.
+ *
+ * The encoder keeps the destination terminal (an emulator fed with the encoded
+ * sequences) and only writes the differences. Scrolling, cursor movements, SGR
+ * attributes and erasures are chosen for the shortest output.
+ * The cells, the cursor, the window title and the size are reproduced,
+ * the modes, the margins, the charsets and the scrollback are not.
+ */
+class ScreenDiffEncoder
+{
+public:
+    /// \param useRepeat  the repeated characters can be written with REP (CSI b),
+    ///                   which is not supported by all terminals
+    ScreenDiffEncoder(int lines, int columns, bool useRepeat = false);
+
+    ScreenDiffEncoder(ScreenDiffEncoder const&) = delete;
+    ScreenDiffEncoder& operator=(ScreenDiffEncoder const&) = delete;
+
+    /// Append to \p out the sequences which turn the destination terminal into the visible screen of \p emulator.
+    void encode(VtEmulator const& emulator, std::string& out);
+    void encode(Screen const& screen, ucs4_carray_view title, std::string& out);
+
+    /// Append a reset of the terminal to \p out, the next \c encode() redraws the whole screen.
+    /// Used when the state of the destination terminal is unknown.
+    void reset(std::string& out);
+
+    /// Destination terminal.
+    VtEmulator const& terminal() const noexcept
+    {
+        return _terminal;
+    }
+
+private:
+    struct Style
+    {
+        CharacterColor foreground;
+        CharacterColor background;
+        Rendition rendition;
+    };
+
+    void encodeLine(int y, Screen::ImageLine const& line, ExtendedCharTable const& table);
+    int writeCell(int x, int y, int end, Screen::ImageLine const& line, ExtendedCharTable const& table);
+    void writeCharacter(int x, int y, Character const& ch, ucs4_carray_view chars,
+                        Screen::ImageLine const* line = nullptr);
+    void writePendingWrap(Screen const& screen);
+    void scroll(Screen const& screen);
+    /// \param line  target line, the characters before \p x can be written instead of moving the cursor
+    void moveTo(int x, int y, Screen::ImageLine const* line = nullptr);
+    std::string moveSequence(int x, int y) const;
+    std::string columnSequence(int cx, int x) const;
+    void setStyle(Character const& ch);
+    void setColors(CharacterColor const& foreground, CharacterColor const& background);
+    void setStyle(Style const& style, bool anyRendition);
+
+    void put(char c);
+    void put(std::string_view s);
+    void putChar(ucs4_char uc);
+
+    VtEmulator _terminal;
+    Style _style;
+    bool _useRepeat;
+    bool _unknownState = false;
+    std::string * _out = nullptr;
+};
+
+}
@@ -0,0 +1,126 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+
+#include "rvt/screen_tracker.hpp"
+#include "rvt/vt_emulator.hpp"
+
+#include <algorithm>
+
+
+namespace rvt
+{
+
+namespace
+{
+    /// the foreground color of a space (erased cell included) is only visible
+    /// with an underline or a reverse video
+    bool is_plain_space(Character const & ch)
+    {
+        return ch.character == ' '
+            && !bool(ch.rendition & (Rendition::Underline | Rendition::Reverse | Rendition::ExtendedChar));
+    }
+
+    bool same_cell(Character const & a, Character const & b)
+    {
+        if (a == b) {
+            return true;
+        }
+        return is_plain_space(a) && is_plain_space(b)
+            && a.backgroundColor == b.backgroundColor;
+    }
+
+    /// number of visually different cells, a missing cell is a default character
+    std::size_t count_changed_cells(Screen::ImageLine const & a, Screen::ImageLine const & b)
+    {
+        Screen::ImageLine const & shortest = (a.size() < b.size()) ? a : b;
+        Screen::ImageLine const & longest = (a.size() < b.size()) ? b : a;
+
+        std::size_t n = 0;
+        for (std::size_t x = 0; x < shortest.size(); ++x) {
+            n += !same_cell(shortest[x], longest[x]);
+        }
+
+        Character const blank;
+        for (std::size_t x = shortest.size(); x < longest.size(); ++x) {
+            n += !same_cell(longest[x], blank);
+        }
+
+        return n;
+    }
+}
+
+ScreenTracker::ScreenTracker(VtEmulator & emulator)
+: _emulator(emulator)
+{
+    _emulator.setChangeTracking(true, this);
+}
+
+ScreenTracker::~ScreenTracker()
+{
+    _emulator.setChangeTracking(false);
+}
+
+ScreenTracker::Changes ScreenTracker::update()
+{
+    Screen const & screen = _emulator.getCurrentScreen();
+    auto const&& lines = screen.getScreenLines();
+
+    bool const alternateScreen = _emulator.isAlternateScreen();
+    bool const allLines = _changes.resized
+                       || alternateScreen != _alternateScreen
+                       || lines.size() != _image.size();
+    _alternateScreen = alternateScreen;
+    _image.resize(lines.size());
+
+    Changes changes = _changes;
+    for (std::size_t y = 0; y < lines.size(); ++y) {
+        if (allLines || screen.isLineChanged(int(y))) {
+            changes.cells += count_changed_cells(_image[y], lines[y]);
+            _image[y] = lines[y];
+        }
+    }
+
+    _emulator.resetChangedLines();
+    _changes = Changes();
+
+    return changes;
+}
+
+void ScreenTracker::beforeLineChange(Screen const& /*screen*/, int /*y*/)
+{
+}
+
+void ScreenTracker::beforeResize(Screen const& /*screen*/)
+{
+    _changes.resized = true;
+}
+
+void ScreenTracker::beforeClear(Screen const& /*screen*/)
+{
+    _changes.cleared = true;
+}
+
+void ScreenTracker::beforeReset(Screen const& /*screen*/)
+{
+    _changes.reset = true;
+}
+
+}
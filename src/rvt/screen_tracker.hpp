@@ -0,0 +1,81 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+
+#pragma once
+
+#include "rvt/screen.hpp"
+
+#include <vector>
+
+#include <cstddef>
+
+
+namespace rvt
+{
+
+class VtEmulator;
+
+/**
+ * Copy of the visible screen of a \c VtEmulator for counting the modified cells.
+ *
+ * Only the lines modified since the previous update are compared (change
+ * tracking of the screens), all the lines are compared when the visible screen
+ * is resized or switched between the normal and the alternate screen.
+ * The tracker is the change observer of the emulator while it exists.
+ */
+class ScreenTracker final : private Screen::ChangeObserver
+{
+public:
+    struct Changes
+    {
+        /// cells which differ from the previous update
+        std::size_t cells = 0;
+        /// the entire screen was erased
+        bool cleared = false;
+        /// the screen was reset
+        bool reset = false;
+        /// the screen was resized
+        bool resized = false;
+    };
+
+    explicit ScreenTracker(VtEmulator & emulator);
+    ~ScreenTracker();
+
+    ScreenTracker(ScreenTracker const&) = delete;
+    ScreenTracker& operator=(ScreenTracker const&) = delete;
+
+    /// Update the copy with the visible screen.
+    /// \return the changes since the previous update (or the construction)
+    Changes update();
+
+private:
+    void beforeLineChange(Screen const& screen, int y) override;
+    void beforeResize(Screen const& screen) override;
+    void beforeClear(Screen const& screen) override;
+    void beforeReset(Screen const& screen) override;
+
+    VtEmulator & _emulator;
+    std::vector<Screen::ImageLine> _image;
+    bool _alternateScreen = false;
+    Changes _changes;
+};
+
+}
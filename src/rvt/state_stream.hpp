@@ -0,0 +1,214 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#pragma once
+
+#include "utils/sugar/array_view.hpp"
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace rvt
+{
+
+/**
+ * Binary writer of the emulator state.
+ * Integers are little endian, variable length integers use LEB128
+ * (zigzag encoding for the signed values).
+ */
+class StateWriter
+{
+public:
+    explicit StateWriter(std::vector<uint8_t> & out) noexcept
+    : _out(out)
+    {}
+
+    void u8(uint8_t x)
+    {
+        _out.push_back(x);
+    }
+
+    void u32(uint32_t x)
+    {
+        uint8_t const bytes[] {uint8_t(x), uint8_t(x >> 8), uint8_t(x >> 16), uint8_t(x >> 24)};
+        _out.insert(_out.end(), bytes, bytes + 4);
+    }
+
+    void u64(uint64_t x)
+    {
+        u32(uint32_t(x));
+        u32(uint32_t(x >> 32));
+    }
+
+    void uvar(uint64_t x)
+    {
+        while (x >= 0x80) {
+            _out.push_back(uint8_t(x | 0x80));
+            x >>= 7;
+        }
+        _out.push_back(uint8_t(x));
+    }
+
+    void svar(int64_t x)
+    {
+        uvar((uint64_t(x) << 1) ^ uint64_t(x >> 63));
+    }
+
+    void bytes(array_view<uint8_t const> bytes)
+    {
+        _out.insert(_out.end(), bytes.begin(), bytes.end());
+    }
+
+    std::vector<uint8_t> & buffer() noexcept
+    {
+        return _out;
+    }
+
+private:
+    std::vector<uint8_t> & _out;
+};
+
+/**
+ * Binary reader of the emulator state written by \c StateWriter.
+ * Reading past the end or an invalid value marks the reader as failed,
+ * the following values are 0.
+ */
+class StateReader
+{
+public:
+    explicit StateReader(array_view<uint8_t const> data) noexcept
+    : _p(data.begin())
+    , _end(data.end())
+    {}
+
+    uint8_t u8() noexcept
+    {
+        if (!has(1)) {
+            return 0;
+        }
+        return *_p++;
+    }
+
+    uint32_t u32() noexcept
+    {
+        if (!has(4)) {
+            return 0;
+        }
+        uint32_t const x = _p[0] | uint32_t(_p[1] << 8) | uint32_t(_p[2] << 16) | uint32_t(_p[3] << 24);
+        _p += 4;
+        return x;
+    }
+
+    uint64_t u64() noexcept
+    {
+        uint64_t const low = u32();
+        return low | (uint64_t(u32()) << 32);
+    }
+
+    uint64_t uvar() noexcept
+    {
+        uint64_t x = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (!has(1)) {
+                return 0;
+            }
+            uint8_t const byte = *_p++;
+            x |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return x;
+            }
+        }
+        fail();
+        return 0;
+    }
+
+    int64_t svar() noexcept
+    {
+        uint64_t const x = uvar();
+        return int64_t(x >> 1) ^ -int64_t(x & 1);
+    }
+
+    /// Signed value in [\p min, \p max], otherwise the reader fails.
+    int bounded(int min, int max) noexcept
+    {
+        int64_t const x = svar();
+        if (x < min || x > max) {
+            fail();
+            return min < 0 && 0 < max ? 0 : min;
+        }
+        return int(x);
+    }
+
+    /// Unsigned size not greater than \p max, otherwise the reader fails.
+    std::size_t size(std::size_t max) noexcept
+    {
+        uint64_t const x = uvar();
+        if (x > max) {
+            fail();
+            return 0;
+        }
+        return std::size_t(x);
+    }
+
+    array_view<uint8_t const> bytes(std::size_t n) noexcept
+    {
+        if (!has(n)) {
+            return {};
+        }
+        array_view<uint8_t const> bytes{_p, n};
+        _p += n;
+        return bytes;
+    }
+
+    void fail() noexcept
+    {
+        _failed = true;
+        _p = _end;
+    }
+
+    bool failed() const noexcept
+    {
+        return _failed;
+    }
+
+    std::size_t remaining() const noexcept
+    {
+        return std::size_t(_end - _p);
+    }
+
+private:
+    bool has(std::size_t n) noexcept
+    {
+        if (std::size_t(_end - _p) < n) {
+            fail();
+            return false;
+        }
+        return true;
+    }
+
+    uint8_t const * _p;
+    uint8_t const * _end;
+    bool _failed = false;
+};
+
+}
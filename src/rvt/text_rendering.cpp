@@ -23,10 +23,12 @@
 
 #include "rvt/character.hpp"
 #include "rvt/screen.hpp"
+#include "rvt/thread_pool.hpp"
 
 #include "rvt/ucs.hpp"
 #include "rvt/utf8_decoder.hpp"
 
+#include <algorithm>
 #include <charconv>
 
 namespace rvt {
@@ -147,6 +149,20 @@ struct RenderingBuffer2
         }
     }
 
+    void unsafe_push_character(Character const & ch, const rvt::ExtendedCharTable & extended_char_table, std::size_t extra_capacity)
+    {
+        if (ch.isRealCharacter) {
+            if (REDEMPTION_UNLIKELY(ch.is_extended())) {
+                auto ucs_array = extended_char_table[ch.character];
+                prepare_buffer(ucs_array.size() * 4, std::max(extra_capacity, ucs_array.size() * 4u));
+                this->unsafe_push_ucs_array(ucs_array);
+            }
+            else {
+                this->unsafe_push_ucs(ch.character);
+            }
+        }
+    }
+
     void unsafe_push_quoted_ucs_array(ucs4_carray_view ucs_array)
     {
         for (ucs4_char ucs : ucs_array) {
@@ -215,6 +231,13 @@ private:
         _p = r.ptr;
     }
 
+    void _unsafe_push_value(uint64_t x)
+    {
+        auto r = std::to_chars(_p, _p + remaining(), x);
+        assert(r.ec == std::errc());
+        _p = r.ptr;
+    }
+
     void _unsafe_push_value(char x)
     {
         unsafe_push_c(x);
@@ -283,6 +306,72 @@ private:
     RenderingBuffer::SetFinalBuffer * _set_final_buffer;
 };
 
+using Line = array_view<const rvt::Character>;
+
+/// Characters of \c line inside \c region.
+Line region_line(Screen::ImageLine const & line, ScreenRegion const & region)
+{
+    std::size_t const first = checked_int(region.first_column);
+    if (first >= line.size()) {
+        return {};
+    }
+    std::size_t const last = std::min<std::size_t>(line.size(), checked_int(region.last_column + 1));
+    return {line.data() + first, last - first};
+}
+
+/// Last character of \c region before \c first_line, it gives the format carried over by a shard of lines.
+rvt::Character const* previous_character(
+    Screen const & screen, ScreenRegion const & region, std::size_t first_line)
+{
+    auto const&& lines = screen.getScreenLines();
+    std::size_t const region_first_line = checked_int(region.first_line);
+    while (first_line > region_first_line) {
+        Line line = region_line(lines[--first_line], region);
+        if (!line.empty()) {
+            return &line[line.size() - 1];
+        }
+    }
+    return nullptr;
+}
+
+/// Call \c render_lines(buf, first_line, last_line, previous_ch) for all the screen lines.
+/// When the screen is large enough, lines are split in shards rendered by the threads of the pool.
+/// \c previous_ch is nullptr for the default format.
+template<class RenderLines>
+void render_screen_lines(
+    RenderingBuffer2 & buf, Screen const & screen, ScreenRegion const & region,
+    ParallelRendering const & parallel, RenderLines & render_lines)
+{
+    std::size_t const region_first_line = checked_int(region.first_line);
+    std::size_t const nb_lines = checked_int(region.lines());
+    std::size_t const nb_cells = nb_lines * checked_int(region.columns());
+
+    if (!parallel.pool || parallel.pool->size() <= 1
+     || nb_lines < 2 || nb_cells < parallel.min_cells
+    ) {
+        render_lines(buf, region_first_line, region_first_line + nb_lines, nullptr);
+        return;
+    }
+
+    std::size_t const nb_shards = std::min<std::size_t>(nb_lines, parallel.pool->size() * 4u);
+    std::vector<std::vector<char>> segments(nb_shards);
+
+    parallel.pool->parallel_for(nb_shards, [&](std::size_t i){
+        std::size_t const first_line = region_first_line + nb_lines * i / nb_shards;
+        std::size_t const last_line = region_first_line + nb_lines * (i + 1) / nb_shards;
+        std::vector<char>& segment = segments[i];
+        segment.resize(nb_cells / nb_shards * 2);
+        RenderingBuffer2 segment_buf{RenderingBuffer::from_vector(segment)};
+        render_lines(segment_buf, first_line, last_line, previous_character(screen, region, first_line));
+        segment_buf.set_final();
+    });
+
+    for (auto const& segment : segments) {
+        buf.prepare_buffer(segment.size(), std::max<std::size_t>(4096, segment.size()));
+        buf.unsafe_push_s(chars_view{segment.data(), segment.size()});
+    }
+}
+
 }
 
 // format = "{
@@ -311,8 +400,24 @@ void json_rendering(
     Screen const & screen,
     ColorTableView palette,
     RenderingBuffer buffer,
-    std::string_view extra_data
+    std::string_view extra_data,
+    ParallelRendering parallel
+) {
+    json_rendering(title, screen, ScreenRegion::from_screen(screen),
+                   palette, buffer, extra_data, parallel);
+}
+
+void json_rendering(
+    ucs4_carray_view title,
+    Screen const & screen,
+    ScreenRegion region,
+    ColorTableView palette,
+    RenderingBuffer buffer,
+    std::string_view extra_data,
+    ParallelRendering parallel
 ) {
+    region = region.clamp(screen);
+
     auto color2int = [](rvt::Color const & color){
         return uint32_t((color.red() << 16) | (color.green() << 8) |  (color.blue() << 0));
     };
@@ -321,15 +426,22 @@ void json_rendering(
 
     buf.prepare_buffer(4096, std::max(title.size() * 4 + 512, std::size_t(4096)));
 
-    if (screen.hasCursorVisible()) {
-        buf.unsafe_push_values("{\"x\":"_av, screen.getCursorX(),
-                               ",\"y\":"_av, screen.getCursorY());
+    int const cursor_x = screen.getCursorX();
+    int const cursor_y = screen.getCursorY();
+    bool const is_cursor_in_region
+        = cursor_y >= region.first_line && cursor_y <= region.last_line
+       && cursor_x >= region.first_column
+       // cursor after the last column of the screen when a wrap is pending
+       && (cursor_x <= region.last_column || region.last_column == screen.getColumns() - 1);
+    if (screen.hasCursorVisible() && is_cursor_in_region) {
+        buf.unsafe_push_values("{\"x\":"_av, cursor_x - region.first_column,
+                               ",\"y\":"_av, cursor_y - region.first_line);
     }
     else {
         buf.unsafe_push_s(R"({"y":-1)"_av);
     }
-    buf.unsafe_push_values(",\"lines\":"_av, screen.getLines(),
-                           ",\"columns\":"_av, screen.getColumns(),
+    buf.unsafe_push_values(",\"lines\":"_av, region.lines(),
+                           ",\"columns\":"_av, region.columns(),
                            ",\"title\":\""_av);
     buf.unsafe_push_quoted_ucs_array(title);
     buf.unsafe_push_values("\",\"style\":{\"r\":0"
@@ -338,13 +450,22 @@ void json_rendering(
 
     constexpr std::size_t max_size_by_loop = 111; // approximate
 
-    if (screen.getColumns() && screen.getLines()) {
+    auto render_lines = [&](
+        RenderingBuffer2 & buf, std::size_t first_line, std::size_t last_line,
+        rvt::Character const* previous_ch
+    ) {
         rvt::Character const default_ch; // Default format
-        rvt::Character const* previous_ch = &default_ch;
+        if (!previous_ch) {
+            previous_ch = &default_ch;
+        }
 
-        for (auto const & line : screen.getScreenLines()) {
+        auto const&& lines = screen.getScreenLines();
+        for (auto const & screen_line : lines.subarray(first_line, last_line - first_line)) {
+            buf.prepare_buffer(max_size_by_loop, 4096);
             buf.unsafe_push_s("[[{"_av);
 
+            Line line = region_line(screen_line, region);
+
             bool is_s_enable = false;
             for (rvt::Character const & ch : line) {
                 buf.prepare_buffer(max_size_by_loop, 4096);
@@ -406,7 +527,10 @@ void json_rendering(
             }
             buf.unsafe_push_s("}]],"_av);
         }
+    };
 
+    if (!region.empty()) {
+        render_screen_lines(buf, screen, region, parallel, render_lines);
         buf.pop_c();
     }
 
@@ -429,8 +553,24 @@ void ansi_rendering(
     Screen const & screen,
     ColorTableView palette,
     RenderingBuffer buffer,
-    std::string_view extra_data
+    std::string_view extra_data,
+    ParallelRendering parallel
+) {
+    ansi_rendering(title, screen, ScreenRegion::from_screen(screen),
+                   palette, buffer, extra_data, parallel);
+}
+
+void ansi_rendering(
+    ucs4_carray_view title,
+    Screen const & screen,
+    ScreenRegion region,
+    ColorTableView palette,
+    RenderingBuffer buffer,
+    std::string_view extra_data,
+    ParallelRendering parallel
 ) {
+    region = region.clamp(screen);
+
     auto write_color = [palette](RenderingBuffer2 & buf, char cmd, rvt::CharacterColor const & ch_color) {
         auto color = ch_color.color(palette);
         buf.unsafe_push_values(';', cmd, '8', ';', '2', ';',
@@ -444,43 +584,102 @@ void ansi_rendering(
     buf.prepare_buffer(4096, 4096);
     buf.push_values('\033', ']', title, '\a');
 
-    rvt::Character const default_ch; // Default format
-    rvt::Character const* previous_ch = &default_ch;
-
     constexpr std::size_t max_size_by_loop = 64; // approximate
 
-    for (auto const & line : screen.getScreenLines()) {
-        for (rvt::Character const & ch : line) {
-            buf.prepare_buffer(max_size_by_loop, 4096);
+    auto render_lines = [&](
+        RenderingBuffer2 & buf, std::size_t first_line, std::size_t last_line,
+        rvt::Character const* previous_ch
+    ) {
+        rvt::Character const default_ch; // Default format
+        if (!previous_ch) {
+            previous_ch = &default_ch;
+        }
+
+        auto const&& lines = screen.getScreenLines();
+        for (auto const & screen_line : lines.subarray(first_line, last_line - first_line)) {
+            for (rvt::Character const & ch : region_line(screen_line, region)) {
+                buf.prepare_buffer(max_size_by_loop, 4096);
 
-            bool const is_same_bg = ch.backgroundColor == previous_ch->backgroundColor;
-            bool const is_same_fg = ch.foregroundColor == previous_ch->foregroundColor;
-            bool const is_same_rendition = ch.rendition == previous_ch->rendition;
-            bool const is_same_format = is_same_bg & is_same_fg & is_same_rendition;
-            if (!is_same_format) {
-                buf.unsafe_push_s("\033[0"_av);
+                bool const is_same_bg = ch.backgroundColor == previous_ch->backgroundColor;
+                bool const is_same_fg = ch.foregroundColor == previous_ch->foregroundColor;
+                bool const is_same_rendition = ch.rendition == previous_ch->rendition;
+                bool const is_same_format = is_same_bg & is_same_fg & is_same_rendition;
                 if (!is_same_format) {
-                    auto const r = ch.rendition;
-                    if (bool(r & rvt::Rendition::Bold))     { buf.unsafe_push_s(";1"_av); }
-                    if (bool(r & rvt::Rendition::Italic))   { buf.unsafe_push_s(";3"_av); }
-                    if (bool(r & rvt::Rendition::Underline)){ buf.unsafe_push_s(";4"_av); }
-                    if (bool(r & rvt::Rendition::Blink))    { buf.unsafe_push_s(";5"_av); }
-                    if (bool(r & rvt::Rendition::Reverse))  { buf.unsafe_push_s(";6"_av); }
+                    buf.unsafe_push_s("\033[0"_av);
+                    if (!is_same_format) {
+                        auto const r = ch.rendition;
+                        if (bool(r & rvt::Rendition::Bold))     { buf.unsafe_push_s(";1"_av); }
+                        if (bool(r & rvt::Rendition::Italic))   { buf.unsafe_push_s(";3"_av); }
+                        if (bool(r & rvt::Rendition::Underline)){ buf.unsafe_push_s(";4"_av); }
+                        if (bool(r & rvt::Rendition::Blink))    { buf.unsafe_push_s(";5"_av); }
+                        if (bool(r & rvt::Rendition::Reverse))  { buf.unsafe_push_s(";6"_av); }
+                    }
+                    if (!is_same_fg) write_color(buf, '3', ch.foregroundColor);
+                    if (!is_same_bg) write_color(buf, '4', ch.backgroundColor);
+                    buf.unsafe_push_c('m');
                 }
-                if (!is_same_fg) write_color(buf, '3', ch.foregroundColor);
-                if (!is_same_bg) write_color(buf, '4', ch.backgroundColor);
-                buf.unsafe_push_c('m');
-            }
 
-            buf.unsafe_push_quoted_character(ch, screen.extendedCharTable(), 4096);
+                buf.unsafe_push_quoted_character(ch, screen.extendedCharTable(), 4096);
 
-            previous_ch = &ch;
+                previous_ch = &ch;
+            }
+
+            buf.prepare_buffer(max_size_by_loop, 4096);
+            buf.unsafe_push_c('\n');
         }
+    };
 
-        buf.prepare_buffer(max_size_by_loop, 4096);
-        buf.unsafe_push_c('\n');
+    render_screen_lines(buf, screen, region, parallel, render_lines);
+
+    if (!extra_data.empty()) {
+        buf.prepare_buffer(extra_data.size(), extra_data.size());
+        buf.unsafe_push_s(extra_data);
     }
 
+    buf.set_final();
+}
+
+
+void text_rendering(
+    Screen const & screen,
+    RenderingBuffer buffer,
+    std::string_view extra_data,
+    ParallelRendering parallel
+) {
+    text_rendering(screen, ScreenRegion::from_screen(screen), buffer, extra_data, parallel);
+}
+
+void text_rendering(
+    Screen const & screen,
+    ScreenRegion region,
+    RenderingBuffer buffer,
+    std::string_view extra_data,
+    ParallelRendering parallel
+) {
+    region = region.clamp(screen);
+
+    RenderingBuffer2 buf{buffer};
+
+    constexpr std::size_t max_size_by_loop = 4;
+
+    auto render_lines = [&](
+        RenderingBuffer2 & buf, std::size_t first_line, std::size_t last_line,
+        rvt::Character const* /*previous_ch*/
+    ) {
+        auto const&& lines = screen.getScreenLines();
+        for (auto const & screen_line : lines.subarray(first_line, last_line - first_line)) {
+            for (rvt::Character const & ch : region_line(screen_line, region)) {
+                buf.prepare_buffer(max_size_by_loop, 4096);
+                buf.unsafe_push_character(ch, screen.extendedCharTable(), 4096);
+            }
+
+            buf.prepare_buffer(1, 4096);
+            buf.unsafe_push_c('\n');
+        }
+    };
+
+    render_screen_lines(buf, screen, region, parallel, render_lines);
+
     if (!extra_data.empty()) {
         buf.prepare_buffer(extra_data.size(), extra_data.size());
         buf.unsafe_push_s(extra_data);
@@ -490,14 +689,264 @@ void ansi_rendering(
 }
 
 
+namespace
+{
+
+/// Cells of a block of minimap.
+struct MinimapBlock
+{
+    uint32_t fg[3];
+    uint32_t bg[3];
+    // twice the contribution of each cell: 2*bg for a blank cell, fg+bg for the others
+    uint32_t mix[3];
+    uint32_t nb_cells;
+    uint32_t nb_filled;
+    uint32_t nb_candidates;
+};
+
+struct MinimapCandidate
+{
+    Character const * ch;
+    uint32_t count;
+};
+
+bool is_blank(Character const & ch) noexcept
+{
+    return ch.isRealCharacter && !ch.is_extended() && (ch.character == ' ' || ch.character == 0);
+}
+
+/// Call \c on_line(blocks, candidates) for each line of minimap.
+/// \c candidates contains, by block, the characters of the block with their number of occurrences
+/// when \c minimap.glyph is \c MinimapGlyph::dominant.
+template<class OnLine>
+void reduce_minimap(
+    Screen const & screen, ColorTableView palette, Minimap const & minimap, OnLine && on_line)
+{
+    std::size_t const block_lines = checked_int(std::max(1, minimap.block_lines));
+    std::size_t const block_columns = checked_int(std::max(1, minimap.block_columns));
+    std::size_t const nb_lines = checked_int(screen.getLines());
+    std::size_t const nb_columns = checked_int(screen.getColumns());
+    std::size_t const nb_blocks = checked_int(minimap.columns(screen));
+    std::size_t const block_size = block_lines * block_columns;
+    bool const with_candidates = (minimap.glyph == MinimapGlyph::dominant);
+
+    std::vector<MinimapBlock> blocks(nb_blocks);
+    std::vector<MinimapCandidate> candidates(with_candidates ? nb_blocks * block_size : 0);
+
+    auto add_color = [](uint32_t (&sum)[3], Color const & color, uint32_t n) {
+        sum[0] += color.red() * n;
+        sum[1] += color.green() * n;
+        sum[2] += color.blue() * n;
+    };
+
+    Character const default_ch;
+    Color const default_bg = default_ch.backgroundColor.color(palette);
+
+    auto const&& lines = screen.getScreenLines();
+    for (std::size_t y = 0; y < nb_lines; y += block_lines) {
+        std::fill(blocks.begin(), blocks.end(), MinimapBlock{});
+        std::size_t const yend = std::min(nb_lines, y + block_lines);
+
+        for (auto const & line : lines.subarray(y, yend - y)) {
+            std::size_t const len = std::min(line.size(), nb_columns);
+            for (std::size_t x = 0; x < len; ++x) {
+                Character const & ch = line[x];
+                std::size_t const ix = x / block_columns;
+                MinimapBlock & block = blocks[ix];
+
+                // colors are already swapped with Rendition::Reverse
+                Color const fg = ch.foregroundColor.color(palette);
+                Color const bg = ch.backgroundColor.color(palette);
+
+                ++block.nb_cells;
+                add_color(block.bg, bg, 1);
+
+                if (is_blank(ch)) {
+                    add_color(block.mix, bg, 2);
+                    continue;
+                }
+
+                ++block.nb_filled;
+                add_color(block.fg, fg, 1);
+                add_color(block.mix, fg, 1);
+                add_color(block.mix, bg, 1);
+
+                if (with_candidates && ch.isRealCharacter) {
+                    auto first = candidates.begin() + checked_int(ix * block_size);
+                    auto last = first + block.nb_candidates;
+                    auto it = std::find_if(first, last, [&ch](MinimapCandidate const & candidate){
+                        return candidate.ch->character == ch.character
+                            && candidate.ch->is_extended() == ch.is_extended();
+                    });
+                    if (it == last) {
+                        *it = MinimapCandidate{&ch, 0};
+                        ++block.nb_candidates;
+                    }
+                    ++it->count;
+                }
+            }
+        }
+
+        // cells after the end of lines
+        for (std::size_t ix = 0; ix < nb_blocks; ++ix) {
+            MinimapBlock & block = blocks[ix];
+            std::size_t const x = ix * block_columns;
+            auto const nb_cells = uint32_t((std::min(nb_columns, x + block_columns) - x) * (yend - y));
+            if (block.nb_cells < nb_cells) {
+                uint32_t const n = nb_cells - block.nb_cells;
+                block.nb_cells = nb_cells;
+                add_color(block.bg, default_bg, n);
+                add_color(block.mix, default_bg, n * 2);
+            }
+        }
+
+        on_line(array_view<const MinimapBlock>{blocks.data(), blocks.size()},
+                array_view<const MinimapCandidate>{candidates.data(), candidates.size()});
+    }
+}
+
+Color average_color(uint32_t const (&sum)[3], uint32_t n) noexcept
+{
+    return Color(
+        uint8_t((sum[0] + n / 2) / n),
+        uint8_t((sum[1] + n / 2) / n),
+        uint8_t((sum[2] + n / 2) / n)
+    );
+}
+
+}
+
+int Minimap::lines(Screen const & screen) const noexcept
+{
+    int const n = std::max(1, block_lines);
+    return (screen.getLines() + n - 1) / n;
+}
+
+int Minimap::columns(Screen const & screen) const noexcept
+{
+    int const n = std::max(1, block_columns);
+    return (screen.getColumns() + n - 1) / n;
+}
+
+void minimap_json_rendering(
+    Screen const & screen,
+    ColorTableView palette,
+    RenderingBuffer buffer,
+    Minimap minimap
+) {
+    auto color2int = [](rvt::Color const & color){
+        return uint32_t((color.red() << 16) | (color.green() << 8) |  (color.blue() << 0));
+    };
+
+    constexpr char density_glyphs[] = " .:-=+*#%@";
+    constexpr uint32_t max_density = sizeof(density_glyphs) - 2;
+
+    std::size_t const block_size = checked_int(
+        std::max(1, minimap.block_lines) * std::max(1, minimap.block_columns));
+    Color const default_fg = rvt::Character().foregroundColor.color(palette);
+
+    RenderingBuffer2 buf{buffer};
+
+    constexpr std::size_t max_size_by_loop = 16; // approximate
+
+    buf.prepare_buffer(4096, 4096);
+    buf.unsafe_push_values("{\"lines\":"_av, minimap.lines(screen),
+                           ",\"columns\":"_av, minimap.columns(screen),
+                           ",\"data\":["_av);
+
+    reduce_minimap(screen, palette, minimap, [&](
+        array_view<const MinimapBlock> blocks,
+        array_view<const MinimapCandidate> candidates
+    ) {
+        buf.prepare_buffer(max_size_by_loop, 4096);
+        buf.unsafe_push_s(R"({"s":")"_av);
+        std::size_t ix = 0;
+        for (MinimapBlock const & block : blocks) {
+            buf.prepare_buffer(max_size_by_loop, 4096);
+            if (minimap.glyph == MinimapGlyph::dominant) {
+                auto first = candidates.begin() + ix * block_size;
+                auto it = std::max_element(first, first + block.nb_candidates,
+                    [](MinimapCandidate const & a, MinimapCandidate const & b){
+                        return a.count < b.count;
+                    });
+                if (block.nb_candidates) {
+                    buf.unsafe_push_quoted_character(*it->ch, screen.extendedCharTable(), 4096);
+                }
+                else {
+                    buf.unsafe_push_c(' ');
+                }
+            }
+            else {
+                uint32_t const density = block.nb_filled
+                    ? std::min(max_density, 1 + block.nb_filled * (max_density - 1) / block.nb_cells)
+                    : 0;
+                buf.unsafe_push_c(density_glyphs[density]);
+            }
+            ++ix;
+        }
+
+        buf.prepare_buffer(max_size_by_loop, 4096);
+        buf.unsafe_push_s(R"(","f":[)"_av);
+        for (MinimapBlock const & block : blocks) {
+            buf.prepare_buffer(max_size_by_loop, 4096);
+            buf.unsafe_push_values(color2int(block.nb_filled
+                ? average_color(block.fg, block.nb_filled)
+                : default_fg), ',');
+        }
+        buf.pop_c();
+
+        buf.prepare_buffer(max_size_by_loop, 4096);
+        buf.unsafe_push_s(R"(],"b":[)"_av);
+        for (MinimapBlock const & block : blocks) {
+            buf.prepare_buffer(max_size_by_loop, 4096);
+            buf.unsafe_push_values(color2int(average_color(block.bg, block.nb_cells)), ',');
+        }
+        buf.pop_c();
+
+        buf.prepare_buffer(max_size_by_loop, 4096);
+        buf.unsafe_push_s("]},"_av);
+    });
+
+    buf.pop_c();
+    buf.prepare_buffer(2, 2);
+    buf.unsafe_push_s("]}"_av);
+
+    buf.set_final();
+}
+
+void minimap_rgb_rendering(
+    Screen const & screen,
+    ColorTableView palette,
+    RenderingBuffer buffer,
+    Minimap minimap
+) {
+    RenderingBuffer2 buf{buffer};
+
+    minimap.glyph = MinimapGlyph::density;
+
+    reduce_minimap(screen, palette, minimap, [&](
+        array_view<const MinimapBlock> blocks,
+        array_view<const MinimapCandidate> /*candidates*/
+    ) {
+        buf.prepare_buffer(blocks.size() * 3, std::max<std::size_t>(4096, blocks.size() * 3));
+        for (MinimapBlock const & block : blocks) {
+            Color const color = average_color(block.mix, block.nb_cells * 2);
+            buf.unsafe_push_c(char(color.red()));
+            buf.unsafe_push_c(char(color.green()));
+            buf.unsafe_push_c(char(color.blue()));
+        }
+    });
+
+    buf.set_final();
+}
+
+
 TranscriptPartialBuffer transcript_partial_rendering(
     Screen const & screen, size_t y, size_t yend,
     RenderingBuffer buffer, std::size_t consumed_buffer
 ) {
     RenderingBuffer2 buf{buffer, consumed_buffer};
 
-    using Line = array_view<const rvt::Character>;
-
     auto write_line_impl = [&](Line line){
         std::size_t nb_byte_for_ascii_line = line.size() * 4u;
         buf.prepare_buffer(nb_byte_for_ascii_line);
@@ -517,26 +966,59 @@ TranscriptPartialBuffer transcript_partial_rendering(
     };
 
     auto const&& lines = screen.getScreenLines();
-    auto const&& lineProperties = screen.getLineProperties();
-    constexpr auto wrapped = rvt::LineProperty::Wrapped;
-    while (y && bool(lineProperties[y-1] & wrapped)) {
-        --y;
-    }
-    while (y < yend) {
-        write_line_impl(lines[y]);
-        if (bool(lineProperties[y] & wrapped)) {
-            while (++y < lines.size()) {
-                write_line_impl(lines[y]);
-                if (!bool(lineProperties[y] & wrapped)) {
-                    break;
-                }
-            }
+    for_each_wrapped_line(screen, y, yend, [&](size_t first_line, size_t last_line){
+        for (size_t i = first_line; i <= last_line; ++i) {
+            write_line_impl(lines[i]);
         }
-        ++y;
-
         buf.prepare_buffer(1);
         buf.unsafe_push_c('\n');
-    }
+    });
+
+    return buf.to_transcript_buffer();
+}
+
+std::size_t transcript_line_count(Screen const & screen, size_t y, size_t yend)
+{
+    std::size_t n = 0;
+    for_each_wrapped_line(screen, y, yend, [&n](size_t /*first_line*/, size_t /*last_line*/){
+        ++n;
+    });
+    return n;
+}
+
+TranscriptPartialBuffer transcript_jsonl_partial_rendering(
+    Screen const & screen, size_t y, size_t yend,
+    TranscriptJsonlContext & ctx,
+    RenderingBuffer buffer, std::size_t consumed_buffer
+) {
+    RenderingBuffer2 buf{buffer, consumed_buffer};
+
+    constexpr std::size_t max_size_of_prefix = 128; // approximate
+
+    auto const&& lines = screen.getScreenLines();
+    for_each_wrapped_line(screen, y, yend, [&](size_t first_line, size_t last_line){
+        for (size_t i = first_line; i <= last_line; ++i) {
+            Line line = lines[i];
+            std::size_t const nb_byte_for_line = max_size_of_prefix + line.size() * 4u;
+            buf.prepare_buffer(nb_byte_for_line);
+            buf.unsafe_push_values("{\"t\":"_av, ctx.time_us,
+                                   ",\"y\":"_av, uint32_t(i),
+                                   ",\"g\":"_av, ctx.group,
+                                   ",\"a\":"_av,
+                                   ctx.alternate_screen ? "true"_av : "false"_av,
+                                   ",\"s\":\""_av);
+            for (auto const& ch : line) {
+                buf.unsafe_push_quoted_character(ch, screen.extendedCharTable(), 4096);
+                // an extended character uses more than 4 bytes
+                if (REDEMPTION_UNLIKELY(ch.isRealCharacter && ch.is_extended())) {
+                    buf.prepare_buffer(checked_int((line.end() - &ch) * 4), nb_byte_for_line);
+                }
+            }
+            buf.prepare_buffer(3);
+            buf.unsafe_push_s("\"}\n"_av);
+        }
+        ++ctx.group;
+    });
 
     return buf.to_transcript_buffer();
 }
@@ -566,6 +1048,21 @@ RenderingBuffer vector_to_rendering_buffer(std::vector<T>& v)
 
 }
 
+ScreenRegion ScreenRegion::from_screen(Screen const & screen) noexcept
+{
+    return {0, screen.getLines() - 1, 0, screen.getColumns() - 1};
+}
+
+ScreenRegion ScreenRegion::clamp(Screen const & screen) const noexcept
+{
+    return {
+        std::max(first_line, 0),
+        std::min(last_line, screen.getLines() - 1),
+        std::max(first_column, 0),
+        std::min(last_column, screen.getColumns() - 1),
+    };
+}
+
 RenderingBuffer RenderingBuffer::from_vector(std::vector<char>& v)
 {
     return vector_to_rendering_buffer(v);
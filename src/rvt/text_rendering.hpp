@@ -28,6 +28,7 @@
 namespace rvt {
 
 class Screen;
+class ThreadPool;
 
 struct RenderingBuffer
 {
@@ -44,16 +45,124 @@ struct RenderingBuffer
     static RenderingBuffer from_vector(std::vector<uint8_t>& v);
 };
 
+/// Split the rendering of lines between the threads of \c pool.
+/// Each shard of lines is rendered in its own segment, then segments are joined in order.
+struct ParallelRendering
+{
+    /// nullptr for a rendering by the calling thread only
+    ThreadPool * pool = nullptr;
+    /// screens with fewer cells (lines * columns) are rendered by the calling thread
+    std::size_t min_cells = 64 * 1024;
+};
+
+/// Rectangle of cells, bounds included.
+struct ScreenRegion
+{
+    int first_line;
+    int last_line;
+    int first_column;
+    int last_column;
+
+    static ScreenRegion from_screen(Screen const & screen) noexcept;
+
+    /// Intersection with \c screen.
+    ScreenRegion clamp(Screen const & screen) const noexcept;
+
+    bool empty() const noexcept
+    {
+        return first_line > last_line || first_column > last_column;
+    }
+
+    int lines() const noexcept { return empty() ? 0 : last_line - first_line + 1; }
+    int columns() const noexcept { return empty() ? 0 : last_column - first_column + 1; }
+};
+
 void json_rendering(
     ucs4_carray_view title, Screen const & screen,
     ColorTableView palette, RenderingBuffer buffer,
-    std::string_view extra_data = {}
+    std::string_view extra_data = {},
+    ParallelRendering parallel = {}
 );
 
 void ansi_rendering(
     ucs4_carray_view title, Screen const & screen,
     ColorTableView palette, RenderingBuffer buffer,
-    std::string_view extra_data = {}
+    std::string_view extra_data = {},
+    ParallelRendering parallel = {}
+);
+
+/// Characters only, a line of screen by line of text.
+void text_rendering(
+    Screen const & screen, RenderingBuffer buffer,
+    std::string_view extra_data = {},
+    ParallelRendering parallel = {}
+);
+
+/// Same as \c json_rendering(), but limited to \p region.
+/// \c lines, \c columns and the cursor position are relative to \p region
+/// and the cursor is hidden when it is outside.
+void json_rendering(
+    ucs4_carray_view title, Screen const & screen, ScreenRegion region,
+    ColorTableView palette, RenderingBuffer buffer,
+    std::string_view extra_data = {},
+    ParallelRendering parallel = {}
+);
+
+/// Same as \c ansi_rendering(), but limited to \p region.
+void ansi_rendering(
+    ucs4_carray_view title, Screen const & screen, ScreenRegion region,
+    ColorTableView palette, RenderingBuffer buffer,
+    std::string_view extra_data = {},
+    ParallelRendering parallel = {}
+);
+
+/// Same as \c text_rendering(), but limited to \p region.
+void text_rendering(
+    Screen const & screen, ScreenRegion region, RenderingBuffer buffer,
+    std::string_view extra_data = {},
+    ParallelRendering parallel = {}
+);
+
+enum class MinimapGlyph : uint8_t
+{
+    /// glyph of " .:-=+*#%@" proportional to the number of non-blank cells
+    density,
+    /// most frequent non-blank character (a space when the block is blank)
+    dominant,
+};
+
+/// Reduction of a screen where each output cell summarizes a block of cells.
+/// The minimap has ceil(lines / block_lines) lines and ceil(columns / block_columns) columns.
+struct Minimap
+{
+    int block_lines = 2;
+    int block_columns = 4;
+    MinimapGlyph glyph = MinimapGlyph::density;
+
+    int lines(Screen const & screen) const noexcept;
+    int columns(Screen const & screen) const noexcept;
+};
+
+// format = "{
+//      lines: %d,
+//      columns: %d,
+//      data: [ {s: %s, f: [$color...], b: [$color...]}... ]
+// }"
+// s: a glyph by output cell
+// f: average foreground color of non-blank cells (default foreground for blank block)
+// b: average background color
+// $color = decimal rgb
+void minimap_json_rendering(
+    Screen const & screen, ColorTableView palette,
+    RenderingBuffer buffer, Minimap minimap = {}
+);
+
+/// 3 bytes (red, green, blue) by output cell, line after line.
+/// A blank cell counts for its background color, the others for the mean
+/// of their foreground and background colors.
+void minimap_rgb_rendering(
+    Screen const & screen, ColorTableView palette,
+    RenderingBuffer buffer, Minimap minimap = {}
 );
 
 struct TranscriptPartialBuffer
@@ -68,4 +177,24 @@ TranscriptPartialBuffer transcript_partial_rendering(
     RenderingBuffer buffer, std::size_t consumed_buffer
 );
 
+/// Number of lines written by \c transcript_partial_rendering().
+std::size_t transcript_line_count(Screen const & screen, size_t y, size_t yend);
+
+struct TranscriptJsonlContext
+{
+    uint64_t time_us;
+    /// identifier of the next wrapped line, incremented for each rendered line
+    uint64_t group;
+    bool alternate_screen;
+};
+
+// format: one object by screen line
+// {"t":$time_us,"y":$row,"g":$group,"a":$alternate_screen,"s":"$text"}\n
+// lines of a same wrapped line have the same group.
+TranscriptPartialBuffer transcript_jsonl_partial_rendering(
+    Screen const & screen, size_t y, size_t yend,
+    TranscriptJsonlContext & ctx,
+    RenderingBuffer buffer, std::size_t consumed_buffer
+);
+
 }
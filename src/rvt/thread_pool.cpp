@@ -0,0 +1,208 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#include "rvt/thread_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+
+namespace rvt
+{
+
+namespace
+{
+    // pool running a task in the current thread, used to detect a job submitted by a task
+    thread_local ThreadPool const * current_pool = nullptr;
+}
+
+ThreadPool::ThreadPool(unsigned nb_thread)
+{
+    if (nb_thread == 0) {
+        nb_thread = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _queues = std::make_unique<TaskQueue[]>(nb_thread);
+
+    _workers.reserve(nb_thread - 1u);
+    try {
+        for (unsigned i = 1; i < nb_thread; ++i) {
+            _workers.emplace_back([this, i]{ this->worker_loop(i); });
+        }
+    }
+    catch (...) {
+        this->stop_workers();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    this->stop_workers();
+}
+
+void ThreadPool::stop_workers() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _job_cv.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+    _workers.clear();
+}
+
+void ThreadPool::run(std::size_t n, TaskFn * fn, void * ctx)
+{
+    if (n == 0) {
+        return;
+    }
+
+    if (n == 1 || _workers.empty() || current_pool == this) {
+        for (std::size_t i = 0; i < n; ++i) {
+            fn(ctx, i, 0);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit_lock(_submit_mutex);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _job = Job{fn, ctx, n};
+
+        std::size_t const nb_thread = this->size();
+        for (std::size_t k = 0; k < nb_thread; ++k) {
+            auto& queue = _queues[k];
+            std::lock_guard<std::mutex> queue_lock(queue.mutex);
+            queue.first = k;
+            queue.begin = 0;
+            queue.end = (k < n) ? (n - k + nb_thread - 1) / nb_thread : 0;
+        }
+
+        _cancelled.store(false, std::memory_order_relaxed);
+        _active_workers = _workers.size();
+        _exception = nullptr;
+        ++_generation;
+    }
+    _job_cv.notify_all();
+
+    // a job submitted by a task of the calling thread is executed serially
+    ThreadPool const * previous_pool = std::exchange(current_pool, this);
+    this->execute_tasks(0);
+    current_pool = previous_pool;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cv.wait(lock, [this]{ return _active_workers == 0; });
+
+    if (_exception) {
+        std::rethrow_exception(std::exchange(_exception, nullptr));
+    }
+}
+
+void ThreadPool::worker_loop(unsigned thread_index)
+{
+    current_pool = this;
+
+    std::size_t generation = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _job_cv.wait(lock, [&]{ return _stop || _generation != generation; });
+            if (_stop) {
+                return;
+            }
+            generation = _generation;
+        }
+
+        this->execute_tasks(thread_index);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_active_workers == 0) {
+            _done_cv.notify_one();
+        }
+    }
+}
+
+void ThreadPool::execute_tasks(unsigned thread_index)
+{
+    std::size_t i;
+    while (!_cancelled.load(std::memory_order_relaxed) && this->pop_task(thread_index, i)) {
+        try {
+            _job.fn(_job.ctx, i, thread_index);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_exception) {
+                _exception = std::current_exception();
+            }
+            _cancelled.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool ThreadPool::pop_task(unsigned thread_index, std::size_t & i)
+{
+    auto& queue = _queues[thread_index];
+    do {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.begin != queue.end) {
+            i = queue.first + queue.begin * this->size();
+            ++queue.begin;
+            return true;
+        }
+    } while (this->steal_tasks(thread_index));
+    return false;
+}
+
+bool ThreadPool::steal_tasks(unsigned thread_index)
+{
+    unsigned const nb_thread = this->size();
+    for (unsigned k = 1; k < nb_thread; ++k) {
+        auto& victim = _queues[(thread_index + k) % nb_thread];
+
+        std::size_t first;
+        std::size_t begin;
+        std::size_t end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            std::size_t const count = victim.end - victim.begin;
+            if (!count) {
+                continue;
+            }
+            first = victim.first;
+            end = victim.end;
+            begin = end - (count + 1) / 2;
+            victim.end = begin;
+        }
+
+        auto& queue = _queues[thread_index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.first = first;
+        queue.begin = begin;
+        queue.end = end;
+        return true;
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,137 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <cstddef>
+
+
+namespace rvt
+{
+
+/**
+ * A fixed set of worker threads for splitting a job into independent tasks.
+ *
+ * The thread which submits a job also executes tasks. Only one job runs at
+ * a time: concurrent submitters are serialized and a job submitted from
+ * a task of the same pool is executed by the calling thread.
+ *
+ * Tasks are distributed in a round robin to the threads (thread \c k starts
+ * with the task \c k), a thread without task steals the second half
+ * of the remaining tasks of another thread.
+ */
+class ThreadPool
+{
+public:
+    /// \param nb_thread  number of threads taking part in a job (caller included),
+    ///                   0 for \c std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned nb_thread = 0);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    /// Number of threads taking part in a job, caller included.
+    unsigned size() const noexcept
+    {
+        return static_cast<unsigned>(_workers.size() + 1u);
+    }
+
+    /**
+     * Call \c f(i) for each \c i in [0, \p n) and wait for completion.
+     * When a task throws, remaining tasks are cancelled and the first
+     * exception is rethrown in the calling thread.
+     */
+    template<class F>
+    void parallel_for(std::size_t n, F&& f)
+    {
+        using Fn = std::remove_reference_t<F>;
+        this->run(n, [](void * ctx, std::size_t i, unsigned /*thread_index*/) {
+            (*static_cast<Fn*>(ctx))(i);
+        }, &f);
+    }
+
+    /**
+     * Same as \c parallel_for() with \c f(thread_index,i).
+     * \c thread_index is in [0, \c size()) and distinct for the tasks running
+     * at the same time, it can be used for reusing per thread resources.
+     */
+    template<class F>
+    void parallel_for_thread(std::size_t n, F&& f)
+    {
+        using Fn = std::remove_reference_t<F>;
+        this->run(n, [](void * ctx, std::size_t i, unsigned thread_index) {
+            (*static_cast<Fn*>(ctx))(thread_index, i);
+        }, &f);
+    }
+
+private:
+    using TaskFn = void(void * ctx, std::size_t i, unsigned thread_index);
+
+    void run(std::size_t n, TaskFn * fn, void * ctx);
+    void worker_loop(unsigned thread_index);
+    void execute_tasks(unsigned thread_index);
+    bool pop_task(unsigned thread_index, std::size_t & i);
+    bool steal_tasks(unsigned thread_index);
+    void stop_workers() noexcept;
+
+    /// Tasks of a thread: \c first + \c j * \c size() for \c j in [\c begin, \c end)
+    struct alignas(64) TaskQueue
+    {
+        std::mutex mutex;
+        std::size_t first = 0;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    struct Job
+    {
+        TaskFn * fn = nullptr;
+        void * ctx = nullptr;
+        std::size_t n = 0;
+    };
+
+    std::vector<std::thread> _workers;
+
+    std::mutex _submit_mutex;
+
+    std::mutex _mutex;
+    std::condition_variable _job_cv;
+    std::condition_variable _done_cv;
+    Job _job;
+    std::size_t _generation = 0;
+    std::size_t _active_workers = 0;
+    std::exception_ptr _exception;
+    bool _stop = false;
+
+    std::unique_ptr<TaskQueue[]> _queues;
+    std::atomic<bool> _cancelled {false};
+};
+
+}
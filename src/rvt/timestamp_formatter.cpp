@@ -0,0 +1,146 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#include "rvt/timestamp_formatter.hpp"
+
+#include <cstring>
+
+
+namespace rvt
+{
+
+namespace
+{
+    char* write_digits(char* p, unsigned value, int n) noexcept
+    {
+        for (int i = n - 1; i >= 0; --i) {
+            p[i] = char('0' + value % 10);
+            value /= 10;
+        }
+        return p + n;
+    }
+}
+
+TimestampFormatter::TimestampFormatter(TimestampFormat format, bool utc) noexcept
+: _format(format)
+, _utc(utc)
+{}
+
+void TimestampFormatter::update_cache(time_t sec)
+{
+    char* p = _cache;
+
+    if (_format == TimestampFormat::Epoch) {
+        char digits[24];
+        char* digits_end = digits + sizeof(digits);
+        char* digits_start = digits_end;
+        auto n = static_cast<unsigned long long>(sec < 0 ? 0 : sec);
+        do {
+            *--digits_start = char('0' + n % 10);
+            n /= 10;
+        } while (n);
+        auto const len = static_cast<std::size_t>(digits_end - digits_start);
+        memcpy(p, digits_start, len);
+        p += len;
+        *p++ = '.';
+        _subsecond_pos = uint8_t(p - _cache);
+        p += 6;
+        *p++ = ' ';
+        _len = uint8_t(p - _cache);
+        return;
+    }
+
+    struct tm tm;
+    if (_utc) {
+        gmtime_r(&sec, &tm);
+    }
+    else {
+        localtime_r(&sec, &tm);
+    }
+
+    p = write_digits(p, unsigned(tm.tm_year + 1900), 4);
+    *p++ = '-';
+    p = write_digits(p, unsigned(tm.tm_mon + 1), 2);
+    *p++ = '-';
+    p = write_digits(p, unsigned(tm.tm_mday), 2);
+    *p++ = (_format == TimestampFormat::Datetime) ? ' ' : 'T';
+    p = write_digits(p, unsigned(tm.tm_hour), 2);
+    *p++ = ':';
+    p = write_digits(p, unsigned(tm.tm_min), 2);
+    *p++ = ':';
+    _second_pos = uint8_t(p - _cache);
+    p = write_digits(p, unsigned(tm.tm_sec), 2);
+
+    if (_format != TimestampFormat::Datetime) {
+        *p++ = '.';
+        _subsecond_pos = uint8_t(p - _cache);
+        p += (_format == TimestampFormat::Iso8601Ms) ? 3 : 6;
+
+        if (_utc) {
+            *p++ = 'Z';
+        }
+        else {
+            long offset = tm.tm_gmtoff / 60;
+            *p++ = (offset < 0) ? '-' : '+';
+            if (offset < 0) {
+                offset = -offset;
+            }
+            p = write_digits(p, unsigned(offset / 60), 2);
+            *p++ = ':';
+            p = write_digits(p, unsigned(offset % 60), 2);
+        }
+    }
+
+    *p++ = ' ';
+    _len = uint8_t(p - _cache);
+}
+
+std::size_t TimestampFormatter::format(time_t sec, uint32_t usec, char* out)
+{
+    if (!_has_cache || sec != _sec) {
+        // time zone offsets are a multiple of a minute
+        if (_has_cache && _format != TimestampFormat::Epoch && sec / 60 == _sec / 60) {
+            write_digits(_cache + _second_pos, unsigned(sec % 60), 2);
+        }
+        else {
+            update_cache(sec);
+            _has_cache = true;
+        }
+        _sec = sec;
+    }
+
+    memcpy(out, _cache, _len);
+
+    switch (_format) {
+        case TimestampFormat::Datetime:
+            break;
+        case TimestampFormat::Iso8601Ms:
+            write_digits(out + _subsecond_pos, usec / 1000 % 1000, 3);
+            break;
+        case TimestampFormat::Epoch:
+        case TimestampFormat::Iso8601Us:
+            write_digits(out + _subsecond_pos, usec % 1000000, 6);
+            break;
+    }
+
+    return _len;
+}
+
+}
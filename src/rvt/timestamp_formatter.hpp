@@ -0,0 +1,73 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+
+namespace rvt
+{
+
+enum class TimestampFormat : uint8_t
+{
+    /// "YYYY-MM-DD hh:mm:ss"
+    Datetime,
+    /// "ssssssssss.uuuuuu", seconds since epoch
+    Epoch,
+    /// "YYYY-MM-DDThh:mm:ss.mmm+hh:mm" ("Z" in UTC)
+    Iso8601Ms,
+    /// "YYYY-MM-DDThh:mm:ss.uuuuuu+hh:mm" ("Z" in UTC)
+    Iso8601Us,
+};
+
+/**
+ * Format a timestamp followed by a space.
+ *
+ * The formatted date is cached: while the minute does not change, only the
+ * digits of the seconds and the sub-second digits are written.
+ */
+class TimestampFormatter
+{
+public:
+    static constexpr std::size_t max_size = 34;
+
+    TimestampFormatter(TimestampFormat format, bool utc) noexcept;
+
+    /// Write the timestamp in \p out (at least \c max_size bytes).
+    /// \return  length of the timestamp
+    std::size_t format(time_t sec, uint32_t usec, char* out);
+
+private:
+    void update_cache(time_t sec);
+
+    TimestampFormat _format;
+    bool _utc;
+    uint8_t _len = 0;
+    uint8_t _second_pos = 0;
+    uint8_t _subsecond_pos = 0;
+    time_t _sec = 0;
+    bool _has_cache = false;
+    char _cache[max_size];
+};
+
+}
@@ -217,6 +217,19 @@ struct Utf8Decoder
         return f;
     }
 
+    /// Bytes of an incomplete character waiting for the next decode()
+    array_view<uint8_t const> pending_bytes() const noexcept
+    {
+        return {data_, std::size_t(data_len_)};
+    }
+
+    /// Replace the waiting bytes (at most 4), typically with the result of \c pending_bytes().
+    void set_pending_bytes(array_view<uint8_t const> bytes) noexcept
+    {
+        assert(bytes.size() <= sizeof(data_));
+        data_len_ = this->copy_to_data(bytes.begin(), bytes.end());
+    }
+
 private:
     template<class CheckedSize, class It, class F>
     static bool advance_and_decode(CheckedSize checked_size, It & it, It const & last, F & f)
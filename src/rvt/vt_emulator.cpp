@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <utility>
 
 #include "utils/sugar/array_view.hpp"
 #include "utils/sugar/underlying_cast.hpp"
@@ -33,6 +34,7 @@
 #include "rvt/char_class.hpp"
 #include "rvt/vt_emulator.hpp"
 #include "rvt/utf8_decoder.hpp"
+#include "rvt/state_stream.hpp"
 
 namespace rvt
 {
@@ -48,6 +50,104 @@ VtEmulator::VtEmulator(int lines, int columns, Screen::LineSaver lineSaver)
 
 VtEmulator::~VtEmulator() = default;
 
+void VtEmulator::copyState(VtEmulator const& other)
+{
+    if (this == &other) {
+        return;
+    }
+
+    Screen::LineSaver lineSaver0 = _screen0.getLineSaver();
+    Screen::LineSaver lineSaver1 = _screen1.getLineSaver();
+    ScreenSaver screenSaver = std::move(_screenSaver);
+    auto logFunction = std::move(_logFunction);
+    bool const changeTracking = !_screen0._changedLines.empty();
+    Screen::ChangeObserver * changeObserver0 = _screen0._changeObserver;
+    Screen::ChangeObserver * changeObserver1 = _screen1._changeObserver;
+
+    *this = other;
+
+    _currentScreen = other.isAlternateScreen() ? &_screen1 : &_screen0;
+    // the line commits of other are kept
+    _screen0.flushSavedLines();
+    _screen0._lineSaver = std::move(lineSaver0);
+    _screen1.flushSavedLines();
+    _screen1._lineSaver = std::move(lineSaver1);
+    _screen0.setChangeTracking(changeTracking, changeObserver0);
+    _screen1.setChangeTracking(changeTracking, changeObserver1);
+    _screenSaver = std::move(screenSaver);
+    _logFunction = std::move(logFunction);
+}
+
+void VtEmulator::setLineSaver(Screen::LineSaver lineSaver)
+{
+    if (!_screenSaver) {
+        _screen1.setLineSaver(lineSaver);
+    }
+    _screen0.setLineSaver(std::move(lineSaver));
+}
+
+void VtEmulator::setLineSaveMode(Screen::LineSaveMode mode)
+{
+    _screen0.setLineSaveMode(mode);
+    _screen1.setLineSaveMode(mode);
+}
+
+void VtEmulator::commitLines()
+{
+    _screen0.commitLines();
+    _screen1.commitLines();
+}
+
+void VtEmulator::setLineSaveBatching(bool enable)
+{
+    _screen0.setLineSaveBatching(enable);
+    _screen1.setLineSaveBatching(enable);
+}
+
+void VtEmulator::flushSavedLines()
+{
+    _currentScreen->flushSavedLines();
+}
+
+void VtEmulator::setChangeTracking(bool enable, Screen::ChangeObserver * observer)
+{
+    _screen0.setChangeTracking(enable, observer);
+    _screen1.setChangeTracking(enable, observer);
+}
+
+void VtEmulator::resetChangedLines()
+{
+    _screen0.resetChangedLines();
+    _screen1.resetChangedLines();
+}
+
+bool VtEmulator::readScreenLine(StateReader & reader, bool alternateScreen, int y)
+{
+    Screen& screen = alternateScreen ? _screen1 : _screen0;
+    if (y < 0 || y >= screen.getLines()) {
+        return false;
+    }
+    return screen.readLine(reader, y);
+}
+
+void VtEmulator::setAlternateScreenSaver(ScreenSaver screenSaver)
+{
+    _screen1.setLineSaver(screenSaver ? Screen::LineSaver() : _screen0.getLineSaver());
+    _screenSaver = std::move(screenSaver);
+    _alternateScreenHash = 0;
+}
+
+void VtEmulator::saveAlternateScreen()
+{
+    if (_screenSaver) {
+        uint64_t const hash = _screen1.hashLines(0, _screen1.getLines() - 1);
+        if (hash != _alternateScreenHash) {
+            _alternateScreenHash = hash;
+            _screenSaver(_screen1);
+        }
+    }
+}
+
 void VtEmulator::clearEntireScreen()
 {
     _currentScreen->clearEntireScreen();
@@ -384,9 +484,12 @@ constexpr inline CharsetId char_to_charset_id(char c)
 
 void VtEmulator::processToken(uint32_t token, int32_t p, int q)
 {
+  ucs4_char const previousGraphicChar = std::exchange(lastGraphicChar, 0);
+
   switch (token)
   {
-    case TY_CHR(         ) : _currentScreen->displayCharacter     (static_cast<ucs4_char>(p)); break; //UTF16
+    case TY_CHR(         ) : _currentScreen->displayCharacter     (static_cast<ucs4_char>(p));
+                             setLastGraphicChar(static_cast<ucs4_char>(p), previousGraphicChar); break; //UTF16
 
     //             127 DEL    : ignored on input
 
@@ -631,6 +734,7 @@ void VtEmulator::processToken(uint32_t token, int32_t p, int q)
     case TY_CSI_PN('T'      ) : _currentScreen->scrollDown           (p        ); break;
     case TY_CSI_PN('X'      ) : _currentScreen->eraseChars           (p        ); break;
     case TY_CSI_PN('Z'      ) : _currentScreen->backtab              (p        ); break;
+    case TY_CSI_PN('b'      ) : repeatCharacter                      (previousGraphicChar, p); break; //ECMA-48
     case TY_CSI_PN('d'      ) : _currentScreen->setCursorY           (p        ); break; //LINUX
     case TY_CSI_PN('f'      ) : _currentScreen->setCursorYX          (p,      q); break; //VT100
     case TY_CSI_PN('r'      ) : setMargins                           (p,      q); break; //VT100
@@ -799,6 +903,25 @@ void VtEmulator::processToken(uint32_t token, int32_t p, int q)
   }
 }
 
+void VtEmulator::setLastGraphicChar(ucs4_char c, ucs4_char previousGraphicChar)
+{
+    int const w = Screen::charWidth(c);
+    // a combining character is a part of the previous character
+    lastGraphicChar = (w > 0) ? c : (w == 0) ? previousGraphicChar : 0;
+}
+
+void VtEmulator::repeatCharacter(ucs4_char c, int n)
+{
+    if (!c) {
+        return;
+    }
+    n = std::max(n, 1);
+    for (int i = 0; i < n; ++i) {
+        _currentScreen->displayCharacter(c);
+    }
+    lastGraphicChar = c;
+}
+
 void VtEmulator::clearScreenAndSetColumns(int columnCount)
 {
     setScreenSize(_currentScreen->getLines(), columnCount);
@@ -895,6 +1018,11 @@ void VtEmulator::setDefaultMargins()
 
 void VtEmulator::setScreen(int n)
 {
+    // keep the order of the lines of both screens
+    _currentScreen->flushSavedLines();
+    if (!(n & 1) && _currentScreen == &_screen1) {
+        saveAlternateScreen();
+    }
     _currentScreen = (n & 1) ? &_screen1 : &_screen0;
 }
 
@@ -908,6 +1036,175 @@ void VtEmulator::setScreenSize(int lines, int columns)
     _screen1.resizeImage(lines, columns);
 }
 
+namespace
+{
+    void write_charsets(StateWriter & writer, CharCodes const& charsets)
+    {
+        for (CharsetId id : charsets.charset) {
+            writer.u8(underlying_cast(id));
+        }
+        writer.u8(underlying_cast(charsets.charset_id));
+        writer.u8(underlying_cast(charsets.sa_charset_id));
+    }
+
+    CharsetId read_charset_id(StateReader & reader)
+    {
+        uint8_t const id = reader.u8();
+        if (id > underlying_cast(CharsetId::MAX_)) {
+            reader.fail();
+            return CharsetId::Undefined;
+        }
+        return CharsetId(id);
+    }
+
+    CharCodes read_charsets(StateReader & reader)
+    {
+        CharCodes charsets;
+        for (CharsetId& id : charsets.charset) {
+            id = read_charset_id(reader);
+        }
+        charsets.charset_id = read_charset_id(reader);
+        charsets.sa_charset_id = read_charset_id(reader);
+        return charsets;
+    }
+}
+
+void VtEmulator::writeState(StateWriter & writer) const
+{
+    writeStateImpl(writer, true);
+}
+
+void VtEmulator::writeTerminalState(StateWriter & writer) const
+{
+    writeStateImpl(writer, false);
+}
+
+void VtEmulator::writeStateImpl(StateWriter & writer, bool withImages) const
+{
+    writer.uvar(unsigned(argc));
+    for (int arg : argv) {
+        writer.uvar(unsigned(arg));
+    }
+
+    writer.uvar(unsigned(tokenBufferPos));
+    for (int i = 0; i <= tokenBufferPos; ++i) {
+        writer.uvar(tokenBuffer[i]);
+    }
+
+    writer.uvar(windowTitleLen);
+    for (ucs4_char uc : getWindowTitle()) {
+        writer.uvar(uc);
+    }
+    writer.uvar(lastGraphicChar);
+
+    write_charsets(writer, _charsets[0]);
+    write_charsets(writer, _charsets[1]);
+
+    writer.uvar(_currentModes.value());
+    writer.uvar(_savedModes.value());
+
+    writer.u8(isAlternateScreen());
+    writer.u64(_alternateScreenHash);
+
+    for (Screen const* screen : {&_screen0, &_screen1}) {
+        if (withImages) {
+            screen->writeState(writer);
+        }
+        else {
+            screen->writeCursorState(writer);
+        }
+    }
+}
+
+bool VtEmulator::readState(StateReader & reader)
+{
+    return readStateImpl(reader, true);
+}
+
+bool VtEmulator::readTerminalState(StateReader & reader)
+{
+    return readStateImpl(reader, false);
+}
+
+bool VtEmulator::readStateImpl(StateReader & reader, bool withImages)
+{
+    auto read_ucs = [&]{ return ucs4_char(reader.size(UINT32_MAX)); };
+
+    int const newArgc = int(reader.size(MAXARGS - 1));
+    int newArgv[MAXARGS];
+    for (int& arg : newArgv) {
+        arg = int(reader.size(MAX_ARGUMENT));
+    }
+
+    int const newTokenBufferPos = int(reader.size(MAX_TOKEN_LENGTH - 1));
+    ucs4_char newTokenBuffer[MAX_TOKEN_LENGTH] {};
+    for (int i = 0; i <= newTokenBufferPos; ++i) {
+        newTokenBuffer[i] = read_ucs();
+    }
+
+    unsigned const newWindowTitleLen = unsigned(reader.size(MAX_TOKEN_LENGTH - 1));
+    ucs4_char newWindowTitle[MAX_TOKEN_LENGTH];
+    for (unsigned i = 0; i < newWindowTitleLen; ++i) {
+        newWindowTitle[i] = read_ucs();
+    }
+    ucs4_char const newLastGraphicChar = read_ucs();
+
+    CharCodes const charsets0 = read_charsets(reader);
+    CharCodes const charsets1 = read_charsets(reader);
+
+    constexpr uint64_t modeMask = (1u << (AllowColumns132 + 1)) - 1u;
+    uint64_t const currentModes = reader.uvar();
+    uint64_t const savedModes = reader.uvar();
+
+    uint8_t const alternateScreen = reader.u8();
+    uint64_t const alternateScreenHash = reader.u64();
+
+    int const lines = _screen0.getLines();
+    int const columns = _screen0.getColumns();
+
+    auto read_screen = [&](Screen& screen){
+        return withImages ? screen.readState(reader) : screen.readCursorState(reader);
+    };
+
+    if (reader.failed()
+     || ((currentModes | savedModes) & ~modeMask)
+     || alternateScreen > 1
+     || (newLastGraphicChar && Screen::charWidth(newLastGraphicChar) <= 0)
+     || !read_screen(_screen0)
+     || !read_screen(_screen1)
+     || _screen0.getLines() != _screen1.getLines()
+     || _screen0.getColumns() != _screen1.getColumns()
+    ) {
+        // invalid state: reset the emulator and keep the configuration of the screens
+        auto const lineSaveMode0 = _screen0._lineSaveMode;
+        auto const lineSaveMode1 = _screen1._lineSaveMode;
+        bool const lineSaveBatching0 = _screen0._lineSaveBatching;
+        bool const lineSaveBatching1 = _screen1._lineSaveBatching;
+        copyState(VtEmulator(lines, columns));
+        _screen0._lineSaveMode = lineSaveMode0;
+        _screen1._lineSaveMode = lineSaveMode1;
+        _screen0._lineSaveBatching = lineSaveBatching0;
+        _screen1._lineSaveBatching = lineSaveBatching1;
+        return false;
+    }
+
+    argc = newArgc;
+    std::copy(std::begin(newArgv), std::end(newArgv), argv);
+    tokenBufferPos = newTokenBufferPos;
+    std::copy(std::begin(newTokenBuffer), std::end(newTokenBuffer), tokenBuffer);
+    windowTitleLen = newWindowTitleLen;
+    std::copy(newWindowTitle, newWindowTitle + newWindowTitleLen, windowTitle);
+    windowTitle[windowTitleLen] = 0;
+    lastGraphicChar = newLastGraphicChar;
+    _charsets[0] = charsets0;
+    _charsets[1] = charsets1;
+    _currentModes = ModeFlags(uint16_t(currentModes));
+    _savedModes = ModeFlags(uint16_t(savedModes));
+    _currentScreen = alternateScreen ? &_screen1 : &_screen0;
+    _alternateScreenHash = alternateScreenHash;
+    return true;
+}
+
 void VtEmulator::setMargins(int t, int b)
 {
     _currentScreen->setMargins(t, b);
@@ -20,6 +20,8 @@
 *   Based on Konsole, an X terminal
 */
 
+#pragma once
+
 #include <array>
 #include <functional> // std::function
 
@@ -78,6 +80,53 @@ public:
     void receiveChar(ucs4_char cc);
     void setScreenSize(int lines, int columns);
 
+    VtEmulator(VtEmulator const&) = delete;
+
+    /// Copy the state of \p other (screens, charsets, modes, partial escape sequence, etc).
+    /// Line savers and log function are not copied.
+    void copyState(VtEmulator const& other);
+
+    void setLineSaver(Screen::LineSaver lineSaver);
+    void setLineSaveMode(Screen::LineSaveMode mode);
+    /// Save the lines waiting with \c Screen::LineSaveMode::Commit (typically at end of stream).
+    void commitLines();
+    /// \see Screen::setLineSaveBatching()
+    void setLineSaveBatching(bool enable);
+    /// Send the lines waiting with \c setLineSaveBatching() (typically at the end of a feed).
+    void flushSavedLines();
+
+    /// Write the state of the emulator (screens, charsets, modes, partial escape sequence, etc).
+    /// Line savers and log function are not written.
+    void writeState(StateWriter & writer) const;
+    /// Restore a state written by writeState(), the storage of the screens is reused.
+    /// With an invalid state, the emulator is reset to its previous size and false is returned.
+    bool readState(StateReader & reader);
+
+    /// Same as writeState() without the lines of the screens.
+    void writeTerminalState(StateWriter & writer) const;
+    /// Restore a state written by writeTerminalState() with the same screen size.
+    /// With an invalid state, the emulator is reset and false is returned.
+    bool readTerminalState(StateReader & reader);
+
+    /// Restore a line written by \c Screen::writeLine().
+    bool readScreenLine(StateReader & reader, bool alternateScreen, int y);
+
+    /// \see Screen::setChangeTracking()
+    void setChangeTracking(bool enable, Screen::ChangeObserver * observer = nullptr);
+    /// \see Screen::resetChangedLines()
+    void resetChangedLines();
+
+    using ScreenSaver = std::function<void(Screen const&)>;
+
+    /// Replace the line saver of the alternate screen with a snapshot of the
+    /// whole screen when the alternate screen is left or with saveAlternateScreen().
+    /// \p screenSaver is not called when the screen did not change since the last snapshot.
+    void setAlternateScreenSaver(ScreenSaver screenSaver);
+    void saveAlternateScreen();
+
+    bool isAlternateScreen() const noexcept { return _currentScreen == &_screen1; }
+    bool isAlternateScreen(Screen const & screen) const noexcept { return &screen == &_screen1; }
+
 private:
     // reimplemented from Emulation
     void setMode(Mode mode);
@@ -122,25 +171,36 @@ private:
     void addToCurrentToken(ucs4_char cc);
     void processWindowAttributeRequest();
     static constexpr int MAX_TOKEN_LENGTH = 256; // Max length of tokens (e.g. window title)
-    ucs4_char tokenBuffer[MAX_TOKEN_LENGTH];
+    ucs4_char tokenBuffer[MAX_TOKEN_LENGTH] {};
     int tokenBufferPos;
     ucs4_char windowTitle[MAX_TOKEN_LENGTH];
     unsigned windowTitleLen = 0;
+    // character repeated by REP, 0 when the previous token is not a character
+    ucs4_char lastGraphicChar = 0;
 
     static constexpr int MAXARGS = 15;
     void addDigit(int dig);
     void addArgument();
-    int argv[MAXARGS];
+    int argv[MAXARGS] {};
     int argc;
 
     void reportDecodingError();
 
+    void writeStateImpl(StateWriter & writer, bool withImages) const;
+    bool readStateImpl(StateReader & reader, bool withImages);
+
     void processToken(uint32_t code, int32_t p, int q);
 
     // clears the screen and resizes it to the specified
     // number of columns
     void clearScreenAndSetColumns(int columnCount);
 
+    // character repeated by REP after c, only a character with a width
+    void setLastGraphicChar(ucs4_char c, ucs4_char previousGraphicChar);
+
+    // displays n times the character c (REP), ignored when c is 0
+    void repeatCharacter(ucs4_char c, int n);
+
     CharCodes _charsets[2];
 
     using ModeFlags = Flags<Mode>;
@@ -152,7 +212,13 @@ private:
     Screen _screen1;
     Screen * _currentScreen = &_screen1;
 
+    ScreenSaver _screenSaver;
+    uint64_t _alternateScreenHash = 0;
+
     std::function<void(char const *, std::size_t)> _logFunction;
+
+    // used by copyState()
+    VtEmulator& operator=(VtEmulator const&) = default;
 };
 
 }
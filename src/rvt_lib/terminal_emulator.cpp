@@ -25,13 +25,33 @@
 #include "rvt/vt_emulator.hpp"
 #include "rvt/utf8_decoder.hpp"
 #include "rvt/text_rendering.hpp"
-
+#include "rvt/image_rendering.hpp"
+#include "rvt/thread_pool.hpp"
+#include "rvt/timestamp_formatter.hpp"
+#include "rvt/keyword_matcher.hpp"
+#include "rvt/emulator_state.hpp"
+#include "rvt/frame_journal.hpp"
+#include "rvt/screen_tracker.hpp"
+#include "rvt/screen_diff_encoder.hpp"
+#include "rvt/state_stream.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
+#include <ctime>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -42,14 +62,191 @@
 extern "C"
 {
 
+struct TerminalEmulatorKeywordMatcher
+{
+    rvt::KeywordMatcher matcher;
+};
+
+struct TerminalEmulatorKeywordAlert
+{
+    TerminalEmulatorKeywordMatcher const * matcher;
+    TerminalEmulatorKeywordAlertFn * fn;
+    void * ctx;
+
+    /// \return first value of \c fn which is not 0
+    int search(rvt::Screen const& screen, size_t y, size_t yend, uint32_t sec, uint32_t usec) const
+    {
+        int errnum = 0;
+        matcher->matcher.searchLines(screen, y, yend, [&](std::size_t pattern_id, std::size_t row){
+            if (!errnum) {
+                errnum = fn(ctx, pattern_id, int(row), sec, usec);
+            }
+        });
+        return errnum;
+    }
+};
+
 struct TerminalEmulator
 {
     rvt::VtEmulator emulator;
     rvt::Utf8Decoder decoder;
+    rvt::ParallelRendering parallel_rendering;
+
+    /// Line saver of terminal_emulator_set_keyword_alert()
+    struct LiveKeywordAlert
+    {
+        TerminalEmulatorKeywordAlert alert {};
+        int errnum = 0;
+
+        void operator()(rvt::Screen const& screen, size_t y, size_t yend)
+        {
+            if (errnum) {
+                return;
+            }
+            timespec now {};
+            clock_gettime(CLOCK_REALTIME, &now);
+            errnum = alert.search(screen, y, yend, uint32_t(now.tv_sec), uint32_t(now.tv_nsec / 1000));
+        }
+    };
+    LiveKeywordAlert keyword_alert;
+
+    /// Reverse deltas of terminal_emulator_feed() for terminal_emulator_undo_frame()
+    std::unique_ptr<rvt::FrameJournal> journal;
 
     TerminalEmulator(int lines, int columns)
     : emulator(lines, columns)
     {}
+
+    /// The state is modified outside of a frame
+    void clear_journal() noexcept
+    {
+        if (journal) {
+            journal->clear();
+        }
+    }
+};
+
+struct TerminalEmulatorThreadPool
+{
+    rvt::ThreadPool pool;
+
+    TerminalEmulatorThreadPool(unsigned nb_thread)
+    : pool(nb_thread)
+    {}
+};
+
+struct TerminalEmulatorTranscriptOptions
+{
+    TerminalEmulatorTranscriptPrefix prefix_type = TerminalEmulatorTranscriptPrefix::noprefix;
+    TerminalEmulatorTranscriptLineMode line_mode = TerminalEmulatorTranscriptLineMode::cursor_move;
+    TerminalEmulatorTranscriptAlternateScreen alternate_screen = TerminalEmulatorTranscriptAlternateScreen::lines;
+    uint32_t snapshot_interval = 0;
+    TerminalEmulatorTranscriptFormat format = TerminalEmulatorTranscriptFormat::text;
+};
+
+struct TerminalEmulatorReplay
+{
+    struct TranscriptSink
+    {
+        TerminalEmulatorBuffer * buffer;
+        TerminalEmulatorTranscriptOptions options;
+    };
+
+    struct SnapshotSink
+    {
+        TerminalEmulatorBuffer * buffer;
+        TerminalEmulatorOutputFormat format;
+        uint32_t interval;
+    };
+
+    struct TimelineSink
+    {
+        TerminalEmulatorBuffer * buffer;
+        uint32_t interval;
+    };
+
+    struct FrameSink
+    {
+        TerminalEmulatorReplayFrameFn * fn;
+        void * ctx;
+    };
+
+    struct ScreenshotSink
+    {
+        TerminalEmulatorOutputFormat format;
+        /// sorted times in microseconds, empty with an interval
+        std::vector<uint64_t> times;
+        uint64_t interval;
+        TerminalEmulatorReplayScreenshotFn * fn;
+        void * ctx;
+    };
+
+    std::vector<TranscriptSink> transcripts;
+    std::vector<SnapshotSink> snapshots;
+    std::vector<ScreenshotSink> screenshots;
+    std::vector<TimelineSink> timelines;
+    std::vector<FrameSink> frames;
+    std::vector<TerminalEmulatorKeywordAlert> alerts;
+
+    // frames in [start_time, end_time)
+    uint32_t start_time = 0;
+    uint32_t end_time = ~uint32_t();
+
+    bool has_buffer(TerminalEmulatorBuffer const * buffer) const noexcept
+    {
+        for (auto const& sink : transcripts) {
+            if (sink.buffer == buffer) {
+                return true;
+            }
+        }
+        for (auto const& sink : snapshots) {
+            if (sink.buffer == buffer) {
+                return true;
+            }
+        }
+        for (auto const& sink : timelines) {
+            if (sink.buffer == buffer) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+struct TerminalEmulatorFrameIndex
+{
+    struct Frame
+    {
+        /// position of the header in the ttyrec
+        uint64_t offset;
+        uint32_t sec;
+        uint32_t usec;
+    };
+
+    struct Keyframe
+    {
+        /// state of the emulator before this frame
+        uint64_t frame;
+        std::size_t state_offset;
+        std::size_t state_len;
+    };
+
+    uint64_t ttyrec_size = 0;
+    std::vector<Frame> frames;
+    std::vector<Keyframe> keyframes;
+    /// serialized states of the keyframes (see \c rvt::write_emulator_state())
+    std::vector<uint8_t> states;
+};
+
+struct TerminalEmulatorMirror
+{
+    rvt::ScreenDiffEncoder encoder;
+    /// sequences of the next update
+    std::string sequences;
+
+    TerminalEmulatorMirror(int lines, int columns, bool use_repeat)
+    : encoder(lines, columns, use_repeat)
+    {}
 };
 
 struct TerminalEmulatorBuffer
@@ -177,6 +374,193 @@ struct TerminalEmulatorBufferWithVector : TerminalEmulatorBuffer
     }
 };
 
+struct TerminalEmulatorBufferWithStream : TerminalEmulatorBuffer
+{
+    /// Blocks are alternately filled by the rendering and written by a dedicated thread.
+    struct Data
+    {
+        Data(TerminalEmulatorBufferWriteFn * write_fn, void * write_ctx, std::size_t block_size) noexcept
+        : write_fn(write_fn)
+        , write_ctx(write_ctx)
+        , block_size(block_size)
+        {}
+
+        TerminalEmulatorBufferWriteFn * write_fn;
+        void * write_ctx;
+
+        std::unique_ptr<uint8_t[]> blocks[2];
+        std::size_t capacities[2] {};
+        std::size_t block_size;
+        int current = 0;
+
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable cv;
+        uint8_t const * pending = nullptr;
+        std::size_t pending_len = 0;
+        int write_error = 0;
+        bool stop = false;
+
+        uint8_t* data() const noexcept
+        {
+            return blocks[current].get();
+        }
+
+        std::size_t count_before(uint8_t* p) const
+        {
+            return static_cast<std::size_t>(p - data());
+        }
+
+        void throw_if_error()
+        {
+            if (REDEMPTION_UNLIKELY(write_error)) {
+                errno = std::exchange(write_error, 0);
+                throw std::system_error(errno, std::generic_category());
+            }
+        }
+
+        void wait_writer(std::unique_lock<std::mutex> & lock)
+        {
+            cv.wait(lock, [this]{ return !pending; });
+        }
+
+        /// Send [data(), data() + len) to writer and switch to the other block.
+        void submit(std::size_t len)
+        {
+            if (!writer.joinable()) {
+                writer = std::thread([this]{ this->write_loop(); });
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            wait_writer(lock);
+            throw_if_error();
+            pending = data();
+            pending_len = len;
+            current = 1 - current;
+            lock.unlock();
+            cv.notify_all();
+        }
+
+        void flush(std::size_t len)
+        {
+            if (len) {
+                submit(len);
+            }
+            stop_writer();
+            throw_if_error();
+        }
+
+        void stop_writer() noexcept
+        {
+            if (writer.joinable()) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wait_writer(lock);
+                    stop = true;
+                }
+                cv.notify_all();
+                writer.join();
+                stop = false;
+            }
+        }
+
+        void write_loop()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                cv.wait(lock, [this]{ return stop || pending; });
+                if (!pending) {
+                    return;
+                }
+
+                lock.unlock();
+                int errnum = write_fn(write_ctx, pending, pending_len);
+                lock.lock();
+
+                if (errnum && !write_error) {
+                    write_error = errnum;
+                }
+                pending = nullptr;
+                cv.notify_all();
+            }
+        }
+    };
+
+    Data d;
+
+    TerminalEmulatorBufferWithStream(
+        void * write_ctx, TerminalEmulatorBufferWriteFn * write_fn, std::size_t block_size
+    ) noexcept
+    : TerminalEmulatorBuffer{
+        &d,
+        // get buffer
+        [](void* ctx, std::size_t * output_len) noexcept {
+            auto& d = *static_cast<Data*>(ctx);
+            *output_len = 0;
+            return d.data();
+        },
+        // alloc extra memory
+        [](void* ctx, std::size_t* extra_capacity_in_out, uint8_t* p, std::size_t used_size) -> uint8_t* {
+            assert(extra_capacity_in_out);
+
+            auto& d = *static_cast<Data*>(ctx);
+
+            std::size_t const extra_capacity = *extra_capacity_in_out;
+            std::size_t current_len = d.count_before(p) + used_size;
+            assert(current_len <= d.capacities[d.current]);
+
+            if (d.capacities[d.current] - current_len < extra_capacity) {
+                if (current_len) {
+                    d.submit(current_len);
+                    current_len = 0;
+                }
+
+                // a single rendering larger than a block
+                if (d.capacities[d.current] < extra_capacity) {
+                    auto* new_buffer = new(std::nothrow) uint8_t[extra_capacity];
+                    if (!new_buffer) {
+                        return nullptr;
+                    }
+                    d.blocks[d.current].reset(new_buffer);
+                    d.capacities[d.current] = extra_capacity;
+                }
+            }
+
+            *extra_capacity_in_out = d.capacities[d.current] - current_len;
+            return d.data() + current_len;
+        },
+        // set final buffer
+        [](void* ctx, uint8_t* p, std::size_t used_size) {
+            auto& d = *static_cast<Data*>(ctx);
+            d.flush(d.count_before(p) + used_size);
+        },
+        // clear
+        [](void* /*ctx*/) noexcept {},
+        // delete
+        [](void* /*ctx*/) noexcept {},
+        // delete self
+        [](TerminalEmulatorBuffer* self) noexcept {
+            auto* stream = static_cast<TerminalEmulatorBufferWithStream*>(self);
+            stream->d.stop_writer();
+            delete stream;
+        }
+    }
+    , d(write_fn, write_ctx, block_size)
+    {}
+
+    bool init_blocks()
+    {
+        for (int i = 0; i < 2; ++i) {
+            d.blocks[i].reset(new(std::nothrow) uint8_t[d.block_size]);
+            if (!d.blocks[i]) {
+                return false;
+            }
+            d.capacities[i] = d.block_size;
+        }
+        return true;
+    }
+};
+
 } // extern "C"
 
 static int errno_or_single_error() noexcept
@@ -185,25 +569,69 @@ static int errno_or_single_error() noexcept
     return errnum ? errnum : -1;
 }
 
+static int write_all(int fd, uint8_t const * data, std::size_t len) noexcept
+{
+    while (len) {
+        ssize_t const n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno_or_single_error();
+        }
+        data += n;
+        len -= static_cast<std::size_t>(n);
+    }
+    return 0;
+}
+
+/// Replace the content of \p buffer with \p data.
+static void set_buffer_data(TerminalEmulatorBuffer & buffer, uint8_t const * data, std::size_t len)
+{
+    auto rendering_buffer = buffer.as_rendering_buffer();
+    uint8_t* p = bytes_t(rendering_buffer.buffer).to_u8p();
+    if (rendering_buffer.length < len) {
+        std::size_t capacity = len;
+        p = rendering_buffer.allocate(rendering_buffer.ctx, &capacity, p, 0);
+        if (REDEMPTION_UNLIKELY(not p)) {
+            throw std::bad_alloc();
+        }
+    }
+    if (len) {
+        memcpy(p, data, len);
+    }
+    rendering_buffer.set_final_buffer(rendering_buffer.ctx, p, len);
+}
+
 static int build_format_string(
-    TerminalEmulatorBuffer & buffer, TerminalEmulator & emu,
-    TerminalEmulatorOutputFormat format, std::string_view extra_data
+    rvt::RenderingBuffer rendering_buffer, TerminalEmulator const & emu,
+    TerminalEmulatorOutputFormat format, rvt::ScreenRegion region,
+    std::string_view extra_data
 ) noexcept
 {
-    rvt::RenderingBuffer rendering_buffer = buffer.as_rendering_buffer();
     try {
         #define call_rendering(Format)                 \
             case TerminalEmulatorOutputFormat::Format: \
                 rvt::Format##_rendering(               \
                     emu.emulator.getWindowTitle(),     \
                     emu.emulator.getCurrentScreen(),   \
+                    region,                            \
                     rvt::xterm_color_table,            \
                     rendering_buffer,                  \
-                    extra_data                         \
+                    extra_data,                        \
+                    emu.parallel_rendering             \
                 ); return 0
         switch (format) {
             call_rendering(json);
             call_rendering(ansi);
+            case TerminalEmulatorOutputFormat::text:
+                rvt::text_rendering(
+                    emu.emulator.getCurrentScreen(),
+                    region,
+                    rendering_buffer,
+                    extra_data,
+                    emu.parallel_rendering
+                ); return 0;
         }
         #undef call_rendering
         return -2;
@@ -213,372 +641,2779 @@ static int build_format_string(
     }
 }
 
-extern "C"
-{
-
-REDEMPTION_LIB_EXPORT
-char const * terminal_emulator_version() noexcept
+static int build_format_string(
+    rvt::RenderingBuffer rendering_buffer, TerminalEmulator const & emu,
+    TerminalEmulatorOutputFormat format, std::string_view extra_data
+) noexcept
 {
-    return RVT_LIB_VERSION;
+    auto region = rvt::ScreenRegion::from_screen(emu.emulator.getCurrentScreen());
+    return build_format_string(rendering_buffer, emu, format, region, extra_data);
 }
 
-#define return_nullptr_if(x) do { if (REDEMPTION_UNLIKELY(x)) { return nullptr; } } while (0)
-#define return_if(x) do { if (REDEMPTION_UNLIKELY(x)) { return -2; } } while (0)
-#define Panic(expr, err) do { try { expr; } \
-    catch (...) { return err; } } while (0)
-#define Panic_errno(expr) do { try { expr; } \
-    catch (std::bad_alloc const&) { return -3; } \
-    catch (...) { return errno_or_single_error(); } } while (0)
-
-REDEMPTION_LIB_EXPORT
-TerminalEmulator * terminal_emulator_new(int lines, int columns) noexcept
+static int build_format_string(
+    TerminalEmulatorBuffer & buffer, TerminalEmulator const & emu,
+    TerminalEmulatorOutputFormat format, std::string_view extra_data
+) noexcept
 {
-    return_nullptr_if(lines <= 0 || columns <= 0);
-    Panic(return new(std::nothrow) TerminalEmulator(lines, columns), nullptr);
+    return build_format_string(buffer.as_rendering_buffer(), emu, format, extra_data);
 }
 
-REDEMPTION_LIB_EXPORT
-int terminal_emulator_delete(TerminalEmulator * emu) noexcept
+namespace
 {
-    delete emu;
-    return 0;
-}
+    uint32_t read_tty_u32(uint8_t const* p) noexcept
+    {
+        return p[0] | uint32_t(p[1] << 8) | uint32_t(p[2] << 16) | uint32_t(p[3] << 24);
+    }
 
-REDEMPTION_LIB_EXPORT
-int terminal_emulator_finish(TerminalEmulator * emu) noexcept
-{
-    return_if(!emu);
+    struct FileCloser
+    {
+        ~FileCloser()
+        {
+            close(fd);
+        }
 
-    auto send_fn = [emu](rvt::ucs4_char ucs) { emu->emulator.receiveChar(ucs); };
-    Panic_errno(emu->decoder.end_decode(send_fn));
-    return 0;
-}
+        int fd;
+    };
 
+    /// Read only memory mapping of a file
+    struct MappedFile
+    {
+        uint8_t const * data = nullptr;
+        std::size_t len = 0;
 
-REDEMPTION_LIB_EXPORT
-int terminal_emulator_set_title(TerminalEmulator * emu, char const * title) noexcept
-{
-    return_if(!emu);
+        MappedFile() = default;
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
 
-    rvt::ucs4_char ucs_title[255];
-    rvt::ucs4_char * p = std::begin(ucs_title);
-    rvt::ucs4_char * e = std::end(ucs_title) - 4;
+        ~MappedFile()
+        {
+            if (len) {
+                munmap(const_cast<uint8_t*>(data), len);
+            }
+        }
 
-    std::size_t sz = strlen(title);
+        /// \return 0 or an errno code
+        int open(char const * infile) noexcept
+        {
+            int fd_in { ::open(infile, O_RDONLY) };
+            if (fd_in == -1) {
+                return errno_or_single_error();
+            }
 
-    auto send_fn = [&p](rvt::ucs4_char ucs) { *p = ucs; ++p; };
-    while (sz && p < e) {
-        std::size_t const consumed = std::min(sz, std::size_t(e-p));
-        emu->decoder.decode(const_bytes_array(title, consumed), send_fn);
-        sz -= consumed;
-        title += consumed;
-    }
-    emu->decoder.end_decode(send_fn);
+            FileCloser _file_closer{fd_in};
 
-    emu->emulator.setWindowTitle({ucs_title, std::size_t(p-ucs_title)});
-    return 0;
-}
+            struct stat s;
+            int status = fstat(fd_in, & s);
+            if (status == -1) {
+                return errno_or_single_error();
+            }
 
-REDEMPTION_LIB_EXPORT
-int terminal_emulator_set_log_function(
-    TerminalEmulator * emu, TerminalEmulatorLogFunction * log_func
-) noexcept
-{
+            auto data_len = static_cast<std::size_t>(s.st_size);
+
+            if (data_len == 0) {
+                return 0;
+            }
+
+            auto* p = mmap(nullptr, data_len, PROT_READ, MAP_PRIVATE, fd_in, 0);
+            if (p == MAP_FAILED) {
+                return errno_or_single_error();
+            }
+
+            // read in order by prepare_transcript_parallel()
+            madvise(p, data_len, MADV_SEQUENTIAL);
+
+            data = static_cast<uint8_t const*>(p);
+            len = data_len;
+            return 0;
+        }
+    };
+
+    /**
+     * Frames of a ttyrec read from a memory buffer or from a file descriptor.
+     *
+     * A file descriptor (file, pipe, etc) is read by aligned blocks in a buffer
+     * of bounded size: a frame is copied only when it overlaps two blocks and
+     * the buffer only grows for a frame larger than a block. The pages of
+     * a file are released once read.
+     */
+    class TtyrecReader
+    {
+    public:
+        static constexpr std::size_t block_size = 256 * 1024;
+        /// largest frame read from a pipe, the size of a file is checked instead
+        static constexpr std::size_t max_pipe_frame_size = 64 * 1024 * 1024;
+
+        TtyrecReader(uint8_t const * data, std::size_t len) noexcept
+        : _p(data)
+        , _end(data + len)
+        {}
+
+        /// \param fd  is not closed
+        explicit TtyrecReader(int fd) noexcept
+        : _fd(fd)
+        {
+            // fails with a pipe
+            _is_file = (0 == posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL));
+            if (_is_file) {
+                off_t const pos = lseek(fd, 0, SEEK_CUR);
+                _file_pos = _dropped_pos = (pos > 0) ? uint64_t(pos) : 0;
+            }
+        }
+
+        TtyrecReader(TtyrecReader const&) = delete;
+        TtyrecReader& operator=(TtyrecReader const&) = delete;
+
+        /// \return false at end of stream or with an error (see \c error())
+        bool next_header(uint32_t & sec, uint32_t & usec, uint32_t & len)
+        {
+            if (!fill(12)) {
+                if (!_errnum && _p != _end) {
+                    _errnum = -1;
+                }
+                return false;
+            }
+            sec  = read_tty_u32(_p);
+            usec = read_tty_u32(_p + 4);
+            len  = read_tty_u32(_p + 8);
+            _p += 12;
+            return true;
+        }
+
+        /// \return frame data or nullptr when truncated or with an error (see \c error())
+        uint8_t const * next_body(uint32_t len)
+        {
+            if (!fill(len)) {
+                if (!_errnum) {
+                    _errnum = -1;
+                }
+                return nullptr;
+            }
+            uint8_t const * data = _p;
+            _p += len;
+            return data;
+        }
+
+        /// \return 0, -1 for a truncated ttyrec or an errno code
+        int error() const noexcept
+        {
+            return _errnum;
+        }
+
+    private:
+        struct FreeDeleter
+        {
+            void operator()(uint8_t * p) const noexcept
+            {
+                std::free(p);
+            }
+        };
+
+        /// Make \p n bytes available from \c _p.
+        bool fill(std::size_t n)
+        {
+            std::size_t avail = std::size_t(_end - _p);
+            if (avail >= n) {
+                return true;
+            }
+            if (_fd == -1 || _eof || _errnum) {
+                return false;
+            }
+
+            constexpr std::size_t page_size = 4096;
+
+            // move the beginning of the frame at the start of the buffer
+            if (n > _capacity) {
+                // a corrupted header can claim a frame of several GiB
+                if (!can_read(n - avail)) {
+                    _errnum = -1;
+                    return false;
+                }
+                std::size_t const capacity = (std::max(n, block_size) + page_size - 1) / page_size * page_size;
+                auto* p = static_cast<uint8_t*>(std::aligned_alloc(page_size, capacity));
+                if (!p) {
+                    throw std::bad_alloc();
+                }
+                if (avail) {
+                    memcpy(p, _p, avail);
+                }
+                _buffer.reset(p);
+                _capacity = capacity;
+            }
+            else if (avail && _p != _buffer.get()) {
+                memmove(_buffer.get(), _p, avail);
+            }
+            _p = _buffer.get();
+            _end = _p + avail;
+
+            this->drop_pages(_file_pos - avail);
+
+            while (avail < n) {
+                // the file offset stays aligned on a page when possible
+                std::size_t len = _capacity - avail;
+                std::size_t const unaligned = (_file_pos + len) % page_size;
+                if (unaligned < len && len - unaligned >= n - avail) {
+                    len -= unaligned;
+                }
+
+                ssize_t const r = read(_fd, _buffer.get() + avail, len);
+                if (r < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    _errnum = errno_or_single_error();
+                    return false;
+                }
+                if (r == 0) {
+                    _eof = true;
+                    return false;
+                }
+                avail += std::size_t(r);
+                _end += r;
+                _file_pos += uint64_t(r);
+            }
+
+            return true;
+        }
+
+        /// \return false when the stream cannot contain \p n more bytes
+        bool can_read(std::size_t n) const noexcept
+        {
+            if (_is_file) {
+                struct stat st;
+                if (fstat(_fd, &st) == 0) {
+                    uint64_t const size = uint64_t(st.st_size);
+                    return size >= _file_pos && n <= size - _file_pos;
+                }
+            }
+            return n <= max_pipe_frame_size;
+        }
+
+        /// Release the pages of the file before \p pos
+        void drop_pages(uint64_t pos) noexcept
+        {
+            constexpr uint64_t drop_size = 8 * 1024 * 1024;
+            if (_is_file && pos - _dropped_pos >= drop_size) {
+                pos -= pos % drop_size;
+                posix_fadvise(_fd, off_t(_dropped_pos), off_t(pos - _dropped_pos), POSIX_FADV_DONTNEED);
+                _dropped_pos = pos;
+            }
+        }
+
+        uint8_t const * _p = nullptr;
+        uint8_t const * _end = nullptr;
+
+        int _fd = -1;
+        bool _is_file = false;
+        bool _eof = false;
+        int _errnum = 0;
+        std::unique_ptr<uint8_t, FreeDeleter> _buffer;
+        std::size_t _capacity = 0;
+        uint64_t _file_pos = 0;
+        uint64_t _dropped_pos = 0;
+    };
+
+    /// Buffered writing of ttyrec frames in a file descriptor.
+    class TtyrecWriter
+    {
+    public:
+        static constexpr std::size_t block_size = 256 * 1024;
+
+        /// \param fd  is not closed
+        explicit TtyrecWriter(int fd) noexcept
+        : _fd(fd)
+        {}
+
+        TtyrecWriter(TtyrecWriter const&) = delete;
+        TtyrecWriter& operator=(TtyrecWriter const&) = delete;
+
+        /// \return 0 or an errno code
+        int write_frame(uint64_t time_us, array_view<uint8_t const> data)
+        {
+            uint32_t const header[] {
+                uint32_t(time_us / 1000000), uint32_t(time_us % 1000000), uint32_t(data.size())
+            };
+            for (uint32_t n : header) {
+                for (int i = 0; i < 4; ++i) {
+                    _buffer.push_back(uint8_t(n >> (i * 8)));
+                }
+            }
+
+            if (data.size() >= block_size) {
+                if (int errnum = flush()) {
+                    return errnum;
+                }
+                return write_all(_fd, data.data(), data.size());
+            }
+
+            _buffer.insert(_buffer.end(), data.begin(), data.end());
+            return (_buffer.size() >= block_size) ? flush() : 0;
+        }
+
+        int flush()
+        {
+            int errnum = write_all(_fd, _buffer.data(), _buffer.size());
+            _buffer.clear();
+            return errnum;
+        }
+
+    private:
+        int _fd;
+        std::vector<uint8_t> _buffer;
+    };
+}
+
+template<class F>
+static void for_each_index(TerminalEmulatorThreadPool * pool, std::size_t n, F f)
+{
+    if (pool) {
+        pool->pool.parallel_for(n, f);
+    }
+    else {
+        for (std::size_t i = 0; i < n; ++i) {
+            f(i);
+        }
+    }
+}
+
+/// Same as \c for_each_index() with \c f(thread_index,i), \c thread_index is less than \c nb_thread(pool)
+template<class F>
+static void for_each_index_and_thread(TerminalEmulatorThreadPool * pool, std::size_t n, F f)
+{
+    if (pool) {
+        pool->pool.parallel_for_thread(n, f);
+    }
+    else {
+        for (std::size_t i = 0; i < n; ++i) {
+            f(0u, i);
+        }
+    }
+}
+
+static unsigned nb_thread(TerminalEmulatorThreadPool const * pool) noexcept
+{
+    return pool ? pool->pool.size() : 1u;
+}
+
+extern "C"
+{
+
+REDEMPTION_LIB_EXPORT
+char const * terminal_emulator_version() noexcept
+{
+    return RVT_LIB_VERSION;
+}
+
+#define return_nullptr_if(x) do { if (REDEMPTION_UNLIKELY(x)) { return nullptr; } } while (0)
+#define return_if(x) do { if (REDEMPTION_UNLIKELY(x)) { return -2; } } while (0)
+#define Panic(expr, err) do { try { expr; } \
+    catch (...) { return err; } } while (0)
+#define Panic_errno(expr) do { try { expr; } \
+    catch (std::bad_alloc const&) { return -3; } \
+    catch (...) { return errno_or_single_error(); } } while (0)
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulator * terminal_emulator_new(int lines, int columns) noexcept
+{
+    return_nullptr_if(lines <= 0 || columns <= 0);
+    Panic(return new(std::nothrow) TerminalEmulator(lines, columns), nullptr);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_delete(TerminalEmulator * emu) noexcept
+{
+    delete emu;
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_finish(TerminalEmulator * emu) noexcept
+{
+    return_if(!emu);
+
+    auto send_fn = [emu](rvt::ucs4_char ucs) { emu->emulator.receiveChar(ucs); };
+    Panic_errno(
+        if (emu->journal) {
+            emu->journal->beginFrame(emu->decoder);
+        }
+        emu->decoder.end_decode(send_fn);
+        emu->emulator.commitLines();
+    );
+    if (emu->journal) {
+        emu->journal->endFrame();
+    }
+    return std::exchange(emu->keyword_alert.errnum, 0);
+}
+
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_set_title(TerminalEmulator * emu, char const * title) noexcept
+{
+    return_if(!emu);
+
+    rvt::ucs4_char ucs_title[255];
+    rvt::ucs4_char * p = std::begin(ucs_title);
+    rvt::ucs4_char * e = std::end(ucs_title) - 4;
+
+    std::size_t sz = strlen(title);
+
+    auto send_fn = [&p](rvt::ucs4_char ucs) { *p = ucs; ++p; };
+    while (sz && p < e) {
+        std::size_t const consumed = std::min(sz, std::size_t(e-p));
+        emu->decoder.decode(const_bytes_array(title, consumed), send_fn);
+        sz -= consumed;
+        title += consumed;
+    }
+    emu->decoder.end_decode(send_fn);
+
+    emu->emulator.setWindowTitle({ucs_title, std::size_t(p-ucs_title)});
+    emu->clear_journal();
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_set_log_function(
+    TerminalEmulator * emu, TerminalEmulatorLogFunction * log_func
+) noexcept
+{
+    return_if(!emu);
+
+    Panic_errno(emu->emulator.setLogFunction(log_func));
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_set_log_function_ctx(
+    TerminalEmulator * emu, TerminalEmulatorLogFunctionCtx * log_func, void * ctx
+) noexcept
+{
+    return_if(!emu);
+
+    Panic_errno(emu->emulator.setLogFunction([log_func, ctx](char const * s, std::size_t len) {
+        log_func(ctx, s, len);
+    }));
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_feed(TerminalEmulator * emu, uint8_t const * s, std::size_t len) noexcept
+{
+    return_if(!emu);
+
+    auto send_fn = [emu](rvt::ucs4_char ucs) { emu->emulator.receiveChar(ucs); };
+    Panic_errno(
+        if (emu->journal) {
+            emu->journal->beginFrame(emu->decoder);
+        }
+        emu->decoder.decode(const_bytes_array(s, len), send_fn);
+    );
+    if (emu->journal) {
+        emu->journal->endFrame();
+    }
+    return std::exchange(emu->keyword_alert.errnum, 0);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_resize(TerminalEmulator * emu, int lines, int columns) noexcept
+{
+    return_if(!emu);
+    return_if(lines <= 0 || columns <= 0);
+
+    if (lines > 4096 || columns > 4096) {
+        return ENOMEM;
+    }
+
+    Panic_errno(emu->emulator.setScreenSize(lines, columns));
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_serialize(
+    TerminalEmulator const * emu, TerminalEmulatorBuffer * buffer) noexcept
+{
+    return_if(!emu || !buffer);
+
+    Panic_errno(
+        std::vector<uint8_t> state;
+        rvt::write_emulator_state(state, emu->emulator, emu->decoder);
+        set_buffer_data(*buffer, state.data(), state.size());
+    );
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_deserialize(
+    TerminalEmulator * emu, uint8_t const * data, std::size_t len) noexcept
+{
+    return_if(!emu || (!data && len));
+
+    emu->clear_journal();
+
+    bool valid = false;
+    Panic_errno(valid = rvt::read_emulator_state({data, len}, emu->emulator, emu->decoder));
+    return valid ? 0 : -1;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_set_journal(TerminalEmulator * emu, std::size_t max_bytes) noexcept
+{
     return_if(!emu);
 
-    Panic_errno(emu->emulator.setLogFunction(log_func));
-    return 0;
+    emu->journal.reset();
+    if (max_bytes) {
+        Panic_errno(emu->journal = std::make_unique<rvt::FrameJournal>(emu->emulator, max_bytes));
+    }
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_undo_frame(TerminalEmulator * emu) noexcept
+{
+    return_if(!emu || !emu->journal);
+
+    bool undone = false;
+    Panic_errno(undone = emu->journal->undoFrame(emu->decoder));
+    return undone ? 0 : -1;
+}
+
+REDEMPTION_LIB_EXPORT
+std::size_t terminal_emulator_journal_frame_count(TerminalEmulator const * emu) noexcept
+{
+    return (emu && emu->journal) ? emu->journal->frameCount() : 0;
+}
+
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorKeywordMatcher * terminal_emulator_keyword_matcher_new(
+    char const * const * patterns, std::size_t n, int ignore_ascii_case) noexcept
+{
+    return_nullptr_if(n && !patterns);
+    Panic(
+        std::vector<std::string_view> keywords;
+        keywords.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            return_nullptr_if(!patterns[i]);
+            keywords.emplace_back(patterns[i]);
+        }
+        return new(std::nothrow) TerminalEmulatorKeywordMatcher{
+            rvt::KeywordMatcher({keywords.data(), keywords.size()}, ignore_ascii_case != 0)
+        },
+        nullptr
+    );
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_keyword_matcher_delete(TerminalEmulatorKeywordMatcher * matcher) noexcept
+{
+    delete matcher;
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_set_keyword_alert(
+    TerminalEmulator * emu, TerminalEmulatorKeywordMatcher const * matcher,
+    TerminalEmulatorKeywordAlertFn * alert_fn, void * ctx) noexcept
+{
+    return_if(!emu || (matcher && !alert_fn));
+
+    auto& vt = emu->emulator;
+    if (matcher) {
+        emu->keyword_alert = {{matcher, alert_fn, ctx}};
+        Panic_errno(
+            vt.setLineSaveMode(rvt::Screen::LineSaveMode::Commit);
+            vt.setLineSaver(rvt::Screen::LineSaver::from_ref(emu->keyword_alert));
+        );
+    }
+    else {
+        Panic_errno(
+            vt.setLineSaveMode(rvt::Screen::LineSaveMode::CursorMove);
+            vt.setLineSaver(nullptr);
+        );
+        emu->keyword_alert = {};
+    }
+    return 0;
+}
+
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorThreadPool * terminal_emulator_thread_pool_new(int nb_thread) noexcept
+{
+    return_nullptr_if(nb_thread < 0);
+    Panic(return new(std::nothrow) TerminalEmulatorThreadPool(unsigned(nb_thread)), nullptr);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_thread_pool_delete(TerminalEmulatorThreadPool * pool) noexcept
+{
+    delete pool;
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_set_parallel_rendering(
+    TerminalEmulator * emu, TerminalEmulatorThreadPool * pool, std::size_t min_cells) noexcept
+{
+    return_if(!emu);
+
+    emu->parallel_rendering.pool = pool ? &pool->pool : nullptr;
+    emu->parallel_rendering.min_cells = min_cells;
+    return 0;
+}
+
+
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorBuffer* terminal_emulator_buffer_new() noexcept
+{
+    return terminal_emulator_buffer_new_with_max_capacity(4u /*Go*/ * 1024 * 1024 * 1024, 0);
+}
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorBuffer* terminal_emulator_buffer_new_with_max_capacity(
+    std::size_t max_capacity, std::size_t pre_alloc_len) noexcept
+{
+    static_assert(noexcept(TerminalEmulatorBufferWithVector(max_capacity)));
+    auto* res = new(std::nothrow) TerminalEmulatorBufferWithVector{max_capacity};
+    if (res && pre_alloc_len) {
+        if (!res->initial_size(pre_alloc_len)) {
+            delete res;
+            return nullptr;
+        }
+    }
+    return res;
+}
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorBuffer * terminal_emulator_buffer_new_with_custom_allocator(
+    void * ctx,
+    TerminalEmulatorBufferGetBufferFn * get_buffer_fn,
+    TerminalEmulatorBufferExtraMemoryAllocatorFn * extra_memory_allocator_fn,
+    TerminalEmulatorBufferSetFinalBufferFn * set_final_buffer_fn,
+    TerminalEmulatorBufferClearFn * clear_fn,
+    TerminalEmulatorBufferDeleteCtxFn * delete_ctx_fn) noexcept
+{
+    return new(std::nothrow) TerminalEmulatorBuffer{
+        ctx,
+        get_buffer_fn,
+        extra_memory_allocator_fn,
+        set_final_buffer_fn,
+        clear_fn,
+        delete_ctx_fn,
+        [](TerminalEmulatorBuffer* self) noexcept { delete self; }
+    };
+}
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorBuffer * terminal_emulator_buffer_new_stream_to_callback(
+    void * ctx, TerminalEmulatorBufferWriteFn * write_fn, std::size_t block_size) noexcept
+{
+    return_nullptr_if(!write_fn);
+
+    auto* res = new(std::nothrow) TerminalEmulatorBufferWithStream{
+        ctx, write_fn, block_size ? block_size : 1024 * 1024};
+    if (res && !res->init_blocks()) {
+        delete res;
+        return nullptr;
+    }
+    return res;
+}
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorBuffer * terminal_emulator_buffer_new_stream_to_fd(
+    int fd, std::size_t block_size) noexcept
+{
+    return_nullptr_if(fd < 0);
+
+    static_assert(sizeof(void*) >= sizeof(intptr_t));
+    auto write_fn = [](void * ctx, uint8_t const * data, std::size_t len) noexcept {
+        return write_all(static_cast<int>(reinterpret_cast<intptr_t>(ctx)), data, len);
+    };
+
+    return terminal_emulator_buffer_new_stream_to_callback(
+        reinterpret_cast<void*>(static_cast<intptr_t>(fd)), write_fn, block_size);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_delete(TerminalEmulatorBuffer * buffer) noexcept
+{
+    return_if(!buffer);
+    buffer->delete_ctx_fn(buffer->ctx);
+    buffer->delete_self(buffer);
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare(
+    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+    TerminalEmulatorOutputFormat format
+) noexcept
+{
+    return_if(!buffer || !emu);
+
+    return build_format_string(*buffer, *emu, format, {});
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare2(
+    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+    TerminalEmulatorOutputFormat format,
+    uint8_t const * extra_data, std::size_t extra_data_len
+) noexcept
+{
+    return_if(!buffer || !emu);
+
+    std::string_view extra = {const_bytes_t(extra_data).to_charp(), extra_data_len};
+    return build_format_string(*buffer, *emu, format, extra);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_region(
+    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+    TerminalEmulatorOutputFormat format,
+    int first_line, int last_line, int first_column, int last_column
+) noexcept
+{
+    return_if(!buffer || !emu);
+    return_if(first_line < 0 || first_column < 0);
+    return_if(first_line > last_line || first_column > last_column);
+
+    rvt::ScreenRegion region{first_line, last_line, first_column, last_column};
+    return build_format_string(buffer->as_rendering_buffer(), *emu, format, region, {});
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_minimap(
+    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+    TerminalEmulatorMinimapFormat format,
+    int block_lines, int block_columns,
+    TerminalEmulatorMinimapGlyph glyph
+) noexcept
+{
+    return_if(!buffer || !emu);
+    return_if(block_lines <= 0 || block_columns <= 0);
+    return_if(block_lines > 64 || block_columns > 64);
+
+    rvt::Minimap minimap{block_lines, block_columns, rvt::MinimapGlyph::density};
+    switch (glyph) {
+        case TerminalEmulatorMinimapGlyph::density: break;
+        case TerminalEmulatorMinimapGlyph::dominant:
+            minimap.glyph = rvt::MinimapGlyph::dominant;
+            break;
+        default: return -2;
+    }
+
+    auto const& screen = emu->emulator.getCurrentScreen();
+    auto rendering_buffer = buffer->as_rendering_buffer();
+
+    switch (format) {
+        case TerminalEmulatorMinimapFormat::json:
+            Panic_errno(rvt::minimap_json_rendering(
+                screen, rvt::xterm_color_table, rendering_buffer, minimap));
+            return 0;
+        case TerminalEmulatorMinimapFormat::rgb:
+            Panic_errno(rvt::minimap_rgb_rendering(
+                screen, rvt::xterm_color_table, rendering_buffer, minimap));
+            return 0;
+    }
+
+    return -2;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_image(
+    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+    TerminalEmulatorImageFormat format, int scale
+) noexcept
+{
+    return_if(!buffer || !emu);
+    return_if(scale < 1 || scale > 16);
+
+    rvt::ImageFormat image_format;
+    switch (format) {
+        case TerminalEmulatorImageFormat::ppm: image_format = rvt::ImageFormat::ppm; break;
+        case TerminalEmulatorImageFormat::pam: image_format = rvt::ImageFormat::pam; break;
+        default: return -2;
+    }
+
+    Panic_errno(rvt::image_rendering(
+        emu->emulator.getCurrentScreen(), rvt::xterm_color_table,
+        buffer->as_rendering_buffer(), image_format, scale));
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+uint8_t const * terminal_emulator_buffer_get_data(
+    TerminalEmulatorBuffer const * buffer, std::size_t * output_len) noexcept
+{
+    if (REDEMPTION_UNLIKELY(!buffer)) {
+        if (output_len) {
+            *output_len = 0;
+        }
+        return nullptr;
+    }
+
+    std::size_t output_len2;
+    return buffer->get_buffer_fn(buffer->ctx, output_len ? output_len : &output_len2);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_clear_data(TerminalEmulatorBuffer * buffer) noexcept
+{
+    return_if(!buffer);
+    buffer->clear_fn(buffer->ctx);
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_render_many(
+    TerminalEmulator * const * emus, std::size_t n,
+    TerminalEmulatorOutputFormat format,
+    TerminalEmulatorBuffer * const * buffers,
+    TerminalEmulatorThreadPool * pool, int * results) noexcept
+{
+    return_if(n && (!emus || !buffers));
+
+    std::unique_ptr<int[]> results_buffer;
+    if (!results) {
+        results_buffer.reset(new(std::nothrow) int[n]);
+        if (!results_buffer) {
+            return -3;
+        }
+        results = results_buffer.get();
+    }
+
+    Panic_errno(for_each_index(pool, n, [=](std::size_t i){
+        results[i] = (emus[i] && buffers[i])
+            ? build_format_string(*buffers[i], *emus[i], format, {})
+            : -2;
+    }));
+
+    for (std::size_t i = 0; i < n; ++i) {
+        if (results[i]) {
+            return results[i];
+        }
+    }
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_render_many_into_buffer(
+    TerminalEmulatorBuffer * buffer,
+    TerminalEmulator * const * emus, std::size_t n,
+    TerminalEmulatorOutputFormat format,
+    TerminalEmulatorThreadPool * pool, std::size_t * offsets) noexcept
+{
+    return_if(!buffer || !offsets || (n && !emus));
+
+    auto run = [&]{
+        std::vector<std::vector<uint8_t>> segments(n);
+        std::vector<int> results(n);
+
+        for_each_index(pool, n, [&](std::size_t i){
+            results[i] = emus[i]
+                ? build_format_string(rvt::RenderingBuffer::from_vector(segments[i]), *emus[i], format, {})
+                : -2;
+        });
+
+        for (int errnum : results) {
+            if (errnum) {
+                return errnum;
+            }
+        }
+
+        std::size_t total_len = 0;
+        offsets[0] = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            total_len += segments[i].size();
+            offsets[i + 1] = total_len;
+        }
+
+        std::size_t capacity = 0;
+        uint8_t* p = buffer->get_buffer_fn(buffer->ctx, &capacity);
+        if (capacity < total_len) {
+            capacity = total_len;
+            p = buffer->extra_memory_allocator_fn(buffer->ctx, &capacity, p, 0);
+            if (REDEMPTION_UNLIKELY(!p)) {
+                return -3;
+            }
+        }
+
+        for (std::size_t i = 0; i < n; ++i) {
+            if (!segments[i].empty()) {
+                memcpy(p + offsets[i], segments[i].data(), segments[i].size());
+            }
+        }
+
+        buffer->set_final_buffer_fn(buffer->ctx, p, total_len);
+        return 0;
+    };
+
+    Panic_errno(return run());
+}
+
+namespace
+{
+    bool init_timestamp_formatter(
+        rvt::TimestampFormatter& formatter, TerminalEmulatorTranscriptPrefix prefix_type)
+    {
+        auto init = [&](rvt::TimestampFormat format, bool utc){
+            formatter = rvt::TimestampFormatter(format, utc);
+            return true;
+        };
+
+        using Prefix = TerminalEmulatorTranscriptPrefix;
+        using Format = rvt::TimestampFormat;
+
+        switch (prefix_type) {
+            case Prefix::noprefix: return true;
+            case Prefix::datetime: return init(Format::Datetime, false);
+            case Prefix::datetime_utc: return init(Format::Datetime, true);
+            case Prefix::epoch: return init(Format::Epoch, true);
+            case Prefix::iso8601_ms: return init(Format::Iso8601Ms, false);
+            case Prefix::iso8601_us: return init(Format::Iso8601Us, false);
+            case Prefix::iso8601_ms_utc: return init(Format::Iso8601Ms, true);
+            case Prefix::iso8601_us_utc: return init(Format::Iso8601Us, true);
+        }
+
+        return false;
+    }
+
+    struct TranscryptRender
+    {
+        enum class LineFormat : uint8_t
+        {
+            Text,
+            TextWithTimestamp,
+            Jsonl,
+        };
+
+        rvt::RenderingBuffer rendering_buffer;
+        std::size_t consumed_buffer = 0;
+        time_t time = 0;
+        uint32_t usec = 0;
+        LineFormat line_format = LineFormat::Text;
+        rvt::TimestampFormatter timestamp_formatter {rvt::TimestampFormat::Datetime, false};
+        rvt::TranscriptJsonlContext jsonl_ctx {};
+
+        /// \return false when \p options has a bad prefix
+        bool init(TerminalEmulatorTranscriptOptions const& options)
+        {
+            if (options.format == TerminalEmulatorTranscriptFormat::jsonl) {
+                line_format = LineFormat::Jsonl;
+            }
+            else if (options.prefix_type != TerminalEmulatorTranscriptPrefix::noprefix) {
+                line_format = LineFormat::TextWithTimestamp;
+            }
+            return init_timestamp_formatter(timestamp_formatter, options.prefix_type);
+        }
+
+        /// A timestamp prefix is written for each call, consecutive lines cannot be merged.
+        bool supports_line_batching() const noexcept
+        {
+            return line_format != LineFormat::TextWithTimestamp;
+        }
+
+        void save_lines(rvt::Screen const& screen, size_t y, size_t yend, bool alternate_screen)
+        {
+            switch (line_format) {
+                case LineFormat::TextWithTimestamp:
+                    write_time();
+                    [[fallthrough]];
+                case LineFormat::Text:
+                    write_line(screen, y, yend);
+                    break;
+                case LineFormat::Jsonl:
+                    write_jsonl(screen, y, yend, alternate_screen);
+                    break;
+            }
+        }
+
+        void write_line(rvt::Screen const& screen, size_t y, size_t yend)
+        {
+            auto partial_buf = transcript_partial_rendering(screen, y, yend, rendering_buffer, consumed_buffer);
+            rendering_buffer.buffer = partial_buf.buffer;
+            rendering_buffer.length = partial_buf.capacity;
+            consumed_buffer = partial_buf.length;
+        }
+
+        void write_jsonl(rvt::Screen const& screen, size_t y, size_t yend, bool alternate_screen)
+        {
+            jsonl_ctx.time_us = uint64_t(time) * 1000000u + usec;
+            jsonl_ctx.alternate_screen = alternate_screen;
+            auto partial_buf = transcript_jsonl_partial_rendering(
+                screen, y, yend, jsonl_ctx, rendering_buffer, consumed_buffer);
+            rendering_buffer.buffer = partial_buf.buffer;
+            rendering_buffer.length = partial_buf.capacity;
+            consumed_buffer = partial_buf.length;
+        }
+
+        void write_time()
+        {
+            char* p = prepare_buffer(rvt::TimestampFormatter::max_size);
+            consumed_buffer += timestamp_formatter.format(time, usec, p);
+        }
+
+        void write_bytes(uint8_t const* data, std::size_t len)
+        {
+            if (len) {
+                memcpy(prepare_buffer(len), data, len);
+                consumed_buffer += len;
+            }
+        }
+
+        /// \return a pointer on at least \p len free bytes
+        char* prepare_buffer(std::size_t len)
+        {
+            if (REDEMPTION_UNLIKELY(rendering_buffer.length - consumed_buffer < len)) {
+                std::size_t capacity = std::max(len, std::size_t(4 * 1024));
+                auto p = start_buffer();
+                p = rendering_buffer.allocate(rendering_buffer.ctx, &capacity, p, consumed_buffer);
+                if (REDEMPTION_UNLIKELY(not p)) {
+                    throw std::bad_alloc();
+                }
+                rendering_buffer.buffer = bytes_t(p).to_charp();
+                rendering_buffer.length = capacity;
+                consumed_buffer = 0;
+            }
+            return rendering_buffer.buffer + consumed_buffer;
+        }
+
+        void finalize()
+        {
+            rendering_buffer.set_final_buffer(rendering_buffer.ctx, start_buffer(), consumed_buffer);
+        }
+
+        uint8_t* start_buffer() const
+        {
+            return bytes_t(rendering_buffer.buffer).to_u8p();
+        }
+    };
+}
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorTranscriptOptions * terminal_emulator_transcript_options_new() noexcept
+{
+    return new(std::nothrow) TerminalEmulatorTranscriptOptions;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_delete(TerminalEmulatorTranscriptOptions * options) noexcept
+{
+    delete options;
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_set_prefix(
+    TerminalEmulatorTranscriptOptions * options, TerminalEmulatorTranscriptPrefix prefix_type) noexcept
+{
+    return_if(!options);
+
+    rvt::TimestampFormatter formatter {rvt::TimestampFormat::Datetime, false};
+    return_if(!init_timestamp_formatter(formatter, prefix_type));
+    options->prefix_type = prefix_type;
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_set_line_mode(
+    TerminalEmulatorTranscriptOptions * options, TerminalEmulatorTranscriptLineMode line_mode) noexcept
+{
+    return_if(!options);
+
+    switch (line_mode) {
+        case TerminalEmulatorTranscriptLineMode::cursor_move:
+        case TerminalEmulatorTranscriptLineMode::commit:
+            options->line_mode = line_mode;
+            return 0;
+    }
+
+    return -2;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_set_alternate_screen(
+    TerminalEmulatorTranscriptOptions * options,
+    TerminalEmulatorTranscriptAlternateScreen alternate_screen,
+    uint32_t snapshot_interval) noexcept
+{
+    return_if(!options);
+
+    switch (alternate_screen) {
+        case TerminalEmulatorTranscriptAlternateScreen::lines:
+        case TerminalEmulatorTranscriptAlternateScreen::snapshot:
+            options->alternate_screen = alternate_screen;
+            options->snapshot_interval = snapshot_interval;
+            return 0;
+    }
+
+    return -2;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_set_format(
+    TerminalEmulatorTranscriptOptions * options, TerminalEmulatorTranscriptFormat format) noexcept
+{
+    return_if(!options);
+
+    switch (format) {
+        case TerminalEmulatorTranscriptFormat::text:
+        case TerminalEmulatorTranscriptFormat::jsonl:
+            options->format = format;
+            return 0;
+    }
+
+    return -2;
+}
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorReplay * terminal_emulator_replay_new() noexcept
+{
+    return new(std::nothrow) TerminalEmulatorReplay;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_delete(TerminalEmulatorReplay * replay) noexcept
+{
+    delete replay;
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_transcript(
+    TerminalEmulatorReplay * replay, TerminalEmulatorBuffer * buffer,
+    TerminalEmulatorTranscriptOptions const * options) noexcept
+{
+    return_if(!replay || !buffer || !options || replay->has_buffer(buffer));
+
+    if (!replay->transcripts.empty()) {
+        auto const& first = replay->transcripts.front().options;
+        return_if(first.line_mode != options->line_mode
+               || first.alternate_screen != options->alternate_screen
+               || first.snapshot_interval != options->snapshot_interval);
+    }
+
+    Panic_errno(replay->transcripts.push_back({buffer, *options}); return 0);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_snapshots(
+    TerminalEmulatorReplay * replay, TerminalEmulatorBuffer * buffer,
+    TerminalEmulatorOutputFormat format, uint32_t interval) noexcept
+{
+    return_if(!replay || !buffer || replay->has_buffer(buffer));
+
+    switch (format) {
+        case TerminalEmulatorOutputFormat::json:
+        case TerminalEmulatorOutputFormat::ansi:
+        case TerminalEmulatorOutputFormat::text:
+            Panic_errno(replay->snapshots.push_back({buffer, format, interval}); return 0);
+    }
+
+    return -2;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_timeline(
+    TerminalEmulatorReplay * replay, TerminalEmulatorBuffer * buffer, uint32_t interval) noexcept
+{
+    return_if(!replay || !buffer || !interval || replay->has_buffer(buffer));
+
+    Panic_errno(replay->timelines.push_back({buffer, interval}); return 0);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_frame_callback(
+    TerminalEmulatorReplay * replay,
+    TerminalEmulatorReplayFrameFn * frame_fn, void * ctx) noexcept
+{
+    return_if(!replay || !frame_fn);
+
+    Panic_errno(replay->frames.push_back({frame_fn, ctx}); return 0);
+}
+
+static bool is_snapshot_format(TerminalEmulatorOutputFormat format) noexcept
+{
+    switch (format) {
+        case TerminalEmulatorOutputFormat::json:
+        case TerminalEmulatorOutputFormat::ansi:
+        case TerminalEmulatorOutputFormat::text:
+            return true;
+    }
+    return false;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_screenshots(
+    TerminalEmulatorReplay * replay, TerminalEmulatorOutputFormat format,
+    uint64_t const * times, std::size_t n,
+    TerminalEmulatorReplayScreenshotFn * screenshot_fn, void * ctx) noexcept
+{
+    return_if(!replay || !screenshot_fn || (n && !times) || !is_snapshot_format(format)
+           || !std::is_sorted(times, times + n));
+
+    Panic_errno(
+        replay->screenshots.push_back({format, std::vector<uint64_t>(times, times + n), 0, screenshot_fn, ctx});
+        return 0;
+    );
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_screenshots_every(
+    TerminalEmulatorReplay * replay, TerminalEmulatorOutputFormat format, uint64_t interval,
+    TerminalEmulatorReplayScreenshotFn * screenshot_fn, void * ctx) noexcept
+{
+    return_if(!replay || !screenshot_fn || !interval || !is_snapshot_format(format));
+
+    Panic_errno(replay->screenshots.push_back({format, {}, interval, screenshot_fn, ctx}); return 0);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_keyword_alert(
+    TerminalEmulatorReplay * replay, TerminalEmulatorKeywordMatcher const * matcher,
+    TerminalEmulatorKeywordAlertFn * alert_fn, void * ctx) noexcept
+{
+    return_if(!replay || !matcher || !alert_fn);
+
+    Panic_errno(replay->alerts.push_back({matcher, alert_fn, ctx}); return 0);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_set_time_window(
+    TerminalEmulatorReplay * replay, uint32_t start_time, uint32_t end_time) noexcept
+{
+    return_if(!replay || start_time > end_time);
+
+    replay->start_time = start_time;
+    replay->end_time = end_time;
+    return 0;
+}
+
+namespace
+{
+    /// Screen saver of \c TerminalEmulatorTranscriptAlternateScreen::snapshot
+    rvt::VtEmulator::ScreenSaver make_alternate_screen_saver(rvt::Screen::LineSaver save_lines)
+    {
+        return [save_lines = std::move(save_lines)](rvt::Screen const& screen){
+            auto const&& lines = screen.getScreenLines();
+            auto const&& lineProperties = screen.getLineProperties();
+            // trailing empty lines are ignored
+            std::size_t yend = lines.size();
+            while (yend && lines[yend-1].empty()) {
+                --yend;
+            }
+            for (std::size_t y = 0; y < yend; ++y) {
+                save_lines(screen, y, y+1);
+                while (y < yend && bool(lineProperties[y] & rvt::LineProperty::Wrapped)) {
+                    ++y;
+                }
+            }
+        };
+    }
+
+    /// Periodic snapshot of the alternate screen (\c TerminalEmulatorTranscriptOptions::snapshot_interval)
+    struct AlternateScreenTimer
+    {
+        uint32_t interval = 0;
+        uint32_t next_snapshot = 0;
+        bool was_alternate_screen = false;
+
+        void update(rvt::VtEmulator& vt, uint32_t sec)
+        {
+            if (!interval) {
+                return;
+            }
+
+            bool const is_alternate_screen = vt.isAlternateScreen();
+            if (is_alternate_screen) {
+                if (!was_alternate_screen) {
+                    next_snapshot = sec + interval;
+                }
+                else if (sec >= next_snapshot) {
+                    vt.saveAlternateScreen();
+                    next_snapshot = sec + interval;
+                }
+            }
+            was_alternate_screen = is_alternate_screen;
+        }
+    };
+
+    int replay_ttyrec(
+        TerminalEmulatorReplay const& replay, TerminalEmulator& emu,
+        TtyrecReader& reader)
+    {
+        struct SnapshotRender
+        {
+            TranscryptRender render;
+            TerminalEmulatorOutputFormat format;
+            uint32_t interval;
+            uint32_t next_snapshot = 0;
+        };
+
+        std::vector<TranscryptRender> renders;
+        renders.reserve(replay.transcripts.size());
+        for (auto const& sink : replay.transcripts) {
+            renders.push_back({sink.buffer->as_rendering_buffer()});
+            if (!renders.back().init(sink.options)) {
+                return -2;
+            }
+        }
+
+        std::vector<SnapshotRender> snapshots;
+        snapshots.reserve(replay.snapshots.size());
+        for (auto const& sink : replay.snapshots) {
+            snapshots.push_back({{sink.buffer->as_rendering_buffer()}, sink.format, sink.interval});
+        }
+
+        struct ScreenshotRender
+        {
+            TerminalEmulatorReplay::ScreenshotSink const& sink;
+            std::size_t i = 0;
+            /// time of the next screenshot, waits for the first frame with an interval
+            uint64_t next_time = ~uint64_t();
+
+            bool has_next() const noexcept
+            {
+                return sink.interval || i < sink.times.size();
+            }
+        };
+
+        std::vector<ScreenshotRender> screenshots;
+        screenshots.reserve(replay.screenshots.size());
+        for (auto const& sink : replay.screenshots) {
+            screenshots.push_back({sink});
+            if (!sink.interval && !sink.times.empty()) {
+                screenshots.back().next_time = sink.times.front();
+            }
+        }
+
+        struct TimelineRender
+        {
+            TranscryptRender render;
+            uint64_t interval;
+            /// period of the current entry, ~0 without entry
+            uint64_t period = ~uint64_t();
+            uint64_t bytes = 0;
+            uint64_t cells = 0;
+            uint64_t lines = 0;
+            bool erased = false;
+            bool reset = false;
+            bool alternate_screen = false;
+
+            void write_entry()
+            {
+                if (period == ~uint64_t()) {
+                    return;
+                }
+
+                constexpr std::size_t max_len = 160;
+                char* p = render.prepare_buffer(max_len);
+                render.consumed_buffer += std::size_t(std::snprintf(p, max_len,
+                    "{\"t\":%llu,\"b\":%llu,\"c\":%llu,\"l\":%llu,\"e\":%s,\"r\":%s,\"a\":%s}\n",
+                    static_cast<unsigned long long>(period * interval),
+                    static_cast<unsigned long long>(bytes),
+                    static_cast<unsigned long long>(cells),
+                    static_cast<unsigned long long>(lines),
+                    erased ? "true" : "false",
+                    reset ? "true" : "false",
+                    alternate_screen ? "true" : "false"));
+
+                period = ~uint64_t();
+                bytes = 0;
+                cells = 0;
+                lines = 0;
+                erased = false;
+                reset = false;
+                alternate_screen = false;
+            }
+        };
+
+        std::vector<TimelineRender> timelines;
+        timelines.reserve(replay.timelines.size());
+        for (auto const& sink : replay.timelines) {
+            timelines.push_back({{sink.buffer->as_rendering_buffer()}, uint64_t(sink.interval) * 1000});
+        }
+
+        std::vector<uint8_t> snapshot_buffer;
+
+        auto save_snapshot = [&](SnapshotRender& snapshot){
+            int errnum = build_format_string(
+                rvt::RenderingBuffer::from_vector(snapshot_buffer), emu, snapshot.format, {});
+            if (errnum) {
+                return errnum;
+            }
+            snapshot.render.write_bytes(snapshot_buffer.data(), snapshot_buffer.size());
+            uint8_t const newline[] {'\n'};
+            snapshot.render.write_bytes(newline, 1);
+            return 0;
+        };
+
+        uint64_t const window_start = uint64_t(replay.start_time) * 1000000;
+        uint64_t const window_end = uint64_t(replay.end_time) * 1000000;
+
+        // screenshots before \p until, the screen is rendered once for all these times
+        auto take_screenshots = [&](uint64_t until, bool end_of_stream){
+            for (auto& screenshot : screenshots) {
+                auto const& sink = screenshot.sink;
+                uint64_t const limit = (end_of_stream && !sink.interval) ? window_end : until;
+                bool rendered = false;
+                while (screenshot.has_next() && screenshot.next_time < limit) {
+                    uint64_t const time = screenshot.next_time;
+                    if (time >= window_start) {
+                        if (!rendered) {
+                            int errnum = build_format_string(
+                                rvt::RenderingBuffer::from_vector(snapshot_buffer), emu, sink.format, {});
+                            if (errnum) {
+                                return errnum;
+                            }
+                            rendered = true;
+                        }
+                        if (int errnum = sink.fn(sink.ctx, screenshot.i, time,
+                                                 snapshot_buffer.data(), snapshot_buffer.size())
+                        ) {
+                            return errnum;
+                        }
+                    }
+                    ++screenshot.i;
+                    if (sink.interval) {
+                        screenshot.next_time += sink.interval;
+                    }
+                    else if (screenshot.i < sink.times.size()) {
+                        screenshot.next_time = sink.times[screenshot.i];
+                    }
+                }
+            }
+            return 0;
+        };
+
+        auto finalize = [&]{
+            for (auto& render : renders) {
+                render.finalize();
+            }
+            for (auto& snapshot : snapshots) {
+                snapshot.render.finalize();
+            }
+            for (auto& timeline : timelines) {
+                timeline.render.finalize();
+            }
+        };
+
+        auto& vt = emu.emulator;
+
+        uint32_t frame_sec = 0;
+        uint32_t frame_usec = 0;
+        int alert_errnum = 0;
+        uint64_t saved_lines = 0;
+
+        auto save_lines = [&](rvt::Screen const& screen, size_t y, size_t yend){
+            saved_lines += yend - y;
+            bool const alternate_screen = vt.isAlternateScreen(screen);
+            for (auto& render : renders) {
+                render.save_lines(screen, y, yend, alternate_screen);
+            }
+            for (auto const& alert : replay.alerts) {
+                if (!alert_errnum) {
+                    alert_errnum = alert.search(screen, y, yend, frame_sec, frame_usec);
+                }
+            }
+        };
+
+        // savers reference local variables
+        struct SaversGuard
+        {
+            rvt::VtEmulator& vt;
+
+            ~SaversGuard()
+            {
+                vt.setLineSaver(nullptr);
+                vt.setAlternateScreenSaver(nullptr);
+            }
+        };
+        SaversGuard savers_guard{vt};
+
+        auto const* transcript_options = replay.transcripts.empty()
+            ? nullptr : &replay.transcripts.front().options;
+
+        bool const commit_mode = transcript_options
+            ? transcript_options->line_mode == TerminalEmulatorTranscriptLineMode::commit
+            : !replay.alerts.empty() || !replay.timelines.empty();
+        if (commit_mode) {
+            vt.setLineSaveMode(rvt::Screen::LineSaveMode::Commit);
+        }
+        vt.setLineSaveBatching(std::all_of(renders.begin(), renders.end(), [](auto& render){
+            return render.supports_line_batching();
+        }));
+
+        bool const alternate_screen_snapshot = transcript_options
+          && transcript_options->alternate_screen == TerminalEmulatorTranscriptAlternateScreen::snapshot;
+        AlternateScreenTimer alternate_screen_timer;
+        if (alternate_screen_snapshot) {
+            alternate_screen_timer.interval = transcript_options->snapshot_interval;
+        }
+
+        // changed cells of the timelines
+        std::optional<rvt::ScreenTracker> screen_tracker;
+
+        // frames before the time window are emulated without saver
+        auto enable_savers = [&]{
+            if (!renders.empty() || !replay.alerts.empty() || !timelines.empty()) {
+                vt.setLineSaver(rvt::Screen::LineSaver::from_ref(save_lines));
+            }
+            if (!timelines.empty()) {
+                screen_tracker.emplace(vt);
+                screen_tracker->update();
+            }
+            if (alternate_screen_snapshot) {
+                vt.setAlternateScreenSaver(make_alternate_screen_saver(
+                    rvt::Screen::LineSaver::from_ref(save_lines)));
+            }
+        };
+
+        auto update_timelines = [&](uint64_t time, uint64_t bytes){
+            auto const changes = screen_tracker->update();
+            bool const alternate_screen = vt.isAlternateScreen();
+            for (auto& timeline : timelines) {
+                uint64_t const period = time / timeline.interval;
+                if (period != timeline.period) {
+                    timeline.write_entry();
+                    timeline.period = period;
+                }
+                timeline.bytes += bytes;
+                timeline.cells += changes.cells;
+                timeline.lines += saved_lines;
+                timeline.erased |= changes.cleared;
+                timeline.reset |= changes.reset;
+                timeline.alternate_screen |= alternate_screen;
+            }
+            saved_lines = 0;
+        };
+
+        auto ucs_receiver = [&vt](rvt::ucs4_char ucs) { vt.receiveChar(ucs); };
+
+        bool first_frame = true;
+        bool in_window = false;
+        bool past_window = false;
+
+        uint64_t last_time = 0;
+
+        uint32_t sec;
+        uint32_t usec;
+        uint32_t frame_len;
+        while (reader.next_header(sec, usec, frame_len)) {
+            uint64_t const time = uint64_t(sec) * 1000000 + usec;
+
+            if (sec >= replay.end_time) {
+                past_window = true;
+                if (in_window) {
+                    if (int errnum = take_screenshots(window_end, false)) {
+                        finalize();
+                        return errnum;
+                    }
+                }
+                break;
+            }
+            if (!in_window && sec >= replay.start_time) {
+                enable_savers();
+                in_window = true;
+                for (auto& screenshot : screenshots) {
+                    if (screenshot.sink.interval) {
+                        screenshot.next_time = time;
+                    }
+                }
+            }
+
+            if (int errnum = take_screenshots(time, false)) {
+                finalize();
+                return errnum;
+            }
+            last_time = time;
+
+            for (auto& render : renders) {
+                render.time = sec;
+                render.usec = usec;
+            }
+            frame_sec = sec;
+            frame_usec = usec;
+
+            uint8_t const * frame = reader.next_body(frame_len);
+            if (!frame) {
+                break;
+            }
+            emu.decoder.decode({frame, frame_len}, ucs_receiver);
+            vt.flushSavedLines();
+
+            if (!in_window) {
+                continue;
+            }
+
+            if (screen_tracker) {
+                update_timelines(time, frame_len);
+            }
+
+            alternate_screen_timer.update(vt, sec);
+
+            if (alert_errnum) {
+                finalize();
+                return alert_errnum;
+            }
+
+            for (auto& snapshot : snapshots) {
+                if (!snapshot.interval) {
+                    continue;
+                }
+                if (first_frame) {
+                    snapshot.next_snapshot = sec + snapshot.interval;
+                }
+                else if (sec >= snapshot.next_snapshot) {
+                    if (int errnum = save_snapshot(snapshot)) {
+                        finalize();
+                        return errnum;
+                    }
+                    snapshot.next_snapshot = sec + snapshot.interval;
+                }
+            }
+
+            for (auto const& frame : replay.frames) {
+                if (int errnum = frame.fn(frame.ctx, &emu, sec, usec)) {
+                    finalize();
+                    return errnum;
+                }
+            }
+
+            first_frame = false;
+        }
+
+        emu.decoder.end_decode(ucs_receiver);
+        vt.flushSavedLines();
+
+        if (in_window) {
+            if (vt.isAlternateScreen()) {
+                vt.saveAlternateScreen();
+            }
+            vt.commitLines();
+
+            if (screen_tracker) {
+                update_timelines(last_time, 0);
+                for (auto& timeline : timelines) {
+                    timeline.write_entry();
+                }
+            }
+
+            if (alert_errnum) {
+                finalize();
+                return alert_errnum;
+            }
+
+            for (auto& snapshot : snapshots) {
+                if (int errnum = save_snapshot(snapshot)) {
+                    finalize();
+                    return errnum;
+                }
+            }
+
+            if (!past_window) {
+                if (int errnum = take_screenshots(last_time + 1, true)) {
+                    finalize();
+                    return errnum;
+                }
+            }
+        }
+
+        finalize();
+
+        return past_window ? 0 : reader.error();
+    }
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_ttyrec_buffer(
+    TerminalEmulatorReplay const * replay,
+    uint8_t const * data, std::size_t data_len) noexcept
+{
+    return_if(!replay || (data_len && !data));
+
+    Panic_errno(
+        TerminalEmulator emu(20, 80);
+        TtyrecReader reader(data, data_len);
+        return replay_ttyrec(*replay, emu, reader);
+    );
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_ttyrec_fd(
+    TerminalEmulatorReplay const * replay, int fd) noexcept
+{
+    return_if(!replay || fd < 0);
+
+    Panic_errno(
+        TerminalEmulator emu(20, 80);
+        TtyrecReader reader(fd);
+        return replay_ttyrec(*replay, emu, reader);
+    );
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_ttyrec_file(
+    TerminalEmulatorReplay const * replay, char const * infile) noexcept
+{
+    return_if(!replay || !infile);
+
+    int fd = open(infile, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno_or_single_error();
+    }
+    FileCloser file_closer{fd};
+
+    return terminal_emulator_replay_ttyrec_fd(replay, fd);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer(
+    TerminalEmulatorBuffer * buffer,
+    uint8_t const * data, std::size_t data_len,
+    TerminalEmulatorTranscriptPrefix prefix_type) noexcept
+{
+    TerminalEmulatorTranscriptOptions options;
+    options.prefix_type = prefix_type;
+    return terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+        buffer, data, data_len, &options);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+    TerminalEmulatorBuffer * buffer,
+    uint8_t const * data, std::size_t data_len,
+    TerminalEmulatorTranscriptOptions const * options) noexcept
+{
+    return_if(!buffer || !options);
+
+    TerminalEmulatorReplay replay;
+    Panic_errno(replay.transcripts.push_back({buffer, *options}));
+    return terminal_emulator_replay_ttyrec_buffer(&replay, data, data_len);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window(
+    TerminalEmulatorBuffer * buffer,
+    uint8_t const * data, std::size_t data_len,
+    TerminalEmulatorTranscriptOptions const * options,
+    uint32_t start_time, uint32_t end_time) noexcept
+{
+    return_if(!buffer || !options || start_time > end_time);
+
+    TerminalEmulatorReplay replay;
+    Panic_errno(replay.transcripts.push_back({buffer, *options}));
+    replay.start_time = start_time;
+    replay.end_time = end_time;
+    return terminal_emulator_replay_ttyrec_buffer(&replay, data, data_len);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd(
+    TerminalEmulatorBuffer * buffer, int fd,
+    TerminalEmulatorTranscriptOptions const * options) noexcept
+{
+    return_if(!buffer || !options);
+
+    TerminalEmulatorReplay replay;
+    Panic_errno(replay.transcripts.push_back({buffer, *options}));
+    return terminal_emulator_replay_ttyrec_fd(&replay, fd);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(
+    TerminalEmulatorBuffer * buffer,
+    char const * infile,
+    TerminalEmulatorTranscriptPrefix prefix_type) noexcept
+{
+    TerminalEmulatorTranscriptOptions options;
+    options.prefix_type = prefix_type;
+    return terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(
+        buffer, infile, &options);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(
+    TerminalEmulatorBuffer * buffer,
+    char const * infile,
+    TerminalEmulatorTranscriptOptions const * options) noexcept
+{
+    return_if(!buffer || !options);
+
+    TerminalEmulatorReplay replay;
+    Panic_errno(replay.transcripts.push_back({buffer, *options}));
+    return terminal_emulator_replay_ttyrec_file(&replay, infile);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_time_window(
+    TerminalEmulatorBuffer * buffer,
+    char const * infile,
+    TerminalEmulatorTranscriptOptions const * options,
+    uint32_t start_time, uint32_t end_time) noexcept
+{
+    return_if(!buffer || !options || start_time > end_time);
+
+    TerminalEmulatorReplay replay;
+    Panic_errno(replay.transcripts.push_back({buffer, *options}));
+    replay.start_time = start_time;
+    replay.end_time = end_time;
+    return terminal_emulator_replay_ttyrec_file(&replay, infile);
+}
+
+namespace
+{
+    struct TranscriptCheckpoint
+    {
+        std::unique_ptr<rvt::VtEmulator> emu;
+        rvt::Utf8Decoder decoder;
+        AlternateScreenTimer alternate_screen_timer;
+        uint64_t jsonl_group;
+        /// first frame of the segment
+        uint8_t const * data;
+    };
+
+    int prepare_transcript_parallel(
+        TerminalEmulatorBuffer & buffer,
+        uint8_t const * data, std::size_t data_len,
+        TerminalEmulatorTranscriptOptions const & options,
+        TerminalEmulatorThreadPool * pool, std::size_t segment_size)
+    {
+        if (!segment_size) {
+            segment_size = 4 * 1024 * 1024;
+        }
+
+        TranscryptRender output{buffer.as_rendering_buffer()};
+        if (!output.init(options)) {
+            return -2;
+        }
+
+        bool const commit_mode = options.line_mode == TerminalEmulatorTranscriptLineMode::commit;
+        bool const alternate_screen_snapshot
+          = options.alternate_screen == TerminalEmulatorTranscriptAlternateScreen::snapshot;
+        bool const is_jsonl = options.format == TerminalEmulatorTranscriptFormat::jsonl;
+
+        auto init_emulator = [&](rvt::VtEmulator& emu, rvt::Screen::LineSaver save_lines){
+            if (commit_mode) {
+                emu.setLineSaveMode(rvt::Screen::LineSaveMode::Commit);
+            }
+            emu.setLineSaveBatching(output.supports_line_batching());
+            if (alternate_screen_snapshot) {
+                emu.setAlternateScreenSaver(make_alternate_screen_saver(save_lines));
+            }
+            emu.setLineSaver(std::move(save_lines));
+        };
+
+        auto* data_end = data + data_len;
+
+        /// \return position after the last complete frame
+        auto replay_frames = [data_end](
+            rvt::VtEmulator& emu, rvt::Utf8Decoder& decoder, AlternateScreenTimer& timer,
+            uint8_t const * p, uint8_t const * end, auto&& on_frame, auto&& on_frame_end
+        ) {
+            auto ucs_receiver = [&emu](rvt::ucs4_char ucs) { emu.receiveChar(ucs); };
+            while (p != end && data_end - p > 12) {
+                uint32_t const sec  = read_tty_u32(p);
+                uint32_t const usec = read_tty_u32(p + 4);
+                uint32_t frame_len  = read_tty_u32(p + 8);
+                if (frame_len > data_end - p - 12) {
+                    break;
+                }
+                on_frame(sec, usec);
+                decoder.decode({p + 12, frame_len}, ucs_receiver);
+                emu.flushSavedLines();
+                timer.update(emu, sec);
+                p += 12 + frame_len;
+                on_frame_end(p);
+            }
+            return p;
+        };
+
+        // first pass: emulation without rendering (savers are needed for
+        // the states of commit mode and alternate screen snapshot)
+        std::vector<TranscriptCheckpoint> checkpoints;
+        uint8_t const * end_of_frames;
+        {
+            uint64_t jsonl_group = 0;
+            rvt::VtEmulator emu(20, 80);
+            rvt::Utf8Decoder decoder;
+            AlternateScreenTimer timer;
+            timer.interval = alternate_screen_snapshot ? options.snapshot_interval : 0;
+
+            init_emulator(emu, is_jsonl
+                ? rvt::Screen::LineSaver([&jsonl_group](rvt::Screen const& screen, size_t y, size_t yend){
+                    jsonl_group += rvt::transcript_line_count(screen, y, yend);
+                })
+                : rvt::Screen::LineSaver([](rvt::Screen const&, size_t, size_t){}));
+
+            auto push_checkpoint = [&](uint8_t const * p){
+                auto cp_emu = std::make_unique<rvt::VtEmulator>(20, 80);
+                cp_emu->copyState(emu);
+                checkpoints.push_back({std::move(cp_emu), decoder, timer, jsonl_group, p});
+            };
+
+            push_checkpoint(data);
+            end_of_frames = replay_frames(emu, decoder, timer, data, data_end,
+                [](uint32_t /*sec*/, uint32_t /*usec*/){},
+                [&](uint8_t const * p){
+                    if (std::size_t(p - checkpoints.back().data) >= segment_size && p != data_end) {
+                        push_checkpoint(p);
+                    }
+                });
+        }
+
+        // second pass: segments rendered in parallel
+        std::size_t const nb_segment = checkpoints.size();
+        std::vector<std::vector<uint8_t>> segments(nb_segment);
+
+        for_each_index(pool, nb_segment, [&](std::size_t i){
+            auto const& checkpoint = checkpoints[i];
+            bool const is_last = (i + 1 == nb_segment);
+
+            TranscryptRender render{rvt::RenderingBuffer::from_vector(segments[i])};
+            render.init(options);
+            render.jsonl_ctx.group = checkpoint.jsonl_group;
+
+            rvt::VtEmulator emu(20, 80);
+            auto save_lines = [&render, &emu](rvt::Screen const& screen, size_t y, size_t yend){
+                render.save_lines(screen, y, yend, emu.isAlternateScreen(screen));
+            };
+            init_emulator(emu, rvt::Screen::LineSaver::from_ref(save_lines));
+            emu.copyState(*checkpoint.emu);
+
+            rvt::Utf8Decoder decoder = checkpoint.decoder;
+            AlternateScreenTimer timer = checkpoint.alternate_screen_timer;
+
+            auto* end = is_last ? end_of_frames : checkpoints[i + 1].data;
+            replay_frames(emu, decoder, timer, checkpoint.data, end,
+                [&render](uint32_t sec, uint32_t usec){
+                    render.time = sec;
+                    render.usec = usec;
+                },
+                [](uint8_t const * /*p*/){});
+
+            if (is_last) {
+                decoder.end_decode([&emu](rvt::ucs4_char ucs) { emu.receiveChar(ucs); });
+                emu.flushSavedLines();
+                if (emu.isAlternateScreen()) {
+                    emu.saveAlternateScreen();
+                }
+                emu.commitLines();
+            }
+
+            render.finalize();
+        });
+
+        for (auto const& segment : segments) {
+            output.write_bytes(segment.data(), segment.size());
+        }
+        output.finalize();
+
+        if (end_of_frames != data_end) {
+            return -1;
+        }
+
+        return 0;
+    }
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel(
+    TerminalEmulatorBuffer * buffer,
+    uint8_t const * data, std::size_t data_len,
+    TerminalEmulatorTranscriptOptions const * options,
+    TerminalEmulatorThreadPool * pool, std::size_t segment_size) noexcept
+{
+    return_if(!buffer || !options || (data_len && !data));
+
+    Panic_errno(return prepare_transcript_parallel(*buffer, data, data_len, *options, pool, segment_size));
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel(
+    TerminalEmulatorBuffer * buffer,
+    char const * infile,
+    TerminalEmulatorTranscriptOptions const * options,
+    TerminalEmulatorThreadPool * pool, std::size_t segment_size) noexcept
+{
+    return_if(!buffer || !infile || !options);
+
+    MappedFile file;
+    if (int errnum = file.open(infile)) {
+        return errnum;
+    }
+
+    return terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel(
+        buffer, file.data, file.len, options, pool, segment_size);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_ttyrec_files(
+    char const * const * infiles, char const * const * outfiles, std::size_t n,
+    TerminalEmulatorTranscriptOptions const * options,
+    TerminalEmulatorThreadPool * pool, int * results) noexcept
+{
+    return_if(!options || (n && (!infiles || !outfiles)));
+
+    std::unique_ptr<int[]> results_buffer;
+    if (!results) {
+        results_buffer.reset(new(std::nothrow) int[n]);
+        if (!results_buffer) {
+            return -3;
+        }
+        results = results_buffer.get();
+    }
+
+    /// emulator and buffer reused by each transcript of a thread
+    struct ThreadContext
+    {
+        TerminalEmulator emu {20, 80};
+        TerminalEmulatorBufferWithVector buffer {4u /*Go*/ * 1024 * 1024 * 1024};
+    };
+
+    auto run = [&]{
+        // largest files first
+        std::vector<std::pair<off_t, std::size_t>> files(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            struct stat st;
+            files[i] = {(infiles[i] && stat(infiles[i], &st) == 0) ? st.st_size : 0, i};
+        }
+        std::stable_sort(files.begin(), files.end(), [](auto& a, auto& b){
+            return a.first > b.first;
+        });
+
+        std::unique_ptr<ThreadContext[]> contexts(new ThreadContext[nb_thread(pool)]);
+        rvt::VtEmulator const initial_state(20, 80);
+
+        for_each_index_and_thread(pool, n, [&](unsigned thread_index, std::size_t k){
+            std::size_t const i = files[k].second;
+            auto& context = contexts[thread_index];
+            int& errnum = results[i];
+
+            if (!infiles[i] || !outfiles[i]) {
+                errnum = -2;
+                return;
+            }
+
+            auto& vt = context.emu.emulator;
+            vt.setAlternateScreenSaver(nullptr);
+            vt.setLineSaver(nullptr);
+            vt.copyState(initial_state);
+            context.emu.decoder = rvt::Utf8Decoder();
+
+            TerminalEmulatorReplay replay;
+            replay.transcripts.push_back({&context.buffer, *options});
+
+            int fd_in = open(infiles[i], O_RDONLY | O_CLOEXEC);
+            if (fd_in == -1) {
+                errnum = errno_or_single_error();
+                return;
+            }
+            {
+                FileCloser file_closer{fd_in};
+                TtyrecReader reader(fd_in);
+                errnum = replay_ttyrec(replay, context.emu, reader);
+            }
+            // a truncated recording still has a transcript
+            if (errnum && errnum != -1) {
+                return;
+            }
+
+            int fd = open(outfiles[i], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+            if (fd == -1) {
+                errnum = errno_or_single_error();
+                return;
+            }
+
+            std::size_t len = 0;
+            uint8_t const * data = context.buffer.get_buffer_fn(context.buffer.ctx, &len);
+            int write_errnum = write_all(fd, data, len);
+            if (close(fd) && !write_errnum) {
+                write_errnum = errno_or_single_error();
+            }
+            if (write_errnum) {
+                errnum = write_errnum;
+            }
+        });
+
+        for (std::size_t i = 0; i < n; ++i) {
+            if (results[i]) {
+                return results[i];
+            }
+        }
+        return 0;
+    };
+
+    Panic_errno(return run());
+}
+
+namespace
+{
+    constexpr uint32_t frame_index_magic = 0x49545652; // "RVTI"
+    constexpr uint8_t frame_index_version = 1;
+
+    int build_frame_index(
+        TerminalEmulatorFrameIndex& index, TtyrecReader& reader, int lines, int columns,
+        uint32_t keyframe_interval, uint64_t keyframe_bytes)
+    {
+        TerminalEmulatorFrameIndex new_index;
+        rvt::VtEmulator vt(lines, columns);
+        rvt::Utf8Decoder decoder;
+
+        auto add_keyframe = [&]{
+            std::size_t const state_offset = new_index.states.size();
+            rvt::write_emulator_state(new_index.states, vt, decoder);
+            new_index.keyframes.push_back({
+                new_index.frames.size(), state_offset, new_index.states.size() - state_offset});
+        };
+
+        add_keyframe();
+
+        auto ucs_receiver = [&vt](rvt::ucs4_char ucs) { vt.receiveChar(ucs); };
+
+        uint64_t offset = 0;
+        uint32_t next_keyframe_time = 0;
+        uint64_t next_keyframe_offset = keyframe_bytes;
+
+        uint32_t sec;
+        uint32_t usec;
+        uint32_t frame_len;
+        while (reader.next_header(sec, usec, frame_len)) {
+            if (new_index.frames.empty()) {
+                next_keyframe_time = sec + keyframe_interval;
+            }
+            else if ((keyframe_interval && sec >= next_keyframe_time)
+                  || (keyframe_bytes && offset >= next_keyframe_offset)
+            ) {
+                add_keyframe();
+                next_keyframe_time = sec + keyframe_interval;
+                next_keyframe_offset = offset + keyframe_bytes;
+            }
+
+            new_index.frames.push_back({offset, sec, usec});
+
+            uint8_t const * frame = reader.next_body(frame_len);
+            if (!frame) {
+                break;
+            }
+            decoder.decode({frame, frame_len}, ucs_receiver);
+            offset += 12u + frame_len;
+        }
+
+        if (int errnum = reader.error()) {
+            return errnum;
+        }
+
+        new_index.ttyrec_size = offset;
+        index = std::move(new_index);
+        return 0;
+    }
+
+    void write_frame_index(TerminalEmulatorFrameIndex const& index, std::vector<uint8_t>& out)
+    {
+        rvt::StateWriter writer(out);
+        writer.u32(frame_index_magic);
+        writer.u8(frame_index_version);
+        writer.u64(index.ttyrec_size);
+
+        writer.u64(index.frames.size());
+        for (auto const& frame : index.frames) {
+            writer.u64(frame.offset);
+            writer.u32(frame.sec);
+            writer.u32(frame.usec);
+        }
+
+        writer.u64(index.keyframes.size());
+        for (auto const& keyframe : index.keyframes) {
+            writer.u64(keyframe.frame);
+            writer.u64(keyframe.state_len);
+            writer.bytes({index.states.data() + keyframe.state_offset, keyframe.state_len});
+        }
+    }
+
+    /// \return false with an invalid index. The keyframes reference \p data.
+    bool read_frame_index(TerminalEmulatorFrameIndex& index, std::vector<uint8_t>&& data)
+    {
+        TerminalEmulatorFrameIndex new_index;
+        rvt::StateReader reader({data.data(), data.size()});
+
+        if (reader.u32() != frame_index_magic || reader.u8() != frame_index_version) {
+            return false;
+        }
+        new_index.ttyrec_size = reader.u64();
+
+        uint64_t const frame_count = reader.u64();
+        if (frame_count > reader.remaining() / 16) {
+            return false;
+        }
+        new_index.frames.resize(frame_count);
+        uint64_t min_offset = 0;
+        for (auto& frame : new_index.frames) {
+            frame.offset = reader.u64();
+            frame.sec = reader.u32();
+            frame.usec = reader.u32();
+            if (frame.offset < min_offset || frame.offset >= new_index.ttyrec_size) {
+                return false;
+            }
+            min_offset = frame.offset + 12;
+        }
+
+        // the first keyframe is the initial state
+        uint64_t const keyframe_count = reader.u64();
+        if (keyframe_count == 0 || keyframe_count > reader.remaining() / 16) {
+            return false;
+        }
+        new_index.keyframes.resize(keyframe_count);
+        uint64_t min_frame = 0;
+        for (auto& keyframe : new_index.keyframes) {
+            keyframe.frame = reader.u64();
+            uint64_t const state_len = reader.u64();
+            if (state_len > reader.remaining()) {
+                return false;
+            }
+            keyframe.state_len = std::size_t(state_len);
+            keyframe.state_offset = data.size() - reader.remaining();
+            reader.bytes(keyframe.state_len);
+            if (keyframe.frame < min_frame || keyframe.frame > frame_count) {
+                return false;
+            }
+            min_frame = keyframe.frame + 1;
+        }
+
+        if (reader.failed() || reader.remaining() || new_index.keyframes.front().frame) {
+            return false;
+        }
+
+        new_index.states = std::move(data);
+        index = std::move(new_index);
+        return true;
+    }
+
+    int seek_frame_index(
+        TerminalEmulatorFrameIndex const& index, TerminalEmulator& emu,
+        int fd, uint32_t sec, uint32_t usec)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            return errno_or_single_error();
+        }
+        if (uint64_t(st.st_size) < index.ttyrec_size) {
+            return -1;
+        }
+
+        auto const& frames = index.frames;
+        std::size_t const frame_end = std::size_t(std::partition_point(
+            frames.begin(), frames.end(), [&](auto const& frame){
+                return frame.sec < sec || (frame.sec == sec && frame.usec <= usec);
+            }) - frames.begin());
+
+        auto const& keyframe = *(std::partition_point(
+            index.keyframes.begin(), index.keyframes.end(), [&](auto const& keyframe){
+                return keyframe.frame <= frame_end;
+            }) - 1);
+
+        if (!rvt::read_emulator_state(
+            {index.states.data() + keyframe.state_offset, keyframe.state_len},
+            emu.emulator, emu.decoder
+        )) {
+            return -1;
+        }
+
+        if (keyframe.frame == frame_end) {
+            return 0;
+        }
+
+        if (lseek(fd, off_t(frames[keyframe.frame].offset), SEEK_SET) == -1) {
+            return errno_or_single_error();
+        }
+
+        auto ucs_receiver = [&emu](rvt::ucs4_char ucs) { emu.emulator.receiveChar(ucs); };
+
+        TtyrecReader reader(fd);
+        for (std::size_t i = keyframe.frame; i < frame_end; ++i) {
+            uint32_t frame_sec;
+            uint32_t frame_usec;
+            uint32_t frame_len;
+            if (!reader.next_header(frame_sec, frame_usec, frame_len)) {
+                return reader.error() ? reader.error() : -1;
+            }
+            uint8_t const * frame = reader.next_body(frame_len);
+            if (!frame) {
+                return reader.error() ? reader.error() : -1;
+            }
+            emu.decoder.decode({frame, frame_len}, ucs_receiver);
+        }
+        emu.emulator.flushSavedLines();
+
+        return 0;
+    }
 }
 
 REDEMPTION_LIB_EXPORT
-int terminal_emulator_set_log_function_ctx(
-    TerminalEmulator * emu, TerminalEmulatorLogFunctionCtx * log_func, void * ctx
-) noexcept
+TerminalEmulatorFrameIndex * terminal_emulator_frame_index_new() noexcept
 {
-    return_if(!emu);
+    return new(std::nothrow) TerminalEmulatorFrameIndex();
+}
 
-    Panic_errno(emu->emulator.setLogFunction([log_func, ctx](char const * s, std::size_t len) {
-        log_func(ctx, s, len);
-    }));
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_frame_index_delete(TerminalEmulatorFrameIndex * index) noexcept
+{
+    delete index;
     return 0;
 }
 
 REDEMPTION_LIB_EXPORT
-int terminal_emulator_feed(TerminalEmulator * emu, uint8_t const * s, std::size_t len) noexcept
+int terminal_emulator_frame_index_build_from_ttyrec_fd(
+    TerminalEmulatorFrameIndex * index, int fd, int lines, int columns,
+    uint32_t keyframe_interval, uint64_t keyframe_bytes) noexcept
 {
-    return_if(!emu);
+    return_if(!index || fd < 0 || lines <= 0 || columns <= 0);
 
-    auto send_fn = [emu](rvt::ucs4_char ucs) { emu->emulator.receiveChar(ucs); };
-    Panic_errno(emu->decoder.decode(const_bytes_array(s, len), send_fn));
-    return 0;
+    Panic_errno(
+        TtyrecReader reader(fd);
+        return build_frame_index(*index, reader, lines, columns, keyframe_interval, keyframe_bytes);
+    );
 }
 
 REDEMPTION_LIB_EXPORT
-int terminal_emulator_resize(TerminalEmulator * emu, int lines, int columns) noexcept
+int terminal_emulator_frame_index_build_from_ttyrec_file(
+    TerminalEmulatorFrameIndex * index, char const * infile, int lines, int columns,
+    uint32_t keyframe_interval, uint64_t keyframe_bytes) noexcept
 {
-    return_if(!emu);
-    return_if(lines <= 0 || columns <= 0);
+    return_if(!index || !infile);
 
-    if (lines > 4096 || columns > 4096) {
-        return ENOMEM;
+    int fd = open(infile, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno_or_single_error();
     }
+    FileCloser file_closer{fd};
 
-    Panic_errno(emu->emulator.setScreenSize(lines, columns));
-    return 0;
+    return terminal_emulator_frame_index_build_from_ttyrec_fd(
+        index, fd, lines, columns, keyframe_interval, keyframe_bytes);
 }
 
-
-
 REDEMPTION_LIB_EXPORT
-TerminalEmulatorBuffer* terminal_emulator_buffer_new() noexcept
+int terminal_emulator_frame_index_save(
+    TerminalEmulatorFrameIndex const * index, char const * outfile) noexcept
 {
-    return terminal_emulator_buffer_new_with_max_capacity(4u /*Go*/ * 1024 * 1024 * 1024, 0);
+    return_if(!index || !outfile || index->keyframes.empty());
+
+    std::vector<uint8_t> data;
+    Panic_errno(write_frame_index(*index, data));
+
+    int fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd == -1) {
+        return errno_or_single_error();
+    }
+
+    int errnum = write_all(fd, data.data(), data.size());
+    if (close(fd) && !errnum) {
+        errnum = errno_or_single_error();
+    }
+    return errnum;
 }
 
 REDEMPTION_LIB_EXPORT
-TerminalEmulatorBuffer* terminal_emulator_buffer_new_with_max_capacity(
-    std::size_t max_capacity, std::size_t pre_alloc_len) noexcept
+int terminal_emulator_frame_index_load(
+    TerminalEmulatorFrameIndex * index, char const * infile) noexcept
 {
-    static_assert(noexcept(TerminalEmulatorBufferWithVector(max_capacity)));
-    auto* res = new(std::nothrow) TerminalEmulatorBufferWithVector{max_capacity};
-    if (res && pre_alloc_len) {
-        if (!res->initial_size(pre_alloc_len)) {
-            delete res;
-            return nullptr;
+    return_if(!index || !infile);
+
+    int fd = open(infile, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno_or_single_error();
+    }
+    FileCloser file_closer{fd};
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return errno_or_single_error();
+    }
+
+    std::vector<uint8_t> data;
+    Panic_errno(data.resize(std::size_t(st.st_size)));
+
+    std::size_t len = 0;
+    while (len < data.size()) {
+        ssize_t const r = read(fd, data.data() + len, data.size() - len);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno_or_single_error();
+        }
+        if (r == 0) {
+            break;
         }
+        len += std::size_t(r);
     }
-    return res;
-}
+    data.resize(len);
 
-REDEMPTION_LIB_EXPORT
-TerminalEmulatorBuffer * terminal_emulator_buffer_new_with_custom_allocator(
-    void * ctx,
-    TerminalEmulatorBufferGetBufferFn * get_buffer_fn,
-    TerminalEmulatorBufferExtraMemoryAllocatorFn * extra_memory_allocator_fn,
-    TerminalEmulatorBufferSetFinalBufferFn * set_final_buffer_fn,
-    TerminalEmulatorBufferClearFn * clear_fn,
-    TerminalEmulatorBufferDeleteCtxFn * delete_ctx_fn) noexcept
-{
-    return new(std::nothrow) TerminalEmulatorBuffer{
-        ctx,
-        get_buffer_fn,
-        extra_memory_allocator_fn,
-        set_final_buffer_fn,
-        clear_fn,
-        delete_ctx_fn,
-        [](TerminalEmulatorBuffer* self) noexcept { delete self; }
-    };
+    Panic_errno(return read_frame_index(*index, std::move(data)) ? 0 : -1);
 }
 
 REDEMPTION_LIB_EXPORT
-int terminal_emulator_buffer_delete(TerminalEmulatorBuffer * buffer) noexcept
+std::size_t terminal_emulator_frame_index_frame_count(
+    TerminalEmulatorFrameIndex const * index) noexcept
 {
-    return_if(!buffer);
-    buffer->delete_ctx_fn(buffer->ctx);
-    buffer->delete_self(buffer);
-    return 0;
+    return index ? index->frames.size() : 0;
 }
 
 REDEMPTION_LIB_EXPORT
-int terminal_emulator_buffer_prepare(
-    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
-    TerminalEmulatorOutputFormat format
-) noexcept
+int terminal_emulator_frame_index_get_frame_time(
+    TerminalEmulatorFrameIndex const * index, std::size_t i,
+    uint32_t * sec, uint32_t * usec) noexcept
 {
-    return_if(!buffer || !emu);
+    return_if(!index || i >= index->frames.size() || !sec || !usec);
 
-    return build_format_string(*buffer, *emu, format, {});
+    *sec = index->frames[i].sec;
+    *usec = index->frames[i].usec;
+    return 0;
 }
 
 REDEMPTION_LIB_EXPORT
-int terminal_emulator_buffer_prepare2(
-    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
-    TerminalEmulatorOutputFormat format,
-    uint8_t const * extra_data, std::size_t extra_data_len
-) noexcept
+int terminal_emulator_frame_index_seek(
+    TerminalEmulatorFrameIndex const * index, TerminalEmulator * emu,
+    char const * infile, uint32_t sec, uint32_t usec) noexcept
 {
-    return_if(!buffer || !emu);
-
-    std::string_view extra = {const_bytes_t(extra_data).to_charp(), extra_data_len};
-    return build_format_string(*buffer, *emu, format, extra);
-}
+    return_if(!index || !emu || !infile || index->keyframes.empty());
 
-REDEMPTION_LIB_EXPORT
-uint8_t const * terminal_emulator_buffer_get_data(
-    TerminalEmulatorBuffer const * buffer, std::size_t * output_len) noexcept
-{
-    if (REDEMPTION_UNLIKELY(!buffer)) {
-        if (output_len) {
-            *output_len = 0;
-        }
-        return nullptr;
+    int fd = open(infile, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno_or_single_error();
     }
+    FileCloser file_closer{fd};
 
-    std::size_t output_len2;
-    return buffer->get_buffer_fn(buffer->ctx, output_len ? output_len : &output_len2);
-}
-
-REDEMPTION_LIB_EXPORT
-int terminal_emulator_buffer_clear_data(TerminalEmulatorBuffer * buffer) noexcept
-{
-    return_if(!buffer);
-    buffer->clear_fn(buffer->ctx);
-    return 0;
+    emu->clear_journal();
+    Panic_errno(return seek_frame_index(*index, *emu, fd, sec, usec));
 }
 
 namespace
 {
-    struct TranscryptRender
+    /// Visible state of an emulator which is not in the cells of the screen
+    struct VisibleCursorAndTitle
     {
-        rvt::RenderingBuffer rendering_buffer;
-        std::size_t consumed_buffer = 0;
-        time_t time = 0;
+        int x = 0;
+        int y = 0;
+        bool visible = false;
+        std::vector<rvt::ucs4_char> title;
 
-        void write_line(rvt::Screen const& screen, size_t y, size_t yend)
+        /// \return false when the state changes
+        bool update(rvt::VtEmulator const& vt)
         {
-            auto partial_buf = transcript_partial_rendering(screen, y, yend, rendering_buffer, consumed_buffer);
-            rendering_buffer.buffer = partial_buf.buffer;
-            rendering_buffer.length = partial_buf.capacity;
-            consumed_buffer = partial_buf.length;
+            rvt::Screen const& screen = vt.getCurrentScreen();
+            auto const new_title = vt.getWindowTitle();
+            bool const unchanged = x == screen.getCursorX()
+                                && y == screen.getCursorY()
+                                && visible == screen.hasCursorVisible()
+                                && std::equal(title.begin(), title.end(), new_title.begin(), new_title.end());
+            if (!unchanged) {
+                x = screen.getCursorX();
+                y = screen.getCursorY();
+                visible = screen.hasCursorVisible();
+                title.assign(new_title.begin(), new_title.end());
+            }
+            return unchanged;
         }
+    };
 
-        void write_time()
+    /// Times of the written frames with the idle gaps reduced to a maximum
+    class IdleReducer
+    {
+    public:
+        /// \param max_idle  in milliseconds, 0 for disable
+        explicit IdleReducer(uint32_t max_idle) noexcept
+        : _max_idle_us(uint64_t(max_idle) * 1000)
+        {}
+
+        /// \return the new time of a frame written at \p time
+        uint64_t next(uint64_t time) noexcept
         {
-            if (REDEMPTION_UNLIKELY(rendering_buffer.length - consumed_buffer < 21)) {
-                std::size_t capacity = 4 * 1024;
-                auto p = start_buffer();
-                p = rendering_buffer.allocate(rendering_buffer.ctx, &capacity, p, consumed_buffer);
-                if (REDEMPTION_UNLIKELY(not p)) {
-                    throw std::bad_alloc();
+            if (_max_idle_us && _has_previous && time > _previous_time
+             && time - _previous_time > _max_idle_us
+            ) {
+                _shift += time - _previous_time - _max_idle_us;
+            }
+            _has_previous = true;
+            _previous_time = time;
+            return time - std::min(_shift, time);
+        }
+
+    private:
+        uint64_t _max_idle_us;
+        // original time of the last written frame
+        uint64_t _previous_time = 0;
+        // time removed by max_idle
+        uint64_t _shift = 0;
+        bool _has_previous = false;
+    };
+
+    int remove_noop_frames(
+        TtyrecReader& reader, TtyrecWriter& writer, int lines, int columns,
+        uint32_t max_idle, uint64_t * frame_counts)
+    {
+        rvt::VtEmulator vt(lines, columns);
+        rvt::Utf8Decoder decoder;
+        rvt::ScreenTracker screen_tracker(vt);
+        VisibleCursorAndTitle cursor_and_title;
+        screen_tracker.update();
+        cursor_and_title.update(vt);
+
+        auto ucs_receiver = [&vt](rvt::ucs4_char ucs) { vt.receiveChar(ucs); };
+
+        IdleReducer idle_reducer(max_idle);
+        uint64_t nb_read = 0;
+        uint64_t nb_written = 0;
+        // bytes of the frames without visible change
+        std::vector<uint8_t> pending;
+        uint64_t pending_time = 0;
+
+        auto write_frame = [&](uint64_t time, array_view<uint8_t const> data){
+            ++nb_written;
+            return writer.write_frame(idle_reducer.next(time), data);
+        };
+
+        auto write_pending = [&]{
+            int errnum = write_frame(pending_time, {pending.data(), pending.size()});
+            pending.clear();
+            return errnum;
+        };
+
+        int errnum = 0;
+
+        uint32_t sec;
+        uint32_t usec;
+        uint32_t frame_len;
+        while (reader.next_header(sec, usec, frame_len)) {
+            uint8_t const * frame = reader.next_body(frame_len);
+            if (!frame) {
+                break;
+            }
+            ++nb_read;
+
+            uint64_t const time = uint64_t(sec) * 1000000 + usec;
+
+            decoder.decode({frame, frame_len}, ucs_receiver);
+            auto const changes = screen_tracker.update();
+            bool const unchanged = cursor_and_title.update(vt) && !changes.cells && !changes.resized;
+
+            if (pending.size() + frame_len > std::numeric_limits<uint32_t>::max()) {
+                if ((errnum = write_pending())) {
+                    break;
                 }
-                rendering_buffer.buffer = bytes_t(p).to_charp();
-                rendering_buffer.length = capacity;
             }
 
-            char* p = rendering_buffer.buffer;
-            struct tm tm;
-            p += strftime(p, 21, "%Y-%m-%d %H:%M:%S ", localtime_r(&time, &tm));
-            consumed_buffer = checked_int(p - rendering_buffer.buffer);
+            if (unchanged) {
+                pending.insert(pending.end(), frame, frame + frame_len);
+                pending_time = time;
+            }
+            else if (pending.empty()) {
+                if ((errnum = write_frame(time, {frame, frame_len}))) {
+                    break;
+                }
+            }
+            else {
+                pending.insert(pending.end(), frame, frame + frame_len);
+                pending_time = time;
+                if ((errnum = write_pending())) {
+                    break;
+                }
+            }
         }
 
-        void finalize()
-        {
-            rendering_buffer.set_final_buffer(rendering_buffer.ctx, start_buffer(), consumed_buffer);
+        if (!errnum && !pending.empty()) {
+            errnum = write_pending();
+        }
+        if (!errnum) {
+            errnum = writer.flush();
         }
 
-        uint8_t* start_buffer() const
-        {
-            return bytes_t(rendering_buffer.buffer).to_u8p();
+        if (frame_counts) {
+            frame_counts[0] = nb_read;
+            frame_counts[1] = nb_written;
         }
-    };
+
+        return errnum ? errnum : reader.error();
+    }
 }
 
-REDEMPTION_LIB_EXPORT
-int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer(
-    TerminalEmulatorBuffer * buffer,
-    uint8_t const * data, std::size_t data_len,
-    TerminalEmulatorTranscriptPrefix prefix_type) noexcept
+namespace
 {
-    return_if(!buffer);
+    int reencode_frames(
+        TtyrecReader& reader, TtyrecWriter& writer, int lines, int columns,
+        uint32_t max_idle, uint64_t * frame_counts)
+    {
+        rvt::VtEmulator vt(lines, columns);
+        rvt::Utf8Decoder decoder;
+        rvt::ScreenDiffEncoder encoder(lines, columns);
 
-    TranscryptRender render{buffer->as_rendering_buffer()};
+        auto ucs_receiver = [&vt](rvt::ucs4_char ucs) { vt.receiveChar(ucs); };
 
-    auto line_saver = [&render](rvt::Screen const& screen, size_t y, size_t yend){
-        render.write_line(screen, y, yend);
-    };
-    auto line_saver_with_datetime = [&render](rvt::Screen const& screen, size_t y, size_t yend){
-        render.write_time();
-        render.write_line(screen, y, yend);
-    };
+        IdleReducer idle_reducer(max_idle);
+        uint64_t nb_read = 0;
+        uint64_t nb_written = 0;
+        std::string sequences;
 
-    auto run = [&]{
-        rvt::VtEmulator emu(20, 80,
-            (prefix_type == TerminalEmulatorTranscriptPrefix::datetime)
-            ? rvt::Screen::LineSaver(line_saver_with_datetime)
-            : rvt::Screen::LineSaver(line_saver));
-        rvt::Utf8Decoder decoder;
-        auto ucs_receiver = [&emu](rvt::ucs4_char ucs) { emu.receiveChar(ucs); };
+        int errnum = 0;
 
-        auto* data_end = data + data_len;
+        uint32_t sec;
+        uint32_t usec;
+        uint32_t frame_len;
+        while (reader.next_header(sec, usec, frame_len)) {
+            uint8_t const * frame = reader.next_body(frame_len);
+            if (!frame) {
+                break;
+            }
+            ++nb_read;
 
-        auto read_tty_u32 = [](uint8_t const* p) -> uint32_t {
-            return p[0] | uint32_t(p[1] << 8) | uint32_t(p[2] << 16) | uint32_t(p[3] << 24);
-        };
+            decoder.decode({frame, frame_len}, ucs_receiver);
+            sequences.clear();
+            encoder.encode(vt, sequences);
 
-        while (data != data_end && data_end - data > 12) {
-            uint32_t const sec  = read_tty_u32(data);
-            //uint32_t const usec = read_tty_u32(data() + 4);
-            uint32_t frame_len  = read_tty_u32(data + 8);
-            render.time = sec /*+ (usec / 1000000)*/;
-            data += 12;
+            // no visible change
+            if (sequences.empty()) {
+                continue;
+            }
 
-            if (frame_len > data_end - data) {
+            ++nb_written;
+            uint64_t const time = uint64_t(sec) * 1000000 + usec;
+            if ((errnum = writer.write_frame(idle_reducer.next(time), {
+                const_bytes_t(sequences.data()).to_u8p(), sequences.size()
+            }))) {
                 break;
             }
-            decoder.decode({data, frame_len}, ucs_receiver);
-            data += frame_len;
         }
 
-        decoder.end_decode(ucs_receiver);
-        render.finalize();
+        if (!errnum) {
+            errnum = writer.flush();
+        }
 
-        if (data != data_end) {
-            return -1;
+        if (frame_counts) {
+            frame_counts[0] = nb_read;
+            frame_counts[1] = nb_written;
         }
 
-        return 0;
-    };
+        return errnum ? errnum : reader.error();
+    }
+}
 
-    Panic_errno(return run());
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_ttyrec_remove_noop_frames_fd(
+    int infd, int outfd, int lines, int columns,
+    uint32_t max_idle, uint64_t * frame_counts) noexcept
+{
+    return_if(infd < 0 || outfd < 0 || lines <= 0 || columns <= 0);
+
+    Panic_errno(
+        TtyrecReader reader(infd);
+        TtyrecWriter writer(outfd);
+        return remove_noop_frames(reader, writer, lines, columns, max_idle, frame_counts);
+    );
 }
 
 REDEMPTION_LIB_EXPORT
-int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(
-    TerminalEmulatorBuffer * buffer,
-    char const * infile,
-    TerminalEmulatorTranscriptPrefix prefix_type) noexcept
+int terminal_emulator_ttyrec_remove_noop_frames(
+    char const * infile, char const * outfile, int lines, int columns,
+    uint32_t max_idle, uint64_t * frame_counts) noexcept
 {
-    return_if(!buffer || !infile);
+    return_if(!infile || !outfile);
 
-    int fd_in { open(infile, O_RDONLY) };
-    if (fd_in == -1) {
+    int infd = open(infile, O_RDONLY | O_CLOEXEC);
+    if (infd == -1) {
         return errno_or_single_error();
     }
+    FileCloser infile_closer{infd};
 
-    struct FileCloser
-    {
-        ~FileCloser()
-        {
-            close(fd);
-        }
-
-        int fd;
-    };
-    FileCloser _file_closer{fd_in};
-
-    struct stat s;
-    int status = fstat(fd_in, & s);
-    if (status == -1) {
+    int outfd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (outfd == -1) {
         return errno_or_single_error();
     }
 
-    auto data_len = static_cast<std::size_t>(s.st_size);
+    int errnum = terminal_emulator_ttyrec_remove_noop_frames_fd(
+        infd, outfd, lines, columns, max_idle, frame_counts);
+    if (close(outfd) && !errnum) {
+        errnum = errno_or_single_error();
+    }
+    return errnum;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_ttyrec_reencode_fd(
+    int infd, int outfd, int lines, int columns,
+    uint32_t max_idle, uint64_t * frame_counts) noexcept
+{
+    return_if(infd < 0 || outfd < 0 || lines <= 0 || columns <= 0);
 
-    if (data_len == 0) {
-        TranscryptRender{buffer->as_rendering_buffer()}.finalize();
-        return 0;
+    Panic_errno(
+        TtyrecReader reader(infd);
+        TtyrecWriter writer(outfd);
+        return reencode_frames(reader, writer, lines, columns, max_idle, frame_counts);
+    );
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_ttyrec_reencode(
+    char const * infile, char const * outfile, int lines, int columns,
+    uint32_t max_idle, uint64_t * frame_counts) noexcept
+{
+    return_if(!infile || !outfile);
+
+    int infd = open(infile, O_RDONLY | O_CLOEXEC);
+    if (infd == -1) {
+        return errno_or_single_error();
     }
+    FileCloser infile_closer{infd};
 
-    auto* data = static_cast<uint8_t*>(mmap(nullptr, data_len, PROT_READ, MAP_PRIVATE, fd_in, 0));
-    if (data == MAP_FAILED) {
+    int outfd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (outfd == -1) {
         return errno_or_single_error();
     }
 
-    int res = terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer(
-        buffer, data, data_len, prefix_type
+    int errnum = terminal_emulator_ttyrec_reencode_fd(
+        infd, outfd, lines, columns, max_idle, frame_counts);
+    if (close(outfd) && !errnum) {
+        errnum = errno_or_single_error();
+    }
+    return errnum;
+}
+
+
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorMirror * terminal_emulator_mirror_new(int lines, int columns, int use_repeat) noexcept
+{
+    return_nullptr_if(lines <= 0 || columns <= 0);
+    Panic(return new(std::nothrow) TerminalEmulatorMirror(lines, columns, use_repeat != 0), nullptr);
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_mirror_delete(TerminalEmulatorMirror * mirror) noexcept
+{
+    delete mirror;
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_mirror_update(
+    TerminalEmulatorMirror * mirror, TerminalEmulator const * emu,
+    TerminalEmulatorBuffer * buffer) noexcept
+{
+    return_if(!mirror || !emu || !buffer);
+
+    Panic_errno(
+        mirror->encoder.encode(emu->emulator, mirror->sequences);
+        set_buffer_data(*buffer, const_bytes_t(mirror->sequences.data()).to_u8p(),
+                        mirror->sequences.size());
+        mirror->sequences.clear();
     );
-    munmap(data, data_len);
-    return res;
+    return 0;
+}
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_mirror_reset(TerminalEmulatorMirror * mirror) noexcept
+{
+    return_if(!mirror);
+
+    Panic_errno(mirror->encoder.reset(mirror->sequences));
+    return 0;
 }
 
 } // extern "C"
@@ -30,15 +30,73 @@ extern "C"
 
 class TerminalEmulator;
 class TerminalEmulatorBuffer;
+class TerminalEmulatorThreadPool;
+class TerminalEmulatorTranscriptOptions;
+class TerminalEmulatorReplay;
+class TerminalEmulatorKeywordMatcher;
+class TerminalEmulatorFrameIndex;
+class TerminalEmulatorMirror;
 
 enum class TerminalEmulatorOutputFormat : int {
     json,
-    ansi
+    ansi,
+    text,
+};
+
+enum class TerminalEmulatorMinimapFormat : int {
+    json,
+    rgb,
+};
+
+enum class TerminalEmulatorMinimapGlyph : int {
+    density,
+    dominant,
+};
+
+enum class TerminalEmulatorImageFormat : int {
+    ppm,
+    pam,
 };
 
 enum class TerminalEmulatorTranscriptPrefix : int {
     noprefix,
+    /// "YYYY-MM-DD hh:mm:ss " in local time
     datetime,
+    /// "YYYY-MM-DD hh:mm:ss " in UTC
+    datetime_utc,
+    /// "ssssssssss.uuuuuu ", seconds since epoch
+    epoch,
+    /// "YYYY-MM-DDThh:mm:ss.mmm+hh:mm " in local time
+    iso8601_ms,
+    /// "YYYY-MM-DDThh:mm:ss.uuuuuu+hh:mm " in local time
+    iso8601_us,
+    /// "YYYY-MM-DDThh:mm:ss.mmmZ "
+    iso8601_ms_utc,
+    /// "YYYY-MM-DDThh:mm:ss.uuuuuuZ "
+    iso8601_us_utc,
+};
+
+enum class TerminalEmulatorTranscriptLineMode : int {
+    /// a line is written each time the cursor leaves it
+    cursor_move,
+    /// a line is written once, when it is scrolled out, erased, overwritten or at end of stream
+    commit,
+};
+
+enum class TerminalEmulatorTranscriptAlternateScreen : int {
+    /// lines of the alternate screen are written like those of the normal screen
+    lines,
+    /// the whole alternate screen is written when it is left, unless unchanged since the previous snapshot
+    snapshot,
+};
+
+enum class TerminalEmulatorTranscriptFormat : int {
+    /// one line of text by line, prefixed with \c TerminalEmulatorTranscriptPrefix
+    text,
+    /// one json object by screen line (prefix is ignored):
+    /// {"t": time_in_us, "y": row, "g": wrapped_line_id, "a": is_alternate_screen, "s": "text"}
+    /// lines of a same wrapped line have the same "g"
+    jsonl,
 };
 
 
@@ -83,6 +141,56 @@ REDEMPTION_LIB_EXPORT
 int terminal_emulator_resize(TerminalEmulator * emu, int lines, int columns) noexcept;
 //END emulator
 
+//BEGIN state
+/// Write the full state of \p emu (screens, cursor, modes, charsets, title,
+/// partial escape sequence and partial UTF-8 character) in \p buffer.
+/// The format is versioned, compact and does not depend on the platform.
+/// Log function, parallel rendering and keyword alert are not saved.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_serialize(
+    TerminalEmulator const * emu, TerminalEmulatorBuffer * buffer) noexcept;
+
+/// Restore a state written by \c terminal_emulator_serialize(), the storage of \p emu is reused.
+/// The size of \p emu becomes the size of the saved state.
+/// \return -1 for an invalid state, \p emu is then reset with its previous size
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_deserialize(
+    TerminalEmulator * emu, uint8_t const * data, std::size_t len) noexcept;
+//END state
+
+//BEGIN journal
+/// Keep the reverse changes of each call of \c terminal_emulator_feed() and \c terminal_emulator_finish()
+/// (a frame): previous content of the modified lines, cursor, modes, title, etc.
+/// The oldest frames are dropped when the journal exceeds \p max_bytes.
+/// The journal is cleared when the state is modified by another function (resize, seek, etc).
+/// \param max_bytes  0 for disable the journal
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_set_journal(TerminalEmulator * emu, std::size_t max_bytes) noexcept;
+
+/// Restore the state before the last frame of the journal.
+/// \return -1 when the journal is empty ; -2 without journal
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_undo_frame(TerminalEmulator * emu) noexcept;
+
+REDEMPTION_LIB_EXPORT
+std::size_t terminal_emulator_journal_frame_count(TerminalEmulator const * emu) noexcept;
+//END journal
+
+//BEGIN thread pool
+/// \param nb_thread  number of threads used by a job (calling thread included), 0 for the number of cores
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorThreadPool * terminal_emulator_thread_pool_new(int nb_thread) noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_thread_pool_delete(TerminalEmulatorThreadPool * pool) noexcept;
+
+/// Split the rendering of screens with at least \p min_cells cells (lines * columns) between the threads of \p pool.
+/// \param pool  nullptr for disable parallel rendering. Must outlive \p emu or the next call.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_set_parallel_rendering(
+    TerminalEmulator * emu, TerminalEmulatorThreadPool * pool, std::size_t min_cells) noexcept;
+//END thread pool
+
 //BEGIN buffer
 using TerminalEmulatorBufferGetBufferFn
   = uint8_t*(void * ctx, std::size_t * output_len) noexcept;
@@ -113,6 +221,24 @@ TerminalEmulatorBuffer * terminal_emulator_buffer_new_with_custom_allocator(
     TerminalEmulatorBufferClearFn * clear_fn,
     TerminalEmulatorBufferDeleteCtxFn * delete_ctx_fn) noexcept;
 
+/// \return 0 or an `errno` code
+using TerminalEmulatorBufferWriteFn
+  = int(void * ctx, uint8_t const * data, std::size_t len) noexcept;
+
+/// Buffer which sends renderings to \p write_fn by blocks of \p block_size bytes (0 for 1 MiB).
+/// Blocks are written by a dedicated thread while the next block is filled, so memory stays bounded.
+/// A rendering larger than \p block_size grows the block.
+/// \c terminal_emulator_buffer_get_data() returns an empty buffer.
+/// A write error is returned by the rendering function.
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorBuffer * terminal_emulator_buffer_new_stream_to_callback(
+    void * ctx, TerminalEmulatorBufferWriteFn * write_fn, std::size_t block_size) noexcept;
+
+/// Same as \c terminal_emulator_buffer_new_stream_to_callback() with a write in \p fd.
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorBuffer * terminal_emulator_buffer_new_stream_to_fd(
+    int fd, std::size_t block_size) noexcept;
+
 REDEMPTION_LIB_EXPORT
 int terminal_emulator_buffer_delete(TerminalEmulatorBuffer * buffer) noexcept;
 
@@ -127,6 +253,32 @@ int terminal_emulator_buffer_prepare2(
     TerminalEmulatorOutputFormat format, uint8_t const * extra_data,
     std::size_t extra_data_len) noexcept;
 
+/// Render the rectangle of cells from (\p first_line, \p first_column) to (\p last_line, \p last_column) included.
+/// The rectangle is truncated to the screen size.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_region(
+    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+    TerminalEmulatorOutputFormat format,
+    int first_line, int last_line, int first_column, int last_column) noexcept;
+
+/// Render a reduced screen where an output cell summarizes a block of \p block_lines x \p block_columns cells.
+/// The rgb format has 3 bytes by output cell and ceil(lines / block_lines) x ceil(columns / block_columns) cells.
+/// \param glyph  unused with rgb format
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_minimap(
+    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+    TerminalEmulatorMinimapFormat format,
+    int block_lines, int block_columns,
+    TerminalEmulatorMinimapGlyph glyph) noexcept;
+
+/// Render an RGB image of screen with a built-in bitmap font.
+/// A character is 8x12 pixels with a \p scale of 1.
+/// \param scale  between 1 and 16
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_image(
+    TerminalEmulatorBuffer * buffer, TerminalEmulator * emu,
+    TerminalEmulatorImageFormat format, int scale) noexcept;
+
 REDEMPTION_LIB_EXPORT
 uint8_t const * terminal_emulator_buffer_get_data(
     TerminalEmulatorBuffer const * buffer, std::size_t * output_len) noexcept;
@@ -135,7 +287,83 @@ REDEMPTION_LIB_EXPORT
 int terminal_emulator_buffer_clear_data(TerminalEmulatorBuffer *) noexcept;
 //END buffer
 
+//BEGIN batch
+/// Render \c emus[i] into \c buffers[i] for each \c i in [0, \p n), spread across the threads of \p pool.
+/// Buffers must be distinct and their allocator functions may be called from any thread of \p pool.
+/// \param pool     nullptr for a rendering by the calling thread
+/// \param results  nullptr or array of \p n elements which receives the error code of each rendering
+/// \return the first error code in order of \p emus or 0
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_render_many(
+    TerminalEmulator * const * emus, std::size_t n,
+    TerminalEmulatorOutputFormat format,
+    TerminalEmulatorBuffer * const * buffers,
+    TerminalEmulatorThreadPool * pool, int * results) noexcept;
+
+/// Render \p n emulators one after the other into \p buffer, spread across the threads of \p pool.
+/// The rendering of \c emus[i] is at [offsets[i], offsets[i+1]) in data of \p buffer.
+/// \param pool     nullptr for a rendering by the calling thread
+/// \param offsets  array of \p n + 1 elements
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_render_many_into_buffer(
+    TerminalEmulatorBuffer * buffer,
+    TerminalEmulator * const * emus, std::size_t n,
+    TerminalEmulatorOutputFormat format,
+    TerminalEmulatorThreadPool * pool, std::size_t * offsets) noexcept;
+//END batch
+
+//BEGIN transcript options
+/// Default options are \c TerminalEmulatorTranscriptPrefix::noprefix, \c TerminalEmulatorTranscriptLineMode::cursor_move
+/// , \c TerminalEmulatorTranscriptAlternateScreen::lines and \c TerminalEmulatorTranscriptFormat::text.
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorTranscriptOptions * terminal_emulator_transcript_options_new() noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_delete(TerminalEmulatorTranscriptOptions * options) noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_set_prefix(
+    TerminalEmulatorTranscriptOptions * options, TerminalEmulatorTranscriptPrefix prefix_type) noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_set_line_mode(
+    TerminalEmulatorTranscriptOptions * options, TerminalEmulatorTranscriptLineMode line_mode) noexcept;
+
+/// \param snapshot_interval  with \c TerminalEmulatorTranscriptAlternateScreen::snapshot,
+///   the alternate screen is also written every \p snapshot_interval seconds of recording (0 for disable)
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_set_alternate_screen(
+    TerminalEmulatorTranscriptOptions * options,
+    TerminalEmulatorTranscriptAlternateScreen alternate_screen,
+    uint32_t snapshot_interval) noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_options_set_format(
+    TerminalEmulatorTranscriptOptions * options, TerminalEmulatorTranscriptFormat format) noexcept;
+//END transcript options
+
 //BEGIN read
+/// Construct a transcript buffer of session recorded by ttyrec.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+    TerminalEmulatorBuffer * buffer,
+    uint8_t const * data, std::size_t data_len,
+    TerminalEmulatorTranscriptOptions const * options) noexcept;
+
+/// Construct a transcript buffer of session recorded by ttyrec.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(
+    TerminalEmulatorBuffer * buffer,
+    char const * infile,
+    TerminalEmulatorTranscriptOptions const * options) noexcept;
+
+/// Construct a transcript buffer of session recorded by ttyrec read from \p fd (file, pipe, etc).
+/// The ttyrec is read by blocks with a bounded memory, \p fd is not closed.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd(
+    TerminalEmulatorBuffer * buffer, int fd,
+    TerminalEmulatorTranscriptOptions const * options) noexcept;
+
 /// Construct a transcript buffer of session recorded by ttyrec.
 REDEMPTION_LIB_EXPORT
 int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer(
@@ -149,8 +377,309 @@ int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(
     TerminalEmulatorBuffer * buffer,
     char const * infile,
     TerminalEmulatorTranscriptPrefix prefix_type) noexcept;
+
+/// Construct a transcript buffer with the lines saved by frames recorded in [\p start_time, \p end_time) (seconds since epoch).
+/// Previous frames are emulated without rendering and the reading stops at the first frame after the window.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window(
+    TerminalEmulatorBuffer * buffer,
+    uint8_t const * data, std::size_t data_len,
+    TerminalEmulatorTranscriptOptions const * options,
+    uint32_t start_time, uint32_t end_time) noexcept;
+
+/// Construct a transcript buffer with the lines saved by frames recorded in [\p start_time, \p end_time) (seconds since epoch).
+/// Previous frames are emulated without rendering and the reading stops at the first frame after the window.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_time_window(
+    TerminalEmulatorBuffer * buffer,
+    char const * infile,
+    TerminalEmulatorTranscriptOptions const * options,
+    uint32_t start_time, uint32_t end_time) noexcept;
+
+/// Construct a transcript buffer identical to \c terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options().
+/// A first pass emulates the session without rendering and copies the emulator state every \p segment_size bytes
+/// (0 for 4 MiB), then segments are rendered in parallel from these checkpoints.
+/// \param pool  may be null
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel(
+    TerminalEmulatorBuffer * buffer,
+    uint8_t const * data, std::size_t data_len,
+    TerminalEmulatorTranscriptOptions const * options,
+    TerminalEmulatorThreadPool * pool, std::size_t segment_size) noexcept;
+
+/// \see terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel(
+    TerminalEmulatorBuffer * buffer,
+    char const * infile,
+    TerminalEmulatorTranscriptOptions const * options,
+    TerminalEmulatorThreadPool * pool, std::size_t segment_size) noexcept;
+
+/// Construct the transcript of the ttyrec file \c infiles[i] into the file \c outfiles[i]
+/// for each \c i in [0, \p n), spread across the threads of \p pool.
+/// Largest files are processed first and each thread reuses its emulator and its buffer.
+/// A truncated recording has a transcript and a -1 error code.
+/// \param pool     nullptr for a processing by the calling thread
+/// \param results  nullptr or array of \p n elements which receives the error code of each transcript
+/// \return the first error code in order of \p infiles or 0
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_transcript_ttyrec_files(
+    char const * const * infiles, char const * const * outfiles, std::size_t n,
+    TerminalEmulatorTranscriptOptions const * options,
+    TerminalEmulatorThreadPool * pool, int * results) noexcept;
 //END read
 
+//BEGIN keyword alert
+/// Keyword set searched in the lines (Aho-Corasick automaton).
+/// A matcher is immutable, it can be shared by the emulators and replays of several threads.
+/// \param patterns  \p n zero-terminated UTF-8 keywords, the id of a keyword is its index
+/// \param ignore_ascii_case  when not 0, ASCII letters are compared without the case
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorKeywordMatcher * terminal_emulator_keyword_matcher_new(
+    char const * const * patterns, std::size_t n, int ignore_ascii_case) noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_keyword_matcher_delete(TerminalEmulatorKeywordMatcher * matcher) noexcept;
+
+/// \param row  line of the screen where the keyword ends. A wrapped line is searched as a single line.
+/// \return 0 to continue, otherwise the search stops and this value is returned by the function which emulates
+using TerminalEmulatorKeywordAlertFn = int(void * ctx, std::size_t pattern_id, int row, uint32_t sec, uint32_t usec) noexcept;
+
+/// Search the keywords of \p matcher in the committed lines of \p emu
+/// (see \c TerminalEmulatorTranscriptLineMode::commit): a line is searched once,
+/// when it is scrolled out, erased, overwritten or by \c terminal_emulator_finish().
+/// The timestamp of an alert is the current time.
+/// \param matcher  nullptr for disable. Must outlive \p emu or the next call.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_set_keyword_alert(
+    TerminalEmulator * emu, TerminalEmulatorKeywordMatcher const * matcher,
+    TerminalEmulatorKeywordAlertFn * alert_fn, void * ctx) noexcept;
+//END keyword alert
+
+//BEGIN replay
+/// A replay emulates a ttyrec once and sends the result to each registered sink.
+/// Each sink has its own buffer.
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorReplay * terminal_emulator_replay_new() noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_delete(TerminalEmulatorReplay * replay) noexcept;
+
+/// Line based sink: \p buffer receives the transcript described by \p options (copied).
+/// Line mode and alternate screen policy drive the emulator and must be the same for all transcripts.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_transcript(
+    TerminalEmulatorReplay * replay, TerminalEmulatorBuffer * buffer,
+    TerminalEmulatorTranscriptOptions const * options) noexcept;
+
+/// Time based sink: \p buffer receives a rendering of the screen every \p interval seconds
+/// of recording (0 for disable) and at end of stream. Each rendering is followed by '\n'.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_snapshots(
+    TerminalEmulatorReplay * replay, TerminalEmulatorBuffer * buffer,
+    TerminalEmulatorOutputFormat format, uint32_t interval) noexcept;
+
+/// Timeline sink: \p buffer receives the activity of each period of \p interval milliseconds
+/// which contains frames (periods are aligned on the epoch), one json object by line:
+/// {"t": start_of_period_in_us, "b": received_bytes, "c": changed_cells, "l": committed_lines,
+///  "e": screen_erased, "r": screen_reset, "a": alternate_screen}
+/// changed_cells is the sum of the cells modified by each frame.
+/// committed_lines is the number of lines saved with the line mode of the transcripts
+/// (\c TerminalEmulatorTranscriptLineMode::commit without transcript).
+/// "a" is true when a frame of the period ends with the alternate screen.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_timeline(
+    TerminalEmulatorReplay * replay, TerminalEmulatorBuffer * buffer, uint32_t interval) noexcept;
+
+/// \param emu  the emulator of the replay, only valid during the call and should not be modified
+/// \return 0 to continue, otherwise the replay stops and returns this value
+using TerminalEmulatorReplayFrameFn = int(void * ctx, TerminalEmulator * emu, uint32_t sec, uint32_t usec) noexcept;
+
+/// Frame based sink: \p frame_fn is called after each frame.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_frame_callback(
+    TerminalEmulatorReplay * replay,
+    TerminalEmulatorReplayFrameFn * frame_fn, void * ctx) noexcept;
+
+/// \param i     index of the screenshot
+/// \param time  requested time in microseconds since epoch
+/// \return 0 to continue, otherwise the replay stops and returns this value
+using TerminalEmulatorReplayScreenshotFn = int(
+    void * ctx, std::size_t i, uint64_t time, uint8_t const * data, std::size_t len) noexcept;
+
+/// Screenshot sink: \p screenshot_fn receives a rendering of the screen at each time of \p times
+/// (microseconds since epoch, copied), that is after the last frame recorded at this time.
+/// The screen is only rendered when the replay crosses a time. Times before the time window are ignored.
+/// \param times  sorted in ascending order
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_screenshots(
+    TerminalEmulatorReplay * replay, TerminalEmulatorOutputFormat format,
+    uint64_t const * times, std::size_t n,
+    TerminalEmulatorReplayScreenshotFn * screenshot_fn, void * ctx) noexcept;
+
+/// Same as \c terminal_emulator_replay_add_screenshots() with a screenshot every \p interval
+/// microseconds from the first frame of the time window to the last frame.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_screenshots_every(
+    TerminalEmulatorReplay * replay, TerminalEmulatorOutputFormat format, uint64_t interval,
+    TerminalEmulatorReplayScreenshotFn * screenshot_fn, void * ctx) noexcept;
+
+/// Alert sink: the keywords of \p matcher are searched in the lines of the transcripts
+/// (committed lines when there is no transcript) and \p alert_fn receives the time of the frame.
+/// \p matcher must outlive \p replay.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_add_keyword_alert(
+    TerminalEmulatorReplay * replay, TerminalEmulatorKeywordMatcher const * matcher,
+    TerminalEmulatorKeywordAlertFn * alert_fn, void * ctx) noexcept;
+
+/// Sinks only receive frames recorded in [\p start_time, \p end_time) (seconds since epoch).
+/// Previous frames are emulated without rendering and the reading stops at the first frame after the window.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_set_time_window(
+    TerminalEmulatorReplay * replay, uint32_t start_time, uint32_t end_time) noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_ttyrec_buffer(
+    TerminalEmulatorReplay const * replay,
+    uint8_t const * data, std::size_t data_len) noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_ttyrec_file(
+    TerminalEmulatorReplay const * replay, char const * infile) noexcept;
+
+/// Same as \c terminal_emulator_replay_ttyrec_file() with a ttyrec read from \p fd (file, pipe, etc).
+/// \p fd is not closed.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_replay_ttyrec_fd(
+    TerminalEmulatorReplay const * replay, int fd) noexcept;
+//END replay
+
+//BEGIN frame index
+/// Index of a ttyrec for seeking: offset and time of each frame and keyframes
+/// with the state of the emulator. An index can be saved in a sidecar file.
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorFrameIndex * terminal_emulator_frame_index_new() noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_frame_index_delete(TerminalEmulatorFrameIndex * index) noexcept;
+
+/// Index a ttyrec emulated with a screen of \p lines x \p columns.
+/// A keyframe is added at the start of the ttyrec, then every \p keyframe_interval
+/// seconds of recording and every \p keyframe_bytes bytes of ttyrec (0 for disable).
+/// \return -1 for a truncated ttyrec, the index is then unchanged
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_frame_index_build_from_ttyrec_file(
+    TerminalEmulatorFrameIndex * index, char const * infile, int lines, int columns,
+    uint32_t keyframe_interval, uint64_t keyframe_bytes) noexcept;
+
+/// Same as \c terminal_emulator_frame_index_build_from_ttyrec_file() with a ttyrec read from \p fd.
+/// \p fd is not closed.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_frame_index_build_from_ttyrec_fd(
+    TerminalEmulatorFrameIndex * index, int fd, int lines, int columns,
+    uint32_t keyframe_interval, uint64_t keyframe_bytes) noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_frame_index_save(
+    TerminalEmulatorFrameIndex const * index, char const * outfile) noexcept;
+
+/// \return -1 for an invalid index file, the index is then unchanged
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_frame_index_load(
+    TerminalEmulatorFrameIndex * index, char const * infile) noexcept;
+
+REDEMPTION_LIB_EXPORT
+std::size_t terminal_emulator_frame_index_frame_count(
+    TerminalEmulatorFrameIndex const * index) noexcept;
+
+/// Time of the frame \p i.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_frame_index_get_frame_time(
+    TerminalEmulatorFrameIndex const * index, std::size_t i,
+    uint32_t * sec, uint32_t * usec) noexcept;
+
+/// Set \p emu to the state of the indexed ttyrec \p infile at the time \p sec.\p usec:
+/// the nearest previous keyframe is restored, then only the following frames
+/// recorded until this time are emulated.
+/// The frames are expected in chronological order.
+/// \return -1 when \p infile does not match the index
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_frame_index_seek(
+    TerminalEmulatorFrameIndex const * index, TerminalEmulator * emu,
+    char const * infile, uint32_t sec, uint32_t usec) noexcept;
+//END frame index
+
+//BEGIN ttyrec rewriting
+/// Write in \p outfd the ttyrec read from \p infd without the frames which leave the visible
+/// screen (cells, cursor and title) of a \p lines x \p columns emulator unchanged.
+/// The bytes of these frames are merged into the next frame which changes the screen,
+/// the rendering of the new ttyrec is the same. The times of the frames are kept.
+/// \p infd and \p outfd are not closed.
+/// \param max_idle      maximum time between 2 frames in milliseconds (0 for disable),
+///                      the following frames are moved back
+/// \param frame_counts  nullptr or array of 2 elements which receives the number of read and written frames
+/// \return -1 for a truncated ttyrec, the previous frames are written
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_ttyrec_remove_noop_frames_fd(
+    int infd, int outfd, int lines, int columns,
+    uint32_t max_idle, uint64_t * frame_counts) noexcept;
+
+/// Same as \c terminal_emulator_ttyrec_remove_noop_frames_fd() with files.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_ttyrec_remove_noop_frames(
+    char const * infile, char const * outfile, int lines, int columns,
+    uint32_t max_idle, uint64_t * frame_counts) noexcept;
+
+/// Write in \p outfd the ttyrec read from \p infd where the frames are replaced with the
+/// escape sequences which turn the previous screen of a \p lines x \p columns emulator
+/// into the next one (cursor movements, SGR attributes, erasures and scrolling are chosen
+/// for the shortest output).
+/// The rendering of the new ttyrec is the same, but not the transcript: the lines which
+/// leave the screen without scrolling are lost. The frames without visible change are removed.
+/// \p infd and \p outfd are not closed.
+/// \param max_idle      maximum time between 2 frames in milliseconds (0 for disable),
+///                      the following frames are moved back
+/// \param frame_counts  nullptr or array of 2 elements which receives the number of read and written frames
+/// \return -1 for a truncated ttyrec, the previous frames are written
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_ttyrec_reencode_fd(
+    int infd, int outfd, int lines, int columns,
+    uint32_t max_idle, uint64_t * frame_counts) noexcept;
+
+/// Same as \c terminal_emulator_ttyrec_reencode_fd() with files.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_ttyrec_reencode(
+    char const * infile, char const * outfile, int lines, int columns,
+    uint32_t max_idle, uint64_t * frame_counts) noexcept;
+//END ttyrec rewriting
+
+//BEGIN mirror
+/// Terminal of a remote viewer which displays the screen of an emulator.
+/// The mirror keeps the last state sent to the viewer, an update only contains
+/// the differences (cursor addressing, erasures, SGR changes and scrolling are chosen
+/// for the shortest output). A viewer updated less often than the emulator skips the intermediate states.
+/// The visible screen, the cursor, the title and the size are reproduced, not the scrollback.
+/// \param use_repeat  when not 0, the repeated characters can be written with REP (CSI b),
+///                    which is not supported by all terminals
+REDEMPTION_LIB_EXPORT
+TerminalEmulatorMirror * terminal_emulator_mirror_new(int lines, int columns, int use_repeat) noexcept;
+
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_mirror_delete(TerminalEmulatorMirror * mirror) noexcept;
+
+/// Replace the content of \p buffer with the ANSI sequences which turn the terminal
+/// of the viewer into the current screen of \p emu. The buffer is empty when the viewer is up to date.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_mirror_update(
+    TerminalEmulatorMirror * mirror, TerminalEmulator const * emu,
+    TerminalEmulatorBuffer * buffer) noexcept;
+
+/// The state of the viewer is unknown (new connection, lost output, etc):
+/// the next update starts with a reset of the terminal and redraws the whole screen.
+REDEMPTION_LIB_EXPORT
+int terminal_emulator_mirror_reset(TerminalEmulatorMirror * mirror) noexcept;
+//END mirror
+
 //@}
 
 }
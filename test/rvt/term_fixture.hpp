@@ -0,0 +1,56 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#pragma once
+
+#include "rvt/vt_emulator.hpp"
+#include "rvt/utf8_decoder.hpp"
+#include "rvt/text_rendering.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// An emulator fed with UTF-8, shared by the tests of the emulator states.
+struct Term
+{
+    rvt::VtEmulator emulator;
+    rvt::Utf8Decoder decoder;
+
+    Term(int lines, int columns)
+    : emulator(lines, columns)
+    {}
+
+    void feed(std::string_view s)
+    {
+        decoder.decode(
+            array_view<uint8_t const>{reinterpret_cast<uint8_t const*>(s.data()), s.size()},
+            [this](rvt::ucs4_char ucs) { emulator.receiveChar(ucs); });
+    }
+
+    std::string json() const
+    {
+        std::vector<char> out;
+        rvt::json_rendering(emulator.getWindowTitle(), emulator.getCurrentScreen(),
+                            rvt::xterm_color_table, rvt::RenderingBuffer::from_vector(out));
+        return std::string(out.data(), out.size());
+    }
+};
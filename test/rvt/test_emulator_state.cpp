@@ -0,0 +1,104 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+
+#define BOOST_TEST_MODULE EmulatorState
+#include "system/redemption_unit_tests.hpp"
+
+#include "rvt/emulator_state.hpp"
+
+#include "term_fixture.hpp"
+
+#include <algorithm>
+#include <string>
+
+
+namespace
+{
+    std::vector<uint8_t> write_state(Term const& term)
+    {
+        std::vector<uint8_t> out;
+        rvt::write_emulator_state(out, term.emulator, term.decoder);
+        return out;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorStateRoundTrip)
+{
+    Term term(5, 12);
+    term.feed("\033]2;title\a");
+    term.feed("abc\033[31;44mdef\033[1mghijklmnop\r\n");
+    term.feed("e\xcc\x81\xcc\x82 \xea\xb0\x80\033[38;2;1;2;3mrgb\033[0m\r\n");
+    term.feed("\033[2;4r\033[4l\033H\033[3g");
+    term.feed("\033[?1049hin alternate\033[5;3H");
+    // partial escape sequence and partial utf-8 character
+    term.feed("\033[3");
+    term.feed("\xc3");
+
+    std::vector<uint8_t> const state = write_state(term);
+
+    Term restored(3, 3);
+    BOOST_REQUIRE(rvt::read_emulator_state({state.data(), state.size()}, restored.emulator, restored.decoder));
+    BOOST_CHECK(restored.emulator.isAlternateScreen());
+    BOOST_CHECK_EQUAL(restored.json(), term.json());
+    BOOST_CHECK(write_state(restored) == state);
+
+    // same state after the same input
+    for (Term* t : {&term, &restored}) {
+        t->feed("2m\xa9x\033[?1049lnormal\033]2;new title\a");
+    }
+    BOOST_CHECK(!restored.emulator.isAlternateScreen());
+    BOOST_CHECK_EQUAL(restored.json(), term.json());
+    BOOST_CHECK(write_state(restored) == write_state(term));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorStateInvalid)
+{
+    Term term(4, 10);
+    term.feed("abc\033[32mdef");
+    std::vector<uint8_t> state = write_state(term);
+
+    Term fresh(4, 10);
+    std::string const fresh_json = fresh.json();
+
+    // truncated
+    for (std::size_t len : {std::size_t(0), std::size_t(4), state.size() / 2, state.size() - 1}) {
+        Term restored(4, 10);
+        restored.feed("xyz");
+        BOOST_CHECK(!rvt::read_emulator_state({state.data(), len}, restored.emulator, restored.decoder));
+        BOOST_CHECK_EQUAL(restored.json(), fresh_json);
+    }
+
+    // bad version
+    state[4] = 0xff;
+    Term restored(4, 10);
+    BOOST_CHECK(!rvt::read_emulator_state({state.data(), state.size()}, restored.emulator, restored.decoder));
+    BOOST_CHECK_EQUAL(restored.json(), fresh_json);
+
+    // system color out of the palette (white is 7)
+    term.feed("\033[37mx");
+    state = write_state(term);
+    uint8_t const white[] {uint8_t(rvt::ColorSpace::System), 7, 0, 0};
+    auto it = std::search(state.begin(), state.end(), std::begin(white), std::end(white));
+    BOOST_REQUIRE(it != state.end());
+    it[1] = 8;
+    BOOST_CHECK(!rvt::read_emulator_state({state.data(), state.size()}, restored.emulator, restored.decoder));
+    BOOST_CHECK_EQUAL(restored.json(), fresh_json);
+}
@@ -0,0 +1,107 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+
+#define BOOST_TEST_MODULE FrameJournal
+#include "system/redemption_unit_tests.hpp"
+
+#include "rvt/frame_journal.hpp"
+
+#include "term_fixture.hpp"
+
+#include <string>
+
+
+namespace
+{
+    constexpr std::string_view frames[] {
+        "\033]2;title\a",
+        "abc\033[31;44mdef\033[1mghijklmnop\r\n",
+        "e\xcc\x81\xcc\x82 \xea\xb0\x80\033[38;2;1;2;3mrgb\033[0m\r\n",
+        "\xcc\x83line3\r\nline4\r\nline5\r\nline6\033[3",
+        "1mbold\033[2;4r\033[4l\033H\033[3g\033[1;2H\033[2L\xc3",
+        "\xa9\033[?1049hin alternate\033[5;3H\033]2;alternate\a",
+        "\033[?1049l\033[r\033[8;6;20tresized\r\n\033[2J",
+        "end",
+    };
+}
+
+BOOST_AUTO_TEST_CASE(TestFrameJournalUndo)
+{
+    Term term(5, 12);
+    rvt::FrameJournal journal(term.emulator, 1024 * 1024);
+
+    std::vector<std::string> screens;
+    for (std::string_view frame : frames) {
+        screens.push_back(term.json());
+        journal.beginFrame(term.decoder);
+        term.feed(frame);
+        journal.endFrame();
+    }
+    BOOST_CHECK_EQUAL(journal.frameCount(), std::size(frames));
+    BOOST_CHECK_GT(journal.memoryUsage(), 0);
+
+    // step back then forward
+    std::string const last_screen = term.json();
+    for (std::size_t i = std::size(frames); i-- > 0;) {
+        BOOST_REQUIRE(journal.undoFrame(term.decoder));
+        BOOST_CHECK_EQUAL(term.json(), screens[i]);
+    }
+    BOOST_CHECK(!journal.undoFrame(term.decoder));
+    BOOST_CHECK_EQUAL(journal.frameCount(), 0);
+    BOOST_CHECK_EQUAL(journal.memoryUsage(), 0);
+
+    for (std::size_t i = 0; i < std::size(frames); ++i) {
+        BOOST_CHECK_EQUAL(term.json(), screens[i]);
+        journal.beginFrame(term.decoder);
+        term.feed(frames[i]);
+        journal.endFrame();
+    }
+    BOOST_CHECK_EQUAL(term.json(), last_screen);
+
+    // a resize outside a frame clears the journal
+    term.emulator.setScreenSize(4, 10);
+    BOOST_CHECK_EQUAL(journal.frameCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestFrameJournalMemoryLimit)
+{
+    Term term(5, 12);
+    rvt::FrameJournal journal(term.emulator, 1024);
+
+    std::vector<std::string> screens;
+    for (int i = 0; i < 100; ++i) {
+        screens.push_back(term.json());
+        journal.beginFrame(term.decoder);
+        term.feed("abcdefghijkl\r\n");
+        journal.endFrame();
+        BOOST_CHECK_LE(journal.memoryUsage(), 1024);
+    }
+
+    std::size_t const frameCount = journal.frameCount();
+    BOOST_CHECK_GT(frameCount, 0);
+    BOOST_CHECK_LT(frameCount, screens.size());
+
+    for (std::size_t i = 0; i < frameCount; ++i) {
+        BOOST_REQUIRE(journal.undoFrame(term.decoder));
+        BOOST_CHECK_EQUAL(term.json(), screens[screens.size() - 1 - i]);
+    }
+    BOOST_CHECK(!journal.undoFrame(term.decoder));
+}
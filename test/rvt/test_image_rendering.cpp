@@ -0,0 +1,125 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#define BOOST_TEST_MODULE ImageRendering
+#include "system/redemption_unit_tests.hpp"
+
+#include "rvt/image_rendering.hpp"
+#include "rvt/vt_emulator.hpp"
+#include "rvt/utf8_decoder.hpp"
+
+#include <string_view>
+
+
+namespace
+{
+    void feed(rvt::VtEmulator & emulator, std::string_view s)
+    {
+        rvt::Utf8Decoder decoder;
+        auto send_fn = [&emulator](rvt::ucs4_char ucs) { emulator.receiveChar(ucs); };
+        decoder.decode(const_bytes_array(s.data(), s.size()), send_fn);
+        decoder.end_decode(send_fn);
+    }
+
+    struct Image
+    {
+        std::string_view pixels;
+        int width;
+
+        rvt::Color pixel(int x, int y) const
+        {
+            auto p = pixels.substr(std::size_t((y * width + x) * 3), 3);
+            return rvt::Color(uint8_t(p[0]), uint8_t(p[1]), uint8_t(p[2]));
+        }
+    };
+}
+
+namespace rvt
+{
+    inline std::ostream & operator<<(std::ostream & out, Color const & color)
+    {
+        return out << "Color(" << color.red()+0 << ", " << color.green()+0 << ", " << color.blue()+0 << ")";
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestImageRendering)
+{
+    rvt::VtEmulator emulator(2, 3);
+    feed(emulator, "A─\033[7m \033[0m\r\n▀\033[4m_");
+
+    std::vector<char> out;
+    rvt::image_rendering(emulator.getCurrentScreen(), rvt::color_table,
+                         rvt::RenderingBuffer::from_vector(out), rvt::ImageFormat::ppm);
+
+    std::string_view header = "P6\n24 24\n255\n";
+    std::string_view data{out.data(), out.size()};
+    BOOST_REQUIRE_EQUAL(data.size(), header.size() + 24 * 24 * 3);
+    BOOST_CHECK_EQUAL(data.substr(0, header.size()), header);
+
+    rvt::Character const default_ch;
+    rvt::Color const fg = default_ch.foregroundColor.color(rvt::color_table);
+    rvt::Color const bg = default_ch.backgroundColor.color(rvt::color_table);
+    BOOST_REQUIRE_NE(fg, bg);
+
+    Image img{data.substr(header.size()), 24};
+
+    // 'A' (".###." at the first row of glyph)
+    BOOST_CHECK_EQUAL(img.pixel(0, 0), bg);
+    BOOST_CHECK_EQUAL(img.pixel(1, 2), bg);
+    BOOST_CHECK_EQUAL(img.pixel(2, 2), fg);
+    BOOST_CHECK_EQUAL(img.pixel(4, 2), fg);
+    BOOST_CHECK_EQUAL(img.pixel(5, 2), bg);
+
+    // '─'
+    for (int x = 8; x < 16; ++x) {
+        BOOST_CHECK_EQUAL(img.pixel(x, 5), bg);
+        BOOST_CHECK_EQUAL(img.pixel(x, 6), fg);
+        BOOST_CHECK_EQUAL(img.pixel(x, 7), bg);
+    }
+
+    // reversed space
+    BOOST_CHECK_EQUAL(img.pixel(16, 0), fg);
+    BOOST_CHECK_EQUAL(img.pixel(23, 11), fg);
+
+    // '▀'
+    BOOST_CHECK_EQUAL(img.pixel(0, 12), fg);
+    BOOST_CHECK_EQUAL(img.pixel(7, 17), fg);
+    BOOST_CHECK_EQUAL(img.pixel(0, 18), bg);
+
+    // underlined '_'
+    BOOST_CHECK_EQUAL(img.pixel(9, 12 + 8), fg);
+    BOOST_CHECK_EQUAL(img.pixel(9, 12 + 9), bg);
+    BOOST_CHECK_EQUAL(img.pixel(8, 12 + 10), fg);
+    BOOST_CHECK_EQUAL(img.pixel(15, 12 + 10), fg);
+
+    // empty cell
+    BOOST_CHECK_EQUAL(img.pixel(20, 20), bg);
+
+    rvt::image_rendering(emulator.getCurrentScreen(), rvt::color_table,
+                         rvt::RenderingBuffer::from_vector(out), rvt::ImageFormat::pam, 2);
+    header = "P7\nWIDTH 48\nHEIGHT 48\nDEPTH 3\nMAXVAL 255\nTUPLTYPE RGB\nENDHDR\n";
+    data = {out.data(), out.size()};
+    BOOST_REQUIRE_EQUAL(data.size(), header.size() + 48 * 48 * 3);
+    BOOST_CHECK_EQUAL(data.substr(0, header.size()), header);
+    img = Image{data.substr(header.size()), 48};
+    BOOST_CHECK_EQUAL(img.pixel(4, 4), fg);
+    BOOST_CHECK_EQUAL(img.pixel(5, 5), fg);
+    BOOST_CHECK_EQUAL(img.pixel(3, 4), bg);
+}
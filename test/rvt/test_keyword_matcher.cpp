@@ -0,0 +1,127 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#define BOOST_TEST_MODULE KeywordMatcher
+#include "system/redemption_unit_tests.hpp"
+
+#include "rvt/keyword_matcher.hpp"
+#include "rvt/vt_emulator.hpp"
+#include "rvt/utf8_decoder.hpp"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace
+{
+    using Matches = std::vector<std::pair<std::size_t, std::size_t>>;
+
+    Matches search(rvt::KeywordMatcher const& matcher, std::string_view s)
+    {
+        Matches matches;
+        matcher.search(rvt::KeywordMatcher::root, {reinterpret_cast<uint8_t const*>(s.data()), s.size()},
+            [&](std::size_t pattern_id, std::size_t end){
+                matches.emplace_back(pattern_id, end);
+            });
+        return matches;
+    }
+
+    std::string to_string(Matches const& matches)
+    {
+        std::string s;
+        for (auto const& [pattern_id, pos] : matches) {
+            s += std::to_string(pattern_id);
+            s += ':';
+            s += std::to_string(pos);
+            s += ' ';
+        }
+        return s;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestKeywordMatcherSearch)
+{
+    std::string_view const patterns[]{"he", "she", "his", "hers", "", "she"};
+    rvt::KeywordMatcher const matcher(make_const_array_view(patterns));
+
+    BOOST_CHECK_EQUAL(matcher.patternCount(), 6);
+    BOOST_CHECK_EQUAL(to_string(search(matcher, "ushers")), "1:4 5:4 0:4 3:6 ");
+    BOOST_CHECK_EQUAL(to_string(search(matcher, "hishe")), "2:3 1:5 5:5 0:5 ");
+    BOOST_CHECK_EQUAL(to_string(search(matcher, "HE")), "");
+    BOOST_CHECK_EQUAL(to_string(search(matcher, "")), "");
+
+    std::string_view const patterns2[]{"rm -rf", "DROP TABLE", "été"};
+    rvt::KeywordMatcher const icase(make_const_array_view(patterns2), true);
+    BOOST_CHECK_EQUAL(to_string(search(icase, "$ RM -Rf /; drop table x")), "0:8 1:22 ");
+    BOOST_CHECK_EQUAL(to_string(search(icase, "l'été")), "2:7 ");
+    BOOST_CHECK_EQUAL(to_string(search(icase, "l'ÉTÉ")), "");
+
+    // state is kept between two searches
+    auto state = icase.search(rvt::KeywordMatcher::root, {reinterpret_cast<uint8_t const*>("rm -"), 4},
+        [](std::size_t, std::size_t){ BOOST_CHECK(false); });
+    int n = 0;
+    icase.search(state, {reinterpret_cast<uint8_t const*>("rf"), 2},
+        [&](std::size_t pattern_id, std::size_t end){
+            ++n;
+            BOOST_CHECK_EQUAL(pattern_id, 0);
+            BOOST_CHECK_EQUAL(end, 2);
+        });
+    BOOST_CHECK_EQUAL(n, 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestKeywordMatcherLines)
+{
+    std::string_view const patterns[]{"rm -rf", "BEGIN RSA", "€€"};
+    rvt::KeywordMatcher const matcher(make_const_array_view(patterns));
+
+    Matches matches;
+    auto line_saver = [&](rvt::Screen const& screen, size_t y, size_t yend){
+        matcher.searchLines(screen, y, yend, [&](std::size_t pattern_id, std::size_t row){
+            matches.emplace_back(pattern_id, row);
+        });
+    };
+
+    rvt::VtEmulator emulator(4, 10);
+    emulator.setLineSaver(rvt::Screen::LineSaver::from_ref(line_saver));
+    emulator.setLineSaveMode(rvt::Screen::LineSaveMode::Commit);
+    rvt::Utf8Decoder decoder;
+    auto receiver = [&emulator](rvt::ucs4_char ucs) { emulator.receiveChar(ucs); };
+    auto feed = [&](std::string_view s) {
+        decoder.decode(const_bytes_array(s.data(), s.size()), receiver);
+    };
+
+    // "rm -rf" on 2 rows (wrapped line), "BEGIN RSA" on a single row
+    feed("$ sudo rm -rf /\r\nBEGIN RSA\r\n");
+    BOOST_CHECK_EQUAL(to_string(matches), "");
+    emulator.commitLines();
+    BOOST_CHECK_EQUAL(to_string(matches), "0:1 1:2 ");
+
+    // a committed line is not searched again
+    matches.clear();
+    emulator.commitLines();
+    BOOST_CHECK_EQUAL(to_string(matches), "");
+
+    // no match between 2 distinct lines, wide and combining characters
+    feed("rm -\r\nrf\r\n€́€€\r\n");
+    emulator.commitLines();
+    BOOST_CHECK_EQUAL(to_string(matches), "2:2 ");
+}
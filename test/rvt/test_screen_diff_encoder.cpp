@@ -0,0 +1,346 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+
+
+#define BOOST_TEST_MODULE ScreenDiffEncoder
+#include "system/redemption_unit_tests.hpp"
+
+#include "rvt/screen_diff_encoder.hpp"
+
+#include "term_fixture.hpp"
+
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+inline std::string get_file_contents(const char * name)
+{
+    std::string s;
+    std::filebuf buf;
+
+    char c;
+    buf.pubsetbuf(&c, 1);
+
+    if (buf.open(name, std::ios::in)) {
+        const std::streamsize sz = buf.in_avail();
+        if (sz != std::streamsize(-1)) {
+            s.resize(std::size_t(sz));
+            const std::streamsize n = buf.sgetn(&s[0], std::streamsize(s.size()));
+            if (sz != n) {
+                s.resize(std::size_t(n));
+            }
+        }
+    }
+
+    return s;
+}
+
+BOOST_AUTO_TEST_CASE(TestScreenDiffEncoder)
+{
+    Term term(4, 10);
+    rvt::ScreenDiffEncoder encoder(4, 10);
+
+    auto encode = [&](std::string_view s) {
+        term.feed(s);
+        std::string out;
+        encoder.encode(term.emulator, out);
+        return out;
+    };
+
+    BOOST_CHECK_EQUAL(encode(""), "");
+    BOOST_CHECK_EQUAL(encode("abc"), "abc");
+    BOOST_CHECK_EQUAL(encode("\033[31m\033[0m"), "");
+    BOOST_CHECK_EQUAL(encode("\033[1;31md"), "\033[1;31md");
+    BOOST_CHECK_EQUAL(encode("\033[0;32me"), "\033[;32me");
+    // same characters
+    BOOST_CHECK_EQUAL(encode("\033[0m\rabc"), "\033[4G");
+    BOOST_CHECK_EQUAL(encode("\033[0m\rab\033[4mC\033[24m"), "\033[D\033[;4mC");
+    BOOST_CHECK_EQUAL(encode("\033[3;5Hx"), "\n\n\033[C\033[mx");
+    BOOST_CHECK_EQUAL(encode("\r\033[K"), "\r\033[K");
+    BOOST_CHECK_EQUAL(encode("\033[?25l\033]2;title\a"), "\033[?25l\033]2;title\a");
+    BOOST_CHECK_EQUAL(encode("\033[?25h\033[2J"), "\033[H\033[K\n\n\033[?25h");
+}
+
+BOOST_AUTO_TEST_CASE(TestScreenDiffEncoderRendering)
+{
+    Term term(5, 12);
+    Term viewer(5, 12);
+    rvt::ScreenDiffEncoder encoder(5, 12);
+
+    std::size_t encoded_size = 0;
+    std::size_t original_size = 0;
+
+    for (std::string_view s : {
+        "ls -l\r\n",
+        "\033[0m\033[01;34mdir\033[0m  file  \033[01;32mexe\033[0m\r\n",
+        "\033[7mreverse\033[27m \033[2mdim\033[0m\r\n",
+        "\033[38;5;200mindex\033[38;2;1;2;3mrgb\033[48;5;17m bg \033[0m\r\n",
+        "line 5\r\nline 6\r\nline 7\r\n",
+        "\033[44m\033[Kcolored\033[0m\r\n",
+        "wide: \xe6\x97\xa5\xe6\x9c\xac e\xcc\x81 x\r\n",
+        "\033[2;3H\033[2Xab\033[1P\033[2@",
+        "\033[4;10H12345",
+        "\033[H\033[2J\033]2;vim\a~\r\n~\r\n~\r\n\033[5;1H\"file\" 3L",
+        "\033[2;1H\033[1L\033[Linserted",
+        "\033[1;11H\xe6\x97\xa5\033[1;11Hx",
+        "\033[5;12Hz",
+        "\033[?25l\033[3;3r\033[3;1H\n\n\033[r",
+        "\033[1;1H\033[1;7mbold reverse\033[22mnormal",
+        "\033[8;3;6t",
+        "\033[8;6;14tresized",
+        "\033[?1049h\033[Halternate\033[?1049l",
+    }) {
+        term.feed(s);
+        std::string out;
+        encoder.encode(term.emulator, out);
+        viewer.feed(out);
+        BOOST_CHECK_EQUAL(term.json(), viewer.json());
+        BOOST_CHECK_EQUAL(encoder.terminal().getCurrentScreen().getCursorX(),
+                          viewer.emulator.getCurrentScreen().getCursorX());
+
+        encoded_size += out.size();
+        original_size += s.size();
+    }
+
+    BOOST_CHECK_LT(encoded_size, original_size * 2);
+
+    // unknown state of the terminal
+    std::string out;
+    encoder.reset(out);
+    encoder.encode(term.emulator, out);
+    Term new_viewer(6, 14);
+    new_viewer.feed("garbage\033[31m\033]2;x\a");
+    new_viewer.feed(out);
+    BOOST_CHECK_EQUAL(term.json(), new_viewer.json());
+}
+
+BOOST_AUTO_TEST_CASE(TestScreenDiffEncoderScroll)
+{
+    Term term(4, 10);
+    rvt::ScreenDiffEncoder encoder(4, 10);
+
+    auto encode = [&](std::string_view s) {
+        term.feed(s);
+        std::string out;
+        encoder.encode(term.emulator, out);
+        return out;
+    };
+
+    BOOST_CHECK_EQUAL(encode("line 1\r\nline 2\r\nline 3\r\nline 4"), "line 1\r\nline 2\r\nline 3\r\nline 4");
+    BOOST_CHECK_EQUAL(encode("\r\nline 5"), "\n\rline 5");
+    BOOST_CHECK_EQUAL(encode("\033[H\033[2Mx"), "\n\n\033[Hx");
+}
+
+BOOST_AUTO_TEST_CASE(TestScreenDiffEncoderRepeat)
+{
+    Term term(4, 10);
+    Term viewer(4, 10);
+    rvt::ScreenDiffEncoder encoder(4, 10, true);
+
+    auto encode = [&](std::string_view s) {
+        term.feed(s);
+        std::string out;
+        encoder.encode(term.emulator, out);
+        viewer.feed(out);
+        BOOST_CHECK_EQUAL(term.json(), viewer.json());
+        return out;
+    };
+
+    BOOST_CHECK_EQUAL(encode("----------"), "-\033[9b");
+    BOOST_CHECK_EQUAL(encode("\r\n===="), "\r\n====");
+    BOOST_CHECK_EQUAL(encode("\r\n\033[31m======x"), "\r\n\033[31m=\033[5bx");
+    // the unchanged cells are not written again
+    BOOST_CHECK_EQUAL(encode("\033[H\033[0m-------\033[31m---"), "\033[d---");
+}
+
+BOOST_AUTO_TEST_CASE(TestScreenDiffEncoderTypescript)
+{
+    std::string const typescript = get_file_contents("test/data/typescript1");
+    BOOST_REQUIRE(!typescript.empty());
+
+    for (bool use_repeat : {false, true}) {
+        for (int lines : {8, 20}) {
+            for (std::size_t chunk_size : {1, 7, 64}) {
+                Term term(lines, 50);
+                Term viewer(lines, 50);
+                rvt::ScreenDiffEncoder encoder(lines, 50, use_repeat);
+
+                std::string out;
+                for (std::size_t i = 0; i < typescript.size(); i += chunk_size) {
+                    term.feed(std::string_view(typescript).substr(i, chunk_size));
+                    out.clear();
+                    encoder.encode(term.emulator, out);
+                    viewer.feed(out);
+                    if (term.json() != viewer.json()) {
+                        BOOST_CHECK_EQUAL(term.json(), viewer.json());
+                        BOOST_TEST_MESSAGE("lines: " << lines << ", chunk: " << chunk_size << ", offset: " << i);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+namespace
+{
+    /// differences of the cells, the formats and the cursor, empty when the screens are rendered the same
+    std::string screen_differences(rvt::Screen const& screen, rvt::Screen const& viewer)
+    {
+        std::string diff;
+        auto mismatch = [&](char const* what, int x, int y) {
+            diff += what;
+            diff += " at ";
+            diff += std::to_string(x);
+            diff += ',';
+            diff += std::to_string(y);
+            diff += '\n';
+        };
+
+        rvt::Rendition const format_mask = ~rvt::Rendition::ExtendedChar;
+        for (int y = 0; y < screen.getLines(); ++y) {
+            auto const& line = screen.getScreenLines()[y];
+            auto const& viewer_line = viewer.getScreenLines()[y];
+            if (line.size() != viewer_line.size()) {
+                mismatch("line size", int(viewer_line.size()), y);
+                continue;
+            }
+            for (std::size_t x = 0; x < line.size(); ++x) {
+                rvt::Character const& a = line[x];
+                rvt::Character const& b = viewer_line[x];
+                if (a.isRealCharacter != b.isRealCharacter
+                 || a.foregroundColor != b.foregroundColor
+                 || a.backgroundColor != b.backgroundColor
+                 || (a.rendition & format_mask) != (b.rendition & format_mask)
+                ) {
+                    mismatch("format", int(x), y);
+                }
+                else if (a.isRealCharacter) {
+                    auto chars = [](rvt::Character const& ch, rvt::ExtendedCharTable const& table) {
+                        return ch.is_extended()
+                            ? std::vector<rvt::ucs4_char>(table[ch.character].begin(), table[ch.character].end())
+                            : std::vector<rvt::ucs4_char>{ch.character};
+                    };
+                    if (chars(a, screen.extendedCharTable()) != chars(b, viewer.extendedCharTable())) {
+                        mismatch("character", int(x), y);
+                    }
+                }
+            }
+        }
+
+        if (screen.hasCursorVisible() != viewer.hasCursorVisible()
+         || (screen.hasCursorVisible()
+          && (screen.getCursorX() != viewer.getCursorX() || screen.getCursorY() != viewer.getCursorY()))
+        ) {
+            mismatch("cursor", viewer.getCursorX(), viewer.getCursorY());
+        }
+
+        return diff;
+    }
+
+    std::string escaped(std::string_view s)
+    {
+        std::string result;
+        for (char c : s) {
+            if (c == '\033') {
+                result += "\\e";
+            }
+            else if (c == '\r' || c == '\n' || c == '\b') {
+                result += (c == '\r') ? "\\r" : (c == '\n') ? "\\n" : "\\b";
+            }
+            else {
+                result += c;
+            }
+        }
+        return result;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestScreenDiffEncoderRandom)
+{
+    constexpr int lines = 6;
+    constexpr int columns = 20;
+
+    // characters and sequences which modify the cells or move the cursor
+    char const* const texts[] {
+        "a", "b", "xyz", " ", "\xc3\xa9", "\xe3\x81\x82", "\xf0\x9f\x98\x80", "\xcc\x83", "\xcc\x81",
+        "\r", "\n", "\b", "\t", "\033(0", "\033(B", "q",
+    };
+    char const* const sequences[] {
+        "A", "B", "C", "D", "G", "d", "H", "K", "1K", "2K", "J", "1J", "2J", "X",
+        "L", "M", "P", "@", "S", "T", "b",
+        "0m", "1m", "2m", "4m", "7m", "22m", "27m", "31m", "44m", "38;5;120m", "48;2;1;2;3m",
+        "?25l", "?25h",
+    };
+
+    std::mt19937 gen(3141592);
+    auto random = [&](std::size_t n) {
+        return std::uniform_int_distribution<std::size_t>(0, n - 1)(gen);
+    };
+
+    int failures = 0;
+    for (int run = 0; run < 3000 && failures < 5; ++run) {
+        Term term(lines, columns);
+        Term viewer(lines, columns);
+        rvt::ScreenDiffEncoder encoder(lines, columns, run % 2);
+        std::string input;
+        std::string out;
+
+        for (int frame = 0; frame < 30; ++frame) {
+            std::string s;
+            for (std::size_t n = random(6) + 1; n; --n) {
+                if (random(3)) {
+                    s += texts[random(std::size(texts))];
+                }
+                else {
+                    char const* sequence = sequences[random(std::size(sequences))];
+                    s += "\033[";
+                    // a column or a count, the last column is the most interesting
+                    if (!sequence[1] && random(2)) {
+                        s += std::to_string(random(2) ? columns : random(columns) + 1);
+                    }
+                    s += sequence;
+                }
+            }
+            if (!input.empty()) {
+                input += " | ";
+            }
+            input += escaped(s);
+
+            term.feed(s);
+            out.clear();
+            encoder.encode(term.emulator, out);
+            viewer.feed(out);
+
+            std::string const diff = screen_differences(
+                term.emulator.getCurrentScreen(), viewer.emulator.getCurrentScreen());
+            if (!diff.empty() || term.json() != viewer.json()) {
+                ++failures;
+                BOOST_CHECK_EQUAL(term.json(), viewer.json());
+                BOOST_ERROR(diff << "run: " << run << "\nframes: " << input
+                            << "\nlast output: " << escaped(out));
+                break;
+            }
+        }
+    }
+}
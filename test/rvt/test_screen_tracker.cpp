@@ -0,0 +1,83 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+
+
+#define BOOST_TEST_MODULE ScreenTracker
+#include "system/redemption_unit_tests.hpp"
+
+#include "rvt/screen_tracker.hpp"
+
+#include "term_fixture.hpp"
+
+#include <string_view>
+
+
+BOOST_AUTO_TEST_CASE(TestScreenTracker)
+{
+    Term term(4, 10);
+    rvt::ScreenTracker tracker(term.emulator);
+
+    auto changes = tracker.update();
+    BOOST_CHECK_EQUAL(0, changes.cells);
+
+    term.feed("abc");
+    BOOST_CHECK_EQUAL(3, tracker.update().cells);
+    BOOST_CHECK_EQUAL(0, tracker.update().cells);
+
+    // same characters
+    term.feed("\rab");
+    BOOST_CHECK_EQUAL(0, tracker.update().cells);
+
+    term.feed("\r\033[31mab\r\nx");
+    BOOST_CHECK_EQUAL(3, tracker.update().cells);
+
+    // erased line, a space with another foreground color is unchanged
+    term.feed("\033[1;1H\033[K");
+    changes = tracker.update();
+    BOOST_CHECK_EQUAL(3, changes.cells);
+    BOOST_CHECK(!changes.cleared);
+
+    term.feed("\033[2J");
+    changes = tracker.update();
+    BOOST_CHECK_EQUAL(1, changes.cells);
+    BOOST_CHECK(changes.cleared);
+    BOOST_CHECK(!changes.reset);
+
+    // alternate screen
+    term.feed("abcd\033[?1049hxy");
+    changes = tracker.update();
+    BOOST_CHECK_EQUAL(2, changes.cells);
+    term.feed("\033[?1049l");
+    changes = tracker.update();
+    BOOST_CHECK_EQUAL(4, changes.cells);
+
+    term.feed("\033c");
+    changes = tracker.update();
+    BOOST_CHECK_EQUAL(4, changes.cells);
+    BOOST_CHECK(changes.cleared);
+    BOOST_CHECK(changes.reset);
+
+    term.feed("1234");
+    term.emulator.setScreenSize(2, 2);
+    changes = tracker.update();
+    BOOST_CHECK(changes.resized);
+    BOOST_CHECK_EQUAL(2, changes.cells);
+}
@@ -0,0 +1,109 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#define BOOST_TEST_MODULE ThreadPool
+#include "system/redemption_unit_tests.hpp"
+
+#include "rvt/thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+
+BOOST_AUTO_TEST_CASE(TestThreadPoolParallelFor)
+{
+    rvt::ThreadPool pool(4);
+    BOOST_CHECK_EQUAL(pool.size(), 4u);
+
+    std::vector<int> values(1000);
+    for (int n = 0; n < 3; ++n) {
+        pool.parallel_for(values.size(), [&](std::size_t i){ values[i] += int(i); });
+    }
+
+    long long sum = 0;
+    for (int x : values) {
+        sum += x;
+    }
+    BOOST_CHECK_EQUAL(sum, 3 * 999 * 1000 / 2);
+
+    pool.parallel_for(0, [](std::size_t){ throw 1; });
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPoolNested)
+{
+    rvt::ThreadPool pool(3);
+    std::atomic<int> count {0};
+    pool.parallel_for(4, [&](std::size_t){
+        pool.parallel_for(5, [&](std::size_t){ ++count; });
+    });
+    BOOST_CHECK_EQUAL(count.load(), 20);
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPoolException)
+{
+    rvt::ThreadPool pool(2);
+    BOOST_CHECK_THROW(
+        pool.parallel_for(100, [](std::size_t i){
+            if (i == 42) {
+                throw std::runtime_error("42");
+            }
+        }),
+        std::runtime_error);
+
+    // pool still usable
+    std::atomic<int> count {0};
+    pool.parallel_for(10, [&](std::size_t){ ++count; });
+    BOOST_CHECK_EQUAL(count.load(), 10);
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPoolWorkStealing)
+{
+    rvt::ThreadPool pool(3);
+
+    std::size_t const n = 100;
+    std::vector<int> visited(n);
+    std::atomic<bool> in_use[3] {};
+    std::atomic<std::size_t> done {0};
+    std::atomic<bool> overlap {false};
+
+    pool.parallel_for_thread(n, [&](unsigned thread_index, std::size_t i){
+        if (thread_index >= 3 || in_use[thread_index].exchange(true)) {
+            overlap = true;
+        }
+
+        // the task 0 waits for the other tasks, including those
+        // initially assigned to its thread
+        if (i == 0) {
+            auto const timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (done != n - 1 && std::chrono::steady_clock::now() < timeout) {
+                std::this_thread::yield();
+            }
+        }
+
+        ++visited[i];
+        in_use[thread_index] = false;
+        ++done;
+    });
+
+    BOOST_CHECK(!overlap);
+    BOOST_CHECK_EQUAL(done.load(), n);
+    BOOST_CHECK(std::all_of(visited.begin(), visited.end(), [](int x){ return x == 1; }));
+}
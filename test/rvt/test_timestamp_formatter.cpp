@@ -0,0 +1,75 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#define BOOST_TEST_MODULE TimestampFormatter
+#include "system/redemption_unit_tests.hpp"
+
+#include "rvt/timestamp_formatter.hpp"
+
+#include <string>
+#include <cstdlib>
+
+
+namespace
+{
+    struct Formatter
+    {
+        rvt::TimestampFormatter formatter;
+
+        std::string operator()(time_t sec, uint32_t usec)
+        {
+            char buf[rvt::TimestampFormatter::max_size];
+            return std::string(buf, formatter.format(sec, usec, buf));
+        }
+    };
+}
+
+BOOST_AUTO_TEST_CASE(TestTimestampFormatter)
+{
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);          // for localtime_r
+    tzset();
+
+    time_t const t = 1511972945; // 2017-11-29 16:29:05 UTC
+
+    Formatter datetime{{rvt::TimestampFormat::Datetime, false}};
+    BOOST_CHECK_EQUAL(datetime(t, 0), "2017-11-29 17:29:05 ");
+    BOOST_CHECK_EQUAL(datetime(t + 1, 999999), "2017-11-29 17:29:06 ");
+    BOOST_CHECK_EQUAL(datetime(t + 54, 0), "2017-11-29 17:29:59 ");
+    BOOST_CHECK_EQUAL(datetime(t + 55, 0), "2017-11-29 17:30:00 ");
+    BOOST_CHECK_EQUAL(datetime(t - 5, 0), "2017-11-29 17:29:00 ");
+
+    Formatter datetime_utc{{rvt::TimestampFormat::Datetime, true}};
+    BOOST_CHECK_EQUAL(datetime_utc(t, 0), "2017-11-29 16:29:05 ");
+
+    Formatter epoch{{rvt::TimestampFormat::Epoch, false}};
+    BOOST_CHECK_EQUAL(epoch(t, 42), "1511972945.000042 ");
+    BOOST_CHECK_EQUAL(epoch(t, 123456), "1511972945.123456 ");
+    BOOST_CHECK_EQUAL(epoch(t + 1, 0), "1511972946.000000 ");
+
+    Formatter iso_ms{{rvt::TimestampFormat::Iso8601Ms, false}};
+    BOOST_CHECK_EQUAL(iso_ms(t, 123456), "2017-11-29T17:29:05.123+01:00 ");
+    BOOST_CHECK_EQUAL(iso_ms(t + 2, 999), "2017-11-29T17:29:07.000+01:00 ");
+    // summer time
+    BOOST_CHECK_EQUAL(iso_ms(1500000000, 0), "2017-07-14T04:40:00.000+02:00 ");
+
+    Formatter iso_us_utc{{rvt::TimestampFormat::Iso8601Us, true}};
+    BOOST_CHECK_EQUAL(iso_us_utc(t, 123456), "2017-11-29T16:29:05.123456Z ");
+    BOOST_CHECK_EQUAL(iso_us_utc(t, 7), "2017-11-29T16:29:05.000007Z ");
+}
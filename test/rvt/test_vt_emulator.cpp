@@ -24,6 +24,7 @@
 #include "rvt/vt_emulator.hpp"
 #include "rvt/utf8_decoder.hpp"
 #include "rvt/text_rendering.hpp"
+#include "rvt/thread_pool.hpp"
 
 #include <fstream>
 #include <iostream>
@@ -335,3 +336,214 @@ BOOST_AUTO_TEST_CASE(TestEmulatorReplay1)
         "\n"
         "Script done on 2017-11-28 11:33:08+0100\n");
 }
+
+BOOST_AUTO_TEST_CASE(TestEmulatorRepeat)
+{
+    rvt::VtEmulator emulator(3, 10);
+    auto send = [&emulator](std::string_view s) {
+        for (char c : s) {
+            emulator.receiveChar(rvt::ucs4_char(c));
+        }
+    };
+    auto line = [&emulator](int y) {
+        std::string out;
+        for (auto const& ch : emulator.getCurrentScreen().getScreenLines()[y]) {
+            out += char(ch.character);
+        }
+        return out;
+    };
+
+    send("a\033[3bb\033[b");
+    BOOST_CHECK_EQUAL(line(0), "aaaabb");
+
+    // the previous token must be a character
+    send("\r\n\033[2b\033[31m\033[2bc\033[A\033[2b");
+    BOOST_CHECK_EQUAL(line(0), "aaaabb");
+    BOOST_CHECK_EQUAL(line(1), "c");
+
+    // wraps like the written characters
+    send("\033[3;9Hd\033[3b");
+    BOOST_CHECK_EQUAL(line(0), "c");
+    BOOST_CHECK_EQUAL(line(1), "        dd");
+    BOOST_CHECK_EQUAL(line(2), "dd        ");
+
+    // a combining character is not repeated, only the character before it
+    send("\033[H\033[2Je");
+    emulator.receiveChar(0x301);
+    send("\033[3b");
+    emulator.receiveChar(0x301);
+    send("\033[2b");
+    auto const& cells = emulator.getCurrentScreen().getScreenLines()[0];
+    BOOST_REQUIRE_EQUAL(cells.size(), 6);
+    for (std::size_t x : {0, 3}) {
+        BOOST_CHECK(cells[x].is_extended());
+        BOOST_CHECK_EQUAL(emulator.getCurrentScreen().extendedCharTable()[cells[x].character].size(), 2);
+    }
+    for (std::size_t x : {1, 2, 4, 5}) {
+        BOOST_CHECK_EQUAL(cells[x].character, 'e');
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorLineSaveMode)
+{
+    auto transcript = [](rvt::Screen::LineSaveMode mode, std::string_view input) {
+        std::string out;
+        auto line_saver = [&out](rvt::Screen const& screen, size_t y, size_t yend){
+            auto const&& lines = screen.getScreenLines();
+            for (; y < yend; ++y) {
+                for (auto const& ch : lines[y]) {
+                    out += char(ch.character);
+                }
+                out += '\n';
+            }
+        };
+        rvt::VtEmulator emulator(3, 20, line_saver);
+        emulator.setLineSaveMode(mode);
+        for (char c : input) {
+            emulator.receiveChar(rvt::ucs4_char(c));
+        }
+        emulator.commitLines();
+        return out;
+    };
+
+    using Mode = rvt::Screen::LineSaveMode;
+
+    // prompt redrawn by cursor moves
+    std::string_view input = "$ l\033[B\033[As\r\nfoo\r\nbar\r\nbaz\r\n$ ";
+    BOOST_CHECK_EQUAL(transcript(Mode::CursorMove, input), "$ l\n\n$ ls\nfoo\nbar\nbaz\n");
+    BOOST_CHECK_EQUAL(transcript(Mode::Commit, input), "$ ls\nfoo\nbar\nbaz\n$ \n");
+
+    // overwritten line
+    input = "a\r\n10%\033[A\033[B\r20%\033[A\033[B\r20%\r\nb";
+    BOOST_CHECK_EQUAL(transcript(Mode::Commit, input), "a\n10%\n20%\nb\n");
+
+    // erased screen
+    input = "a\r\nb\033[2Jc";
+    BOOST_CHECK_EQUAL(transcript(Mode::Commit, input), "a\nb\n c\n");
+
+    // same content after an erased screen
+    input = "$ cat secret\r\nTOKEN=abc\r\n$ \033[H\033[2J$ cat secret\r\nTOKEN=abc\r\n$ ";
+    BOOST_CHECK_EQUAL(transcript(Mode::Commit, input),
+        "$ cat secret\nTOKEN=abc\n$ \n"
+        "$ cat secret\nTOKEN=abc\n$ \n");
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorLineSaveBatching)
+{
+    struct Transcript
+    {
+        std::string out;
+        int nb_call = 0;
+    };
+
+    auto transcript = [](bool batching, std::string_view input, std::size_t feed_size) {
+        Transcript result;
+        std::vector<char> buffer;
+        auto line_saver = [&](rvt::Screen const& screen, size_t y, size_t yend){
+            ++result.nb_call;
+            auto rendering_buffer = rvt::RenderingBuffer::from_vector(buffer);
+            auto partial = rvt::transcript_partial_rendering(screen, y, yend, rendering_buffer, 0);
+            rendering_buffer.set_final_buffer(
+                rendering_buffer.ctx, reinterpret_cast<uint8_t*>(partial.buffer), partial.length);
+            result.out.append(buffer.begin(), buffer.end());
+        };
+        rvt::VtEmulator emulator(4, 10);
+        emulator.setLineSaver(rvt::Screen::LineSaver::from_ref(line_saver));
+        emulator.setLineSaveBatching(batching);
+        rvt::Utf8Decoder decoder;
+        auto receiver = [&emulator](rvt::ucs4_char ucs) { emulator.receiveChar(ucs); };
+        // several feeds
+        for (std::size_t i = 0; i < input.size(); i += feed_size) {
+            std::string_view chunk = input.substr(i, feed_size);
+            decoder.decode(const_bytes_array(chunk.data(), chunk.size()), receiver);
+            emulator.flushSavedLines();
+        }
+        return result;
+    };
+
+    auto check = [&](std::string_view input, std::size_t feed_size = 7) {
+        BOOST_TEST_CONTEXT("input=" << input << " feed_size=" << feed_size) {
+            auto const expected = transcript(false, input, feed_size);
+            auto const batched = transcript(true, input, feed_size);
+            BOOST_CHECK_EQUAL(expected.out, batched.out);
+            BOOST_CHECK_LE(batched.nb_call, expected.nb_call);
+            return std::pair{expected.nb_call, batched.nb_call};
+        }
+        return std::pair{0, 0};
+    };
+
+    std::string output;
+    for (int i = 0; i < 50; ++i) {
+        output += "line " + std::to_string(i) + "\r\n";
+    }
+    auto [nb_call, nb_batched_call] = check(output, output.size());
+    BOOST_CHECK_EQUAL(nb_call, 50);
+    // one call each time the screen is scrolled
+    BOOST_CHECK_EQUAL(nb_batched_call, 13);
+    check(output);
+
+    // wrapped lines
+    check("abcdefghijklmnopqrstuvwxyz\r\n0123456789abcdef\r\nx\r\ny\r\nz\r\n");
+    // cursor moves and overwritten lines
+    check("a\r\nb\r\nc\033[Ad\033[Be\r\n10%\033[A\033[B\r20%\r\nf\r\ng\r\nh\r\n");
+    // scrolling region, insert and delete lines
+    check("1\r\n2\r\n3\r\n4\033[2;3r\033[2;1Hx\r\ny\r\nz\r\n\033[r\033[1;1H\033[L\033[2M5\r\n6\r\n7\r\n");
+    // reverse index, erase and combining character
+    check("a\r\nb\r\nc\r\nd\033Me\033M\033Mf\r\ne\xcc\x81\r\n\033[2Jg\r\nh\033[1K\r\ni\r\n");
+    // alternate screen
+    check("a\r\nb\033[?1049hvim\r\nx\r\ny\033[?1049lc\r\nd\r\ne\r\nf\r\n");
+    // wrapped line at the bottom
+    check("a\r\nb\r\nc\r\nabcdefghijklmnopqrstuvwxyz0123456789\r\nd\r\ne\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorParallelRendering)
+{
+    rvt::VtEmulator emulator(57, 104);
+    rvt::Utf8Decoder text_decoder;
+    std::filebuf in;
+    in.open("test/data/typescript1", std::ios::in);
+
+    char buf[4096];
+    std::streamsize len;
+    while ((len = in.sgetn(buf, sizeof(buf)))) {
+        text_decoder.decode({buf, buf+len}, [&emulator](rvt::ucs4_char ucs) {
+            emulator.receiveChar(ucs);
+        });
+    }
+
+    rvt::ThreadPool pool(4);
+    rvt::ParallelRendering parallel{&pool, 0};
+
+    auto const& screen = emulator.getCurrentScreen();
+    auto const title = emulator.getWindowTitle();
+
+    auto check = [&](std::size_t min_size, auto rendering) {
+        std::vector<char> s1;
+        std::vector<char> s2;
+        rendering(rvt::RenderingBuffer::from_vector(s1), rvt::ParallelRendering{});
+        rendering(rvt::RenderingBuffer::from_vector(s2), parallel);
+        BOOST_CHECK_GT(s1.size(), min_size);
+        BOOST_CHECK_EQUAL(std::string_view(s1.data(), s1.size()), std::string_view(s2.data(), s2.size()));
+    };
+
+    rvt::ScreenRegion const region{10, 40, 4, 30};
+
+    check(4000u, [&](rvt::RenderingBuffer buffer, rvt::ParallelRendering parallel){
+        json_rendering(title, screen, rvt::color_table, buffer, {}, parallel);
+    });
+    check(4000u, [&](rvt::RenderingBuffer buffer, rvt::ParallelRendering parallel){
+        ansi_rendering(title, screen, rvt::color_table, buffer, {}, parallel);
+    });
+    check(2000u, [&](rvt::RenderingBuffer buffer, rvt::ParallelRendering parallel){
+        text_rendering(screen, buffer, {}, parallel);
+    });
+    check(1000u, [&](rvt::RenderingBuffer buffer, rvt::ParallelRendering parallel){
+        json_rendering(title, screen, region, rvt::color_table, buffer, {}, parallel);
+    });
+    check(1000u, [&](rvt::RenderingBuffer buffer, rvt::ParallelRendering parallel){
+        ansi_rendering(title, screen, region, rvt::color_table, buffer, {}, parallel);
+    });
+    check(500u, [&](rvt::RenderingBuffer buffer, rvt::ParallelRendering parallel){
+        text_rendering(screen, region, buffer, {}, parallel);
+    });
+}
@@ -24,13 +24,18 @@
 #include "rvt_lib/terminal_emulator.hpp"
 #include "utils/sugar/bytes_t.hpp"
 
+#include <algorithm>
 #include <memory>
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 #include <cstring>
 #include <cerrno>
 
+#include <fcntl.h>
 #include <unistd.h>
 
 inline std::string get_file_contents(const char * name)
@@ -58,6 +63,9 @@ inline std::string get_file_contents(const char * name)
 
 using OutputFormat = TerminalEmulatorOutputFormat;
 using TranscriptPrefix = TerminalEmulatorTranscriptPrefix;
+using MinimapFormat = TerminalEmulatorMinimapFormat;
+using MinimapGlyph = TerminalEmulatorMinimapGlyph;
+using ImageFormat = TerminalEmulatorImageFormat;
 
 template<>
 struct std::default_delete<TerminalEmulator>
@@ -74,6 +82,48 @@ struct std::default_delete<TerminalEmulatorBuffer>
     { BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_delete(p)); }
 };
 
+template<>
+struct std::default_delete<TerminalEmulatorThreadPool>
+{
+    void operator()(TerminalEmulatorThreadPool * p) noexcept
+    { BOOST_CHECK_EQUAL(0, terminal_emulator_thread_pool_delete(p)); }
+};
+
+template<>
+struct std::default_delete<TerminalEmulatorTranscriptOptions>
+{
+    void operator()(TerminalEmulatorTranscriptOptions * p) noexcept
+    { BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_delete(p)); }
+};
+
+template<>
+struct std::default_delete<TerminalEmulatorReplay>
+{
+    void operator()(TerminalEmulatorReplay * p) noexcept
+    { BOOST_CHECK_EQUAL(0, terminal_emulator_replay_delete(p)); }
+};
+
+template<>
+struct std::default_delete<TerminalEmulatorKeywordMatcher>
+{
+    void operator()(TerminalEmulatorKeywordMatcher * p) noexcept
+    { BOOST_CHECK_EQUAL(0, terminal_emulator_keyword_matcher_delete(p)); }
+};
+
+template<>
+struct std::default_delete<TerminalEmulatorFrameIndex>
+{
+    void operator()(TerminalEmulatorFrameIndex * p) noexcept
+    { BOOST_CHECK_EQUAL(0, terminal_emulator_frame_index_delete(p)); }
+};
+
+template<>
+struct std::default_delete<TerminalEmulatorMirror>
+{
+    void operator()(TerminalEmulatorMirror * p) noexcept
+    { BOOST_CHECK_EQUAL(0, terminal_emulator_mirror_delete(p)); }
+};
+
 static uint8_t const* to_u8p(char const* p) noexcept
 {
     return const_bytes_t(p).to_u8p();
@@ -86,6 +136,22 @@ static std::string_view get_data(TerminalEmulatorBuffer * buf)
     return {const_bytes_t(data).to_charp(), len};
 }
 
+using TtyrecFrame = std::tuple<uint32_t, uint32_t, std::string_view>;
+
+static std::string make_ttyrec(std::initializer_list<TtyrecFrame> frames)
+{
+    std::string ttyrec;
+    for (auto [sec, usec, data] : frames) {
+        for (uint32_t n : {sec, usec, uint32_t(data.size())}) {
+            for (int i = 0; i < 4; ++i) {
+                ttyrec += char(n >> (i * 8));
+            }
+        }
+        ttyrec += data;
+    }
+    return ttyrec;
+}
+
 BOOST_AUTO_TEST_CASE(TestTermEmu)
 {
     std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(3, 10)};
@@ -156,6 +222,187 @@ BOOST_AUTO_TEST_CASE(TestTermEmu)
     BOOST_CHECK_EQUAL(ENOMEM, terminal_emulator_resize(emu, very_big_size, very_big_size)); // bad alloc
 }
 
+BOOST_AUTO_TEST_CASE(TestTermEmuRegion)
+{
+    std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(4, 10)};
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto emu = uemu.get();
+    auto emubuf = uemubuf.get();
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_title(emu, "Lib test"));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emu, to_u8p("abcdef\r\nghi\033[31mjkl\r\nmn"), 23));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare(emubuf, emu, OutputFormat::text));
+    BOOST_CHECK_EQUAL("abcdef\nghijkl\nmn\n\n", get_data(emubuf));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_region(emubuf, emu, OutputFormat::text, 0, 1, 2, 3));
+    BOOST_CHECK_EQUAL("cd\nij\n", get_data(emubuf));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_region(emubuf, emu, OutputFormat::json, 1, 2, 2, 3));
+    BOOST_CHECK_EQUAL(R"xxx({"x":0,"y":1,"lines":2,"columns":2,"title":"Lib test","style":{"r":0,"f":16777215,"b":0},"data":[[[{"s":"i"},{"f":13434880,"s":"j"}]],[[{}]]]})xxx", get_data(emubuf));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_region(emubuf, emu, OutputFormat::json, 0, 0, 4, 100));
+    BOOST_CHECK_EQUAL(R"xxx({"y":-1,"lines":1,"columns":6,"title":"Lib test","style":{"r":0,"f":16777215,"b":0},"data":[[[{"s":"ef"}]]]})xxx", get_data(emubuf));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_region(emubuf, emu, OutputFormat::ansi, 1, 1, 4, 4));
+    BOOST_CHECK_EQUAL("\033]Lib test\a\033[0;38;2;205;0;0mk\n", get_data(emubuf));
+
+    // whole screen
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare(emubuf, emu, OutputFormat::json));
+    std::string const contents{get_data(emubuf)};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_region(emubuf, emu, OutputFormat::json, 0, 1000, 0, 1000));
+    BOOST_CHECK_EQUAL(contents, get_data(emubuf));
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_region(emubuf, emu, OutputFormat::json, -1, 2, 0, 2));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_region(emubuf, emu, OutputFormat::json, 2, 1, 0, 2));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_region(emubuf, emu, OutputFormat::json, 0, 1, 3, 2));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_region(nullptr, emu, OutputFormat::json, 0, 1, 0, 2));
+}
+
+BOOST_AUTO_TEST_CASE(TestTermEmuMinimap)
+{
+    std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(3, 10)};
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto emu = uemu.get();
+    auto emubuf = uemubuf.get();
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emu, to_u8p("abcaa\r\nx\033[41m \033[0mzzzzz"), 23));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_minimap(emubuf, emu, MinimapFormat::json, 2, 4, MinimapGlyph::density));
+    BOOST_CHECK_EQUAL(R"xxx({"lines":2,"columns":3,"data":[{"s":"%+ ","f":[16777215,16777215,16777215],"b":[1703936,0,0]},{"s":"   ","f":[16777215,16777215,16777215],"b":[0,0,0]}]})xxx", get_data(emubuf));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_minimap(emubuf, emu, MinimapFormat::json, 2, 4, MinimapGlyph::dominant));
+    BOOST_CHECK_EQUAL(R"xxx({"lines":2,"columns":3,"data":[{"s":"az ","f":[16777215,16777215,16777215],"b":[1703936,0,0]},{"s":"   ","f":[16777215,16777215,16777215],"b":[0,0,0]}]})xxx", get_data(emubuf));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_minimap(emubuf, emu, MinimapFormat::rgb, 2, 4, MinimapGlyph::density));
+    // block of 8 cells: 7 white characters on black (+ 1 red background) ; 4 white characters ; blank
+    BOOST_CHECK_EQUAL(std::string_view("\x89\x70\x70" "\x40\x40\x40" "\0\0\0" "\0\0\0" "\0\0\0" "\0\0\0", 18), get_data(emubuf));
+
+    // colors of reverse video are already swapped in the screen
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emu, to_u8p("\033[H\033[2J\033[7m  \033[0m"), 17));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_minimap(emubuf, emu, MinimapFormat::rgb, 2, 4, MinimapGlyph::density));
+    BOOST_CHECK_EQUAL(std::string_view("\x40\x40\x40" "\0\0\0" "\0\0\0" "\0\0\0" "\0\0\0" "\0\0\0", 18), get_data(emubuf));
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_minimap(emubuf, emu, MinimapFormat::rgb, 0, 4, MinimapGlyph::density));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_minimap(emubuf, emu, MinimapFormat::rgb, 2, 65, MinimapGlyph::density));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_minimap(nullptr, emu, MinimapFormat::rgb, 2, 4, MinimapGlyph::density));
+}
+
+BOOST_AUTO_TEST_CASE(TestTermEmuImage)
+{
+    std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(3, 10)};
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto emu = uemu.get();
+    auto emubuf = uemubuf.get();
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emu, to_u8p("abc"), 3));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_image(emubuf, emu, ImageFormat::ppm, 1));
+    std::string_view header = "P6\n80 36\n255\n";
+    BOOST_CHECK_EQUAL(header.size() + 80 * 36 * 3, get_data(emubuf).size());
+    BOOST_CHECK_EQUAL(header, get_data(emubuf).substr(0, header.size()));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_image(emubuf, emu, ImageFormat::pam, 3));
+    header = "P7\nWIDTH 240\nHEIGHT 108\nDEPTH 3\nMAXVAL 255\nTUPLTYPE RGB\nENDHDR\n";
+    BOOST_CHECK_EQUAL(header.size() + 240 * 108 * 3, get_data(emubuf).size());
+    BOOST_CHECK_EQUAL(header, get_data(emubuf).substr(0, header.size()));
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_image(emubuf, emu, ImageFormat::ppm, 0));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_image(emubuf, emu, ImageFormat::ppm, 17));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_image(emubuf, nullptr, ImageFormat::ppm, 1));
+}
+
+BOOST_AUTO_TEST_CASE(TestTermEmuParallelRendering)
+{
+    std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(50, 30)};
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto emu = uemu.get();
+    auto emubuf = uemubuf.get();
+
+    for (int i = 0; i < 60; ++i) {
+        BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emu, to_u8p("abc\033[31mdef\033[0mghi\r\n"), 20));
+    }
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare(emubuf, emu, OutputFormat::json));
+    std::string const contents{get_data(emubuf)};
+
+    TerminalEmulatorThreadPool * pool = terminal_emulator_thread_pool_new(3);
+    BOOST_REQUIRE(pool);
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_parallel_rendering(emu, pool, 0));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare(emubuf, emu, OutputFormat::json));
+    BOOST_CHECK_EQUAL(contents, get_data(emubuf));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_parallel_rendering(emu, nullptr, 0));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_thread_pool_delete(pool));
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_set_parallel_rendering(nullptr, nullptr, 0));
+    BOOST_CHECK_EQUAL(nullptr, terminal_emulator_thread_pool_new(-1));
+}
+
+BOOST_AUTO_TEST_CASE(TestTermEmuRenderMany)
+{
+    constexpr std::size_t n = 5;
+    std::unique_ptr<TerminalEmulator> uemus[n];
+    std::unique_ptr<TerminalEmulatorBuffer> uemubufs[n];
+    TerminalEmulator * emus[n];
+    TerminalEmulatorBuffer * emubufs[n];
+    std::string expected[n];
+    std::string expected_concat;
+
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto emubuf = uemubuf.get();
+
+    for (std::size_t i = 0; i < n; ++i) {
+        uemus[i].reset(terminal_emulator_new(int(3 + i), 10));
+        uemubufs[i].reset(terminal_emulator_buffer_new());
+        emus[i] = uemus[i].get();
+        emubufs[i] = uemubufs[i].get();
+        std::string s = "session " + std::to_string(i);
+        BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emus[i], to_u8p(s.c_str()), s.size()));
+        BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare(emubuf, emus[i], OutputFormat::ansi));
+        expected[i] = get_data(emubuf);
+        expected_concat += expected[i];
+    }
+
+    std::unique_ptr<TerminalEmulatorThreadPool> upool{terminal_emulator_thread_pool_new(3)};
+    auto pool = upool.get();
+    BOOST_REQUIRE(pool);
+
+    for (auto* p : {pool, static_cast<TerminalEmulatorThreadPool*>(nullptr)}) {
+        int results[n] {-1, -1, -1, -1, -1};
+        BOOST_CHECK_EQUAL(0, terminal_emulator_render_many(emus, n, OutputFormat::ansi, emubufs, p, results));
+        for (std::size_t i = 0; i < n; ++i) {
+            BOOST_CHECK_EQUAL(0, results[i]);
+            BOOST_CHECK_EQUAL(expected[i], get_data(emubufs[i]));
+        }
+
+        std::size_t offsets[n + 1];
+        BOOST_CHECK_EQUAL(0, terminal_emulator_render_many_into_buffer(emubuf, emus, n, OutputFormat::ansi, p, offsets));
+        BOOST_CHECK_EQUAL(expected_concat, get_data(emubuf));
+        for (std::size_t i = 0; i < n; ++i) {
+            BOOST_CHECK_EQUAL(expected[i], get_data(emubuf).substr(offsets[i], offsets[i+1] - offsets[i]));
+        }
+    }
+
+    // parallel rendering of each emulator with the same pool
+    for (auto* emu : emus) {
+        BOOST_CHECK_EQUAL(0, terminal_emulator_set_parallel_rendering(emu, pool, 0));
+    }
+    BOOST_CHECK_EQUAL(0, terminal_emulator_render_many(emus, n, OutputFormat::ansi, emubufs, pool, nullptr));
+    BOOST_CHECK_EQUAL(expected[n-1], get_data(emubufs[n-1]));
+
+    emus[2] = nullptr;
+    int results[n] {};
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_render_many(emus, n, OutputFormat::ansi, emubufs, pool, results));
+    BOOST_CHECK_EQUAL(0, results[1]);
+    BOOST_CHECK_EQUAL(-2, results[2]);
+    BOOST_CHECK_EQUAL(0, results[3]);
+
+    std::size_t offsets[n + 1];
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_render_many_into_buffer(emubuf, emus, n, OutputFormat::ansi, pool, offsets));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_render_many_into_buffer(emubuf, emus, n, OutputFormat::ansi, pool, nullptr));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_render_many(nullptr, n, OutputFormat::ansi, emubufs, pool, nullptr));
+}
+
 BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscript)
 {
     setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);          // for localtime_r
@@ -176,6 +423,1192 @@ BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscript)
     BOOST_CHECK_EQUAL(contents, get_data(emubuf));
 }
 
+BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscriptPrefix)
+{
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);          // for localtime_r
+
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emubuf = uemubuf.get();
+
+    auto check_prefix = [&](TranscriptPrefix prefix_type, std::string_view prefix) {
+        BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(emubuf, "test/data/ttyrec1", prefix_type));
+        BOOST_CHECK_EQUAL(get_data(emubuf).substr(0, prefix.size() + 3), std::string(prefix) + "[2]");
+    };
+
+    check_prefix(TranscriptPrefix::datetime, "2017-11-29 17:29:05 ");
+    check_prefix(TranscriptPrefix::datetime_utc, "2017-11-29 16:29:05 ");
+    check_prefix(TranscriptPrefix::epoch, "1511972945.270797 ");
+    check_prefix(TranscriptPrefix::iso8601_ms, "2017-11-29T17:29:05.270+01:00 ");
+    check_prefix(TranscriptPrefix::iso8601_us, "2017-11-29T17:29:05.270797+01:00 ");
+    check_prefix(TranscriptPrefix::iso8601_ms_utc, "2017-11-29T16:29:05.270Z ");
+    check_prefix(TranscriptPrefix::iso8601_us_utc, "2017-11-29T16:29:05.270797Z ");
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(emubuf, "test/data/ttyrec1", TranscriptPrefix(42)));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscriptLineMode)
+{
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emubuf = uemubuf.get();
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> uoptions{terminal_emulator_transcript_options_new()};
+    auto* options = uoptions.get();
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_transcript_options_set_line_mode(options, TerminalEmulatorTranscriptLineMode(42)));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_transcript_options_set_prefix(options, TranscriptPrefix(42)));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_transcript_options_set_prefix(nullptr, TranscriptPrefix::noprefix));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(emubuf, "test/data/ttyrec1", nullptr));
+
+    std::string_view ttyrec{"\0\0\0\0\0\0\0\0\x1d\0\0\0"
+        "$ l\x1b[B\x1b[As\r\nfoo\r\nbar\r\nbaz\r\n$ ", 41};
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options));
+    BOOST_CHECK_EQUAL("$ l\n\n$ ls\nfoo\nbar\nbaz\n", get_data(emubuf));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_line_mode(options, TerminalEmulatorTranscriptLineMode::commit));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options));
+    BOOST_CHECK_EQUAL("$ ls\nfoo\nbar\nbaz\n$ \n", get_data(emubuf));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscriptRepeat)
+{
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emubuf = uemubuf.get();
+
+    // REP repeats the character of the previous token, also from the previous frame
+    std::string const ttyrec = make_ttyrec({
+        {1, 0, "ab\033[3b\r\n-"},
+        {2, 0, "\033[9b\r\n"},
+        {3, 0, "\033[31m\033[2bc\r\n"},
+    });
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer(
+        emubuf, to_u8p(ttyrec.data()), ttyrec.size(), TranscriptPrefix::noprefix));
+    BOOST_CHECK_EQUAL("abbbb\n----------\nc\n", get_data(emubuf));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscriptAlternateScreen)
+{
+    std::string const ttyrec = make_ttyrec({
+        {0, 0, "a\r\n\033[?1049hvim1"},
+        {5, 0, "\033[Hvim2"},
+        {10, 0, "\033[Hvim3"},
+        {11, 0, "\033[?1049lb\r\n"},
+    });
+
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emubuf = uemubuf.get();
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> uoptions{terminal_emulator_transcript_options_new()};
+    auto* options = uoptions.get();
+
+    auto transcript = [&]{
+        BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+            emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options));
+        return std::string(get_data(emubuf));
+    };
+
+    using AlternateScreen = TerminalEmulatorTranscriptAlternateScreen;
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_transcript_options_set_alternate_screen(options, AlternateScreen(42), 0));
+
+    BOOST_CHECK_EQUAL("a\nvim1\nvim2\nb\n", transcript());
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_alternate_screen(options, AlternateScreen::snapshot, 0));
+    BOOST_CHECK_EQUAL("a\nvim3\nb\n", transcript());
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_alternate_screen(options, AlternateScreen::snapshot, 5));
+    BOOST_CHECK_EQUAL("a\nvim2\nvim3\nb\n", transcript());
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscriptTimeWindow)
+{
+    std::string ttyrec = make_ttyrec({
+        {0, 0, "a\r\n"},
+        {5, 0, "b\r\n"},
+        {10, 0, "c\r\n"},
+        {15, 0, "d\r\n"},
+    });
+    // truncated frame
+    ttyrec += std::string_view("\x14\0\0\0\0\0\0\0\xff\0\0\0e", 13);
+
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emubuf = uemubuf.get();
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> uoptions{terminal_emulator_transcript_options_new()};
+    auto* options = uoptions.get();
+
+    auto transcript = [&](uint32_t start_time, uint32_t end_time){
+        BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window(
+            emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options, start_time, end_time));
+        return std::string(get_data(emubuf));
+    };
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window(
+        emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options, 10, 5));
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_time_window(
+        emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options, 0, ~uint32_t()));
+
+    BOOST_CHECK_EQUAL("b\nc\n", transcript(5, 15));
+    BOOST_CHECK_EQUAL("b\nc\n", transcript(1, 11));
+    BOOST_CHECK_EQUAL("a\nb\nc\nd\n", transcript(0, 16));
+    BOOST_CHECK_EQUAL("", transcript(6, 10));
+    BOOST_CHECK_EQUAL("", transcript(16, 20));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_line_mode(options, TerminalEmulatorTranscriptLineMode::commit));
+    BOOST_CHECK_EQUAL("b\nc\n", transcript(5, 15));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorTranscriptFromFd)
+{
+    // frames over several read blocks and a frame larger than a block
+    std::string ttyrec;
+    auto add_frame = [&](uint32_t sec, std::string_view data){
+        ttyrec += make_ttyrec({{sec, 0, data}});
+    };
+    for (uint32_t i = 0; i < 30000; ++i) {
+        add_frame(i, "line " + std::to_string(i) + "\r\n");
+        if (i == 20000) {
+            add_frame(i, std::string(300000, 'x') + "\r\n");
+        }
+    }
+    add_frame(30000, "");
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> uoptions{terminal_emulator_transcript_options_new()};
+    auto* options = uoptions.get();
+
+    std::unique_ptr<TerminalEmulatorBuffer> uexpected{terminal_emulator_buffer_new()};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+        uexpected.get(), to_u8p(ttyrec.data()), ttyrec.size(), options));
+    auto expected = get_data(uexpected.get());
+    BOOST_CHECK_EQUAL(expected.substr(0, 14), "line 0\nline 1\n");
+
+    auto transcript = [&](std::string_view data){
+        int fds[2];
+        BOOST_REQUIRE_EQUAL(0, pipe(fds));
+        std::thread writer([&]{
+            while (!data.empty()) {
+                ssize_t n = write(fds[1], data.data(), data.size());
+                if (n <= 0) {
+                    break;
+                }
+                data.remove_prefix(std::size_t(n));
+            }
+            close(fds[1]);
+        });
+        std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+        int errnum = terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd(uemubuf.get(), fds[0], options);
+        writer.join();
+        close(fds[0]);
+        return std::pair{errnum, std::string(get_data(uemubuf.get()))};
+    };
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd(uexpected.get(), -1, options));
+
+    auto [errnum, text] = transcript(ttyrec);
+    BOOST_CHECK_EQUAL(0, errnum);
+    BOOST_CHECK(text == expected);
+
+    // truncated frame
+    auto [errnum2, text2] = transcript(std::string_view(ttyrec).substr(0, ttyrec.size() - 17));
+    BOOST_CHECK_EQUAL(-1, errnum2);
+    BOOST_CHECK_EQUAL(text2.substr(0, 14), "line 0\nline 1\n");
+
+    // corrupted header with a frame of almost 4 GiB
+    std::string const huge_frame = make_ttyrec({{1, 0, "abc\r\n"}}) + std::string("\2\0\0\0\0\0\0\0\0\0\0\xff" "def", 15);
+    auto [errnum3, text3] = transcript(huge_frame);
+    BOOST_CHECK_EQUAL(-1, errnum3);
+    BOOST_CHECK_EQUAL(text3, "abc\n");
+
+    char const * huge_frame_file = "/tmp/emu_huge_frame.ttyrec";
+    std::ofstream(huge_frame_file) << huge_frame;
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(
+        uexpected.get(), huge_frame_file, options));
+    BOOST_CHECK_EQUAL(get_data(uexpected.get()), "abc\n");
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscriptParallel)
+{
+    using LineMode = TerminalEmulatorTranscriptLineMode;
+    using AlternateScreen = TerminalEmulatorTranscriptAlternateScreen;
+    using TranscriptFormat = TerminalEmulatorTranscriptFormat;
+
+    std::string const long_line(100, 'x');
+
+    // split lines, utf8 sequence cut between 2 frames and alternate screen
+    std::string_view const frames[] {
+        "abc\r\n", "de", "f\r\n", long_line, "\r\n\xc3", "\xa9t\xc3\xa9\r\n",
+        "\x1b[?1049hvim1", "\r\nvim2", "\x1b[?1049l", "ghi\r\n", "xy", "\rz",
+    };
+
+    std::string ttyrec;
+    uint32_t sec = 0;
+    for (std::string_view data : frames) {
+        ttyrec += make_ttyrec({{sec, sec * 1000u, data}});
+        sec += 7;
+    }
+
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emubuf = uemubuf.get();
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> uoptions{terminal_emulator_transcript_options_new()};
+    auto* options = uoptions.get();
+
+    std::unique_ptr<TerminalEmulatorThreadPool> upool{terminal_emulator_thread_pool_new(3)};
+    auto pool = upool.get();
+    BOOST_REQUIRE(pool);
+
+    auto check_transcript = [&](std::string_view data){
+        BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+            emubuf, to_u8p(data.data()), data.size(), options));
+        std::string const expected {get_data(emubuf)};
+        BOOST_CHECK(!expected.empty());
+
+        for (auto* p : {pool, static_cast<TerminalEmulatorThreadPool*>(nullptr)}) {
+            for (std::size_t segment_size : {0, 1, 20, 100}) {
+                BOOST_TEST_CONTEXT("segment_size=" << segment_size << " pool=" << bool(p)) {
+                    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel(
+                        emubuf, to_u8p(data.data()), data.size(), options, p, segment_size));
+                    BOOST_CHECK_EQUAL(expected, get_data(emubuf));
+                }
+            }
+        }
+    };
+
+    auto check_all_modes = [&](std::string_view data){
+        for (auto format : {TranscriptFormat::text, TranscriptFormat::jsonl}) {
+            for (auto line_mode : {LineMode::cursor_move, LineMode::commit}) {
+                for (auto alternate_screen : {AlternateScreen::lines, AlternateScreen::snapshot}) {
+                    BOOST_TEST_CONTEXT("format=" << int(format) << " line_mode=" << int(line_mode)
+                                    << " alternate_screen=" << int(alternate_screen)) {
+                        terminal_emulator_transcript_options_set_format(options, format);
+                        terminal_emulator_transcript_options_set_line_mode(options, line_mode);
+                        terminal_emulator_transcript_options_set_alternate_screen(options, alternate_screen, 10);
+                        check_transcript(data);
+                    }
+                }
+            }
+        }
+    };
+
+    check_all_modes(ttyrec);
+
+    terminal_emulator_transcript_options_set_prefix(options, TranscriptPrefix::datetime);
+    check_all_modes(ttyrec);
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> udefault_options{terminal_emulator_transcript_options_new()};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel(
+        emubuf, "test/data/ttyrec1", udefault_options.get(), pool, 4096));
+    std::string const file_transcript {get_data(emubuf)};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(
+        emubuf, "test/data/ttyrec1", udefault_options.get()));
+    BOOST_CHECK_EQUAL(file_transcript, get_data(emubuf));
+
+    // truncated frame
+    ttyrec += std::string_view("\x64\0\0\0\0\0\0\0\xff\0\0\0e", 13);
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel(
+        emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options, pool, 1));
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel(
+        nullptr, to_u8p(ttyrec.data()), ttyrec.size(), options, pool, 1));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_parallel(
+        emubuf, to_u8p(ttyrec.data()), ttyrec.size(), nullptr, pool, 1));
+    BOOST_CHECK_EQUAL(2, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_parallel(
+        emubuf, "/unknown/file", options, pool, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorTranscriptTtyrecFiles)
+{
+    std::string const small_ttyrec = make_ttyrec({
+        {1, 0, "abc\r\n"},
+        {1, 0, "\x1b[?1049hvim\x1b[?1049l"},
+        {1, 0, "def"},
+    });
+    std::string const truncated_ttyrec = small_ttyrec + std::string("\x64\0\0\0\0\0\0\0\xff\0\0\0e", 13);
+
+    std::string const ttyrec1 = get_file_contents("test/data/ttyrec1");
+    BOOST_REQUIRE(!ttyrec1.empty());
+
+    char const * infiles[] {
+        "/tmp/emu_batch_small.ttyrec",
+        "test/data/ttyrec1",
+        "/tmp/emu_batch_truncated.ttyrec",
+        "/unknown/file",
+        "/tmp/emu_batch_small.ttyrec",
+    };
+    char const * outfiles[] {
+        "/tmp/emu_batch_out0.txt",
+        "/tmp/emu_batch_out1.txt",
+        "/tmp/emu_batch_out2.txt",
+        "/tmp/emu_batch_out3.txt",
+        "/tmp/emu_batch_out4.txt",
+    };
+    std::size_t const n = std::size(infiles);
+
+    std::ofstream(infiles[0]) << small_ttyrec;
+    std::ofstream(infiles[2]) << truncated_ttyrec;
+    for (auto* outfile : outfiles) {
+        unlink(outfile);
+    }
+
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emubuf = uemubuf.get();
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> uoptions{terminal_emulator_transcript_options_new()};
+    auto* options = uoptions.get();
+    terminal_emulator_transcript_options_set_alternate_screen(
+        options, TerminalEmulatorTranscriptAlternateScreen::snapshot, 0);
+
+    auto transcript = [&](std::string const& ttyrec){
+        terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+            emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options);
+        return std::string(get_data(emubuf));
+    };
+    std::string const expected_small = transcript(small_ttyrec);
+    std::string const expected_ttyrec1 = transcript(ttyrec1);
+    std::string const expected_truncated = transcript(truncated_ttyrec);
+    BOOST_CHECK_EQUAL("abc\nvim\n", expected_small);
+
+    std::unique_ptr<TerminalEmulatorThreadPool> upool{terminal_emulator_thread_pool_new(3)};
+    auto pool = upool.get();
+    BOOST_REQUIRE(pool);
+
+    for (auto* p : {pool, static_cast<TerminalEmulatorThreadPool*>(nullptr)}) {
+        int results[n] {42, 42, 42, 42, 42};
+        BOOST_CHECK_EQUAL(-1, terminal_emulator_transcript_ttyrec_files(infiles, outfiles, n, options, p, results));
+        BOOST_CHECK_EQUAL(0, results[0]);
+        BOOST_CHECK_EQUAL(0, results[1]);
+        BOOST_CHECK_EQUAL(-1, results[2]);
+        BOOST_CHECK_EQUAL(ENOENT, results[3]);
+        BOOST_CHECK_EQUAL(0, results[4]);
+
+        BOOST_CHECK_EQUAL(expected_small, get_file_contents(outfiles[0]));
+        BOOST_CHECK_EQUAL(expected_ttyrec1, get_file_contents(outfiles[1]));
+        BOOST_CHECK_EQUAL(expected_truncated, get_file_contents(outfiles[2]));
+        BOOST_CHECK_EQUAL(-1, access(outfiles[3], F_OK));
+        BOOST_CHECK_EQUAL(expected_small, get_file_contents(outfiles[4]));
+    }
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_ttyrec_files(infiles, outfiles, 2, options, pool, nullptr));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_ttyrec_files(nullptr, nullptr, 0, options, pool, nullptr));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_transcript_ttyrec_files(infiles, outfiles, n, nullptr, pool, nullptr));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_transcript_ttyrec_files(nullptr, outfiles, n, options, pool, nullptr));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscriptJsonl)
+{
+    std::string const long_line(84, 'x');
+
+    std::string const ttyrec = make_ttyrec({
+        {1, 5, "a\"b\\\r\n"},
+        {2, 0, long_line},
+        {3, 42, "\r\n\033[?1049hvim\033[?1049l"},
+    });
+
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emubuf = uemubuf.get();
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> uoptions{terminal_emulator_transcript_options_new()};
+    auto* options = uoptions.get();
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_transcript_options_set_format(options, TerminalEmulatorTranscriptFormat(42)));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_format(options, TerminalEmulatorTranscriptFormat::jsonl));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_prefix(options, TranscriptPrefix::datetime));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_line_mode(options, TerminalEmulatorTranscriptLineMode::commit));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+        emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options));
+    BOOST_CHECK_EQUAL(
+        "{\"t\":3000042,\"y\":0,\"g\":0,\"a\":false,\"s\":\"a\\\"b\\\\\"}\n"
+        "{\"t\":3000042,\"y\":1,\"g\":1,\"a\":false,\"s\":\"" + long_line.substr(0, 80) + "\"}\n"
+        "{\"t\":3000042,\"y\":2,\"g\":1,\"a\":false,\"s\":\"xxxx\"}\n"
+        "{\"t\":3000042,\"y\":0,\"g\":2,\"a\":true,\"s\":\"vim\"}\n",
+        get_data(emubuf));
+
+    std::string_view first_line = "{\"t\":1000005,\"y\":0,\"g\":0,\"a\":false,\"s\":\"a\\\"b\\\\\"}\n";
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_line_mode(options, TerminalEmulatorTranscriptLineMode::cursor_move));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+        emubuf, to_u8p(ttyrec.data()), ttyrec.size(), options));
+    BOOST_CHECK_EQUAL(first_line, get_data(emubuf).substr(0, first_line.size()));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscriptJsonlExtendedChars)
+{
+    // combining characters take more than 4 bytes by cell
+    std::string line;
+    for (int i = 0; i < 38; ++i) {
+        line += "e\u20d0\u20d1\u20d2";
+    }
+    for (int i = 0; i < 42; ++i) {
+        line += "\u2500";
+    }
+    std::string const data = line + "\r\n";
+    std::string const ttyrec = make_ttyrec({{1, 0, data}});
+
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> uoptions{terminal_emulator_transcript_options_new()};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_format(uoptions.get(), TerminalEmulatorTranscriptFormat::jsonl));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_buffer_with_options(
+        uemubuf.get(), to_u8p(ttyrec.data()), ttyrec.size(), uoptions.get()));
+    BOOST_CHECK_EQUAL(
+        "{\"t\":1000000,\"y\":0,\"g\":0,\"a\":false,\"s\":\"" + line + "\"}\n",
+        get_data(uemubuf.get()));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorReplay)
+{
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);          // for localtime_r
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> utext_options{terminal_emulator_transcript_options_new()};
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> ujsonl_options{terminal_emulator_transcript_options_new()};
+    auto* text_options = utext_options.get();
+    auto* jsonl_options = ujsonl_options.get();
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_prefix(text_options, TranscriptPrefix::datetime));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_format(jsonl_options, TerminalEmulatorTranscriptFormat::jsonl));
+
+    auto transcript = [](TerminalEmulatorTranscriptOptions * options){
+        std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+        BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(
+            uemubuf.get(), "test/data/ttyrec1", options));
+        return std::string(get_data(uemubuf.get()));
+    };
+
+    std::unique_ptr<TerminalEmulatorBuffer> utextbuf{terminal_emulator_buffer_new()};
+    std::unique_ptr<TerminalEmulatorBuffer> ujsonlbuf{terminal_emulator_buffer_new()};
+    std::unique_ptr<TerminalEmulatorBuffer> usnapshotbuf{terminal_emulator_buffer_new()};
+    auto* textbuf = utextbuf.get();
+    auto* jsonlbuf = ujsonlbuf.get();
+    auto* snapshotbuf = usnapshotbuf.get();
+
+    std::unique_ptr<TerminalEmulatorReplay> ureplay{terminal_emulator_replay_new()};
+    auto* replay = ureplay.get();
+
+    struct Frames
+    {
+        int count = 0;
+        uint32_t sec = 0;
+        std::string last_screen;
+        int error = 0;
+    };
+
+    auto frame_fn = [](void * ctx, TerminalEmulator * emu, uint32_t sec, uint32_t /*usec*/) noexcept {
+        auto& frames = *static_cast<Frames*>(ctx);
+        ++frames.count;
+        frames.sec = sec;
+        std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+        terminal_emulator_buffer_prepare(uemubuf.get(), emu, TerminalEmulatorOutputFormat::text);
+        frames.last_screen = get_data(uemubuf.get());
+        return frames.error;
+    };
+
+    Frames frames;
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_transcript(replay, textbuf, text_options));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_transcript(replay, jsonlbuf, jsonl_options));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_snapshots(replay, snapshotbuf, TerminalEmulatorOutputFormat::text, 0));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_frame_callback(replay, frame_fn, &frames));
+
+    // same buffer
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_transcript(replay, textbuf, text_options));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_snapshots(replay, textbuf, TerminalEmulatorOutputFormat::text, 0));
+    // options which drive the emulator
+    std::unique_ptr<TerminalEmulatorBuffer> uotherbuf{terminal_emulator_buffer_new()};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_line_mode(jsonl_options, TerminalEmulatorTranscriptLineMode::commit));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_transcript(replay, uotherbuf.get(), jsonl_options));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_transcript_options_set_line_mode(jsonl_options, TerminalEmulatorTranscriptLineMode::cursor_move));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_snapshots(replay, uotherbuf.get(), TerminalEmulatorOutputFormat(42), 0));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_frame_callback(replay, nullptr, nullptr));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_ttyrec_file(replay, "test/data/ttyrec1"));
+
+    BOOST_CHECK_EQUAL(transcript(text_options), get_data(textbuf));
+    BOOST_CHECK_EQUAL(transcript(jsonl_options), get_data(jsonlbuf));
+    BOOST_CHECK_EQUAL(frames.last_screen + "\n", get_data(snapshotbuf));
+    BOOST_CHECK_EQUAL(1511972946, frames.sec);
+    BOOST_CHECK_GT(frames.count, 1);
+
+    // stopped by a sink
+    frames.error = 42;
+    BOOST_CHECK_EQUAL(42, terminal_emulator_replay_ttyrec_file(replay, "test/data/ttyrec1"));
+    BOOST_CHECK_EQUAL(get_data(snapshotbuf), "");
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorReplayScreenshots)
+{
+    std::string const ttyrec = make_ttyrec({
+        {1, 0, "a"},
+        {3, 500000, "b"},
+        {5, 0, "c"},
+    });
+
+    auto screen = [](std::string_view data){
+        std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(20, 80)};
+        std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+        terminal_emulator_feed(uemu.get(), to_u8p(data.data()), data.size());
+        terminal_emulator_buffer_prepare(uemubuf.get(), uemu.get(), TerminalEmulatorOutputFormat::text);
+        return std::string(get_data(uemubuf.get()));
+    };
+
+    struct Screenshots
+    {
+        std::vector<std::tuple<std::size_t, uint64_t, std::string>> results;
+        int error = 0;
+    };
+
+    auto screenshot_fn = [](void * ctx, std::size_t i, uint64_t time, uint8_t const * data, std::size_t len) noexcept {
+        auto& screenshots = *static_cast<Screenshots*>(ctx);
+        screenshots.results.emplace_back(i, time, std::string(const_bytes_t(data).to_charp(), len));
+        return screenshots.error;
+    };
+
+    using Results = std::vector<std::tuple<std::size_t, uint64_t, std::string>>;
+
+    uint64_t const times[] {500000, 1000000, 2000000, 3500000, 4000000, 9000000};
+    uint64_t const unsorted_times[] {2000000, 1000000};
+
+    Screenshots list;
+    Screenshots every;
+    std::unique_ptr<TerminalEmulatorReplay> ureplay{terminal_emulator_replay_new()};
+    auto* replay = ureplay.get();
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_screenshots(
+        replay, TerminalEmulatorOutputFormat::text, times, std::size(times), screenshot_fn, &list));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_screenshots_every(
+        replay, TerminalEmulatorOutputFormat::text, 1000000, screenshot_fn, &every));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_screenshots(
+        replay, TerminalEmulatorOutputFormat::text, unsorted_times, 2, screenshot_fn, &list));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_screenshots(
+        replay, TerminalEmulatorOutputFormat(42), times, 1, screenshot_fn, &list));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_screenshots_every(
+        replay, TerminalEmulatorOutputFormat::text, 0, screenshot_fn, &every));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_ttyrec_buffer(replay, to_u8p(ttyrec.data()), ttyrec.size()));
+    BOOST_CHECK(list.results == (Results{
+        {0, 500000, screen("")},
+        {1, 1000000, screen("a")},
+        {2, 2000000, screen("a")},
+        {3, 3500000, screen("ab")},
+        {4, 4000000, screen("ab")},
+        {5, 9000000, screen("abc")},
+    }));
+    BOOST_CHECK(every.results == (Results{
+        {0, 1000000, screen("a")},
+        {1, 2000000, screen("a")},
+        {2, 3000000, screen("a")},
+        {3, 4000000, screen("ab")},
+        {4, 5000000, screen("abc")},
+    }));
+
+    // time window
+    list = Screenshots();
+    every = Screenshots();
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_set_time_window(replay, 2, 5));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_ttyrec_buffer(replay, to_u8p(ttyrec.data()), ttyrec.size()));
+    BOOST_CHECK(list.results == (Results{
+        {2, 2000000, screen("a")},
+        {3, 3500000, screen("ab")},
+        {4, 4000000, screen("ab")},
+    }));
+    BOOST_CHECK(every.results == (Results{
+        {0, 3500000, screen("ab")},
+        {1, 4500000, screen("ab")},
+    }));
+
+    // stopped by a sink
+    list = Screenshots();
+    list.error = 42;
+    BOOST_CHECK_EQUAL(42, terminal_emulator_replay_ttyrec_buffer(replay, to_u8p(ttyrec.data()), ttyrec.size()));
+    BOOST_CHECK_EQUAL(1, list.results.size());
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorReplayTimeline)
+{
+    std::string const ttyrec = make_ttyrec({
+        {1, 0, "ab\r\n"},
+        {1, 500000, "\033[2J"},
+        {3, 200000, "\033[?1049hxyz"},
+        {3, 300000, "\033[?1049l\033c"},
+    });
+
+    std::unique_ptr<TerminalEmulatorBuffer> utimelinebuf{terminal_emulator_buffer_new()};
+    std::unique_ptr<TerminalEmulatorBuffer> uhalfbuf{terminal_emulator_buffer_new()};
+    auto* timelinebuf = utimelinebuf.get();
+    auto* halfbuf = uhalfbuf.get();
+
+    std::unique_ptr<TerminalEmulatorReplay> ureplay{terminal_emulator_replay_new()};
+    auto* replay = ureplay.get();
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_timeline(replay, timelinebuf, 1000));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_timeline(replay, halfbuf, 500));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_timeline(replay, timelinebuf, 1000));
+    std::unique_ptr<TerminalEmulatorBuffer> uotherbuf{terminal_emulator_buffer_new()};
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_timeline(replay, uotherbuf.get(), 0));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_ttyrec_buffer(replay, to_u8p(ttyrec.data()), ttyrec.size()));
+    BOOST_CHECK_EQUAL(
+        "{\"t\":1000000,\"b\":8,\"c\":4,\"l\":1,\"e\":true,\"r\":false,\"a\":false}\n"
+        "{\"t\":3000000,\"b\":21,\"c\":6,\"l\":3,\"e\":true,\"r\":true,\"a\":true}\n",
+        get_data(timelinebuf));
+    BOOST_CHECK_EQUAL(
+        "{\"t\":1000000,\"b\":4,\"c\":2,\"l\":0,\"e\":false,\"r\":false,\"a\":false}\n"
+        "{\"t\":1500000,\"b\":4,\"c\":2,\"l\":1,\"e\":true,\"r\":false,\"a\":false}\n"
+        "{\"t\":3000000,\"b\":21,\"c\":6,\"l\":3,\"e\":true,\"r\":true,\"a\":true}\n",
+        get_data(halfbuf));
+
+    // time window
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_set_time_window(replay, 2, 10));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_ttyrec_buffer(replay, to_u8p(ttyrec.data()), ttyrec.size()));
+    BOOST_CHECK_EQUAL(
+        "{\"t\":3000000,\"b\":21,\"c\":6,\"l\":3,\"e\":true,\"r\":true,\"a\":true}\n",
+        get_data(timelinebuf));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorKeywordAlert)
+{
+    char const* patterns[]{"rm -rf", "drop table", "BEGIN RSA"};
+    BOOST_CHECK(!terminal_emulator_keyword_matcher_new(nullptr, 1, 0));
+    std::unique_ptr<TerminalEmulatorKeywordMatcher> umatcher{
+        terminal_emulator_keyword_matcher_new(patterns, 3, 1)};
+    auto* matcher = umatcher.get();
+    BOOST_REQUIRE(matcher);
+
+    struct Alerts
+    {
+        std::string matches;
+        uint32_t sec = 0;
+        int error = 0;
+    };
+
+    auto alert_fn = [](void * ctx, std::size_t pattern_id, int row, uint32_t sec, uint32_t /*usec*/) noexcept {
+        auto& alerts = *static_cast<Alerts*>(ctx);
+        alerts.matches += std::to_string(pattern_id) + ":" + std::to_string(row) + " ";
+        alerts.sec = sec;
+        return alerts.error;
+    };
+
+    Alerts alerts;
+
+    // live emulator
+    std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(4, 10)};
+    auto* emu = uemu.get();
+    auto feed = [&](std::string_view s){
+        return terminal_emulator_feed(emu, to_u8p(s.data()), s.size());
+    };
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_set_keyword_alert(emu, matcher, nullptr, nullptr));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_keyword_alert(emu, matcher, alert_fn, &alerts));
+
+    BOOST_CHECK_EQUAL(0, feed("$ sudo RM -Rf /\r\n"));
+    BOOST_CHECK_EQUAL(0, feed("a\r\nb\r\nc\r\n"));
+    BOOST_CHECK_EQUAL("0:1 ", alerts.matches);
+    BOOST_CHECK_GT(alerts.sec, 1500000000);
+    BOOST_CHECK_EQUAL(0, feed("DROP TABLE"));
+    BOOST_CHECK_EQUAL("0:1 ", alerts.matches);
+    BOOST_CHECK_EQUAL(0, terminal_emulator_finish(emu));
+    BOOST_CHECK_EQUAL("0:1 1:3 ", alerts.matches);
+
+    alerts.error = 42;
+    BOOST_CHECK_EQUAL(0, feed("\r\nBEGIN RSA"));
+    BOOST_CHECK_EQUAL(42, terminal_emulator_finish(emu));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_finish(emu));
+    BOOST_CHECK_EQUAL("0:1 1:3 2:3 ", alerts.matches);
+
+    alerts = Alerts();
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_keyword_alert(emu, nullptr, nullptr, nullptr));
+    BOOST_CHECK_EQUAL(0, feed("\r\nrm -rf\r\n\r\n\r\n\r\n"));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_finish(emu));
+    BOOST_CHECK_EQUAL("", alerts.matches);
+
+    // disabled with pending lines
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_keyword_alert(emu, matcher, alert_fn, &alerts));
+    BOOST_CHECK_EQUAL(0, feed("a\r\nb\r\n"));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_keyword_alert(emu, nullptr, nullptr, nullptr));
+    BOOST_CHECK_EQUAL(0, feed("c\r\nd\r\ne\r\nf\r\n"));
+    BOOST_CHECK_EQUAL("", alerts.matches);
+
+    // replay
+    std::string const ttyrec = make_ttyrec({
+        {1, 0, "ls\r\n"},
+        {5, 0, "rm -rf /tmp/x\r\n"},
+        {10, 0, "ok\r\n"},
+    });
+
+    std::unique_ptr<TerminalEmulatorReplay> ureplay{terminal_emulator_replay_new()};
+    auto* replay = ureplay.get();
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_replay_add_keyword_alert(replay, nullptr, alert_fn, &alerts));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_keyword_alert(replay, matcher, alert_fn, &alerts));
+
+    // lines are committed at end of stream
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_ttyrec_buffer(replay, to_u8p(ttyrec.data()), ttyrec.size()));
+    BOOST_CHECK_EQUAL("0:1 ", alerts.matches);
+    BOOST_CHECK_EQUAL(10, alerts.sec);
+
+    // with a transcript, the lines of the transcript are searched
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    std::unique_ptr<TerminalEmulatorTranscriptOptions> uoptions{terminal_emulator_transcript_options_new()};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_transcript(replay, uemubuf.get(), uoptions.get()));
+    alerts = Alerts();
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_ttyrec_buffer(replay, to_u8p(ttyrec.data()), ttyrec.size()));
+    BOOST_CHECK_EQUAL("0:1 ", alerts.matches);
+    BOOST_CHECK_EQUAL(5, alerts.sec);
+    BOOST_CHECK_EQUAL("ls\nrm -rf /tmp/x\nok\n", get_data(uemubuf.get()));
+
+    // stopped by an alert
+    alerts = Alerts();
+    alerts.error = 42;
+    BOOST_CHECK_EQUAL(42, terminal_emulator_replay_ttyrec_buffer(replay, to_u8p(ttyrec.data()), ttyrec.size()));
+    BOOST_CHECK_EQUAL("0:1 ", alerts.matches);
+    BOOST_CHECK_EQUAL("ls\nrm -rf /tmp/x\n", get_data(uemubuf.get()));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorFrameIndex)
+{
+    struct Frame
+    {
+        uint32_t sec;
+        uint32_t usec;
+        std::string screen;
+    };
+
+    auto frame_fn = [](void * ctx, TerminalEmulator * emu, uint32_t sec, uint32_t usec) noexcept {
+        std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+        terminal_emulator_buffer_prepare(uemubuf.get(), emu, TerminalEmulatorOutputFormat::json);
+        static_cast<std::vector<Frame>*>(ctx)->push_back({sec, usec, std::string(get_data(uemubuf.get()))});
+        return 0;
+    };
+
+    std::vector<Frame> frames;
+    std::unique_ptr<TerminalEmulatorReplay> ureplay{terminal_emulator_replay_new()};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_add_frame_callback(ureplay.get(), frame_fn, &frames));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_replay_ttyrec_file(ureplay.get(), "test/data/ttyrec1"));
+    BOOST_REQUIRE_GT(frames.size(), 10);
+
+    std::unique_ptr<TerminalEmulatorFrameIndex> ubuilt{terminal_emulator_frame_index_new()};
+    std::unique_ptr<TerminalEmulatorFrameIndex> uloaded{terminal_emulator_frame_index_new()};
+    auto* built = ubuilt.get();
+    auto* loaded = uloaded.get();
+
+    char const * index_file = "/tmp/emu_frame_index.idx";
+    unlink(index_file);
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_frame_index_save(built, index_file));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_frame_index_build_from_ttyrec_file(
+        built, "test/data/ttyrec1", 20, 80, 1, 4096));
+    BOOST_CHECK_EQUAL(frames.size(), terminal_emulator_frame_index_frame_count(built));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_frame_index_save(built, index_file));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_frame_index_load(loaded, index_file));
+    BOOST_CHECK_EQUAL(frames.size(), terminal_emulator_frame_index_frame_count(loaded));
+
+    std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(3, 3)};
+    auto* emu = uemu.get();
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emubuf = uemubuf.get();
+
+    auto seek = [&](TerminalEmulatorFrameIndex * index, uint32_t sec, uint32_t usec){
+        BOOST_CHECK_EQUAL(0, terminal_emulator_frame_index_seek(index, emu, "test/data/ttyrec1", sec, usec));
+        terminal_emulator_buffer_prepare(emubuf, emu, TerminalEmulatorOutputFormat::json);
+        return std::string(get_data(emubuf));
+    };
+
+    for (auto* index : {built, loaded}) {
+        for (std::size_t i : {std::size_t(0), std::size_t(1), frames.size() / 3, frames.size() / 2, frames.size() - 1}) {
+            uint32_t sec = 0;
+            uint32_t usec = 0;
+            BOOST_CHECK_EQUAL(0, terminal_emulator_frame_index_get_frame_time(index, i, &sec, &usec));
+            BOOST_CHECK_EQUAL(frames[i].sec, sec);
+            BOOST_CHECK_EQUAL(frames[i].usec, usec);
+            // last frame with this time
+            while (i + 1 < frames.size() && frames[i + 1].sec == sec && frames[i + 1].usec == usec) {
+                ++i;
+            }
+            BOOST_CHECK_EQUAL(frames[i].screen, seek(index, sec, usec));
+        }
+
+        // before the first frame
+        std::unique_ptr<TerminalEmulator> ufresh{terminal_emulator_new(20, 80)};
+        terminal_emulator_buffer_prepare(emubuf, ufresh.get(), TerminalEmulatorOutputFormat::json);
+        std::string const fresh_screen(get_data(emubuf));
+        BOOST_CHECK_EQUAL(fresh_screen, seek(index, frames[0].sec - 1, 0));
+        BOOST_CHECK_EQUAL(frames.back().screen, seek(index, ~uint32_t(), 0));
+    }
+
+    uint32_t sec;
+    uint32_t usec;
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_frame_index_get_frame_time(loaded, frames.size(), &sec, &usec));
+
+    // ttyrec which does not match the index
+    std::ofstream("/tmp/emu_frame_index_small.ttyrec") << std::string("\1\0\0\0\0\0\0\0\1\0\0\0a", 13);
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_frame_index_seek(loaded, emu, "/tmp/emu_frame_index_small.ttyrec", 0, 0));
+    BOOST_CHECK_EQUAL(ENOENT, terminal_emulator_frame_index_seek(loaded, emu, "/unknown/file", 0, 0));
+
+    // frame body truncated in a ttyrec with the indexed size
+    char const * body_file = "/tmp/emu_frame_index_body.ttyrec";
+    std::ofstream(body_file) << make_ttyrec({{1, 0, "ab"}, {2, 0, "cd"}});
+    std::unique_ptr<TerminalEmulatorFrameIndex> ubody{terminal_emulator_frame_index_new()};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_frame_index_build_from_ttyrec_file(ubody.get(), body_file, 4, 10, 0, 0));
+    std::ofstream(body_file) << make_ttyrec({{1, 0, "ab"}, {2, 0, "cd"}}).replace(22, 1, "\3");
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_frame_index_seek(ubody.get(), emu, body_file, 2, 0));
+
+    // invalid or truncated index file
+    std::string index_data = get_file_contents(index_file);
+    for (std::size_t len : {std::size_t(3), index_data.size() / 2, index_data.size() - 1}) {
+        std::ofstream(index_file) << index_data.substr(0, len);
+        BOOST_CHECK_EQUAL(-1, terminal_emulator_frame_index_load(loaded, index_file));
+    }
+    BOOST_CHECK_EQUAL(frames.size(), terminal_emulator_frame_index_frame_count(loaded));
+
+    // truncated ttyrec
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_frame_index_build_from_ttyrec_file(
+        loaded, "/tmp/emu_frame_index.idx", 20, 80, 1, 0));
+    BOOST_CHECK_EQUAL(frames.size(), terminal_emulator_frame_index_frame_count(loaded));
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_frame_index_build_from_ttyrec_file(
+        loaded, "test/data/ttyrec1", 0, 80, 1, 0));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_frame_index_seek(nullptr, emu, "test/data/ttyrec1", 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorSerialize)
+{
+    std::unique_ptr<TerminalEmulator> usrc{terminal_emulator_new(4, 12)};
+    std::unique_ptr<TerminalEmulator> udst{terminal_emulator_new(3, 3)};
+    std::unique_ptr<TerminalEmulatorBuffer> ustate{terminal_emulator_buffer_new()};
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* src = usrc.get();
+    auto* dst = udst.get();
+    auto* state = ustate.get();
+    auto* emubuf = uemubuf.get();
+
+    auto render = [&](TerminalEmulator * emu){
+        BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare(emubuf, emu, TerminalEmulatorOutputFormat::json));
+        return std::string(get_data(emubuf));
+    };
+
+    // partial escape sequence and partial UTF-8 character
+    std::string_view const input = "\033]2;title\007ab\033[1;31mcd\033[2;5r\r\ne\u0301f\033[3";
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_title(src, "title"));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(src, to_u8p(input.data()), input.size()));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(src, to_u8p("\xC3"), 1));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_serialize(src, state));
+    std::string const data(get_data(state));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_deserialize(dst, to_u8p(data.data()), data.size()));
+    BOOST_CHECK_EQUAL(render(src), render(dst));
+
+    std::string_view const next = "\xA9;4Hgh\033[mij";
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(src, to_u8p(next.data()), next.size()));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(dst, to_u8p(next.data()), next.size()));
+    BOOST_CHECK_EQUAL(render(src), render(dst));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_serialize(src, state));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_deserialize(dst, to_u8p(get_data(state).data()), get_data(state).size()));
+    BOOST_CHECK_EQUAL(render(src), render(dst));
+
+    // invalid state: dst is reset with its previous size
+    std::unique_ptr<TerminalEmulator> ufresh{terminal_emulator_new(4, 12)};
+    std::string const fresh_screen = render(ufresh.get());
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_deserialize(dst, to_u8p(data.data()), data.size() - 1));
+    BOOST_CHECK_EQUAL(fresh_screen, render(dst));
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_deserialize(dst, nullptr, 0));
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_serialize(nullptr, state));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_serialize(src, nullptr));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_deserialize(nullptr, to_u8p(data.data()), data.size()));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_deserialize(dst, nullptr, 1));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorJournal)
+{
+    std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(4, 12)};
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    auto* emu = uemu.get();
+    auto* emubuf = uemubuf.get();
+
+    auto render = [&]{
+        BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare(emubuf, emu, TerminalEmulatorOutputFormat::json));
+        return std::string(get_data(emubuf));
+    };
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_undo_frame(emu));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_journal(emu, 64 * 1024));
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_undo_frame(emu));
+
+    std::string_view const frames[] {
+        "\033]2;title\007abc\r\n",
+        "\033[1;32mdef\033[2;3r\xC3",
+        "\xA9\033[?1049halternate",
+        "\033[?1049l\r\n\r\n\r\nscroll\033[",
+    };
+    std::vector<std::string> screens;
+    for (std::string_view frame : frames) {
+        screens.push_back(render());
+        BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emu, to_u8p(frame.data()), frame.size()));
+    }
+    BOOST_CHECK_EQUAL(std::size(frames), terminal_emulator_journal_frame_count(emu));
+
+    std::string const last_screen = render();
+    for (std::size_t i = std::size(frames); i-- > 0;) {
+        BOOST_CHECK_EQUAL(0, terminal_emulator_undo_frame(emu));
+        BOOST_CHECK_EQUAL(screens[i], render());
+    }
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_undo_frame(emu));
+
+    for (std::string_view frame : frames) {
+        BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emu, to_u8p(frame.data()), frame.size()));
+    }
+    BOOST_CHECK_EQUAL(last_screen, render());
+
+    // cleared by a modification outside a frame
+    BOOST_CHECK_EQUAL(0, terminal_emulator_resize(emu, 5, 12));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_journal_frame_count(emu));
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_set_journal(emu, 0));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_undo_frame(emu));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_set_journal(nullptr, 1024));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorRemoveNoopFrames)
+{
+    std::string const ttyrec = make_ttyrec({
+        {1, 0, "ab"},
+        {2, 0, "\033[31m"},
+        {3, 0, "\033]2;title\007"},
+        {4, 0, "\033[?25l\033[?25h"},
+        {5, 0, "c"},
+        {100, 0, "\033[0m"},
+    });
+
+    char const * infile = "/tmp/emu_noop_frames.ttyrec";
+    char const * outfile = "/tmp/emu_noop_frames.out.ttyrec";
+    {
+        std::ofstream f(infile, std::ios::binary);
+        f << ttyrec;
+    }
+
+    auto read_outfile = [&]{
+        std::string content(4096, '\0');
+        int fd = open(outfile, O_RDONLY);
+        ssize_t const n = read(fd, content.data(), content.size());
+        close(fd);
+        content.resize(n > 0 ? std::size_t(n) : 0);
+        return content;
+    };
+
+    uint64_t frame_counts[2] {};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_ttyrec_remove_noop_frames(infile, outfile, 4, 10, 0, frame_counts));
+    BOOST_CHECK_EQUAL(6, frame_counts[0]);
+    BOOST_CHECK_EQUAL(4, frame_counts[1]);
+    BOOST_CHECK_EQUAL(make_ttyrec({
+        {1, 0, "ab"},
+        {3, 0, "\033[31m\033]2;title\007"},
+        {5, 0, "\033[?25l\033[?25hc"},
+        {100, 0, "\033[0m"},
+    }), read_outfile());
+
+    // idle gaps are reduced to 10s
+    BOOST_CHECK_EQUAL(0, terminal_emulator_ttyrec_remove_noop_frames(infile, outfile, 4, 10, 10000, nullptr));
+    BOOST_CHECK_EQUAL(make_ttyrec({
+        {1, 0, "ab"},
+        {3, 0, "\033[31m\033]2;title\007"},
+        {5, 0, "\033[?25l\033[?25hc"},
+        {15, 0, "\033[0m"},
+    }), read_outfile());
+
+    // truncated
+    {
+        std::ofstream f(infile, std::ios::binary);
+        f << ttyrec.substr(0, ttyrec.size() - 2);
+    }
+    BOOST_CHECK_EQUAL(-1, terminal_emulator_ttyrec_remove_noop_frames(infile, outfile, 4, 10, 0, frame_counts));
+    BOOST_CHECK_EQUAL(5, frame_counts[0]);
+    BOOST_CHECK_EQUAL(3, frame_counts[1]);
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_ttyrec_remove_noop_frames(infile, outfile, 0, 10, 0, nullptr));
+    BOOST_CHECK_EQUAL(ENOENT, terminal_emulator_ttyrec_remove_noop_frames("/tmp/emu_noop_frames_no_file", outfile, 4, 10, 0, nullptr));
+
+    unlink(infile);
+    unlink(outfile);
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorReencodeFrames)
+{
+    char const * infile = "/tmp/emu_reencode.ttyrec";
+    char const * outfile = "/tmp/emu_reencode.out.ttyrec";
+    {
+        std::ofstream f(infile, std::ios::binary);
+        f << make_ttyrec({
+            {1, 0, "ab"},
+            {2, 0, "\033[31m"},
+            {3, 0, "c\033[1;1Hd"},
+            {4, 0, "\033[0m\033[31m"},
+            {100, 0, "\033[3;1H\033[31me"},
+        });
+    }
+
+    uint64_t frame_counts[2] {};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_ttyrec_reencode(infile, outfile, 4, 10, 10000, frame_counts));
+    BOOST_CHECK_EQUAL(5, frame_counts[0]);
+    BOOST_CHECK_EQUAL(3, frame_counts[1]);
+    BOOST_CHECK_EQUAL(make_ttyrec({
+        {1, 0, "ab"},
+        {3, 0, "\r\033[31md\033[Cc\033[2G"},
+        {13, 0, "\r\n\ne"},
+    }), get_file_contents(outfile));
+
+    // same rendering with ttyrec1
+    auto render = [](std::string_view ttyrec){
+        std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(24, 80)};
+        std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+        std::vector<std::string> screens;
+        while (ttyrec.size() >= 12) {
+            auto const* p = to_u8p(ttyrec.data());
+            std::size_t const len = p[8] | (p[9] << 8) | (p[10] << 16) | (std::size_t(p[11]) << 24);
+            BOOST_CHECK_EQUAL(0, terminal_emulator_feed(uemu.get(), p + 12, int(len)));
+            BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare(uemubuf.get(), uemu.get(), OutputFormat::json));
+            screens.emplace_back(get_data(uemubuf.get()));
+            ttyrec.remove_prefix(12 + len);
+        }
+        return screens;
+    };
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_ttyrec_reencode("test/data/ttyrec1", outfile, 24, 80, 0, frame_counts));
+    std::string const ttyrec1 = get_file_contents("test/data/ttyrec1");
+    std::string const reencoded = get_file_contents(outfile);
+    BOOST_CHECK_LT(reencoded.size(), ttyrec1.size());
+    auto const screens = render(reencoded);
+    BOOST_REQUIRE_EQUAL(frame_counts[1], screens.size());
+    auto expected_screens = render(ttyrec1);
+    expected_screens.erase(
+        std::unique(expected_screens.begin(), expected_screens.end()),
+        expected_screens.end());
+    BOOST_CHECK(expected_screens == screens);
+
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_ttyrec_reencode(infile, outfile, 4, 0, 0, nullptr));
+    BOOST_CHECK_EQUAL(ENOENT, terminal_emulator_ttyrec_reencode("/tmp/emu_reencode_no_file", outfile, 4, 10, 0, nullptr));
+
+    unlink(infile);
+    unlink(outfile);
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorMirror)
+{
+    std::unique_ptr<TerminalEmulator> uemu{terminal_emulator_new(4, 10)};
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    std::unique_ptr<TerminalEmulatorMirror> ufast{terminal_emulator_mirror_new(4, 10, 0)};
+    std::unique_ptr<TerminalEmulatorMirror> uslow{terminal_emulator_mirror_new(4, 10, 1)};
+    auto emu = uemu.get();
+    auto emubuf = uemubuf.get();
+
+    // terminals of the viewers
+    std::unique_ptr<TerminalEmulator> ufast_viewer{terminal_emulator_new(4, 10)};
+    std::unique_ptr<TerminalEmulator> uslow_viewer{terminal_emulator_new(4, 10)};
+
+    auto json = [&](TerminalEmulator * emu){
+        BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare(emubuf, emu, OutputFormat::json));
+        return std::string(get_data(emubuf));
+    };
+
+    auto update = [&](TerminalEmulatorMirror * mirror, TerminalEmulator * viewer){
+        BOOST_CHECK_EQUAL(0, terminal_emulator_mirror_update(mirror, emu, emubuf));
+        std::string const sequences(get_data(emubuf));
+        BOOST_CHECK_EQUAL(0, terminal_emulator_feed(viewer, to_u8p(sequences.data()), int(sequences.size())));
+        return sequences;
+    };
+
+    for (std::string_view s : {
+        "$ ls\r\n",
+        "\033[1;34mdir\033[0m  file\r\n",
+        "\033[31m----------\033[0m\r\n$ ",
+        "\033]2;title\007clear",
+        "\r\n\033[H\033[2J$ ",
+    }) {
+        BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emu, to_u8p(s.data()), int(s.size())));
+        update(ufast.get(), ufast_viewer.get());
+        BOOST_CHECK_EQUAL(json(emu), json(ufast_viewer.get()));
+    }
+    BOOST_CHECK_EQUAL(update(ufast.get(), ufast_viewer.get()), "");
+
+    // the intermediate states are skipped
+    BOOST_CHECK_EQUAL(update(uslow.get(), uslow_viewer.get()), "$ \033]2;title\007");
+    BOOST_CHECK_EQUAL(json(emu), json(uslow_viewer.get()));
+
+    // redraw a new viewer
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(emu, to_u8p("=========="), 10));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_mirror_reset(uslow.get()));
+    std::unique_ptr<TerminalEmulator> unew_viewer{terminal_emulator_new(4, 10)};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_feed(unew_viewer.get(), to_u8p("garbage"), 7));
+    BOOST_CHECK_EQUAL(update(uslow.get(), unew_viewer.get()), "\033c$ =\033[7b\r\n==\033[?25h\033]2;title\007");
+    BOOST_CHECK_EQUAL(json(emu), json(unew_viewer.get()));
+
+    BOOST_CHECK(!terminal_emulator_mirror_new(0, 10, 0));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_mirror_update(uslow.get(), nullptr, emubuf));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_mirror_update(nullptr, emu, emubuf));
+    BOOST_CHECK_EQUAL(-2, terminal_emulator_mirror_reset(nullptr));
+}
+
+BOOST_AUTO_TEST_CASE(TestEmulatorBufferStream)
+{
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);          // for localtime_r
+
+    std::unique_ptr<TerminalEmulatorBuffer> uemubuf{terminal_emulator_buffer_new()};
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(uemubuf.get(), "test/data/ttyrec1", TranscriptPrefix::datetime));
+    std::string const ref {get_data(uemubuf.get())};
+
+    struct Ctx
+    {
+        std::string output;
+        int nb_write = 0;
+        int error = 0;
+    };
+
+    auto write_fn = [](void * ctx, uint8_t const * data, std::size_t len) noexcept {
+        auto& out = *static_cast<Ctx*>(ctx);
+        out.output.append(const_bytes_t(data).to_charp(), len);
+        ++out.nb_write;
+        return out.error;
+    };
+
+    // block smaller than a line
+    Ctx ctx;
+    std::unique_ptr<TerminalEmulatorBuffer> ustreambuf{
+        terminal_emulator_buffer_new_stream_to_callback(&ctx, write_fn, 16)};
+    auto* streambuf = ustreambuf.get();
+
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(streambuf, "test/data/ttyrec1", TranscriptPrefix::datetime));
+    BOOST_CHECK_EQUAL(ref, ctx.output);
+    BOOST_CHECK_EQUAL(4, ctx.nb_write);
+    BOOST_CHECK_EQUAL(0, get_data(streambuf).size());
+
+    // reused
+    ctx.output.clear();
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(streambuf, "test/data/ttyrec1", TranscriptPrefix::datetime));
+    BOOST_CHECK_EQUAL(ref, ctx.output);
+
+    // several lines per block
+    Ctx ctx2;
+    ustreambuf.reset(terminal_emulator_buffer_new_stream_to_callback(&ctx2, write_fn, 8192));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(ustreambuf.get(), "test/data/ttyrec1", TranscriptPrefix::datetime));
+    BOOST_CHECK_EQUAL(ref, ctx2.output);
+    BOOST_CHECK_EQUAL(1, ctx2.nb_write);
+
+    // write error
+    ctx2.error = ENOSPC;
+    BOOST_CHECK_EQUAL(ENOSPC, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(ustreambuf.get(), "test/data/ttyrec1", TranscriptPrefix::datetime));
+
+    // file descriptor
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(0, pipe(fds));
+    ustreambuf.reset(terminal_emulator_buffer_new_stream_to_fd(fds[1], 0));
+    BOOST_CHECK_EQUAL(0, terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(ustreambuf.get(), "test/data/ttyrec1", TranscriptPrefix::datetime));
+    close(fds[1]);
+    std::string output(ref.size() + 1, '\0');
+    BOOST_CHECK_EQUAL(ref.size(), read(fds[0], output.data(), output.size()));
+    output.resize(ref.size());
+    BOOST_CHECK_EQUAL(ref, output);
+    close(fds[0]);
+
+    BOOST_CHECK(!terminal_emulator_buffer_new_stream_to_fd(-1, 0));
+    BOOST_CHECK(!terminal_emulator_buffer_new_stream_to_callback(nullptr, nullptr, 0));
+}
+
 BOOST_AUTO_TEST_CASE(TestEmulatorBufferTranscriptBigFile)
 {
     setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);          // for localtime_r
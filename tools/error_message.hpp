@@ -0,0 +1,35 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen
+*/
+
+#pragma once
+
+#include <cstring>
+
+
+/// Message of an error code returned by the terminal_emulator_* functions.
+inline char const * error_message(int errnum)
+{
+    switch (errnum) {
+        case -1: return "truncated or invalid file";
+        case -2: return "bad argument";
+        case -3: return "out of memory";
+        default: return errnum > 0 ? std::strerror(errnum) : "unknown error";
+    }
+}
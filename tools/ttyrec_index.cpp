@@ -0,0 +1,149 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen;
+*
+*   Based on Konsole, an X terminal
+*/
+
+#include "rvt_lib/terminal_emulator.hpp"
+
+#include "error_message.hpp"
+
+#include <memory>
+#include <string>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+
+static void usage(char const * name)
+{
+    std::fprintf(stderr,
+        "Usage: %s [-l lines] [-c columns] [-i keyframe_interval] [-b keyframe_bytes] ttyrec_file [index_file]\n"
+        "       %s --seek seconds[.microseconds] ttyrec_file [index_file]\n"
+        "\n"
+        "index_file is ttyrec_file.idx by default. A keyframe is added every\n"
+        "keyframe_interval seconds (60 by default) and every keyframe_bytes bytes\n"
+        "of ttyrec (8MiB by default), 0 for disable.\n"
+        "--seek writes in ANSI the screen at a time (seconds since epoch).\n",
+        name, name);
+}
+
+using FrameIndexPtr = std::unique_ptr<TerminalEmulatorFrameIndex, int(*)(TerminalEmulatorFrameIndex*)>;
+
+static int seek(char const * time, char const * infile, char const * index_file)
+{
+    char * end;
+    unsigned long const sec = std::strtoul(time, &end, 10);
+    unsigned long usec = 0;
+    if (*end == '.') {
+        std::string digits = std::string(end + 1).substr(0, 6);
+        digits.resize(6, '0');
+        usec = std::strtoul(digits.c_str(), &end, 10);
+    }
+    if (*end) {
+        return -2;
+    }
+
+    FrameIndexPtr index{terminal_emulator_frame_index_new(), terminal_emulator_frame_index_delete};
+    std::unique_ptr<TerminalEmulator, int(*)(TerminalEmulator*)> emu{
+        terminal_emulator_new(1, 1), terminal_emulator_delete};
+    std::unique_ptr<TerminalEmulatorBuffer, int(*)(TerminalEmulatorBuffer*)> buf{
+        terminal_emulator_buffer_new_stream_to_fd(1, 0), terminal_emulator_buffer_delete};
+    if (!index || !emu || !buf) {
+        return -3;
+    }
+
+    if (int errnum = terminal_emulator_frame_index_load(index.get(), index_file)) {
+        std::fprintf(stderr, "%s: %s\n", index_file, error_message(errnum));
+        return errnum;
+    }
+
+    int errnum = terminal_emulator_frame_index_seek(
+        index.get(), emu.get(), infile, uint32_t(sec), uint32_t(usec));
+    if (!errnum) {
+        errnum = terminal_emulator_buffer_prepare(buf.get(), emu.get(), TerminalEmulatorOutputFormat::ansi);
+    }
+    if (errnum) {
+        std::fprintf(stderr, "%s: %s\n", infile, error_message(errnum));
+    }
+    return errnum;
+}
+
+int main(int ac, char ** av)
+{
+    if (ac >= 4 && std::strcmp(av[1], "--seek") == 0) {
+        std::string const index_file = (ac >= 5) ? av[4] : std::string(av[3]) + ".idx";
+        int res = seek(av[2], av[3], index_file.c_str());
+        if (res == -2) {
+            usage(av[0]);
+        }
+        return res ? 1 : 0;
+    }
+
+    int lines = 24;
+    int columns = 80;
+    unsigned long keyframe_interval = 60;
+    unsigned long long keyframe_bytes = 8 * 1024 * 1024;
+
+    int opt;
+    while ((opt = getopt(ac, av, "l:c:i:b:")) != -1) {
+        switch (opt) {
+            case 'l': lines = std::atoi(optarg); break;
+            case 'c': columns = std::atoi(optarg); break;
+            case 'i': keyframe_interval = std::strtoul(optarg, nullptr, 10); break;
+            case 'b': keyframe_bytes = std::strtoull(optarg, nullptr, 10); break;
+            default: usage(av[0]); return 1;
+        }
+    }
+
+    int const nb_arg = ac - optind;
+    if (nb_arg < 1 || nb_arg > 2) {
+        usage(av[0]);
+        return 1;
+    }
+
+    char const * infile = av[optind];
+    std::string const index_file = (nb_arg == 2) ? av[optind + 1] : std::string(infile) + ".idx";
+
+    FrameIndexPtr index{terminal_emulator_frame_index_new(), terminal_emulator_frame_index_delete};
+    if (!index) {
+        return 1;
+    }
+
+    int errnum = terminal_emulator_frame_index_build_from_ttyrec_file(
+        index.get(), infile, lines, columns, uint32_t(keyframe_interval), keyframe_bytes);
+    if (errnum) {
+        std::fprintf(stderr, "%s: %s\n", infile, error_message(errnum));
+        if (errnum == -2) {
+            usage(av[0]);
+        }
+        return 1;
+    }
+
+    errnum = terminal_emulator_frame_index_save(index.get(), index_file.c_str());
+    if (errnum) {
+        std::fprintf(stderr, "%s: %s\n", index_file.c_str(), error_message(errnum));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen;
+*
+*   Based on Konsole, an X terminal
+*/
+
+#include "rvt_lib/terminal_emulator.hpp"
+
+#include "error_message.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+
+
+static void usage(char const * name)
+{
+    std::fprintf(stderr,
+        "Usage: %s [-d] [-l lines] [-c columns] [-m max_idle] ttyrec_file output_file\n"
+        "\n"
+        "Write ttyrec_file without the frames which leave the screen unchanged,\n"
+        "their bytes are merged into the next frame which changes the screen.\n"
+        "With -d, the frames are replaced with the minimal sequences which update\n"
+        "the screen (the rendering is kept, not the scrollback).\n"
+        "max_idle is the maximum time between 2 frames in milliseconds (0 by default\n"
+        "for disable), the following frames are moved back.\n",
+        name);
+}
+
+int main(int ac, char ** av)
+{
+    int lines = 24;
+    int columns = 80;
+    unsigned long max_idle = 0;
+    bool reencode = false;
+
+    int opt;
+    while ((opt = getopt(ac, av, "dl:c:m:")) != -1) {
+        switch (opt) {
+            case 'd': reencode = true; break;
+            case 'l': lines = std::atoi(optarg); break;
+            case 'c': columns = std::atoi(optarg); break;
+            case 'm': max_idle = std::strtoul(optarg, nullptr, 10); break;
+            default: usage(av[0]); return 1;
+        }
+    }
+
+    if (ac - optind != 2) {
+        usage(av[0]);
+        return 1;
+    }
+
+    char const * infile = av[optind];
+    char const * outfile = av[optind + 1];
+
+    uint64_t frame_counts[2] {};
+    int errnum = (reencode
+        ? terminal_emulator_ttyrec_reencode
+        : terminal_emulator_ttyrec_remove_noop_frames
+    )(infile, outfile, lines, columns, uint32_t(max_idle), frame_counts);
+    if (errnum) {
+        std::fprintf(stderr, "%s: %s\n", infile, error_message(errnum));
+        if (errnum == -2) {
+            usage(av[0]);
+        }
+        if (errnum != -1) {
+            return 1;
+        }
+    }
+
+    std::printf("%llu frames, %llu written\n",
+        static_cast<unsigned long long>(frame_counts[0]),
+        static_cast<unsigned long long>(frame_counts[1]));
+
+    return errnum ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+/*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 2 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*
+*   Product name: redemption, a FLOSS RDP proxy
+*   Copyright (C) Wallix 2010-2016
+*   Author(s): Jonathan Poelen;
+*
+*   Based on Konsole, an X terminal
+*/
+
+#include "rvt_lib/terminal_emulator.hpp"
+
+#include "error_message.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+
+static void usage(char const * name)
+{
+    std::fprintf(stderr,
+        "Usage: %s [-f json|ansi|text] [-o prefix] -t time[,time...] ttyrec_file\n"
+        "       %s [-f json|ansi|text] [-o prefix] -i interval ttyrec_file\n"
+        "\n"
+        "Write the screen at each time (seconds[.microseconds] since epoch, sorted)\n"
+        "or every interval seconds[.microseconds] of recording in prefix-N.format\n"
+        "(ttyrec_file-N.format by default). The ttyrec is emulated once.\n",
+        name, name);
+}
+
+/// seconds[.microseconds] to microseconds, \c end points after the parsed characters
+static bool parse_time(char const * s, char const ** end, uint64_t & time)
+{
+    char * p;
+    unsigned long long const sec = std::strtoull(s, &p, 10);
+    if (p == s) {
+        return false;
+    }
+    uint64_t usec = 0;
+    if (*p == '.') {
+        ++p;
+        for (int i = 0; i < 6; ++i) {
+            usec *= 10;
+            if ('0' <= *p && *p <= '9') {
+                usec += uint64_t(*p - '0');
+                ++p;
+            }
+        }
+        while ('0' <= *p && *p <= '9') {
+            ++p;
+        }
+    }
+    time = sec * 1000000 + usec;
+    *end = p;
+    return true;
+}
+
+static bool parse_times(char const * s, std::vector<uint64_t> & times)
+{
+    for (;;) {
+        uint64_t time;
+        if (!parse_time(s, &s, time)) {
+            return false;
+        }
+        times.push_back(time);
+        if (!*s) {
+            return true;
+        }
+        if (*s != ',') {
+            return false;
+        }
+        ++s;
+    }
+}
+
+struct Output
+{
+    std::string prefix;
+    char const * extension;
+};
+
+static int write_screenshot(void * ctx, std::size_t i, uint64_t /*time*/, uint8_t const * data, std::size_t len) noexcept
+{
+    auto& output = *static_cast<Output*>(ctx);
+    std::string const filename = output.prefix + "-" + std::to_string(i) + "." + output.extension;
+
+    FILE * f = std::fopen(filename.c_str(), "wb");
+    if (!f) {
+        int errnum = errno;
+        std::fprintf(stderr, "%s: %s\n", filename.c_str(), std::strerror(errnum));
+        return errnum ? errnum : -1;
+    }
+    bool const ok = std::fwrite(data, 1, len, f) == len;
+    if (std::fclose(f) || !ok) {
+        int errnum = errno;
+        std::fprintf(stderr, "%s: %s\n", filename.c_str(), std::strerror(errnum));
+        return errnum ? errnum : -1;
+    }
+    return 0;
+}
+
+int main(int ac, char ** av)
+{
+    auto format = TerminalEmulatorOutputFormat::ansi;
+    char const * extension = "ansi";
+    char const * prefix = nullptr;
+    std::vector<uint64_t> times;
+    uint64_t interval = 0;
+
+    int opt;
+    while ((opt = getopt(ac, av, "f:o:t:i:")) != -1) {
+        switch (opt) {
+            case 'f':
+                extension = optarg;
+                if (std::strcmp(optarg, "json") == 0) {
+                    format = TerminalEmulatorOutputFormat::json;
+                }
+                else if (std::strcmp(optarg, "ansi") == 0) {
+                    format = TerminalEmulatorOutputFormat::ansi;
+                }
+                else if (std::strcmp(optarg, "text") == 0) {
+                    format = TerminalEmulatorOutputFormat::text;
+                    extension = "txt";
+                }
+                else {
+                    usage(av[0]);
+                    return 1;
+                }
+                break;
+            case 'o': prefix = optarg; break;
+            case 't':
+                if (!parse_times(optarg, times)) {
+                    usage(av[0]);
+                    return 1;
+                }
+                break;
+            case 'i': {
+                char const * end;
+                if (!parse_time(optarg, &end, interval) || *end || !interval) {
+                    usage(av[0]);
+                    return 1;
+                }
+                break;
+            }
+            default: usage(av[0]); return 1;
+        }
+    }
+
+    if (ac - optind != 1 || (times.empty() == !interval)) {
+        usage(av[0]);
+        return 1;
+    }
+
+    char const * infile = av[optind];
+    Output output{prefix ? prefix : infile, extension};
+
+    std::unique_ptr<TerminalEmulatorReplay, int(*)(TerminalEmulatorReplay*)> replay{
+        terminal_emulator_replay_new(), terminal_emulator_replay_delete};
+    if (!replay) {
+        return 1;
+    }
+
+    int errnum = interval
+        ? terminal_emulator_replay_add_screenshots_every(
+            replay.get(), format, interval, write_screenshot, &output)
+        : terminal_emulator_replay_add_screenshots(
+            replay.get(), format, times.data(), times.size(), write_screenshot, &output);
+    if (errnum) {
+        std::fprintf(stderr, "%s\n", error_message(errnum));
+        if (errnum == -2) {
+            usage(av[0]);
+        }
+        return 1;
+    }
+
+    errnum = terminal_emulator_replay_ttyrec_file(replay.get(), infile);
+    if (errnum) {
+        std::fprintf(stderr, "%s: %s\n", infile, error_message(errnum));
+        return 1;
+    }
+
+    return 0;
+}
@@ -22,14 +22,90 @@
 
 #include "rvt_lib/terminal_emulator.hpp"
 
+#include "error_message.hpp"
+
+#include <memory>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+static void usage(char const * name)
+{
+    std::fprintf(stderr,
+        "Usage: %s [ttyrec_file]\n"
+        "       %s --batch [-j nb_thread] ttyrec_file output_file [ttyrec_file output_file]...\n",
+        name, name);
+}
+
+/// Transcript of each pair of files, the status of each file is written to stderr.
+static int batch(int ac, char ** av)
+{
+    int nb_thread = 0;
+    if (ac >= 2 && std::strcmp(av[0], "-j") == 0) {
+        nb_thread = std::atoi(av[1]);
+        ac -= 2;
+        av += 2;
+    }
+
+    if (ac == 0 || ac % 2 || nb_thread < 0) {
+        return -2;
+    }
+
+    std::size_t const n = std::size_t(ac) / 2;
+    std::vector<char const *> infiles(n);
+    std::vector<char const *> outfiles(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        infiles[i] = av[i * 2];
+        outfiles[i] = av[i * 2 + 1];
+    }
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions, int(*)(TerminalEmulatorTranscriptOptions*)> options{
+        terminal_emulator_transcript_options_new(), terminal_emulator_transcript_options_delete};
+    std::unique_ptr<TerminalEmulatorThreadPool, int(*)(TerminalEmulatorThreadPool*)> pool{
+        terminal_emulator_thread_pool_new(nb_thread), terminal_emulator_thread_pool_delete};
+    if (!options || !pool) {
+        return -3;
+    }
+    terminal_emulator_transcript_options_set_prefix(options.get(), TerminalEmulatorTranscriptPrefix::datetime);
+
+    std::vector<int> results(n);
+    int res = terminal_emulator_transcript_ttyrec_files(
+        infiles.data(), outfiles.data(), n, options.get(), pool.get(), results.data());
+
+    for (std::size_t i = 0; i < n; ++i) {
+        if (results[i]) {
+            std::fprintf(stderr, "%s: %s\n", infiles[i], error_message(results[i]));
+        }
+    }
+
+    return res;
+}
+
 int main(int ac, char ** av)
 {
-    auto* buf = terminal_emulator_buffer_new();
-    int res = terminal_emulator_buffer_prepare_transcript_from_ttyrec_file(
-        buf,
-        ac == 2 ? av[1] : "/dev/stdin",
-        TerminalEmulatorTranscriptPrefix::datetime
-    );
+    if (ac >= 2 && std::strcmp(av[1], "--batch") == 0) {
+        int res = batch(ac - 2, av + 2);
+        if (res == -2) {
+            usage(av[0]);
+        }
+        return res ? 1 : 0;
+    }
+
+    std::unique_ptr<TerminalEmulatorTranscriptOptions, int(*)(TerminalEmulatorTranscriptOptions*)> options{
+        terminal_emulator_transcript_options_new(), terminal_emulator_transcript_options_delete};
+    if (!options) {
+        return -3;
+    }
+    terminal_emulator_transcript_options_set_prefix(options.get(), TerminalEmulatorTranscriptPrefix::datetime);
+
+    auto* buf = terminal_emulator_buffer_new_stream_to_fd(1, 0);
+    // stdin is read by blocks, it can be a pipe
+    int res = (ac == 2)
+        ? terminal_emulator_buffer_prepare_transcript_from_ttyrec_file_with_options(buf, av[1], options.get())
+        : terminal_emulator_buffer_prepare_transcript_from_ttyrec_fd(buf, 0, options.get());
     terminal_emulator_buffer_delete(buf);
     return res;
 }